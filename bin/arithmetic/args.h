@@ -194,6 +194,25 @@ struct argp_option program_options[] =
       GAL_OPTIONS_NOT_SET
     },
 
+
+
+
+
+    /* Operating mode. */
+    {
+      "stackstrip",
+      UI_KEY_STACKSTRIP,
+      "INT",
+      0,
+      "Stack FITS inputs in strips of this many rows.",
+      GAL_OPTIONS_GROUP_OPERATING_MODE,
+      &p->stackstrip,
+      GAL_TYPE_SIZE_T,
+      GAL_OPTIONS_RANGE_GE_0,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
+
     {0}
   };
 
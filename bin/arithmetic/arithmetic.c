@@ -31,6 +31,8 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 #include <gnuastro/wcs.h>
 #include <gnuastro/fits.h>
+#include <gnuastro/qsort.h>
+#include <gnuastro/blank.h>
 #include <gnuastro/array.h>
 #include <gnuastro/binary.h>
 #include <gnuastro/threads.h>
@@ -40,6 +42,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/arithmetic.h>
 #include <gnuastro/interpolate.h>
 
+#include <gnuastro-internal/timing.h>
 #include <gnuastro-internal/checkset.h>
 
 #include "main.h"
@@ -196,6 +199,14 @@ struct arithmetic_filter_p
   float      sclip_param;       /* Termination critera in sigma-cliping. */
   gal_data_t      *input;       /* Input dataset.                        */
   gal_data_t        *out;       /* Output dataset.                       */
+
+  /* Only for the running (sliding-window) filters. */
+  size_t             dim;       /* Dimension of this pass (running mean).*/
+  double            *src;       /* Input of this pass (running mean).    */
+  double            *dst;       /* Output of this pass (running mean).   */
+  size_t          numcnt;       /* Number of counters (running mean).    */
+  double        *csrc[3];       /* Input numbers of elements (see below).*/
+  double        *cdst[3];       /* Output numbers of elements.           */
 };
 
 
@@ -359,6 +370,499 @@ arithmetic_filter(void *in_prm)
 
 
 
+/* Running (sliding-window) mean.
+
+   The sum over a box-shaped window is separable: it can be found by
+   summing over the window's width along each dimension independently.
+   Along each dimension, the sum is also updated incrementally when going
+   from one pixel to the next (adding the element that enters the window
+   and subtracting the one that leaves it). So irrespective of the filter
+   size, each pixel is only visited twice in each dimension. To avoid the
+   accumulation of round-off errors along long lines, the sum is found
+   from scratch once every window width (doubling the number of
+   additions).
+
+   In every pass, the data are viewed as a 3D array of 'outer x n x
+   inner' elements (where 'n' is the length along this pass's dimension,
+   'outer' is the product of the lengths of the slower dimensions and
+   'inner' is the product of the lengths of the faster dimensions). The
+   running sum is then done on contiguous groups of 'inner' elements
+   (rows of the 3D array), making it cache-friendly along all
+   dimensions. Each action of this function is one 'outer' index and a
+   group of at most 'ARITHMETIC_FILTER_CHUNK' inner elements.
+
+   When all the input elements are finite, the number of elements in
+   each window is just the product of the widths along each dimension, so
+   we can divide by the width in each pass (and avoid keeping the number
+   of elements). Otherwise, the non-finite elements are not added to the
+   sum (one infinity would make the sum NaN after it leaves the window)
+   and the numbers of finite, positive infinity and negative infinity
+   elements are summed in the same way (in the 'numcnt' counters: only
+   the first when there are no infinities). In the end, the sums are
+   divided by the number of finite elements, or the output is an
+   infinity (or NaN when both infinities are in the window), like the
+   mean of the window's elements. The counters are integers, so their
+   running sums are exact. */
+#define ARITHMETIC_FILTER_CHUNK   256
+#define ARITHMETIC_FILTER_NUMCNT  3
+static void *
+arithmetic_filter_mean_pass(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct arithmetic_filter_p *afp=(struct arithmetic_filter_p *)tprm->params;
+  size_t d=afp->dim, *dsize=afp->input->dsize, ndim=afp->input->ndim;
+
+  double w, *s, *c;
+  double *src=afp->src, *dst=afp->dst;
+  size_t i, j, k, x, y, o, lo, hi, base, inner=1, numchunks, n=dsize[d];
+  size_t hn=afp->hnfsize[d], hp=afp->hpfsize[d], i0, i1, nw, numcnt;
+  double acc[ARITHMETIC_FILTER_CHUNK];
+  double cacc[ARITHMETIC_FILTER_NUMCNT][ARITHMETIC_FILTER_CHUNK];
+
+  /* Number of elements in the faster dimensions and the number of
+     chunks that they are divided into. */
+  numcnt=afp->numcnt;
+  for(j=d+1;j<ndim;++j) inner*=dsize[j];
+  numchunks = inner/ARITHMETIC_FILTER_CHUNK
+              + (inner%ARITHMETIC_FILTER_CHUNK ? 1 : 0);
+
+  /* Go over all the actions that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Find the range of inner elements and starting element. */
+      o  = tprm->indexs[i] / numchunks;
+      i0 = tprm->indexs[i] % numchunks * ARITHMETIC_FILTER_CHUNK;
+      i1 = i0+ARITHMETIC_FILTER_CHUNK < inner ? i0+ARITHMETIC_FILTER_CHUNK
+                                              : inner;
+      nw = i1-i0;
+      base = o*n*inner + i0;
+
+      /* Initialize the running counters with the rows that are within the
+         window of the first element (the sum is initialized within the
+         loop below). */
+      for(k=0;k<numcnt;++k)
+        {
+          for(j=0;j<nw;++j) cacc[k][j]=0.0f;
+          for(x=0; x<=hp && x<n; ++x)
+            {
+              c=afp->csrc[k]+base+x*inner;
+              for(j=0;j<nw;++j) cacc[k][j]+=c[j];
+            }
+        }
+
+      /* Go along this dimension. */
+      for(x=0;x<n;++x)
+        {
+          /* Range of this element's window. */
+          lo = x>hn ? x-hn : 0;
+          hi = x+hp<n ? x+hp : n-1;
+
+          /* Find the sum from scratch on the first element and once in
+             every window width. */
+          if( x % (hn+hp+1) == 0 )
+            {
+              for(j=0;j<nw;++j) acc[j]=0.0f;
+              for(y=lo;y<=hi;++y)
+                {
+                  s=src+base+y*inner;
+                  for(j=0;j<nw;++j) acc[j]+=s[j];
+                }
+            }
+
+          /* Write the output of this row. */
+          s=dst+base+x*inner;
+          if(numcnt)
+            {
+              for(j=0;j<nw;++j) s[j]=acc[j];
+              for(k=0;k<numcnt;++k)
+                {
+                  c=afp->cdst[k]+base+x*inner;
+                  for(j=0;j<nw;++j) c[j]=cacc[k][j];
+                }
+            }
+          else
+            {
+              w = hi-lo+1;
+              for(j=0;j<nw;++j) s[j]=acc[j]/w;
+            }
+
+          /* Remove the row that leaves the window and add the row that
+             enters it (if they are within the dataset). */
+          if(x>=hn)
+            {
+              s=src+base+(x-hn)*inner;
+              for(j=0;j<nw;++j) acc[j]-=s[j];
+              for(k=0;k<numcnt;++k)
+                {
+                  c=afp->csrc[k]+base+(x-hn)*inner;
+                  for(j=0;j<nw;++j) cacc[k][j]-=c[j];
+                }
+            }
+          if(x+hp+1<n)
+            {
+              s=src+base+(x+hp+1)*inner;
+              for(j=0;j<nw;++j) acc[j]+=s[j];
+              for(k=0;k<numcnt;++k)
+                {
+                  c=afp->csrc[k]+base+(x+hp+1)*inner;
+                  for(j=0;j<nw;++j) cacc[k][j]+=c[j];
+                }
+            }
+        }
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+static void
+arithmetic_filter_mean(struct arithmeticparams *p,
+                       struct arithmetic_filter_p *afp)
+{
+  double *o, *of, *cnt, *pinf, *ninf;
+  size_t i, k, d, inner, numchunks, ndim=afp->input->ndim;
+  gal_data_t *sum, *buf[2], *cbuf[ARITHMETIC_FILTER_NUMCNT][2]={{NULL}};
+
+  /* Copy the input into a 64-bit floating point array (blank elements
+     will become NaN). The output of each pass is the input of the next,
+     so the two arrays are used alternatively. */
+  sum=gal_data_copy_to_new_type(afp->input, GAL_TYPE_FLOAT64);
+  buf[0]=sum;
+  buf[1]=afp->out;
+
+  /* See if there are non-finite elements: one counter is necessary when
+     there are only blank (NaN) elements, and all three when there are
+     infinities (see the comments above 'arithmetic_filter_mean_pass'). */
+  afp->numcnt=0;
+  of=(o=sum->array)+sum->size;
+  do
+    if( !isfinite(*o) )
+      {
+        if( isnan(*o) ) { if(afp->numcnt==0) afp->numcnt=1; }
+        else { afp->numcnt=ARITHMETIC_FILTER_NUMCNT; break; }
+      }
+  while(++o<of);
+
+  /* Allocate the counters and set the non-finite elements to zero (so
+     they don't affect the sum). */
+  if(afp->numcnt)
+    {
+      for(k=0;k<afp->numcnt;++k)
+        for(i=0;i<2;++i)
+          cbuf[k][i]=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, ndim,
+                                    afp->input->dsize, NULL, 0,
+                                    p->cp.minmapsize, p->cp.quietmmap,
+                                    NULL, NULL, NULL);
+      cnt=cbuf[0][0]->array;
+      pinf = afp->numcnt>1 ? cbuf[1][0]->array : NULL;
+      ninf = afp->numcnt>1 ? cbuf[2][0]->array : NULL;
+      of=(o=sum->array)+sum->size;
+      do
+        {
+          *cnt++ = isfinite(*o) ? 1.0f : 0.0f;
+          if(pinf)
+            {
+              *pinf++ = isinf(*o) && *o>0 ? 1.0f : 0.0f;
+              *ninf++ = isinf(*o) && *o<0 ? 1.0f : 0.0f;
+            }
+          if( !isfinite(*o) ) *o=0.0f;
+        }
+      while(++o<of);
+    }
+
+  /* Do the passes, starting from the fastest dimension. */
+  for(i=0;i<ndim;++i)
+    {
+      /* Set the parameters of this pass. */
+      d=ndim-1-i;
+      afp->dim=d;
+      afp->src=buf[i%2]->array;
+      afp->dst=buf[(i+1)%2]->array;
+      for(k=0;k<afp->numcnt;++k)
+        {
+          afp->csrc[k]=cbuf[k][i%2]->array;
+          afp->cdst[k]=cbuf[k][(i+1)%2]->array;
+        }
+
+      /* Number of actions in this pass (see the comments above
+         'arithmetic_filter_mean_pass'). */
+      inner=afp->input->size/gal_dimension_total_size(d+1,
+                                                      afp->input->dsize);
+      numchunks = inner/ARITHMETIC_FILTER_CHUNK
+                  + (inner%ARITHMETIC_FILTER_CHUNK ? 1 : 0);
+      gal_threads_spin_off_schedule(arithmetic_filter_mean_pass, afp,
+                          gal_dimension_total_size(d, afp->input->dsize)
+                                    * numchunks, p->cp.numthreads,
+                                    GAL_THREADS_SCHEDULE_BLOCK, 0,
+                                    p->cp.minmapsize, p->cp.quietmmap);
+    }
+
+  /* The number of passes is the number of dimensions, so with an even
+     number of dimensions, the final result is in 'sum'. */
+  if(ndim%2==0)
+    memcpy(afp->out->array, sum->array, sum->size*sizeof *o);
+
+  /* When there were non-finite values, divide the sum by the number of
+     finite elements, or set the infinity of the window (the final numbers
+     are in the same array as the final sums). */
+  if(afp->numcnt)
+    {
+      cnt=cbuf[0][ndim%2]->array;
+      pinf = afp->numcnt>1 ? cbuf[1][ndim%2]->array : NULL;
+      ninf = afp->numcnt>1 ? cbuf[2][ndim%2]->array : NULL;
+      of=(o=afp->out->array)+afp->out->size;
+      do
+        {
+          if( pinf && (*pinf || *ninf) )
+            *o = *pinf && *ninf ? NAN : ( *pinf ? INFINITY : -INFINITY );
+          else
+            *o = *cnt ? *o / *cnt : NAN;
+          ++cnt;
+          if(pinf) { ++pinf; ++ninf; }
+        }
+      while(++o<of);
+      for(k=0;k<afp->numcnt;++k)
+        { gal_data_free(cbuf[k][0]); gal_data_free(cbuf[k][1]); }
+    }
+
+  /* Clean up. */
+  gal_data_free(sum);
+}
+
+
+
+
+
+/* Running (sliding-window) median.
+
+   Each action is one line of the output along the fastest dimension. The
+   (non-blank) elements within the window of each pixel are counted in a
+   Fenwick (binary indexed) tree. When going from one pixel to the next
+   along the line, only the elements that leave and enter the window (one
+   for each line of the window along the fastest dimension) are removed
+   from or added to the tree, and the median is found by descending the
+   tree. So the work for each pixel doesn't depend on the width of the
+   window (and no memory is allocated within the line).
+
+   For the 8 and 16 bit integer types, the tree is a histogram of all the
+   possible values (like Huang's median filter). For the other types, the
+   elements of all the lines of the window (along the full length of the
+   output line) are sorted once and the tree is built over their ranks:
+   'rank' keeps the rank of each element and 'sorted' keeps the value of
+   each rank. The median is then found in the same way as
+   'gal_statistics_median'.
+
+   The 'offs' array keeps the index of the first element of each line of
+   the window (along the fastest dimension) in the input. */
+static void
+arithmetic_filter_median_add(size_t *tree, size_t n, size_t key, int add)
+{
+  for(++key; key<=n; key += key & -key)
+    if(add) ++tree[key]; else --tree[key];
+}
+
+
+
+
+
+/* Return the key of the 'k'-th (counting from one) smallest element in
+   the tree ('top' is the largest power of two that is not larger than
+   'n'). */
+static size_t
+arithmetic_filter_median_kth(size_t *tree, size_t n, size_t top, size_t k)
+{
+  size_t pos=0, step;
+  for(step=top; step; step>>=1)
+    if(pos+step<=n && tree[pos+step]<k)
+      { pos+=step; k-=tree[pos]; }
+  return pos;
+}
+
+
+
+
+
+#define FILTER_MEDIAN_UPDATE(X, ADD) {                                  \
+    for(k=0;k<noffs;++k)                                                \
+      {                                                                 \
+        if(hist)                                                        \
+          {                                                             \
+            v=in[offs[k]+(X)];                                          \
+            key = ( (b==b ? v!=b : v==v)                                \
+                    ? (size_t)((int64_t)v-hmin) : GAL_BLANK_SIZE_T );   \
+          }                                                             \
+        else key=rank[k*nx+(X)];                                        \
+        if(key!=GAL_BLANK_SIZE_T)                                       \
+          {                                                             \
+            arithmetic_filter_median_add(tree, n, key, ADD);            \
+            if(ADD) ++nw; else --nw;                                    \
+          }                                                             \
+      }                                                                 \
+  }
+#define FILTER_MEDIAN_VALUE(IT, K) ( hist                               \
+    ? (IT)((int64_t)arithmetic_filter_median_kth(tree, n, top, K)+hmin) \
+    : sorted[arithmetic_filter_median_kth(tree, n, top, K)] )
+#define FILTER_MEDIAN_LINE(IT) {                                        \
+    size_t *rank=NULL, *sidx=NULL;                                      \
+    int hist = sizeof(IT)<=2;     /* Only integers have 1 or 2 bytes. */\
+    int64_t hmin=0;                                                     \
+    IT b, v, *in=afp->input->array, *out=afp->out->array;               \
+    IT *band=NULL, *sorted=NULL;                                        \
+    gal_blank_write(&b, afp->input->type);                              \
+                                                                        \
+    /* Allocate the tree and the arrays for sorting. */                 \
+    if(hist)                                                            \
+      {                                                                 \
+        nmax = sizeof(IT)==1 ? 256 : 65536;                             \
+        if( (IT)(-1)<0 ) hmin=-(int64_t)nmax/2;                         \
+      }                                                                 \
+    else                                                                \
+      {                                                                 \
+        nmax=noffsmax*nx;                                               \
+        band=gal_pointer_allocate(afp->input->type, 2*nmax, 0,          \
+                                  __func__, "band");                    \
+        sorted=band+nmax;                                               \
+        rank=gal_pointer_allocate(GAL_TYPE_SIZE_T, 2*nmax, 0,           \
+                                  __func__, "rank");                    \
+        sidx=rank+nmax;                                                 \
+      }                                                                 \
+    tree=gal_pointer_allocate(GAL_TYPE_SIZE_T, nmax+1, 0, __func__,     \
+                              "tree");                                  \
+                                                                        \
+    for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)                  \
+      {                                                                 \
+        /* Starting index of the line and the window's lines. */        \
+        ind=tprm->indexs[i]*nx;                                         \
+        noffs=arithmetic_filter_median_offs(afp, ind, offs);            \
+                                                                        \
+        /* Sort the non-blank elements of the window's lines. */        \
+        if(hist) n=nmax;                                                \
+        else                                                            \
+          {                                                             \
+            for(n=k=0;k<noffs;++k)                                      \
+              for(x=0;x<nx;++x)                                         \
+                {                                                       \
+                  v = band[k*nx+x] = in[offs[k]+x];                     \
+                  rank[k*nx+x]=GAL_BLANK_SIZE_T;                        \
+                  if( b==b ? v!=b : v==v ) sidx[n++]=k*nx+x;            \
+                }                                                       \
+            gal_qsort_index_radix(sidx, n, band, afp->input->type, 0,   \
+                                  1, -1, 1);                            \
+            for(j=0;j<n;++j) { rank[sidx[j]]=j; sorted[j]=band[sidx[j]]; }\
+          }                                                             \
+        memset(tree, 0, (n+1)*sizeof *tree);                            \
+        for(top=1; top<=n/2; top*=2);                                   \
+                                                                        \
+        /* Go along the line, note that the loop starts before the */   \
+        /* first pixel to fill the window of the first pixel. */        \
+        nw=0;                                                           \
+        for(x=-(hp+1); x!=nx; ++x)                                      \
+          {                                                             \
+            /* Remove the elements that leave the window and add */     \
+            /* those that enter it. */                                  \
+            if(x-hn-1<nx) { FILTER_MEDIAN_UPDATE(x-hn-1, 0); }          \
+            if(x+hp<nx)   { FILTER_MEDIAN_UPDATE(x+hp,   1); }          \
+                                                                        \
+            /* Write the median (when the window is complete). */       \
+            if(x<nx)                                                    \
+              out[ind+x] = ( nw                                         \
+                             ? ( nw%2                                   \
+                                 ? FILTER_MEDIAN_VALUE(IT, nw/2+1)      \
+                                 : ( FILTER_MEDIAN_VALUE(IT, nw/2+1)    \
+                                     + FILTER_MEDIAN_VALUE(IT, nw/2) )/2 )\
+                             : b );                                     \
+          }                                                             \
+      }                                                                 \
+    if(band) free(band);                                                \
+    if(rank) free(rank);                                                \
+    free(tree);                                                         \
+  }
+
+static size_t
+arithmetic_filter_median_offs(struct arithmetic_filter_p *afp, size_t ind,
+                              size_t *offs)
+{
+  size_t *dsize=afp->input->dsize, ndim=afp->input->ndim;
+  size_t j, noffs=1, coord[ARITHMETIC_FILTER_DIM];
+  size_t start[ARITHMETIC_FILTER_DIM], end[ARITHMETIC_FILTER_DIM];
+
+  /* Find the range of the window along the slower dimensions (like
+     'arithmetic_filter', we are dealing with unsigned integers here). */
+  gal_dimension_index_to_coord(ind, ndim, dsize, coord);
+  for(j=0;j<ndim-1;++j)
+    {
+      start[j] = ( coord[j] - afp->hnfsize[j] > dsize[j]
+                   ? 0 : coord[j] - afp->hnfsize[j] );
+      end[j]   = ( coord[j] + afp->hpfsize[j] >= dsize[j]
+                   ? dsize[j] : coord[j] + afp->hpfsize[j] + 1 );
+      noffs *= end[j]-start[j];
+      coord[j]=start[j];
+    }
+
+  /* Go over all the lines within the window (the fastest dimension's
+     coordinate is already zero, since 'ind' is the start of a line). */
+  for(j=0;j<noffs;++j)
+    {
+      offs[j]=gal_dimension_coord_to_index(ndim, dsize, coord);
+      if(ndim>1)
+        {
+          /* Increment the coordinate like an odometer. */
+          for(ind=ndim-2; ++coord[ind]==end[ind] && ind>0; --ind)
+            coord[ind]=start[ind];
+        }
+    }
+  return noffs;
+}
+
+static void *
+arithmetic_filter_median(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct arithmetic_filter_p *afp=(struct arithmetic_filter_p *)tprm->params;
+  size_t ndim=afp->input->ndim, nx=afp->input->dsize[ndim-1];
+
+  size_t *offs, *tree, noffs, noffsmax=1;
+  size_t i, j, k, n, x, nw, ind, key, top, nmax;
+  size_t hn=afp->hnfsize[ndim-1], hp=afp->hpfsize[ndim-1];
+
+  /* Allocate the array to keep the lines of the window. */
+  for(j=0;j<ndim-1;++j) noffsmax*=afp->fsize[j];
+  offs=gal_pointer_allocate(GAL_TYPE_SIZE_T, noffsmax, 0, __func__,
+                            "offs");
+
+  /* Do the operation on all the lines assigned to this thread. */
+  switch(afp->input->type)
+    {
+    case GAL_TYPE_UINT8:     FILTER_MEDIAN_LINE( uint8_t  );    break;
+    case GAL_TYPE_INT8:      FILTER_MEDIAN_LINE( int8_t   );    break;
+    case GAL_TYPE_UINT16:    FILTER_MEDIAN_LINE( uint16_t );    break;
+    case GAL_TYPE_INT16:     FILTER_MEDIAN_LINE( int16_t  );    break;
+    case GAL_TYPE_UINT32:    FILTER_MEDIAN_LINE( uint32_t );    break;
+    case GAL_TYPE_INT32:     FILTER_MEDIAN_LINE( int32_t  );    break;
+    case GAL_TYPE_UINT64:    FILTER_MEDIAN_LINE( uint64_t );    break;
+    case GAL_TYPE_INT64:     FILTER_MEDIAN_LINE( int64_t  );    break;
+    case GAL_TYPE_FLOAT32:   FILTER_MEDIAN_LINE( float    );    break;
+    case GAL_TYPE_FLOAT64:   FILTER_MEDIAN_LINE( double   );    break;
+    default:
+      error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+            __func__, afp->input->type);
+    }
+
+  /* Clean up, wait for all the other threads to finish, then return. */
+  free(offs);
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
 static void
 wrapper_for_filter(struct arithmeticparams *p, char *token, int operator)
 {
@@ -532,10 +1036,31 @@ wrapper_for_filter(struct arithmeticparams *p, char *token, int operator)
                              NULL);
 
 
-      /* Spin off threads for each pixel. */
-      gal_threads_spin_off(arithmetic_filter, &afp, afp.input->size,
-                           p->cp.numthreads, p->cp.minmapsize,
-                           p->cp.quietmmap);
+      /* The median and mean have running (sliding-window) algorithms
+         that don't need to parse the full window for each pixel. */
+      switch(operator)
+        {
+        case ARITHMETIC_OP_FILTER_MEAN:
+          arithmetic_filter_mean(p, &afp);
+          break;
+
+        case ARITHMETIC_OP_FILTER_MEDIAN:
+          gal_threads_spin_off_schedule(arithmetic_filter_median, &afp,
+                             afp.input->size/afp.input->dsize[ndim-1],
+                                        p->cp.numthreads,
+                                        GAL_THREADS_SCHEDULE_BLOCK, 0,
+                                        p->cp.minmapsize, p->cp.quietmmap);
+          break;
+
+        /* Spin off threads for each pixel. Each thread is given a
+           contiguous block of pixels so the windows of neighbouring
+           pixels (that mostly overlap) are read by the same thread. */
+        default:
+          gal_threads_spin_off_schedule(arithmetic_filter, &afp,
+                                        afp.input->size, p->cp.numthreads,
+                                        GAL_THREADS_SCHEDULE_BLOCK, 0,
+                                        p->cp.minmapsize, p->cp.quietmmap);
+        }
     }
 
 
@@ -680,7 +1205,8 @@ arithmetic_connected_components(struct arithmeticparams *p, char *token)
   conn_int=arithmetic_binary_sanity_checks(in, conn, token);
 
   /* Do the connected components labeling. */
-  gal_binary_connected_components(in, &out, conn_int);
+  gal_binary_connected_components_threads(in, &out, conn_int,
+                                          p->cp.numthreads);
 
   /* Push the result onto the stack. */
   operands_add(p, NULL, out);
@@ -835,7 +1361,8 @@ arithmetic_interpolate_region(struct arithmeticparams *p,
   /* Build a binary image with the blank regions masked and label them,
      then free the flagged array. */
   flag=gal_blank_flag(in);
-  numlabs=gal_binary_connected_components(flag, &lab, con[0]);
+  numlabs=gal_binary_connected_components_threads(flag, &lab, con[0],
+                                                  p->cp.numthreads);
   gal_data_free(flag);
 
   /* Allocate array to keep maximum values for each region. Just note that
@@ -1435,6 +1962,324 @@ arithmetic_repeat(struct arithmeticparams *p, char *token, int operator)
 
 
 
+/***************************************************************/
+/*************          Streamed stacking          *************/
+/***************************************************************/
+/* Parameters for reading one strip (a range of rows along the slowest
+   dimension) of all the stacked images. */
+struct arithmetic_stream_params
+{
+  fitsfile        **fptrs;   /* CFITSIO pointers (same order as list). */
+  int            datatype;   /* CFITSIO type of the inputs.            */
+  void             *blank;   /* Blank value to use when reading.       */
+  size_t          rowsize;   /* Number of elements in each row.        */
+  size_t             row0;   /* First row of the strip to read.        */
+  size_t            nrows;   /* Number of rows in the strip to read.   */
+  gal_data_t      *strip;    /* List of datasets to read the strip in. */
+};
+
+
+
+
+
+/* Open the HDUs of the top 'numop' operands on the stack if they are all
+   FITS images (that haven't been read yet) with the same type and size
+   (after removing extra dimensions). If so, the CFITSIO pointers are
+   returned (in the same order that the stacking operator will see them:
+   the first operand on the command-line first) and 'type', 'ndim' and
+   'dsize' are set. Otherwise, NULL is returned and nothing is changed. */
+static fitsfile **
+arithmetic_stream_open(struct arithmeticparams *p, size_t numop,
+                       int *type, size_t *ndim, size_t **dsize)
+{
+  fitsfile **fptrs;
+  char *name, *unit;
+  struct operand *op;
+  int status=0, ttype, same=0;
+  size_t i, j, tndim, *tdsize;
+
+  /* Make sure all the operands are unread FITS images. */
+  for(i=0, op=p->operands; i<numop; ++i, op=op->next)
+    if( op==NULL || op->filename==NULL || op->hdu==NULL
+        || gal_fits_file_recognized(op->filename)==0
+        || gal_fits_hdu_format(op->filename, op->hdu, "--hdu")!=IMAGE_HDU )
+      return NULL;
+
+  /* Open them all and make sure they have the same type and size. */
+  errno=0;
+  fptrs=malloc(numop*sizeof *fptrs);
+  if(fptrs==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'fptrs'",
+          __func__, numop*sizeof *fptrs);
+  for(i=0, op=p->operands; i<numop; ++i, op=op->next)
+    {
+      name=unit=NULL;
+      fptrs[numop-1-i]=gal_fits_hdu_open_format(op->filename, op->hdu, 0,
+                                                "--hdu");
+      gal_fits_img_info(fptrs[numop-1-i], &ttype, &tndim, &tdsize,
+                        &name, &unit);
+      tndim=gal_dimension_remove_extra(tndim, tdsize, NULL);
+      if(name) free(name);
+      if(unit) free(unit);
+
+      /* Keep the first, compare the rest with it. */
+      if(i==0) { *type=ttype; *ndim=tndim; *dsize=tdsize; same=1; }
+      else
+        {
+          same = ttype==*type && tndim==*ndim;
+          for(j=0; same && j<tndim; ++j)
+            if(tdsize[j]!=(*dsize)[j]) same=0;
+          free(tdsize);
+        }
+      if(same==0 || tndim==0) break;
+    }
+
+  /* If any of the inputs was different, close the opened files (the
+     standard method will report the problem). */
+  if(i<numop)
+    {
+      for(j=0;j<=i;++j)
+        {
+          fits_close_file(fptrs[numop-1-j], &status);
+          gal_fits_io_error(status, NULL);
+        }
+      free(*dsize);
+      free(fptrs);
+      return NULL;
+    }
+
+  /* Return the pointers. */
+  return fptrs;
+}
+
+
+
+
+
+/* Read one strip of all the inputs (this is run on a separate thread, so
+   the next strip is read while the current one is being stacked). */
+static void *
+arithmetic_stream_read(void *in_prm)
+{
+  struct arithmetic_stream_params *sp=
+    (struct arithmetic_stream_params *)in_prm;
+
+  size_t i;
+  gal_data_t *tmp;
+  int anynul=0, status=0;
+  size_t num=sp->nrows*sp->rowsize;
+
+  for(i=0, tmp=sp->strip; tmp!=NULL; ++i, tmp=tmp->next)
+    {
+      if( fits_read_img(sp->fptrs[i], sp->datatype,
+                        sp->row0*sp->rowsize+1, num, sp->blank,
+                        tmp->array, &anynul, &status) )
+        gal_fits_io_error(status, NULL);
+      tmp->dsize[0]=sp->nrows;
+      tmp->size=num;
+    }
+  return NULL;
+}
+
+
+
+
+
+/* Stack the top 'numop' operands with the 'operator' stacking operator
+   without reading them completely into memory: the same strip of rows of
+   all the inputs is read, stacked and copied into the output before
+   going to the next strip (while each strip is being stacked, the next
+   one is read on another thread). So the necessary memory is only two
+   strips of all inputs (and the output). If the operands can't be
+   streamed (for example they are not all FITS images), NULL is
+   returned and the stack isn't touched. */
+static gal_data_t *
+arithmetic_stream(struct arithmeticparams *p, int operator,
+                  size_t numop, gal_data_t *params, int flags)
+{
+  int type;
+  pthread_t reader;
+  fitsfile **fptrs;
+  struct operand *op;
+  struct arithmetic_stream_params sp;
+  int i, status=0, nextflags=flags;
+  gal_data_t *tmp, *ttmp, *sout, *out=NULL, *strips[2]={NULL, NULL};
+  size_t j, s, w, ndim, nstrips, *dsize, *sdsize, numrows, maxrows;
+
+  /* Only the stacking operators (that produce one value per pixel from
+     the same pixel of all inputs) can be streamed. The 'maskfilled'
+     operators return all the inputs, so they can't be streamed. */
+  switch(operator)
+    {
+    case GAL_ARITHMETIC_OP_MIN:
+    case GAL_ARITHMETIC_OP_MAX:
+    case GAL_ARITHMETIC_OP_SUM:
+    case GAL_ARITHMETIC_OP_STD:
+    case GAL_ARITHMETIC_OP_MAD:
+    case GAL_ARITHMETIC_OP_MEAN:
+    case GAL_ARITHMETIC_OP_NUMBER:
+    case GAL_ARITHMETIC_OP_MEDIAN:
+    case GAL_ARITHMETIC_OP_QUANTILE:
+    case GAL_ARITHMETIC_OP_SIGCLIP_MAD:
+    case GAL_ARITHMETIC_OP_MADCLIP_MAD:
+    case GAL_ARITHMETIC_OP_SIGCLIP_STD:
+    case GAL_ARITHMETIC_OP_MADCLIP_STD:
+    case GAL_ARITHMETIC_OP_SIGCLIP_MEAN:
+    case GAL_ARITHMETIC_OP_MADCLIP_MEAN:
+    case GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN:
+    case GAL_ARITHMETIC_OP_MADCLIP_MEDIAN:
+      break;
+    default:
+      return NULL;
+    }
+
+  /* Open the inputs (if they can be streamed). */
+  fptrs=arithmetic_stream_open(p, numop, &type, &ndim, &dsize);
+  if(fptrs==NULL) return NULL;
+
+  /* Set the size of each strip. */
+  numrows=dsize[0];
+  maxrows = p->stackstrip < numrows ? p->stackstrip : numrows;
+  nstrips=(numrows+maxrows-1)/maxrows;
+  sdsize=gal_pointer_allocate(GAL_TYPE_SIZE_T, ndim, 0, __func__,
+                              "sdsize");
+  for(j=0;j<ndim;++j) sdsize[j]=dsize[j];
+  sdsize[0]=maxrows;
+
+  /* Allocate the two buffers (each is a list of 'numop' strips). */
+  for(i=0;i<2;++i)
+    for(j=0;j<numop;++j)
+      gal_list_data_add_alloc(&strips[i], NULL, type, ndim, sdsize, NULL,
+                              0, p->cp.minmapsize, p->cp.quietmmap,
+                              NULL, NULL, NULL);
+
+  /* Set the reading parameters. */
+  sp.fptrs=fptrs;
+  sp.blank=gal_blank_alloc_write(type);
+  sp.datatype=gal_fits_type_to_datatype(type);
+  sp.rowsize=gal_dimension_total_size(ndim, dsize)/numrows;
+
+  /* Remove the operands from the stack and keep the reference
+     information (similar to 'operands_pop'). */
+  for(j=0;j<numop;++j)
+    {
+      op=p->operands;
+      if(!p->cp.quiet)
+        printf(" - Stream: %s (hdu %s).\n", op->filename, op->hdu);
+      p->operands=op->next;
+      free(op->hdu);
+      free(op);
+    }
+  p->popcounter+=numop;
+  if(p->refdata.ndim==0)
+    {
+      p->refdata.ndim=ndim;
+      p->refdata.dsize=gal_pointer_allocate(GAL_TYPE_SIZE_T, ndim, 0,
+                                            __func__, "p->refdata.dsize");
+      for(j=0;j<ndim;++j) p->refdata.dsize[j]=dsize[j];
+    }
+  if(!p->cp.quiet)
+    printf(" - Stacking %zu inputs in %zu strip(s) of %zu rows.\n",
+           numop, nstrips, maxrows);
+
+  /* The strips (and parameters) are re-used, so they must not be freed
+     or over-written by the operator. */
+  nextflags &= ~(GAL_ARITHMETIC_FLAG_FREE | GAL_ARITHMETIC_FLAG_INPLACE);
+
+  /* Read the first strip. */
+  sp.row0=0;
+  sp.nrows=maxrows;
+  sp.strip=strips[0];
+  arithmetic_stream_read(&sp);
+
+  /* Go over the strips. */
+  for(s=0;s<nstrips;++s)
+    {
+      /* Start reading the next strip (into the other buffer). */
+      if(s+1<nstrips)
+        {
+          sp.row0=(s+1)*maxrows;
+          sp.strip=strips[(s+1)%2];
+          sp.nrows = sp.row0+maxrows > numrows ? numrows-sp.row0 : maxrows;
+          errno=pthread_create(&reader, NULL, arithmetic_stream_read, &sp);
+          if(errno)
+            error(EXIT_FAILURE, errno, "%s: can't create thread for "
+                  "reading the next strip", __func__);
+        }
+
+      /* Stack this strip. */
+      sout=gal_arithmetic(operator, p->cp.numthreads, nextflags,
+                          strips[s%2], params);
+
+      /* In the first strip, allocate the full output(s) (the clipping
+         operators also return the number of used inputs). */
+      if(out==NULL)
+        {
+          for(tmp=sout; tmp!=NULL; tmp=tmp->next)
+            gal_list_data_add_alloc(&out, NULL, tmp->type, ndim, dsize,
+                                    NULL, 0, p->cp.minmapsize,
+                                    p->cp.quietmmap, NULL, NULL, NULL);
+          gal_list_data_reverse(&out);
+        }
+
+      /* Copy the stacked strip into the output(s). */
+      for(tmp=out, ttmp=sout; tmp!=NULL; tmp=tmp->next, ttmp=ttmp->next)
+        {
+          w=gal_type_sizeof(tmp->type);
+          memcpy( (char *)(tmp->array) + s*maxrows*sp.rowsize*w,
+                  ttmp->array, ttmp->size*w );
+        }
+      gal_list_data_free(sout);
+
+      /* Wait for the next strip to be read. */
+      if(s+1<nstrips)
+        {
+          errno=pthread_join(reader, NULL);
+          if(errno)
+            error(EXIT_FAILURE, errno, "%s: joining the reading thread",
+                  __func__);
+        }
+    }
+
+  /* Clean up. The strips of the last (possibly smaller) strip have their
+     sizes changed, so reset them before freeing. */
+  for(i=0;i<2;++i)
+    for(tmp=strips[i]; tmp!=NULL; tmp=tmp->next)
+      { tmp->dsize[0]=maxrows; tmp->size=maxrows*sp.rowsize; }
+  gal_list_data_free(strips[0]);
+  gal_list_data_free(strips[1]);
+  for(j=0;j<numop;++j)
+    {
+      fits_close_file(fptrs[j], &status);
+      gal_fits_io_error(status, NULL);
+    }
+  gal_list_data_free(params);
+  free(sp.blank);
+  free(sdsize);
+  free(dsize);
+  free(fptrs);
+  return out;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /***************************************************************/
 /*************      Reverse Polish algorithm       *************/
 /***************************************************************/
@@ -1647,6 +2492,12 @@ arithmetic_operator_run(struct arithmeticparams *p, int operator,
              linked list of any number of operands within the single 'd1'
              pointer. */
           numop=pop_number_of_operands(p, operator, operator_string, &d2);
+          if( p->stackstrip
+              && (d1=arithmetic_stream(p, operator, numop, d2, flags)) )
+            {
+              operands_add(p, NULL, d1);
+              return;
+            }
           for(i=0;i<numop;++i)
             gal_list_data_add(&d1, operands_pop(p, operator_string));
           break;
@@ -1911,9 +2762,10 @@ arithmetic_final_data(struct arithmeticparams *p)
 void
 reversepolish(struct arithmeticparams *p)
 {
+  struct timeval t1;
   char *printnum=NULL;
   struct operand *otmp;
-  size_t num_operands=0;
+  size_t nbytes=0, num_operands=0;
   gal_list_str_t *token;
   gal_data_t *tmp, *data, *col;
   struct gal_options_common_params *cp=&p->cp;
@@ -2040,12 +2892,25 @@ reversepolish(struct arithmeticparams *p)
                         p->onedonstdout ? NULL : p->cp.output,
                         "ARITHMETIC", 0, 0);
       else
-        for(tmp=data; tmp!=NULL; tmp=tmp->next)
-          gal_fits_img_write(tmp, p->cp.output, NULL, 0);
+        {
+          gettimeofday(&t1, NULL);
+          for(tmp=data; tmp!=NULL; tmp=tmp->next)
+            {
+              gal_fits_img_write_threads(tmp, p->cp.output, NULL, 0,
+                                         p->cp.numthreads);
+              nbytes += tmp->size * gal_type_sizeof(tmp->type);
+            }
+        }
 
       /* Let the user know that the job is done. */
       if(!p->cp.quiet)
-        printf(" - Write (final): %s\n", p->cp.output);
+        {
+          if(nbytes)
+            printf(" - Write (final): %s (%.1f MB/s)\n", p->cp.output,
+                   gal_timing_rate(&t1, nbytes));
+          else
+            printf(" - Write (final): %s\n", p->cp.output);
+        }
     }
 
 
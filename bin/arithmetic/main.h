@@ -91,6 +91,7 @@ struct arithmeticparams
 
   /* Operating mode: */
   int        wcs_collapsed;  /* If the internal WCS is already collapsed.*/
+  size_t        stackstrip;  /* Rows in each strip of streamed stacking.*/
 
   /* Internal: */
   uint8_t          envseed;  /* To setup the random number generator.   */
@@ -33,6 +33,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/fits.h>
 #include <gnuastro/tiff.h>
 #include <gnuastro/array.h>
+#include <gnuastro-internal/timing.h>
 #include <gnuastro-internal/checkset.h>
 #include <gnuastro-internal/arithmetic-set.h>
 
@@ -224,6 +225,7 @@ gal_data_t *
 operands_pop(struct arithmeticparams *p, char *operator)
 {
   size_t i;
+  struct timeval t1;
   gal_data_t *data;
   char *filename, *hdu;
   struct operand *operands=p->operands;
@@ -242,9 +244,15 @@ operands_pop(struct arithmeticparams *p, char *operator)
       hdu=operands->hdu;
       filename=operands->filename;
 
-      /* Read the dataset and remove possibly extra dimensions. */
-      data=gal_array_read_one_ch(filename, hdu, NULL, p->cp.minmapsize,
-                                 p->cp.quietmmap, "--hdu");
+      /* Read the dataset and remove possibly extra dimensions (FITS
+         images are read with multiple threads). */
+      gettimeofday(&t1, NULL);
+      data = ( gal_fits_file_recognized(filename)
+               ? gal_fits_img_read_threads(filename, hdu, p->cp.minmapsize,
+                                           p->cp.quietmmap, p->cp.numthreads,
+                                           "--hdu")
+               : gal_array_read_one_ch(filename, hdu, NULL, p->cp.minmapsize,
+                                       p->cp.quietmmap, "--hdu") );
       data->ndim=gal_dimension_remove_extra(data->ndim, data->dsize, NULL);
 
       /* When the reference data structure's dimensionality is non-zero, it
@@ -271,7 +279,9 @@ operands_pop(struct arithmeticparams *p, char *operator)
         }
 
       /* Report the read image if desired: */
-      if(!p->cp.quiet) printf(" - Read: %s (hdu %s).\n", filename, hdu);
+      if(!p->cp.quiet)
+        printf(" - Read: %s (hdu %s, %.1f MB/s).\n", filename, hdu,
+               gal_timing_rate(&t1, data->size*gal_type_sizeof(data->type)));
 
       /* Free the HDU string: */
       if(hdu) free(hdu);
@@ -275,6 +275,24 @@ struct argp_option program_options[] =
 
 
 
+    /* Operating mode. */
+    {
+      "bandrows",
+      UI_KEY_BANDROWS,
+      "INT",
+      0,
+      "Read inputs in bands of this many rows.",
+      GAL_OPTIONS_GROUP_OPERATING_MODE,
+      &p->bandrows,
+      GAL_TYPE_SIZE_T,
+      GAL_OPTIONS_RANGE_GE_0,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
+
+
+
+
 
     /* Upper limit magnitude configurations. */
     {
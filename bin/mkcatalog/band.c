@@ -0,0 +1,209 @@
+/*********************************************************************
+MakeCatalog - Make a catalog from an input and labeled image.
+MakeCatalog is part of GNU Astronomy Utilities (Gnuastro) package.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <config.h>
+
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <errno.h>
+#include <error.h>
+#include <stdlib.h>
+
+#include <gnuastro/data.h>
+#include <gnuastro/fits.h>
+#include <gnuastro/blank.h>
+#include <gnuastro/dimension.h>
+
+#include "main.h"
+
+#include "band.h"
+
+
+
+
+
+/* With '--bandrows', the input images are not read into memory at the
+   start. Only one band of rows (that is contiguous in the FITS data
+   unit) of each input is read at a time, see 'mkcatalog_band'. The
+   functions here do the reading. */
+
+
+
+
+
+/* Read the type and size of an input image, without reading its
+   pixels. */
+static size_t *
+band_info(char *filename, char *hdu, int *type, size_t *ndim, char **unit,
+          char *hdu_option_name)
+{
+  int status=0;
+  size_t *dsize;
+  fitsfile *fptr;
+
+  /* Only FITS images can be read in parts. */
+  if( gal_fits_file_recognized(filename)==0 )
+    error(EXIT_FAILURE, 0, "%s: only FITS images can be read in bands "
+          "of rows (with '--bandrows')", filename);
+
+  /* Read the basic information and close the file. */
+  fptr=gal_fits_hdu_open_format(filename, hdu, 0, hdu_option_name);
+  gal_fits_img_info(fptr, type, ndim, &dsize, NULL, unit);
+  if( fits_close_file(fptr, &status) ) gal_fits_io_error(status, NULL);
+
+  /* Remove extra (length-one) dimensions like when reading the full
+     image. */
+  *ndim=gal_dimension_remove_extra(*ndim, dsize, NULL);
+  return dsize;
+}
+
+
+
+
+
+/* In band mode, 'p->objects' only has the type and size of the labeled
+   image (its 'array' is NULL): its pixels are read one band at a
+   time. The type of the labels in the file is written in 'intype'. */
+gal_data_t *
+band_objects(struct mkcatalogparams *p, uint8_t *intype)
+{
+  int type;
+  gal_data_t *out;
+  size_t d, ndim, *dsize;
+
+  /* Read the image information. */
+  dsize=band_info(p->objectsfile, p->cp.hdu, &type, &ndim, NULL, "--hdu");
+  *intype=type;
+
+  /* Build the meta-data structure. */
+  out=gal_data_alloc_empty(ndim, p->cp.minmapsize, p->cp.quietmmap);
+  out->size=1;
+  out->type=GAL_TYPE_INT32;
+  for(d=0;d<ndim;++d) out->size *= out->dsize[d] = dsize[d];
+
+  /* Clean up and return. */
+  free(dsize);
+  return out;
+}
+
+
+
+
+
+/* Allocate the dataset to keep one band of the given input. The input
+   must have the same size as the labeled image and the values will be
+   read with the given type. */
+gal_data_t *
+band_alloc(struct mkcatalogparams *p, char *filename, char *hdu,
+           uint8_t type, char *hdu_option_name)
+{
+  gal_data_t *out;
+  char *unit=NULL;
+  int intype, different=0;
+  gal_data_t *objects=p->objects;
+  size_t d, ndim, *dsize, bsize[2];
+
+  /* Make sure the input has the same size as the labels. */
+  dsize=band_info(filename, hdu, &intype, &ndim, &unit, hdu_option_name);
+  if(ndim==objects->ndim)
+    { for(d=0;d<ndim;++d) if(dsize[d]!=objects->dsize[d]) different=1; }
+  else different=1;
+  if(different)
+    error(EXIT_FAILURE, 0, "'%s' (hdu: %s) and '%s' (hdu: %s) have a "
+          "different dimension/size. When the inputs are read in bands "
+          "of rows ('--bandrows'), the Sky and its standard deviation "
+          "can't be given on a tessellation: they should either be a "
+          "single value or an image with the same size as the labels",
+          filename, hdu, p->objectsfile, p->cp.hdu);
+
+  /* Allocate the band (the last band of the image may use fewer rows). */
+  bsize[0] = ( p->bandrows < objects->dsize[0]
+               ? p->bandrows : objects->dsize[0] );
+  bsize[1] = objects->dsize[1];
+  out=gal_data_alloc(NULL, type, 2, bsize, NULL, 0, p->cp.minmapsize,
+                     p->cp.quietmmap, NULL, unit, NULL);
+
+  /* Clean up and return. */
+  free(unit);
+  free(dsize);
+  return out;
+}
+
+
+
+
+
+/* Read the band of the given input that starts at 'row' into 'band' and
+   return the number of rows that were read (the last band of the image
+   may have fewer rows than the others). */
+size_t
+band_read(struct mkcatalogparams *p, gal_data_t *band, char *filename,
+          char *hdu, size_t row, char *hdu_option_name)
+{
+  void *blank;
+  fitsfile *fptr;
+  int anynul=0, status=0;
+  size_t nrows=p->objects->dsize[0]-row, ncols=band->dsize[1];
+
+  /* Set the number of rows to read. */
+  if(nrows>band->dsize[0]) nrows=band->dsize[0];
+
+  /* The rows are contiguous in the FITS data unit, so they can be read
+     with one call (CFITSIO counts the elements from 1). */
+  fptr=gal_fits_hdu_open_format(filename, hdu, 0, hdu_option_name);
+  blank=gal_blank_alloc_write(band->type);
+  if( fits_read_img(fptr, gal_fits_type_to_datatype(band->type),
+                    row*ncols+1, nrows*ncols, blank, band->array,
+                    &anynul, &status) )
+    gal_fits_io_error(status, NULL);
+  free(blank);
+
+  /* Close the file and return the number of rows. */
+  if( fits_close_file(fptr, &status) ) gal_fits_io_error(status, NULL);
+  return nrows;
+}
+
+
+
+
+
+/* Minimum (non-blank) value of a 32-bit floating point input that is
+   read in bands ('band' is used to keep each band). */
+float
+band_minimum(struct mkcatalogparams *p, gal_data_t *band, char *filename,
+             char *hdu, char *hdu_option_name)
+{
+  size_t row, nrows;
+  float *f, *ff, min=FLT_MAX;
+
+  /* Parse all the bands (NaN values fail the comparison). */
+  for(row=0; row<p->objects->dsize[0]; row+=nrows)
+    {
+      nrows=band_read(p, band, filename, hdu, row, hdu_option_name);
+      ff=(f=band->array)+nrows*band->dsize[1];
+      do if(*f<min) min=*f; while(++f<ff);
+    }
+
+  /* Return the minimum (NaN if all the pixels were blank). */
+  return min==FLT_MAX ? NAN : min;
+}
@@ -0,0 +1,41 @@
+/*********************************************************************
+MakeCatalog - Make a catalog from an input and labeled image.
+MakeCatalog is part of GNU Astronomy Utilities (Gnuastro) package.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#ifndef BAND_H
+#define BAND_H
+
+gal_data_t *
+band_objects(struct mkcatalogparams *p, uint8_t *intype);
+
+gal_data_t *
+band_alloc(struct mkcatalogparams *p, char *filename, char *hdu,
+           uint8_t type, char *hdu_option_name);
+
+size_t
+band_read(struct mkcatalogparams *p, gal_data_t *band, char *filename,
+          char *hdu, size_t row, char *hdu_option_name);
+
+float
+band_minimum(struct mkcatalogparams *p, gal_data_t *band, char *filename,
+             char *hdu, char *hdu_option_name);
+
+#endif
@@ -2526,18 +2526,29 @@ static uint32_t
 columns_xy_extrema(struct mkcatalog_passparams *pp, double *oi,
                    size_t *coord, int key)
 {
-  size_t ndim=pp->tile->ndim;
-  gal_data_t *tile=pp->tile, *block=tile->block;
+  size_t d, tsize[3];
+  gal_data_t *tile=pp->tile;
+  size_t *minmax=pp->minmax, ndim=pp->p->objects->ndim;
 
   /* We only want to do the coordinate estimation once: in 'columns_fill',
      we initialized the coordinates with 'GAL_BLANK_SIZE_T'. When the
      coordinate has already been measured already, it won't have this value
-     any more. */
+     any more. In band mode, there is no tile: the object's bounding box
+     is directly available. */
   if(coord[0]==GAL_BLANK_SIZE_T)
-    gal_dimension_index_to_coord(gal_pointer_num_between(block->array,
-                                                         tile->array,
-                                                         block->type),
-                                 block->ndim, block->dsize, coord);
+    {
+      if(tile)
+        gal_dimension_index_to_coord(
+                   gal_pointer_num_between(tile->block->array, tile->array,
+                                           tile->block->type),
+                   ndim, tile->block->dsize, coord);
+      else
+        for(d=0;d<ndim;++d) coord[d]=minmax[d];
+    }
+
+  /* Size of the object's box along each dimension. */
+  for(d=0;d<ndim;++d)
+    tsize[d] = tile ? tile->dsize[d] : minmax[ndim+d]-minmax[d]+1;
 
   /* Return the proper value: note that 'coord' is in C standard: starting
      from the slowest dimension and counting from zero. */
@@ -2545,11 +2556,11 @@ columns_xy_extrema(struct mkcatalog_passparams *pp, double *oi,
     switch(key)
       {
       case UI_KEY_MINX: return coord[ndim-1] + 1;                   break;
-      case UI_KEY_MAXX: return coord[ndim-1] + tile->dsize[ndim-1]; break;
+      case UI_KEY_MAXX: return coord[ndim-1] + tsize[ndim-1];       break;
       case UI_KEY_MINY: return coord[ndim-2] + 1;                   break;
-      case UI_KEY_MAXY: return coord[ndim-2] + tile->dsize[ndim-2]; break;
+      case UI_KEY_MAXY: return coord[ndim-2] + tsize[ndim-2];       break;
       case UI_KEY_MINZ: return coord[ndim-3] + 1;                   break;
-      case UI_KEY_MAXZ: return coord[ndim-3] + tile->dsize[ndim-3]; break;
+      case UI_KEY_MAXZ: return coord[ndim-3] + tsize[ndim-3];       break;
       default:
         error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to "
               "fix the problem. The value %d is not a recognized value",
@@ -40,6 +40,9 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #define MKCATALOG_UPPERLIMIT_MINIMUM_NUM     20
 #define MKCATALOG_UPPERLIMIT_MAXFAILS_MULTIP 10
 
+/* Maximum number of random upper-limit positions evaluated together. */
+#define MKCATALOG_UPPERLIMIT_BATCH           256
+
 
 /* Unit string to use if values dataset doesn't have any. */
 #define MKCATALOG_NO_UNIT "input-units"
@@ -267,6 +270,7 @@ struct mkcatalogparams
   float           sfmagnsigma;  /* Surface brightness multiple of sigma.*/
   float             sfmagarea;  /* Surface brightness area (arcsec^2).  */
   uint8_t       inbetweenints;  /* Keep rows (integer ids) with no labs.*/
+  size_t             bandrows;  /* Rows in each band of inputs (or 0).  */
   double         sigmaclip[2];  /* Sigma clip column settings.          */
 
   char            *upmaskfile;  /* Name of upper limit mask file.       */
@@ -288,6 +292,8 @@ struct mkcatalogparams
   gal_data_t             *sky;  /* Sky.                                 */
   gal_data_t             *std;  /* Sky standard deviation.              */
   gal_data_t          *upmask;  /* Upper limit magnitude mask.          */
+  gal_data_t           *upsat;  /* Summed-area table of used pixels.    */
+  size_t            upthreads;  /* Threads for one object's upper-limit.*/
   float                medstd;  /* Median standard deviation value.     */
   float               cpscorr;  /* Counts-per-second correction.        */
   int32_t            *outlabs;  /* Labels in output cat (when necessary)*/
@@ -299,6 +305,9 @@ struct mkcatalogparams
   gal_data_t      *objectcols;  /* Output columns for the objects.      */
   gal_data_t       *clumpcols;  /* Output columns for the clumps.       */
   gal_data_t           *tiles;  /* Tiles to cover each object.          */
+  size_t              *minmax;  /* Band mode: box of each object.       */
+  size_t            *pixstart;  /* Start of each label in 'pixind'.     */
+  gal_data_t          *pixind;  /* Pixel indexs, sorted by label.       */
   char            *objectsout;  /* Output objects catalog.              */
   char             *clumpsout;  /* Output clumps catalog.               */
   char            *upcheckout;  /* Name of upperlimit check table.      */
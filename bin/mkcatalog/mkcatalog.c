@@ -49,6 +49,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include "mkcatalog.h"
 
 #include "ui.h"
+#include "band.h"
 #include "parse.h"
 #include "columns.h"
 #include "upperlimit.h"
@@ -190,6 +191,21 @@ mkcatalog_single_object_init(struct mkcatalogparams *p,
 
 
 
+/* Free the space that was allocated in 'mkcatalog_single_object_init'. */
+static void
+mkcatalog_single_object_free(struct mkcatalog_passparams *pp)
+{
+  free(pp->oi);
+  free(pp->shift);
+  gal_data_free(pp->up_vals);
+  if(pp->rng) gsl_rng_free(pp->rng);
+  gal_data_array_free(pp->vector, VEC_NUM, 1);
+}
+
+
+
+
+
 /* Each thread will call this function once. It will go over all the
    objects that are assigned to it. */
 static void *
@@ -210,10 +226,15 @@ mkcatalog_single_object(void *in_prm)
       /* For easy reading. Note that the object IDs start from one while
          the array positions start from 0. */
       pp.ci       = NULL;
+      pp.minmax   = NULL;
       pp.object   = ( p->outlabs
                       ? p->outlabs[ tprm->indexs[i] ]
                       : tprm->indexs[i] + 1 );
       pp.tile     = &p->tiles[   tprm->indexs[i] ];
+      pp.pixind   = ( (size_t *)(p->pixind->array)
+                      + p->pixstart[ pp.object ] );
+      pp.numpix   = ( p->pixstart[ pp.object+1 ]
+                      - p->pixstart[ pp.object   ] );
 
       /* Initialize the parameters for this object/tile. */
       parse_initialize(&pp);
@@ -265,11 +286,260 @@ mkcatalog_single_object(void *in_prm)
     }
 
   /* Clean up. */
-  free(pp.oi);
-  free(pp.shift);
-  gal_data_free(pp.up_vals);
-  if(pp.rng) gsl_rng_free(pp.rng);
-  gal_data_array_free(pp.vector, VEC_NUM, 1);
+  mkcatalog_single_object_free(&pp);
+
+  /* Wait until all the threads finish and return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/**************        Index of object pixels      *******************/
+/*********************************************************************/
+/* Each chunk has its own counter for every label, so the number of chunks
+   is limited to keep all the counters below this fraction of the number
+   of pixels (with many labels, each chunk has few pixels of each label
+   and there is little to gain from more chunks anyway). */
+#define MKCATALOG_PIXIND_MAXFRAC 8
+
+/* Parameters to build the index of each object's pixels. */
+struct mkcatalog_pixind_params
+{
+  struct mkcatalogparams  *p;   /* Main MakeCatalog parameters.         */
+  int32_t           *labels;    /* Labels to use (image or one band).   */
+  size_t               size;    /* Number of elements in 'labels'.      */
+  size_t             offset;    /* Index of 'labels[0]' in the image.   */
+  size_t               nlab;    /* One more than the largest label.     */
+  size_t          numchunks;    /* Number of chunks over the image.     */
+  size_t            *counts;    /* Per-chunk counter of each label.     */
+  uint8_t              fill;    /* ==0: only count, ==1: fill index.    */
+};
+
+
+
+
+
+/* Each chunk is a contiguous range of the labeled image. In the first
+   round ('fill==0'), we only count the number of pixels of each label
+   within the chunk. In the second round, the counters contain the
+   position of this chunk's first pixel (of each label) in the final
+   index, so we can just write the pixel indexs. Since the chunks are
+   contiguous and parsed in order, each object's pixels will be sorted
+   by their index in the image (exactly the order they are visited when
+   parsing over the object's tile). */
+static void *
+mkcatalog_pixind_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct mkcatalog_pixind_params *prm=tprm->params;
+  struct mkcatalogparams *p=prm->p;
+
+  int32_t *o, *of;
+  size_t i, ch, *cnt, *pixind=prm->fill ? p->pixind->array : NULL;
+  int32_t *objarr=prm->labels, nlab=prm->nlab;
+
+  /* Go over all the chunks given to this thread. */
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Set the range of this chunk and its counter. */
+      ch  = tprm->indexs[i];
+      cnt = prm->counts + ch * prm->nlab;
+      o   = objarr + ch     * prm->size / prm->numchunks;
+      of  = objarr + (ch+1) * prm->size / prm->numchunks;
+
+      /* Parse the pixels of this chunk. Note that blank labels are
+         negative, so they will also be ignored with the first check. */
+      if(prm->fill)
+        for(;o<of;++o)
+          { if(*o>0 && *o<nlab)
+              pixind[ cnt[*o]++ ] = prm->offset + (o-objarr); }
+      else
+        for(;o<of;++o)
+          { if(*o>0 && *o<nlab) ++cnt[*o]; }
+    }
+
+  /* Wait for all threads to finish and return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* The tile of each object is its bounding box, so when objects are large
+   (and not box-shaped) or overlap, most of the pixels in the tile don't
+   belong to it. To avoid checking all those pixels in every pass over
+   each object, we build a compressed index of the pixels of each label
+   here: the pixels of label 'L' are 'p->pixind[ p->pixstart[L] ]' to
+   'p->pixind[ p->pixstart[L+1]-1 ]'. The 'size' labels may also be one
+   band of the image, where 'offset' is the index of its first pixel in
+   the full image. */
+static void
+mkcatalog_pixind(struct mkcatalogparams *p, int32_t *labels, size_t size,
+                 size_t offset)
+{
+  size_t i, ch, tmp, sum=0;
+  struct mkcatalog_pixind_params prm;
+
+  /* Set the basic parameters. The labels that don't have a row in the
+     final catalog (only possible after the last output label) are
+     ignored, so we'll use the last output label for the counters. */
+  prm.p=p;
+  prm.fill=0;
+  prm.size=size;
+  prm.labels=labels;
+  prm.offset=offset;
+  prm.nlab=(p->outlabs ? p->outlabs[p->numobjects-1] : p->numobjects)+1;
+  prm.numchunks = size / (MKCATALOG_PIXIND_MAXFRAC*prm.nlab);
+  if(prm.numchunks>p->cp.numthreads) prm.numchunks=p->cp.numthreads;
+  if(prm.numchunks==0) prm.numchunks=1;
+  prm.counts=gal_pointer_allocate(GAL_TYPE_SIZE_T,
+                                  prm.numchunks*prm.nlab, 1,
+                                  __func__, "prm.counts");
+
+  /* Count the number of pixels of each label in each chunk. */
+  gal_threads_spin_off(mkcatalog_pixind_worker, &prm, prm.numchunks,
+                       p->cp.numthreads, p->cp.minmapsize,
+                       p->cp.quietmmap);
+
+  /* Set the starting position of each label, and convert the counters of
+     each chunk into the starting position of that chunk's first pixel of
+     each label. */
+  p->pixstart=gal_pointer_allocate(GAL_TYPE_SIZE_T, prm.nlab+1, 0,
+                                   __func__, "p->pixstart");
+  for(i=0;i<prm.nlab;++i)
+    {
+      p->pixstart[i]=sum;
+      for(ch=0;ch<prm.numchunks;++ch)
+        {
+          tmp=prm.counts[ ch*prm.nlab + i ];
+          prm.counts[ ch*prm.nlab + i ]=sum;
+          sum+=tmp;
+        }
+    }
+  p->pixstart[prm.nlab]=sum;
+
+  /* Allocate the index and fill it (a dataset can't have a size of zero,
+     which is possible when the image has no usable labeled pixel). */
+  if(sum==0) sum=1;
+  p->pixind=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &sum, NULL, 0,
+                           p->cp.minmapsize, p->cp.quietmmap, NULL, NULL,
+                           NULL);
+  prm.fill=1;
+  gal_threads_spin_off(mkcatalog_pixind_worker, &prm, prm.numchunks,
+                       p->cp.numthreads, p->cp.minmapsize,
+                       p->cp.quietmmap);
+
+  /* Clean up. */
+  free(prm.counts);
+}
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/**************         Processing in bands        *******************/
+/*********************************************************************/
+/* Parameters of each band (with '--bandrows'). */
+struct mkcatalog_band_params
+{
+  struct mkcatalogparams  *p;   /* Main MakeCatalog parameters.         */
+  size_t                row;    /* First row of this band in the image. */
+  size_t              nrows;    /* Number of rows in this band.         */
+  size_t              *objs;    /* Output index of objects in this band.*/
+  double               **oi;    /* First pass sums of each object.      */
+};
+
+
+
+
+
+/* The first pass measurements are sums over the pixels of each object, so
+   the sums of each band can be added to the sums of the previous bands
+   (in 'oi'). Once the band containing the last row of an object is
+   parsed, its sums are complete and its columns can be filled. */
+static void *
+mkcatalog_band_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct mkcatalog_band_params *prm=tprm->params;
+  struct mkcatalogparams *p=prm->p;
+
+  double *oi;
+  size_t i, d, o, ndim=p->objects->ndim;
+  struct mkcatalog_passparams pp;
+
+  /* Initialize and allocate all the necessary values (the sums of each
+     object are in 'prm->oi', so the 'oi' of this thread isn't used). */
+  mkcatalog_single_object_init(p, &pp);
+  oi=pp.oi;
+
+  /* Parse the objects given to this thread. */
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
+    {
+      /* For easy reading. */
+      o           = prm->objs[ tprm->indexs[i] ];
+      pp.ci       = NULL;
+      pp.tile     = NULL;
+      pp.oi       = prm->oi[o];
+      pp.clumpsinobj = 0;
+      pp.minmax   = p->minmax + o*2*ndim;
+      pp.object   = p->outlabs ? p->outlabs[o] : o + 1;
+      pp.pixind   = ( (size_t *)(p->pixind->array)
+                      + p->pixstart[ pp.object ] );
+      pp.numpix   = ( p->pixstart[ pp.object+1 ]
+                      - p->pixstart[ pp.object   ] );
+
+      /* All the input pointers start at the first pixel of the band. */
+      pp.start_end_inc[0] = prm->row * p->objects->dsize[1];
+      pp.st_c   = NULL;
+      pp.st_v   = p->values ? p->values->array : NULL;
+      pp.st_sky = p->sky && p->sky->size>1 ? p->sky->array : NULL;
+      pp.st_std = p->std && p->std->size>1 ? p->std->array : NULL;
+
+      /* Like 'parse_initialize', the shift is the first pixel of the
+         object's box (counting from 1). */
+      if(pp.shift)
+        for(d=0;d<ndim;++d) pp.shift[d]=pp.minmax[d]+1;
+
+      /* Add this band's pixels to the object's sums. */
+      parse_objects(&pp);
+
+      /* If this is the last band of the object, fill its columns. */
+      if( pp.minmax[ndim] < prm->row + prm->nrows )
+        columns_fill(&pp);
+    }
+
+  /* Clean up. */
+  pp.oi=oi;
+  mkcatalog_single_object_free(&pp);
 
   /* Wait until all the threads finish and return. */
   if(tprm->b) pthread_barrier_wait(tprm->b);
@@ -280,10 +550,93 @@ mkcatalog_single_object(void *in_prm)
 
 
 
+/* Read the inputs in bands of 'p->bandrows' rows and measure the objects
+   in each band. Only the objects that have pixels in a band (or finish
+   in it) are parsed in each band. */
+static void
+mkcatalog_band(struct mkcatalogparams *p)
+{
+  gal_data_t *labels;
+  size_t o, num, label, *minmax;
+  size_t ndim=p->objects->ndim, ncols=p->objects->dsize[1];
+  struct mkcatalog_band_params prm;
+
+  /* Allocate the space for each band's labels and the objects in it. */
+  labels=band_alloc(p, p->objectsfile, p->cp.hdu, GAL_TYPE_INT32, "--hdu");
+  prm.objs=gal_pointer_allocate(GAL_TYPE_SIZE_T, p->numobjects, 0,
+                                __func__, "prm.objs");
+  errno=0;
+  prm.oi=calloc(p->numobjects, sizeof *prm.oi);
+  if(prm.oi==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'prm.oi'", __func__,
+          p->numobjects * sizeof *prm.oi);
+
+  /* Parse the bands. */
+  prm.p=p;
+  for(prm.row=0; prm.row<p->objects->dsize[0]; prm.row+=prm.nrows)
+    {
+      /* Read this band of the inputs. */
+      prm.nrows=band_read(p, labels, p->objectsfile, p->cp.hdu, prm.row,
+                          "--hdu");
+      if(p->values)
+        band_read(p, p->values, p->usedvaluesfile, p->valueshdu, prm.row,
+                  "--valueshdu");
+      if(p->sky && p->sky->size>1)
+        band_read(p, p->sky, p->usedskyfile, p->skyhdu, prm.row,
+                  "--skyhdu");
+      if(p->std && p->std->size>1)
+        band_read(p, p->std, p->usedstdfile, p->stdhdu, prm.row,
+                  "--stdhdu");
+      if(p->subtractsky && p->values) ui_subtract_sky(p);
+
+      /* Index of the pixels of each object within this band. */
+      mkcatalog_pixind(p, labels->array, prm.nrows*ncols, prm.row*ncols);
+
+      /* Find the objects with pixels in this band, or that finish in it
+         (labels that don't exist in the image, but are kept with
+         '--inbetweenints', have a box of zero). */
+      num=0;
+      for(o=0;o<p->numobjects;++o)
+        {
+          minmax=p->minmax+o*2*ndim;
+          label=p->outlabs ? p->outlabs[o] : o+1;
+          if( p->pixstart[label+1]>p->pixstart[label]
+              || ( minmax[ndim]>=prm.row
+                   && minmax[ndim]<prm.row+prm.nrows ) )
+            {
+              if(prm.oi[o]==NULL)
+                prm.oi[o]=gal_pointer_allocate(GAL_TYPE_FLOAT64,
+                                               OCOL_NUMCOLS, 1, __func__,
+                                               "prm.oi[o]");
+              prm.objs[num++]=o;
+            }
+        }
 
+      /* Do the measurements on each thread. */
+      if(num)
+        gal_threads_spin_off(mkcatalog_band_worker, &prm, num,
+                             p->cp.numthreads, p->cp.minmapsize,
+                             p->cp.quietmmap);
 
+      /* The sums of the objects that finished in this band are no longer
+         necessary. */
+      for(o=0;o<num;++o)
+        {
+          minmax=p->minmax+prm.objs[o]*2*ndim;
+          if( minmax[ndim]<prm.row+prm.nrows )
+            { free(prm.oi[prm.objs[o]]); prm.oi[prm.objs[o]]=NULL; }
+        }
 
+      /* Clean up this band's index. */
+      free(p->pixstart);
+      gal_data_free(p->pixind);
+    }
 
+  /* Clean up. */
+  free(prm.oi);
+  free(prm.objs);
+  gal_data_free(labels);
+}
 
 
 
@@ -307,33 +660,34 @@ mkcatalog_wcs_conversion(struct mkcatalogparams *p)
 {
   gal_data_t *c;
   gal_data_t *column;
+  size_t nt=p->cp.numthreads;
 
   /* Flux weighted center positions for clumps and objects. */
   if(p->wcs_vo)
     {
-      gal_wcs_img_to_world(p->wcs_vo, p->objects->wcs, 1);
+      gal_wcs_img_to_world_threads(p->wcs_vo, p->objects->wcs, 1, nt);
       if(p->wcs_vc)
-        gal_wcs_img_to_world(p->wcs_vc, p->objects->wcs, 1);
+        gal_wcs_img_to_world_threads(p->wcs_vc, p->objects->wcs, 1, nt);
     }
 
 
   /* Geometric center positions for clumps and objects. */
   if(p->wcs_go)
     {
-      gal_wcs_img_to_world(p->wcs_go, p->objects->wcs, 1);
+      gal_wcs_img_to_world_threads(p->wcs_go, p->objects->wcs, 1, nt);
       if(p->wcs_gc)
-        gal_wcs_img_to_world(p->wcs_gc, p->objects->wcs, 1);
+        gal_wcs_img_to_world_threads(p->wcs_gc, p->objects->wcs, 1, nt);
     }
 
 
   /* All clumps flux weighted center. */
   if(p->wcs_vcc)
-    gal_wcs_img_to_world(p->wcs_vcc, p->objects->wcs, 1);
+    gal_wcs_img_to_world_threads(p->wcs_vcc, p->objects->wcs, 1, nt);
 
 
   /* All clumps geometric center. */
   if(p->wcs_gcc)
-    gal_wcs_img_to_world(p->wcs_gcc, p->objects->wcs, 1);
+    gal_wcs_img_to_world_threads(p->wcs_gcc, p->objects->wcs, 1, nt);
 
 
   /* Go over all the object columns and fill in the values. */
@@ -796,10 +1150,26 @@ mkcatalog(struct mkcatalogparams *p)
      it to assign a column to the clumps in the final catalog. */
   if( p->cp.numthreads > 1 ) pthread_mutex_init(&p->mutex, NULL);
 
-  /* Do the processing on each thread. */
-  gal_threads_spin_off(mkcatalog_single_object, p, p->numobjects,
-                       p->cp.numthreads, p->cp.minmapsize,
-                       p->cp.quietmmap);
+  /* When the inputs are read in bands, all the measurements are done
+     over the bands. */
+  if(p->bandrows) mkcatalog_band(p);
+  else
+    {
+      /* Build the index of the pixels of each object (and the table of
+         used pixels for the upper-limit measurements). */
+      mkcatalog_pixind(p, p->objects->array, p->objects->size, 0);
+      if(p->upperlimit) upperlimit_prepare(p);
+
+      /* Do the processing on each thread. */
+      gal_threads_spin_off(mkcatalog_single_object, p, p->numobjects,
+                           p->cp.numthreads, p->cp.minmapsize,
+                           p->cp.quietmmap);
+
+      /* The pixel index is no longer necessary. */
+      free(p->pixstart);
+      gal_data_free(p->upsat);
+      gal_data_free(p->pixind);
+    }
 
   /* Post-thread processing, for example to convert image coordinates to RA
      and Dec. */
@@ -36,6 +36,9 @@ struct mkcatalog_passparams
   int32_t            object;    /* Object that is currently working on. */
   size_t        clumpsinobj;    /* The number of clumps in this object. */
   gal_data_t          *tile;    /* The tile to pass-over.               */
+  size_t            *minmax;    /* Band mode: box of object (no tile).  */
+  size_t            *pixind;    /* Indexs of this object's pixels.      */
+  size_t             numpix;    /* Number of pixels in this object.     */
   int32_t             *st_o;    /* Starting pointer for object labels.  */
   int32_t             *st_c;    /* Starting pointer for clump labels.   */
   float               *st_v;    /* Starting pointer for values array.   */
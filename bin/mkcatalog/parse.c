@@ -315,6 +315,23 @@ parse_vector_dim3(struct mkcatalog_passparams *pp, gal_data_t *xybin)
 
 
 
+/* Index of a pixel (with index 'ind' in the full 3D cube) in the 2D
+   projection of its object's tile over the first two (fastest) FITS
+   dimensions. */
+static size_t
+parse_xy_index(struct mkcatalog_passparams *pp, size_t ind)
+{
+  size_t *dsize=pp->p->objects->dsize, *tsize=pp->tile->dsize;
+  size_t start=pp->start_end_inc[0];
+
+  return ( ( ind/dsize[2]%dsize[1] - start/dsize[2]%dsize[1] ) * tsize[2]
+           + ind%dsize[2] - start%dsize[2] );
+}
+
+
+
+
+
 void
 parse_objects(struct mkcatalog_passparams *pp)
 {
@@ -324,11 +341,10 @@ parse_objects(struct mkcatalog_passparams *pp)
 
   double *oi=pp->oi;
   gal_data_t *xybin=NULL;
-  size_t *tsize=pp->tile->dsize;
   uint8_t *u, *uf, goodvalue, *xybinarr=NULL;
   double minima_v=FLT_MAX, maxima_v=-FLT_MAX;
-  size_t d, pind=0, increment=0, num_increment=1;
-  int32_t *O, *OO, *C=NULL, *objarr=p->objects->array;
+  int32_t *C=NULL;
+  size_t i, d, o, ind, pind=0;
   float var, sval, varval, skyval, *V=NULL, *SK=NULL, *ST=NULL;
   float *std=p->std?p->std->array:NULL, *sky=p->sky?p->sky->array:NULL;
 
@@ -384,244 +400,220 @@ parse_objects(struct mkcatalog_passparams *pp)
       || oif[ OCOL_SUMOTHERVARINSLICE ]
       || oif[ OCOL_NUMALLOTHERINSLICE ] )
     {
-      xybin=gal_data_alloc(NULL, GAL_TYPE_UINT8, 2, &tsize[1], NULL,
-                           1, p->cp.minmapsize, p->cp.quietmmap,
+      xybin=gal_data_alloc(NULL, GAL_TYPE_UINT8, 2, &pp->tile->dsize[1],
+                           NULL, 1, p->cp.minmapsize, p->cp.quietmmap,
                            NULL, NULL, NULL);
       xybinarr=xybin->array;
     }
 
-  /* Parse each contiguous patch of memory covered by this object. */
-  while( pp->start_end_inc[0] + increment <= pp->start_end_inc[1] )
+  /* Parse over the pixels of this object (sorted by their index in the
+     image). 'o' is the offset of each pixel from the start of the tile
+     (where all the 'st_*' pointers point to). */
+  for(i=0;i<pp->numpix;++i)
     {
-      /* Set the contiguous range to parse. The pixel-to-pixel counting
-         along the fastest dimension will be done over the 'O' pointer. */
-      if( p->clumps            ) C  = pp->st_c   + increment;
-      if( p->values            ) V  = pp->st_v   + increment;
-      if( p->sky && pp->st_sky ) SK = pp->st_sky + increment;
-      if( p->std && pp->st_std ) ST = pp->st_std + increment;
-      OO = ( O = pp->st_o + increment ) + tsize[ndim-1];
-
-      /* Parse the tile. */
-      do
-        {
-          /* If this pixel belongs to the requested object then do the
-             processing.  */
-          if( *O==pp->object )
-            {
-              /* INTERNAL: Get the number of clumps in this object: it is
-                 the largest clump ID over each object. */
-              if( p->clumps && *C>0 )
-                pp->clumpsinobj = *C > pp->clumpsinobj?*C:pp->clumpsinobj;
+      ind = pp->pixind[i];
+      o   = ind - pp->start_end_inc[0];
+      if( p->clumps            ) C  = pp->st_c   + o;
+      if( p->values            ) V  = pp->st_v   + o;
+      if( p->sky && pp->st_sky ) SK = pp->st_sky + o;
+      if( p->std && pp->st_std ) ST = pp->st_std + o;
+      if( xybin                ) pind = parse_xy_index(pp, ind);
 
+      /* INTERNAL: Get the number of clumps in this object: it is
+         the largest clump ID over each object. */
+      if( p->clumps && *C>0 )
+        pp->clumpsinobj = *C > pp->clumpsinobj?*C:pp->clumpsinobj;
 
-              /* Add to the area of this object. */
-              if(xybin) xybinarr[ pind ]=1;
-              if(oif[ OCOL_NUMALL   ]) oi[ OCOL_NUMALL ]++;
 
+      /* Add to the area of this object. */
+      if(xybin) xybinarr[ pind ]=1;
+      if(oif[ OCOL_NUMALL   ]) oi[ OCOL_NUMALL ]++;
 
-              /* Geometric coordinate measurements. */
-              if(c)
-                {
-                  /* Convert the index to coordinate. */
-                  gal_dimension_index_to_coord(O-objarr, ndim, dsize, c);
-
-                  /* If we need tile-ID, get the tile ID now. */
-                  if(tid!=GAL_BLANK_SIZE_T)
-                    tid=gal_tile_full_id_from_coord(&p->cp.tl, c);
-
-                  /* Do the general geometric (independent of pixel value)
-                     calculations. */
-                  if(oif[ OCOL_GX ]) oi[ OCOL_GX ] += c[ ndim-1 ]+1;
-                  if(oif[ OCOL_GY ]) oi[ OCOL_GY ] += c[ ndim-2 ]+1;
-                  if(oif[ OCOL_GZ ]) oi[ OCOL_GZ ] += c[ ndim-3 ]+1;
-                  if(pp->shift)
-                    {
-                      /* Calculate the shifted coordinates for second order
-                         calculations. The coordinate is incremented
-                         because from now on, the positions are in the FITS
-                         standard (starting from one).  */
-                      for(d=0;d<ndim;++d) sc[d] = c[d] + 1 - pp->shift[d];
-
-                      /* Include the shifted values, note that the second
-                         order moments are never needed independently, they
-                         are used together to find the ellipticity
-                         parameters. */
-                      oi[ OCOL_GXX ] += sc[1] * sc[1];
-                      oi[ OCOL_GYY ] += sc[0] * sc[0];
-                      oi[ OCOL_GXY ] += sc[1] * sc[0];
-                    }
-                  if(p->clumps && *C>0)
-                    {
-                      if(oif[ OCOL_C_NUMALL ]) oi[ OCOL_C_NUMALL ]++;
-                      if(oif[ OCOL_C_GX ]) oi[ OCOL_C_GX ] += c[ndim-1]+1;
-                      if(oif[ OCOL_C_GY ]) oi[ OCOL_C_GY ] += c[ndim-2]+1;
-                      if(oif[ OCOL_C_GZ ]) oi[ OCOL_C_GZ ] += c[ndim-3]+1;
-                    }
-                }
 
+      /* Geometric coordinate measurements. */
+      if(c)
+        {
+          /* Convert the index to coordinate. */
+          gal_dimension_index_to_coord(ind, ndim, dsize, c);
+
+          /* If we need tile-ID, get the tile ID now. */
+          if(tid!=GAL_BLANK_SIZE_T)
+            tid=gal_tile_full_id_from_coord(&p->cp.tl, c);
+
+          /* Do the general geometric (independent of pixel value)
+             calculations. */
+          if(oif[ OCOL_GX ]) oi[ OCOL_GX ] += c[ ndim-1 ]+1;
+          if(oif[ OCOL_GY ]) oi[ OCOL_GY ] += c[ ndim-2 ]+1;
+          if(oif[ OCOL_GZ ]) oi[ OCOL_GZ ] += c[ ndim-3 ]+1;
+          if(pp->shift)
+            {
+              /* Calculate the shifted coordinates for second order
+                 calculations. The coordinate is incremented
+                 because from now on, the positions are in the FITS
+                 standard (starting from one).  */
+              for(d=0;d<ndim;++d) sc[d] = c[d] + 1 - pp->shift[d];
+
+              /* Include the shifted values, note that the second
+                 order moments are never needed independently, they
+                 are used together to find the ellipticity
+                 parameters. */
+              oi[ OCOL_GXX ] += sc[1] * sc[1];
+              oi[ OCOL_GYY ] += sc[0] * sc[0];
+              oi[ OCOL_GXY ] += sc[1] * sc[0];
+            }
+          if(p->clumps && *C>0)
+            {
+              if(oif[ OCOL_C_NUMALL ]) oi[ OCOL_C_NUMALL ]++;
+              if(oif[ OCOL_C_GX ]) oi[ OCOL_C_GX ] += c[ndim-1]+1;
+              if(oif[ OCOL_C_GY ]) oi[ OCOL_C_GY ] += c[ndim-2]+1;
+              if(oif[ OCOL_C_GZ ]) oi[ OCOL_C_GZ ] += c[ndim-3]+1;
+            }
+        }
 
-              /* Value related measurements. */
-              goodvalue=0;
-              if( p->values && !( p->hasblank && isnan(*V) ) )
-                {
-                  /* For the standard-deviation measurements later. */
-                  goodvalue=1;
 
-                  /* General flux summations. */
-                  if(xybin) xybinarr[ pind ]=2;
-                  if(oif[ OCOL_NUM ])   oi[ OCOL_NUM   ]++;
-                  if(oif[ OCOL_SUM ])   oi[ OCOL_SUM   ] += *V;
-                  if(oif[ OCOL_SUMP2 ]) oi[ OCOL_SUMP2 ] += *V * *V;
+      /* Value related measurements. */
+      goodvalue=0;
+      if( p->values && !( p->hasblank && isnan(*V) ) )
+        {
+          /* For the standard-deviation measurements later. */
+          goodvalue=1;
 
-                  /* Get the necessary clump information. */
-                  if(p->clumps && *C>0)
-                    {
-                      if(oif[ OCOL_C_NUM ]) oi[ OCOL_C_NUM ]++;
-                      if(oif[ OCOL_C_SUM ]) oi[ OCOL_C_SUM ] += *V;
-                    }
+          /* General flux summations. */
+          if(xybin) xybinarr[ pind ]=2;
+          if(oif[ OCOL_NUM ])   oi[ OCOL_NUM   ]++;
+          if(oif[ OCOL_SUM ])   oi[ OCOL_SUM   ] += *V;
+          if(oif[ OCOL_SUMP2 ]) oi[ OCOL_SUMP2 ] += *V * *V;
 
-                  /* Get the extrema of the values. Note that if the minima
-                     or maxima value's coordinates are requested in any
-                     dimension, then 'OCOL_MINVNUM' or 'OCOL_MAXVNUM' will
-                     be activated). */
-                  if( oif[ OCOL_MINVNUM ] && *V<=minima_v )
-                    {
-                      /* If the value is smaller than the smallest found so
-                         far, reset the counter to one, and reset the sum
-                         of positions this one's position. */
-                      if( *V<minima_v )
-                        {
-                          minima_v = *V;
-                          oi[ OCOL_MINVNUM ]=1;
-                          if(oif[OCOL_MINVX])oi[OCOL_MINVX]=c[ndim-1]+1;
-                          if(oif[OCOL_MINVY])oi[OCOL_MINVY]=c[ndim-2]+1;
-                          if(oif[OCOL_MINVZ])oi[OCOL_MINVZ]=c[ndim-3]+1;
-                        }
-                      else
-                        {
-                          oi[ OCOL_MINVNUM ]++;
-                          if(oif[OCOL_MINVX])oi[OCOL_MINVX]+=c[ndim-1]+1;
-                          if(oif[OCOL_MINVY])oi[OCOL_MINVY]+=c[ndim-2]+1;
-                          if(oif[OCOL_MINVZ])oi[OCOL_MINVZ]+=c[ndim-3]+1;
-                        }
-                    }
-                  if( oif[ OCOL_MAXVNUM ] && *V>=maxima_v )
-                    {
-                      if( *V>maxima_v )
-                        {
-                          maxima_v = *V;
-                          oi[ OCOL_MAXVNUM ]=1;
-                          if(oif[OCOL_MAXVX])oi[OCOL_MAXVX]=c[ndim-1]+1;
-                          if(oif[OCOL_MAXVY])oi[OCOL_MAXVY]=c[ndim-2]+1;
-                          if(oif[OCOL_MAXVZ])oi[OCOL_MAXVZ]=c[ndim-3]+1;
-                        }
-                      else
-                        {
-                          oi[ OCOL_MAXVNUM ]++;
-                          if(oif[OCOL_MAXVX])oi[OCOL_MAXVX]+=c[ndim-1]+1;
-                          if(oif[OCOL_MAXVY])oi[OCOL_MAXVY]+=c[ndim-2]+1;
-                          if(oif[OCOL_MAXVZ])oi[OCOL_MAXVZ]+=c[ndim-3]+1;
-                        }
-                    }
+          /* Get the necessary clump information. */
+          if(p->clumps && *C>0)
+            {
+              if(oif[ OCOL_C_NUM ]) oi[ OCOL_C_NUM ]++;
+              if(oif[ OCOL_C_SUM ]) oi[ OCOL_C_SUM ] += *V;
+            }
 
-                  /* For flux weighted centers, we can only use positive
-                     values, so do those measurements here. */
-                  if( *V > 0.0f )
-                    {
-                      if(oif[ OCOL_NUMWHT ]) oi[ OCOL_NUMWHT ]++;
-                      if(oif[ OCOL_SUMWHT ]) oi[ OCOL_SUMWHT ] += *V;
-                      if(oif[ OCOL_VX ]) oi[ OCOL_VX ] += *V*(c[ndim-1]+1);
-                      if(oif[ OCOL_VY ]) oi[ OCOL_VY ] += *V*(c[ndim-2]+1);
-                      if(oif[ OCOL_VZ ]) oi[ OCOL_VZ ] += *V*(c[ndim-3]+1);
-                      if(pp->shift)
-                        {
-                          oi[ OCOL_VXX    ] += *V * sc[1] * sc[1];
-                          oi[ OCOL_VYY    ] += *V * sc[0] * sc[0];
-                          oi[ OCOL_VXY    ] += *V * sc[1] * sc[0];
-                        }
-                      if(p->clumps && *C>0)
-                        {
-                          if(oif[ OCOL_C_NUMWHT ]) oi[ OCOL_C_NUMWHT ]++;
-                          if(oif[ OCOL_C_SUMWHT ]) oi[ OCOL_C_SUMWHT ]+=*V;
-                          if(oif[ OCOL_C_VX ])
-                            oi[   OCOL_C_VX ] += *V * (c[ ndim-1 ]+1);
-                          if(oif[ OCOL_C_VY ])
-                            oi[   OCOL_C_VY ] += *V * (c[ ndim-2 ]+1);
-                          if(oif[ OCOL_C_VZ ])
-                            oi[   OCOL_C_VZ ] += *V * (c[ ndim-3 ]+1);
-                        }
-                    }
+          /* Get the extrema of the values. Note that if the minima
+             or maxima value's coordinates are requested in any
+             dimension, then 'OCOL_MINVNUM' or 'OCOL_MAXVNUM' will
+             be activated). */
+          if( oif[ OCOL_MINVNUM ] && *V<=minima_v )
+            {
+              /* If the value is smaller than the smallest found so
+                 far, reset the counter to one, and reset the sum
+                 of positions this one's position. */
+              if( *V<minima_v )
+                {
+                  minima_v = *V;
+                  oi[ OCOL_MINVNUM ]=1;
+                  if(oif[OCOL_MINVX])oi[OCOL_MINVX]=c[ndim-1]+1;
+                  if(oif[OCOL_MINVY])oi[OCOL_MINVY]=c[ndim-2]+1;
+                  if(oif[OCOL_MINVZ])oi[OCOL_MINVZ]=c[ndim-3]+1;
                 }
-
-
-              /* Sky value based measurements. */
-              if(p->sky && oif[ OCOL_SUMSKY ])
+              else
                 {
-                  skyval = ( pp->st_sky
-                             ? (isnan(*SK)?0:*SK)        /* Full array  */
-                             : ( p->sky->size>1
-                                 ? (isnan(sky[tid])?0:sky[tid]) /* Tile */
-                                 : sky[0] ) );           /* Single value*/
-                  if(!isnan(skyval))
-                    {
-                      oi[ OCOL_NUMSKY  ]++;
-                      oi[ OCOL_SUMSKY  ] += skyval;
-                    }
+                  oi[ OCOL_MINVNUM ]++;
+                  if(oif[OCOL_MINVX])oi[OCOL_MINVX]+=c[ndim-1]+1;
+                  if(oif[OCOL_MINVY])oi[OCOL_MINVY]+=c[ndim-2]+1;
+                  if(oif[OCOL_MINVZ])oi[OCOL_MINVZ]+=c[ndim-3]+1;
                 }
-
-
-              /* Sky standard deviation based measurements.*/
-              if(p->std)
+            }
+          if( oif[ OCOL_MAXVNUM ] && *V>=maxima_v )
+            {
+              if( *V>maxima_v )
                 {
-                  /* Calculate the variance and save it in the output if
-                     necessary. */
-                  sval=pp->st_std ? *ST : (p->std->size>1?std[tid]:std[0]);
-                  var = p->variance ? sval : sval*sval;
-                  if(oif[ OCOL_SUMVAR ] && (!isnan(var)))
-                    {
-                      oi[ OCOL_NUMVAR  ]++;
-                      oi[ OCOL_SUMVAR  ] += var;
-                    }
+                  maxima_v = *V;
+                  oi[ OCOL_MAXVNUM ]=1;
+                  if(oif[OCOL_MAXVX])oi[OCOL_MAXVX]=c[ndim-1]+1;
+                  if(oif[OCOL_MAXVY])oi[OCOL_MAXVY]=c[ndim-2]+1;
+                  if(oif[OCOL_MAXVZ])oi[OCOL_MAXVZ]=c[ndim-3]+1;
+                }
+              else
+                {
+                  oi[ OCOL_MAXVNUM ]++;
+                  if(oif[OCOL_MAXVX])oi[OCOL_MAXVX]+=c[ndim-1]+1;
+                  if(oif[OCOL_MAXVY])oi[OCOL_MAXVY]+=c[ndim-2]+1;
+                  if(oif[OCOL_MAXVZ])oi[OCOL_MAXVZ]+=c[ndim-3]+1;
+                }
+            }
 
-                  /* For each pixel, we have a sky contribution to the
-                     counts and the signal's contribution. The standard
-                     deviation in the sky is simply 'sval', but the
-                     standard deviation of the signal (independent of the
-                     sky) is 'sqrt(*V)'. Therefore the total variance of
-                     this pixel is the variance of the sky added with the
-                     absolute value of its sky-subtracted flux. We use the
-                     absolute value, because especially as the signal gets
-                     noisy there will be negative values, and we don't want
-                     them to decrease the variance. */
-                  if(oif[ OCOL_SUM_VAR ] && goodvalue)
-                    {
-                      varval=p->variance ? var : sval;
-                      if(!isnan(varval))
-                        {
-                          oi[ OCOL_SUM_VAR_NUM  ]++;
-                          oi[ OCOL_SUM_VAR      ] += varval + fabs(*V);
-                        }
-                    }
+          /* For flux weighted centers, we can only use positive
+             values, so do those measurements here. */
+          if( *V > 0.0f )
+            {
+              if(oif[ OCOL_NUMWHT ]) oi[ OCOL_NUMWHT ]++;
+              if(oif[ OCOL_SUMWHT ]) oi[ OCOL_SUMWHT ] += *V;
+              if(oif[ OCOL_VX ]) oi[ OCOL_VX ] += *V*(c[ndim-1]+1);
+              if(oif[ OCOL_VY ]) oi[ OCOL_VY ] += *V*(c[ndim-2]+1);
+              if(oif[ OCOL_VZ ]) oi[ OCOL_VZ ] += *V*(c[ndim-3]+1);
+              if(pp->shift)
+                {
+                  oi[ OCOL_VXX    ] += *V * sc[1] * sc[1];
+                  oi[ OCOL_VYY    ] += *V * sc[0] * sc[0];
+                  oi[ OCOL_VXY    ] += *V * sc[1] * sc[0];
+                }
+              if(p->clumps && *C>0)
+                {
+                  if(oif[ OCOL_C_NUMWHT ]) oi[ OCOL_C_NUMWHT ]++;
+                  if(oif[ OCOL_C_SUMWHT ]) oi[ OCOL_C_SUMWHT ]+=*V;
+                  if(oif[ OCOL_C_VX ])
+                    oi[   OCOL_C_VX ] += *V * (c[ ndim-1 ]+1);
+                  if(oif[ OCOL_C_VY ])
+                    oi[   OCOL_C_VY ] += *V * (c[ ndim-2 ]+1);
+                  if(oif[ OCOL_C_VZ ])
+                    oi[   OCOL_C_VZ ] += *V * (c[ ndim-3 ]+1);
                 }
             }
+        }
 
-          /* Increment the other pointers. */
-          if( xybin                ) ++pind;
-          if( p->values            ) ++V;
-          if( p->clumps            ) ++C;
-          if( p->sky && pp->st_sky ) ++SK;
-          if( p->std && pp->st_std ) ++ST;
+
+      /* Sky value based measurements. */
+      if(p->sky && oif[ OCOL_SUMSKY ])
+        {
+          skyval = ( pp->st_sky
+                     ? (isnan(*SK)?0:*SK)        /* Full array  */
+                     : ( p->sky->size>1
+                         ? (isnan(sky[tid])?0:sky[tid]) /* Tile */
+                         : sky[0] ) );           /* Single value*/
+          if(!isnan(skyval))
+            {
+              oi[ OCOL_NUMSKY  ]++;
+              oi[ OCOL_SUMSKY  ] += skyval;
+            }
         }
-      while(++O<OO);
 
-      /* Increment to the next contiguous region of this tile. */
-      increment += ( gal_tile_block_increment(p->objects, tsize,
-                                              num_increment++, NULL) );
 
-      /* If a 2D projection is requested, see if we should initialize (set
-         to zero) the projection-index ('pind') not. */
-      if(xybin && (num_increment-1)%tsize[1]==0 )
-        pind=0;
+      /* Sky standard deviation based measurements.*/
+      if(p->std)
+        {
+          /* Calculate the variance and save it in the output if
+             necessary. */
+          sval=pp->st_std ? *ST : (p->std->size>1?std[tid]:std[0]);
+          var = p->variance ? sval : sval*sval;
+          if(oif[ OCOL_SUMVAR ] && (!isnan(var)))
+            {
+              oi[ OCOL_NUMVAR  ]++;
+              oi[ OCOL_SUMVAR  ] += var;
+            }
+
+          /* For each pixel, we have a sky contribution to the
+             counts and the signal's contribution. The standard
+             deviation in the sky is simply 'sval', but the
+             standard deviation of the signal (independent of the
+             sky) is 'sqrt(*V)'. Therefore the total variance of
+             this pixel is the variance of the sky added with the
+             absolute value of its sky-subtracted flux. We use the
+             absolute value, because especially as the signal gets
+             noisy there will be negative values, and we don't want
+             them to decrease the variance. */
+          if(oif[ OCOL_SUM_VAR ] && goodvalue)
+            {
+              varval=p->variance ? var : sval;
+              if(!isnan(varval))
+                {
+                  oi[ OCOL_SUM_VAR_NUM  ]++;
+                  oi[ OCOL_SUM_VAR      ] += varval + fabs(*V);
+                }
+            }
+        }
     }
 
   /* Write the projected area columns. */
@@ -725,12 +717,12 @@ parse_clumps(struct mkcatalog_passparams *pp)
 
   double *ci, *cir;
   gal_data_t *xybin=NULL;
-  int32_t *O, *OO, *C=NULL, nlab;
-  size_t cind, *tsize=pp->tile->dsize;
+  int32_t *C=NULL, nlab;
+  size_t o, ind, cind, *tsize=pp->tile->dsize;
   double *minima_v=NULL, *maxima_v=NULL;
   uint8_t *u, *uf, goodvalue, *cif=p->ciflag;
   size_t nngb=gal_dimension_num_neighbors(ndim);
-  size_t i, ii, d, pind=0, increment=0, num_increment=1;
+  size_t i, j, ii, d, pind=0;
   float var, sval, varval, skyval, *V=NULL, *SK=NULL, *ST=NULL;
   int32_t *objects=p->objects->array, *clumps=p->clumps->array;
   float *std=p->std?p->std->array:NULL, *sky=p->sky?p->sky->array:NULL;
@@ -802,307 +794,282 @@ parse_clumps(struct mkcatalog_passparams *pp)
       || cif[ CCOL_MAXVY   ] || cif[ CCOL_MAXVZ ] )
     maxima_v=parse_init_extrema(cif, GAL_TYPE_FLOAT64, pp->clumpsinobj, 1);
 
-  /* Parse each contiguous patch of memory covered by this object. */
-  while( pp->start_end_inc[0] + increment <= pp->start_end_inc[1] )
+  /* Parse over the pixels of this object (sorted by their index in the
+     image). 'o' is the offset of each pixel from the start of the tile
+     (where all the 'st_*' pointers point to). */
+  for(i=0;i<pp->numpix;++i)
     {
-      /* Set the contiguous range to parse. The pixel-to-pixel counting
-         along the fastest dimension will be done over the 'O' pointer. */
-      C = pp->st_c + increment;
-      if( p->values            ) V  = pp->st_v   + increment;
-      if( p->sky && pp->st_sky ) SK = pp->st_sky + increment;
-      if( p->std && pp->st_std ) ST = pp->st_std + increment;
-      OO = ( O = pp->st_o + increment ) + tsize[ndim-1];
-
-      /* Parse the tile */
-      do
+      ind = pp->pixind[i];
+      o   = ind - pp->start_end_inc[0];
+      C = pp->st_c + o;
+      if( p->values            ) V  = pp->st_v   + o;
+      if( p->sky && pp->st_sky ) SK = pp->st_sky + o;
+      if( p->std && pp->st_std ) ST = pp->st_std + o;
+      if( xybin                ) pind = parse_xy_index(pp, ind);
+
+      /* We are on a clump. */
+      if(p->clumps && *C>0)
         {
-          /* If this pixel belongs to the requested object then do the
-             processing. */
-          if( *O==pp->object )
+          /* Pointer to make things easier. Note that the clump
+             labels start from 1, but the array indexs from 0.*/
+          cind = *C-1;
+          ci=&pp->ci[ cind * CCOL_NUMCOLS ];
+
+          /* Add to the area of this object. */
+          if( cif[ CCOL_NUMALL ]
+              || cif[ CCOL_MINX ] || cif[ CCOL_MAXX ]
+              || cif[ CCOL_MINY ] || cif[ CCOL_MAXY ]
+              || cif[ CCOL_MINZ ] || cif[ CCOL_MAXZ ] )
+            ci[ CCOL_NUMALL ]++;
+          if(cif[ CCOL_NUMALLXY ])
+            ((uint8_t *)(xybin[cind].array))[ pind ] = 1;
+
+          /* Raw-position related measurements. */
+          if(c)
             {
-              /* We are on a clump. */
-              if(p->clumps && *C>0)
+              /* Get "C" the coordinates of this point. */
+              gal_dimension_index_to_coord(ind, ndim, dsize, c);
+
+              /* Position extrema measurements. */
+              if(cif[ CCOL_MINX ])
+                ci[CCOL_MINX]=CMIN(CCOL_MINX, ndim-1);
+              if(cif[ CCOL_MAXX ])
+                ci[CCOL_MAXX]=CMAX(CCOL_MAXX, ndim-1);
+              if(cif[ CCOL_MINY ])
+                ci[CCOL_MINY]=CMIN(CCOL_MINY, ndim-2);
+              if(cif[ CCOL_MAXY ])
+                ci[CCOL_MAXY]=CMAX(CCOL_MAXY, ndim-2);
+              if(cif[ CCOL_MINZ ])
+                ci[CCOL_MINZ]=CMIN(CCOL_MINZ, ndim-3);
+              if(cif[ CCOL_MAXZ ])
+                ci[CCOL_MAXZ]=CMAX(CCOL_MAXZ, ndim-3);
+
+              /* If we need tile-ID, get the tile ID now. */
+              if(tid!=GAL_BLANK_SIZE_T)
+                tid=gal_tile_full_id_from_coord(&p->cp.tl, c);
+
+              /* General geometric (independent of pixel value)
+                 calculations. */
+              if(cif[ CCOL_GX ]) ci[ CCOL_GX ] += c[ ndim-1 ]+1;
+              if(cif[ CCOL_GY ]) ci[ CCOL_GY ] += c[ ndim-2 ]+1;
+              if(cif[ CCOL_GZ ]) ci[ CCOL_GZ ] += c[ ndim-3 ]+1;
+              if(pp->shift)
                 {
-                  /* Pointer to make things easier. Note that the clump
-                     labels start from 1, but the array indexs from 0.*/
-                  cind = *C-1;
-                  ci=&pp->ci[ cind * CCOL_NUMCOLS ];
-
-                  /* Add to the area of this object. */
-                  if( cif[ CCOL_NUMALL ]
-                      || cif[ CCOL_MINX ] || cif[ CCOL_MAXX ]
-                      || cif[ CCOL_MINY ] || cif[ CCOL_MAXY ]
-                      || cif[ CCOL_MINZ ] || cif[ CCOL_MAXZ ] )
-                    ci[ CCOL_NUMALL ]++;
-                  if(cif[ CCOL_NUMALLXY ])
-                    ((uint8_t *)(xybin[cind].array))[ pind ] = 1;
-
-                  /* Raw-position related measurements. */
-                  if(c)
+                  /* Shifted coordinates for second order moments,
+                     see explanations in the first pass.*/
+                  for(d=0;d<ndim;++d) sc[d] = c[d]+1-pp->shift[d];
+
+                  /* Raw second-order measurements. */
+                  ci[ CCOL_GXX ] += sc[1] * sc[1];
+                  ci[ CCOL_GYY ] += sc[0] * sc[0];
+                  ci[ CCOL_GXY ] += sc[1] * sc[0];
+                }
+            }
+
+          /* Value related measurements, see 'parse_objects' for
+             comments. */
+          goodvalue=0;
+          if( p->values && !( p->hasblank && isnan(*V) ) )
+            {
+              /* For the standard-deviation measurement. */
+              goodvalue=1;
+
+              /* Fill in the necessary information. */
+              if(cif[ CCOL_NUM   ]) ci[ CCOL_NUM   ]++;
+              if(cif[ CCOL_SUM   ]) ci[ CCOL_SUM   ] += *V;
+              if(cif[ CCOL_SUMP2 ]) ci[ CCOL_SUMP2 ] += *V * *V;
+              if(cif[ CCOL_NUMXY ])
+                ((uint8_t *)(xybin[cind].array))[ pind ] = 2;
+
+              /* Minimum/maximum pixel positions. */
+              if( cif[ CCOL_MINVNUM ] && *V<=minima_v[cind] )
+                {
+                  if( *V<minima_v[cind] )
                     {
-                      /* Get "C" the coordinates of this point. */
-                      gal_dimension_index_to_coord(O-objects, ndim,
-                                                   dsize, c);
-
-                      /* Position extrema measurements. */
-                      if(cif[ CCOL_MINX ])
-                        ci[CCOL_MINX]=CMIN(CCOL_MINX, ndim-1);
-                      if(cif[ CCOL_MAXX ])
-                        ci[CCOL_MAXX]=CMAX(CCOL_MAXX, ndim-1);
-                      if(cif[ CCOL_MINY ])
-                        ci[CCOL_MINY]=CMIN(CCOL_MINY, ndim-2);
-                      if(cif[ CCOL_MAXY ])
-                        ci[CCOL_MAXY]=CMAX(CCOL_MAXY, ndim-2);
-                      if(cif[ CCOL_MINZ ])
-                        ci[CCOL_MINZ]=CMIN(CCOL_MINZ, ndim-3);
-                      if(cif[ CCOL_MAXZ ])
-                        ci[CCOL_MAXZ]=CMAX(CCOL_MAXZ, ndim-3);
-
-                      /* If we need tile-ID, get the tile ID now. */
-                      if(tid!=GAL_BLANK_SIZE_T)
-                        tid=gal_tile_full_id_from_coord(&p->cp.tl, c);
-
-                      /* General geometric (independent of pixel value)
-                         calculations. */
-                      if(cif[ CCOL_GX ]) ci[ CCOL_GX ] += c[ ndim-1 ]+1;
-                      if(cif[ CCOL_GY ]) ci[ CCOL_GY ] += c[ ndim-2 ]+1;
-                      if(cif[ CCOL_GZ ]) ci[ CCOL_GZ ] += c[ ndim-3 ]+1;
-                      if(pp->shift)
-                        {
-                          /* Shifted coordinates for second order moments,
-                             see explanations in the first pass.*/
-                          for(d=0;d<ndim;++d) sc[d] = c[d]+1-pp->shift[d];
-
-                          /* Raw second-order measurements. */
-                          ci[ CCOL_GXX ] += sc[1] * sc[1];
-                          ci[ CCOL_GYY ] += sc[0] * sc[0];
-                          ci[ CCOL_GXY ] += sc[1] * sc[0];
-                        }
+                      minima_v[cind] = *V;
+                      ci[ CCOL_MINVNUM ]=1;
+                      if(cif[CCOL_MINVX])
+                        ci[ CCOL_MINVX ] = c[ ndim-1 ]+1;
+                      if(cif[CCOL_MINVY])
+                        ci[ CCOL_MINVY ] = c[ ndim-2 ]+1;
+                      if(cif[CCOL_MINVZ])
+                        ci[ CCOL_MINVZ ] = c[ ndim-3 ]+1;
                     }
-
-                  /* Value related measurements, see 'parse_objects' for
-                     comments. */
-                  goodvalue=0;
-                  if( p->values && !( p->hasblank && isnan(*V) ) )
+                  else
                     {
-                      /* For the standard-deviation measurement. */
-                      goodvalue=1;
-
-                      /* Fill in the necessary information. */
-                      if(cif[ CCOL_NUM   ]) ci[ CCOL_NUM   ]++;
-                      if(cif[ CCOL_SUM   ]) ci[ CCOL_SUM   ] += *V;
-                      if(cif[ CCOL_SUMP2 ]) ci[ CCOL_SUMP2 ] += *V * *V;
-                      if(cif[ CCOL_NUMXY ])
-                        ((uint8_t *)(xybin[cind].array))[ pind ] = 2;
-
-                      /* Minimum/maximum pixel positions. */
-                      if( cif[ CCOL_MINVNUM ] && *V<=minima_v[cind] )
-                        {
-                          if( *V<minima_v[cind] )
-                            {
-                              minima_v[cind] = *V;
-                              ci[ CCOL_MINVNUM ]=1;
-                              if(cif[CCOL_MINVX])
-                                ci[ CCOL_MINVX ] = c[ ndim-1 ]+1;
-                              if(cif[CCOL_MINVY])
-                                ci[ CCOL_MINVY ] = c[ ndim-2 ]+1;
-                              if(cif[CCOL_MINVZ])
-                                ci[ CCOL_MINVZ ] = c[ ndim-3 ]+1;
-                            }
-                          else
-                            {
-                              ci[ CCOL_MINVNUM ]++;
-                              if(cif[CCOL_MINVX])
-                                ci[  CCOL_MINVX ] += c[ ndim-1 ]+1;
-                              if(cif[CCOL_MINVY])
-                                ci[  CCOL_MINVY ] += c[ ndim-2 ]+1;
-                              if(cif[CCOL_MINVZ])
-                                ci[  CCOL_MINVZ ] += c[ ndim-3 ]+1;
-                            }
-                        }
-                      if( cif[ CCOL_MAXVNUM ] && *V>=maxima_v[cind] )
-                        {
-                          if( *V>maxima_v[cind] )
-                            {
-                              maxima_v[cind] = *V;
-                              ci[ CCOL_MAXVNUM ]=1;
-                              if(cif[CCOL_MAXVX])
-                                ci[  CCOL_MAXVX ] = c[ ndim-1 ]+1;
-                              if(cif[CCOL_MAXVY])
-                                ci[  CCOL_MAXVY ] = c[ ndim-2 ]+1;
-                              if(cif[CCOL_MAXVZ])
-                                ci[  CCOL_MAXVZ ] = c[ ndim-3 ]+1;
-                            }
-                          else
-                            {
-                              ci[ CCOL_MAXVNUM ]++;
-                              if(cif[CCOL_MAXVX])
-                                ci[  CCOL_MAXVX ] += c[ ndim-1 ]+1;
-                              if(cif[CCOL_MAXVY])
-                                ci[  CCOL_MAXVY ] += c[ ndim-2 ]+1;
-                              if(cif[CCOL_MAXVZ])
-                                ci[  CCOL_MAXVZ ] += c[ ndim-3 ]+1;
-                            }
-                        }
-
-                      /* Columns that need positive values. */
-                      if( *V > 0.0f )
-                        {
-                          if(cif[ CCOL_NUMWHT ]) ci[ CCOL_NUMWHT ]++;
-                          if(cif[ CCOL_SUMWHT ]) ci[ CCOL_SUMWHT ] += *V;
-                          if(cif[ CCOL_VX ])
-                            ci[   CCOL_VX ] += *V * (c[ ndim-1 ]+1);
-                          if(cif[ CCOL_VY ])
-                            ci[   CCOL_VY ] += *V * (c[ ndim-2 ]+1);
-                          if(cif[ CCOL_VZ ])
-                            ci[   CCOL_VZ ] += *V * (c[ ndim-3 ]+1);
-                          if(pp->shift)
-                            {
-                              ci[ CCOL_VXX ] += *V * sc[1] * sc[1];
-                              ci[ CCOL_VYY ] += *V * sc[0] * sc[0];
-                              ci[ CCOL_VXY ] += *V * sc[1] * sc[0];
-                            }
-                        }
+                      ci[ CCOL_MINVNUM ]++;
+                      if(cif[CCOL_MINVX])
+                        ci[  CCOL_MINVX ] += c[ ndim-1 ]+1;
+                      if(cif[CCOL_MINVY])
+                        ci[  CCOL_MINVY ] += c[ ndim-2 ]+1;
+                      if(cif[CCOL_MINVZ])
+                        ci[  CCOL_MINVZ ] += c[ ndim-3 ]+1;
                     }
-
-                  /* Sky based measurements. */
-                  if(p->sky && cif[ CCOL_SUMSKY ])
+                }
+              if( cif[ CCOL_MAXVNUM ] && *V>=maxima_v[cind] )
+                {
+                  if( *V>maxima_v[cind] )
                     {
-                      skyval = ( pp->st_sky
-                                 ? *SK             /* Full. */
-                                 : ( p->sky->size>1
-                                     ? sky[tid]    /* Tile. */
-                                     : sky[0] ) ); /* 1 value. */
-                      if(!isnan(skyval))
-                        {
-                          ci[ CCOL_NUMSKY  ]++;
-                          ci[ CCOL_SUMSKY  ] += skyval;
-                        }
+                      maxima_v[cind] = *V;
+                      ci[ CCOL_MAXVNUM ]=1;
+                      if(cif[CCOL_MAXVX])
+                        ci[  CCOL_MAXVX ] = c[ ndim-1 ]+1;
+                      if(cif[CCOL_MAXVY])
+                        ci[  CCOL_MAXVY ] = c[ ndim-2 ]+1;
+                      if(cif[CCOL_MAXVZ])
+                        ci[  CCOL_MAXVZ ] = c[ ndim-3 ]+1;
                     }
-
-                  /* Sky Standard deviation based measurements, see
-                     'parse_objects' for comments. */
-                  if(p->std)
+                  else
                     {
-                      sval = ( pp->st_std
-                               ? *ST
-                               : (p->std->size>1 ? std[tid] : std[0]) );
-                      var = p->variance ? sval : sval*sval;
-                      if(cif[ CCOL_SUMVAR  ] && (!isnan(var)))
-                        {
-                          ci[ CCOL_NUMVAR ]++;
-                          ci[ CCOL_SUMVAR ] += var;
-                        }
-                      if(cif[ CCOL_SUM_VAR ] && goodvalue)
-                        {
-                          varval=p->variance ? var : sval;
-                          if(!isnan(varval))
-                            {
-                              ci[ CCOL_SUM_VAR_NUM ]++;
-                              ci[ CCOL_SUM_VAR     ] += varval + fabs(*V);
-                            }
-                        }
+                      ci[ CCOL_MAXVNUM ]++;
+                      if(cif[CCOL_MAXVX])
+                        ci[  CCOL_MAXVX ] += c[ ndim-1 ]+1;
+                      if(cif[CCOL_MAXVY])
+                        ci[  CCOL_MAXVY ] += c[ ndim-2 ]+1;
+                      if(cif[CCOL_MAXVZ])
+                        ci[  CCOL_MAXVZ ] += c[ ndim-3 ]+1;
                     }
                 }
 
-              /* This pixel is on the diffuse region (and the object
-                 actually has clumps). If any river-based measurements are
-                 necessary check to see if it is touching a clump or not,
-                 but only if this object actually has any clumps. */
-              else if(ngblabs && pp->clumpsinobj)
+              /* Columns that need positive values. */
+              if( *V > 0.0f )
                 {
-                  /* We are on a diffuse (possibly a river) pixel. So the
-                     value of this pixel has to be added to any of the
-                     clumps in touches. But since it might touch a labeled
-                     region more than once, we use 'ngblabs' to keep track
-                     of which label we have already added its value
-                     to. 'ii' is the number of different labels this river
-                     pixel has already been considered for. 'ngblabs' will
-                     keep the list labels. */
-                  ii=0;
-                  memset(ngblabs, 0, nngb*sizeof *ngblabs);
-
-                  /* Go over the neighbors and see if this pixel is
-                     touching a clump or not. */
-                  GAL_DIMENSION_NEIGHBOR_OP(O-objects, ndim, dsize, ndim,
-                                            dinc,
-                     {
-                       /* Neighbor's label (mainly for easy reading). */
-                       nlab=clumps[nind];
+                  if(cif[ CCOL_NUMWHT ]) ci[ CCOL_NUMWHT ]++;
+                  if(cif[ CCOL_SUMWHT ]) ci[ CCOL_SUMWHT ] += *V;
+                  if(cif[ CCOL_VX ])
+                    ci[   CCOL_VX ] += *V * (c[ ndim-1 ]+1);
+                  if(cif[ CCOL_VY ])
+                    ci[   CCOL_VY ] += *V * (c[ ndim-2 ]+1);
+                  if(cif[ CCOL_VZ ])
+                    ci[   CCOL_VZ ] += *V * (c[ ndim-3 ]+1);
+                  if(pp->shift)
+                    {
+                      ci[ CCOL_VXX ] += *V * sc[1] * sc[1];
+                      ci[ CCOL_VYY ] += *V * sc[0] * sc[0];
+                      ci[ CCOL_VXY ] += *V * sc[1] * sc[0];
+                    }
+                }
+            }
 
-                       /* We only want neighbors that are a clump and part
-                          of this object and part of the same object. */
-                       if( nlab>0 && objects[nind]==pp->object)
-                         {
-                           /* Go over all already checked labels and make
-                              sure this clump hasn't already been
-                              considered. */
-                           for(i=0;i<ii;++i) if(ngblabs[i]==nlab) break;
-
-                           /* It hasn't been considered yet: */
-                           if(i==ii)
-                             {
-                               /* Make sure it won't be considered any
-                                  more. */
-                               ngblabs[ii++] = nlab;
-
-                               /* To help in reading. */
-                               cir=&pp->ci[ (nlab-1) * CCOL_NUMCOLS ];
-
-                               /* Write in the necessary values. */
-                               if(cif[ CCOL_RIV_NUM  ])
-                                 cir[ CCOL_RIV_NUM ]++;
-
-                               /* Total sum of values in river. */
-                               if(cif[ CCOL_RIV_SUM  ])
-                                 cir[ CCOL_RIV_SUM ] += *V;
-
-                               /* Minimum river value. */
-                               if(cif[CCOL_RIV_MIN])
-                                 if(cir[CCOL_RIV_NUM]==1
-                                    || *V < cir[CCOL_RIV_MIN])
-                                   cir[CCOL_RIV_MIN]=*V;
-
-                               /* Maximum river value. */
-                               if(cif[CCOL_RIV_MAX])
-                                 if(cir[CCOL_RIV_NUM]==1
-                                    || *V > cir[CCOL_RIV_MAX])
-                                   cir[CCOL_RIV_MAX]=*V;
-
-                               /* Sum of variances within river. */
-                               if(cif[ CCOL_RIV_SUM_VAR  ])
-                                 {
-                                   sval = ( pp->st_std
-                                            ? *ST
-                                            : ( p->std->size>1
-                                                ? std[tid]
-                                                : std[0] )     );
-                                   cir[ CCOL_RIV_SUM_VAR ] += fabs(*V)
-                                     + (p->variance ? sval : sval*sval);
-                                 }
-                             }
-                         }
-                     });
+          /* Sky based measurements. */
+          if(p->sky && cif[ CCOL_SUMSKY ])
+            {
+              skyval = ( pp->st_sky
+                         ? *SK             /* Full. */
+                         : ( p->sky->size>1
+                             ? sky[tid]    /* Tile. */
+                             : sky[0] ) ); /* 1 value. */
+              if(!isnan(skyval))
+                {
+                  ci[ CCOL_NUMSKY  ]++;
+                  ci[ CCOL_SUMSKY  ] += skyval;
                 }
             }
 
-          /* Increment the other pointers. */
-          ++C;
-          if( xybin                ) ++pind;
-          if( p->values            ) ++V;
-          if( p->sky && pp->st_sky ) ++SK;
-          if( p->std && pp->st_std ) ++ST;
+          /* Sky Standard deviation based measurements, see
+             'parse_objects' for comments. */
+          if(p->std)
+            {
+              sval = ( pp->st_std
+                       ? *ST
+                       : (p->std->size>1 ? std[tid] : std[0]) );
+              var = p->variance ? sval : sval*sval;
+              if(cif[ CCOL_SUMVAR  ] && (!isnan(var)))
+                {
+                  ci[ CCOL_NUMVAR ]++;
+                  ci[ CCOL_SUMVAR ] += var;
+                }
+              if(cif[ CCOL_SUM_VAR ] && goodvalue)
+                {
+                  varval=p->variance ? var : sval;
+                  if(!isnan(varval))
+                    {
+                      ci[ CCOL_SUM_VAR_NUM ]++;
+                      ci[ CCOL_SUM_VAR     ] += varval + fabs(*V);
+                    }
+                }
+            }
         }
-      while(++O<OO);
 
-      /* Increment to the next contiguous region of this tile. */
-      increment += ( gal_tile_block_increment(p->objects, tsize,
-                                              num_increment++, NULL) );
-
-      /* If a 2D projection is requested, see if we should initialize (set
-         to zero) the projection-index ('pind') not. */
-      if(xybin && (num_increment-1) % tsize[1]==0 )
-        pind=0;
+      /* This pixel is on the diffuse region (and the object
+         actually has clumps). If any river-based measurements are
+         necessary check to see if it is touching a clump or not,
+         but only if this object actually has any clumps. */
+      else if(ngblabs && pp->clumpsinobj)
+        {
+          /* We are on a diffuse (possibly a river) pixel. So the
+             value of this pixel has to be added to any of the
+             clumps in touches. But since it might touch a labeled
+             region more than once, we use 'ngblabs' to keep track
+             of which label we have already added its value
+             to. 'ii' is the number of different labels this river
+             pixel has already been considered for. 'ngblabs' will
+             keep the list labels. */
+          ii=0;
+          memset(ngblabs, 0, nngb*sizeof *ngblabs);
+
+          /* Go over the neighbors and see if this pixel is
+             touching a clump or not. */
+          GAL_DIMENSION_NEIGHBOR_OP(ind, ndim, dsize, ndim,
+                                    dinc,
+             {
+               /* Neighbor's label (mainly for easy reading). */
+               nlab=clumps[nind];
+
+               /* We only want neighbors that are a clump and part
+                  of this object and part of the same object. */
+               if( nlab>0 && objects[nind]==pp->object)
+                 {
+                   /* Go over all already checked labels and make
+                      sure this clump hasn't already been
+                      considered. */
+                   for(j=0;j<ii;++j) if(ngblabs[j]==nlab) break;
+
+                   /* It hasn't been considered yet: */
+                   if(j==ii)
+                     {
+                       /* Make sure it won't be considered any
+                          more. */
+                       ngblabs[ii++] = nlab;
+
+                       /* To help in reading. */
+                       cir=&pp->ci[ (nlab-1) * CCOL_NUMCOLS ];
+
+                       /* Write in the necessary values. */
+                       if(cif[ CCOL_RIV_NUM  ])
+                         cir[ CCOL_RIV_NUM ]++;
+
+                       /* Total sum of values in river. */
+                       if(cif[ CCOL_RIV_SUM  ])
+                         cir[ CCOL_RIV_SUM ] += *V;
+
+                       /* Minimum river value. */
+                       if(cif[CCOL_RIV_MIN])
+                         if(cir[CCOL_RIV_NUM]==1
+                            || *V < cir[CCOL_RIV_MIN])
+                           cir[CCOL_RIV_MIN]=*V;
+
+                       /* Maximum river value. */
+                       if(cif[CCOL_RIV_MAX])
+                         if(cir[CCOL_RIV_NUM]==1
+                            || *V > cir[CCOL_RIV_MAX])
+                           cir[CCOL_RIV_MAX]=*V;
+
+                       /* Sum of variances within river. */
+                       if(cif[ CCOL_RIV_SUM_VAR  ])
+                         {
+                           sval = ( pp->st_std
+                                    ? *ST
+                                    : ( p->std->size>1
+                                        ? std[tid]
+                                        : std[0] )     );
+                           cir[ CCOL_RIV_SUM_VAR ] += fabs(*V)
+                             + (p->variance ? sval : sval*sval);
+                         }
+                     }
+                 }
+             });
+        }
     }
 
 
@@ -1279,10 +1246,9 @@ parse_order_based(struct mkcatalog_passparams *pp)
   float *sigcliparr;
   gal_data_t *result;
   uint8_t clipflags=0;
-  int32_t *O, *OO, *C=NULL;
-  size_t i, increment=0, num_increment=1;
+  int32_t *C=NULL;
+  size_t i, o, ind;
   gal_data_t *objvals=NULL, **clumpsvals=NULL;
-  size_t *tsize=pp->tile->dsize, ndim=p->objects->ndim;
   size_t counter=0, *ccounter=NULL, tmpsize=pp->oi[OCOL_NUM];
 
   /* It may happen that there are no usable pixels for this object (and
@@ -1353,45 +1319,32 @@ parse_order_based(struct mkcatalog_passparams *pp)
     }
 
 
-  /* Parse each contiguous patch of memory covered by this object. */
-  while( pp->start_end_inc[0] + increment <= pp->start_end_inc[1] )
+  /* Parse over the pixels of this object (sorted by their index in the
+     image). 'o' is the offset of each pixel from the start of the tile
+     (where all the 'st_*' pointers point to). */
+  for(i=0;i<pp->numpix;++i)
     {
-      /* Set the contiguous range to parse. The pixel-to-pixel counting
-         along the fastest dimension will be done over the 'O' pointer. */
-      V = pp->st_v + increment;
-      if(p->clumps) C = pp->st_c + increment;
-      OO = ( O = pp->st_o + increment ) + tsize[ndim-1];
-
-      /* Parse the next contiguous region of this tile. */
-      do
+      ind = pp->pixind[i];
+      o   = ind - pp->start_end_inc[0];
+      V   = pp->st_v + o;
+      if(p->clumps) C = pp->st_c + o;
+
+      /* 'hasblank' is constant, so when the values don't have any blank
+         values, the 'isnan' will never be checked. */
+      if( !( p->hasblank && isnan(*V) ) )
         {
-          /* If this pixel belongs to the requested object, then do the
-             processing. 'hasblank' is constant, so when the values doesn't
-             have any blank values, the 'isnan' will never be checked. */
-          if( *O==pp->object && !( p->hasblank && isnan(*V) ) )
-            {
-              /* Copy the value for the whole object. */
-              memcpy( gal_pointer_increment(objvals->array, counter++,
-                                             p->values->type), V,
-                      gal_type_sizeof(p->values->type) );
-
-              /* We are also on a clump. */
-              if(p->clumps && *C>0 && clumpsvals[*C-1]!=NULL)
-                memcpy( gal_pointer_increment(clumpsvals[*C-1]->array,
-                                              ccounter[*C-1]++,
-                                              p->values->type), V,
-                        gal_type_sizeof(p->values->type) );
-            }
-
-          /* Increment the other pointers. */
-          ++V;
-          if(p->clumps) ++C;
+          /* Copy the value for the whole object. */
+          memcpy( gal_pointer_increment(objvals->array, counter++,
+                                         p->values->type), V,
+                  gal_type_sizeof(p->values->type) );
+
+          /* We are also on a clump. */
+          if(p->clumps && *C>0 && clumpsvals[*C-1]!=NULL)
+            memcpy( gal_pointer_increment(clumpsvals[*C-1]->array,
+                                          ccounter[*C-1]++,
+                                          p->values->type), V,
+                    gal_type_sizeof(p->values->type) );
         }
-      while(++O<OO);
-
-      /* Increment to the next contiguous region of this tile. */
-      increment += ( gal_tile_block_increment(p->objects, tsize,
-                                              num_increment++, NULL) );
     }
 
 
@@ -49,6 +49,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include "mkcatalog.h"
 
 #include "ui.h"
+#include "band.h"
 #include "columns.h"
 #include "authors-cite.h"
 
@@ -445,6 +446,12 @@ ui_check_only_options(struct mkcatalogparams *p)
                 "the requested fraction as a second value to '--fracmax', "
                 "separated by a comma (,)");
     }
+
+  /* The clumps catalog isn't yet implemented in band mode. */
+  if(p->bandrows && p->clumpscat)
+    error(EXIT_FAILURE, 0, "'--clumpscat' can't be used with '--bandrows' "
+          "(the clumps catalog can't yet be made when the inputs are read "
+          "in bands of rows)");
 }
 
 
@@ -726,37 +733,16 @@ ui_num_clumps(struct mkcatalogparams *p)
 
 
 
-/* To make the catalog processing more scalable (and later allow for
-   over-lappping regions), we will define a tile for each object. */
+/* Update the minimum and maximum coordinates of each label with the
+   'size' pixels starting at 'labels' ('start' is the index of the first
+   one in the full labeled image). */
 static void
-ui_one_tile_per_object_correct_numobjects(struct mkcatalogparams *p)
+ui_labels_minmax(struct mkcatalogparams *p, int32_t *labels, size_t size,
+                 size_t start, size_t *minmax, size_t *coord)
 {
-  size_t ndim=p->objects->ndim;
-
-  uint8_t *rarray=NULL;
-  int32_t *l, *lf, *start;
-  gal_data_t *rowsremove=NULL;
-  size_t i, j, d, no, *min, *max, exists, width=2*ndim;
-  size_t *minmax=gal_pointer_allocate(GAL_TYPE_SIZE_T,
-                                      width*p->numobjects, 0, __func__,
-                                      "minmax");
-  size_t *coord=gal_pointer_allocate(GAL_TYPE_SIZE_T, ndim, 0, __func__,
-                                      "coord");
+  size_t d, *min, *max, ndim=p->objects->ndim, width=2*ndim;
+  int32_t *l=labels, *lf=labels+size;
 
-  /* Initialize the minimum and maximum position for each tile/object. So,
-     we'll initialize the minimum coordinates to the maximum possible
-     'size_t' value (in 'GAL_BLANK_SIZE_T') and the maximums to zero. */
-  for(i=0;i<p->numobjects;++i)
-    for(d=0;d<ndim;++d)
-      {
-        minmax[ i * width +        d ] = GAL_BLANK_SIZE_T; /* Minimum. */
-        minmax[ i * width + ndim + d ] = 0;                /* Maximum. */
-      }
-
-  /* Go over the objects label image and correct the minimum and maximum
-     coordinates. */
-  start=p->objects->array;
-  lf=(l=p->objects->array)+p->objects->size;
   do
     {
       /* Small sanity check: the objects image shouldn't have negative
@@ -779,8 +765,8 @@ ui_one_tile_per_object_correct_numobjects(struct mkcatalogparams *p)
       if(*l>0)
         {
           /* Get the coordinates of this pixel. */
-          gal_dimension_index_to_coord(l-start, ndim, p->objects->dsize,
-                                       coord);
+          gal_dimension_index_to_coord(start+(l-labels), ndim,
+                                       p->objects->dsize, coord);
 
           /* Check to see this coordinate is the smallest/largest found so
              far for this label. Note that labels start from 1, while indexs
@@ -795,6 +781,56 @@ ui_one_tile_per_object_correct_numobjects(struct mkcatalogparams *p)
         }
     }
   while(++l<lf);
+}
+
+
+
+
+
+/* To make the catalog processing more scalable (and later allow for
+   over-lappping regions), we will define a tile for each object. */
+static void
+ui_one_tile_per_object_correct_numobjects(struct mkcatalogparams *p)
+{
+  size_t ndim=p->objects->ndim;
+
+  uint8_t *rarray=NULL;
+  gal_data_t *labels, *rowsremove=NULL;
+  size_t i, j, d, no, row, nrows, exists, width=2*ndim;
+  size_t *minmax=gal_pointer_allocate(GAL_TYPE_SIZE_T,
+                                      width*p->numobjects, 0, __func__,
+                                      "minmax");
+  size_t *coord=gal_pointer_allocate(GAL_TYPE_SIZE_T, ndim, 0, __func__,
+                                      "coord");
+
+  /* Initialize the minimum and maximum position for each tile/object. So,
+     we'll initialize the minimum coordinates to the maximum possible
+     'size_t' value (in 'GAL_BLANK_SIZE_T') and the maximums to zero. */
+  for(i=0;i<p->numobjects;++i)
+    for(d=0;d<ndim;++d)
+      {
+        minmax[ i * width +        d ] = GAL_BLANK_SIZE_T; /* Minimum. */
+        minmax[ i * width + ndim + d ] = 0;                /* Maximum. */
+      }
+
+  /* Go over the objects label image and correct the minimum and maximum
+     coordinates. In band mode, the labels are read one band at a time. */
+  if(p->bandrows)
+    {
+      labels=band_alloc(p, p->objectsfile, p->cp.hdu, GAL_TYPE_INT32,
+                        "--hdu");
+      for(row=0; row<p->objects->dsize[0]; row+=nrows)
+        {
+          nrows=band_read(p, labels, p->objectsfile, p->cp.hdu, row,
+                          "--hdu");
+          ui_labels_minmax(p, labels->array, nrows*labels->dsize[1],
+                           row*labels->dsize[1], minmax, coord);
+        }
+      gal_data_free(labels);
+    }
+  else
+    ui_labels_minmax(p, p->objects->array, p->objects->size, 0, minmax,
+                     coord);
 
   /* If a label doesn't exist in the image, then write over it and define
      the unique labels to use for the next steps. To over-write, we have
@@ -887,12 +923,45 @@ ui_one_tile_per_object_correct_numobjects(struct mkcatalogparams *p)
            minmax[i*width+1], minmax[i*width+2], minmax[i*width+3]);
   */
 
-  /* Make the tiles. */
-  p->tiles=gal_tile_series_from_minmax(p->objects, minmax, p->numobjects);
+  /* Make the tiles. In band mode, the labels aren't in memory, so the
+     bounding box of each object is kept instead. */
+  if(p->bandrows) p->minmax=minmax;
+  else
+    {
+      p->tiles=gal_tile_series_from_minmax(p->objects, minmax,
+                                           p->numobjects);
+      free(minmax);
+    }
 
   /* Clean up. */
   free(coord);
-  free(minmax);
+}
+
+
+
+
+
+/* In band mode, find the largest label by reading the labeled image one
+   band at a time. */
+static size_t
+ui_read_labels_band_max(struct mkcatalogparams *p)
+{
+  gal_data_t *labels;
+  size_t row, nrows;
+  int32_t *l, *lf, max=0;
+
+  /* Parse the bands (blank labels are negative). */
+  labels=band_alloc(p, p->objectsfile, p->cp.hdu, GAL_TYPE_INT32, "--hdu");
+  for(row=0; row<p->objects->dsize[0]; row+=nrows)
+    {
+      nrows=band_read(p, labels, p->objectsfile, p->cp.hdu, row, "--hdu");
+      lf=(l=labels->array)+nrows*labels->dsize[1];
+      do if(*l>max) max=*l; while(++l<lf);
+    }
+
+  /* Clean up and return. */
+  gal_data_free(labels);
+  return max;
 }
 
 
@@ -904,22 +973,32 @@ ui_one_tile_per_object_correct_numobjects(struct mkcatalogparams *p)
 static void
 ui_read_labels(struct mkcatalogparams *p)
 {
+  uint8_t intype;
   gal_list_i32_t *colcode;
   gal_data_t *tmp, *keys=gal_data_array_calloc(2);
 
-  /* Read it into memory. */
-  p->objects = gal_array_read_one_ch(p->objectsfile, p->cp.hdu, NULL,
-                                     p->cp.minmapsize, p->cp.quietmmap,
-                                     "--hdu");
-  p->objects->ndim=gal_dimension_remove_extra(p->objects->ndim,
-                                              p->objects->dsize, NULL);
-
-  /* Make sure it has an integer type. */
-  ui_check_type_int(p->objectsfile, p->cp.hdu, p->objects->type);
-
-
-  /* Convert it to 'int32' type (if it already isn't). */
-  p->objects=gal_data_copy_to_new_type_free(p->objects, GAL_TYPE_INT32);
+  /* Read it into memory. In band mode, only its type and size are read
+     here (its pixels are read one band of rows at a time). */
+  if(p->bandrows)
+    {
+      p->objects=band_objects(p, &intype);
+      ui_check_type_int(p->objectsfile, p->cp.hdu, intype);
+    }
+  else
+    {
+      p->objects = gal_array_read_one_ch(p->objectsfile, p->cp.hdu, NULL,
+                                         p->cp.minmapsize,
+                                         p->cp.quietmmap, "--hdu");
+      p->objects->ndim=gal_dimension_remove_extra(p->objects->ndim,
+                                                  p->objects->dsize, NULL);
+
+      /* Make sure it has an integer type. */
+      ui_check_type_int(p->objectsfile, p->cp.hdu, p->objects->type);
+
+      /* Convert it to 'int32' type (if it already isn't). */
+      p->objects=gal_data_copy_to_new_type_free(p->objects,
+                                                GAL_TYPE_INT32);
+    }
 
 
   /* Currently MakeCatalog is only implemented for 2D images or 3D cubes. */
@@ -927,6 +1006,10 @@ ui_read_labels(struct mkcatalogparams *p)
     error(EXIT_FAILURE, 0, "%s (hdu %s) has %zu dimensions, MakeCatalog "
           "currently only supports 2D or 3D datasets", p->objectsfile,
           p->cp.hdu, p->objects->ndim);
+  if(p->bandrows && p->objects->ndim!=2)
+    error(EXIT_FAILURE, 0, "%s (hdu %s) has %zu dimensions, but the "
+          "inputs can only be read in bands of rows ('--bandrows') for 2D "
+          "images", p->objectsfile, p->cp.hdu, p->objects->ndim);
 
 
   /* If a column needs a 3D input, do the check here.  */
@@ -957,13 +1040,17 @@ ui_read_labels(struct mkcatalogparams *p)
   if(keys[0].status) /* status!=0: the key didn't exist. */
     {
       /* Get the maximum of the labels.*/
-      tmp=gal_statistics_maximum(p->objects);
-      p->numobjects=*((int32_t *)(tmp->array)); /*numobjects is int32_t.*/
+      if(p->bandrows) p->numobjects=ui_read_labels_band_max(p);
+      else
+        {
+          tmp=gal_statistics_maximum(p->objects);
+          p->numobjects=*((int32_t *)(tmp->array)); /* Is int32_t. */
 
-      /* In case the input is all blank, the maximum will be blank, so in
-         effect, there we no objects. */
-      if(p->numobjects==GAL_BLANK_INT32) p->numobjects=0;
-      gal_data_free(tmp);
+          /* In case the input is all blank, the maximum will be blank, so
+             in effect, there we no objects. */
+          if(p->numobjects==GAL_BLANK_INT32) p->numobjects=0;
+          gal_data_free(tmp);
+        }
     }
 
   /* If there were no objects in the input, then inform the user with an
@@ -975,8 +1062,10 @@ ui_read_labels(struct mkcatalogparams *p)
 
 
   /* See if the labels image has blank pixels and set the flags
-     appropriately. */
-  p->hasblank = gal_blank_present(p->objects, 1);
+     appropriately. In band mode, the pixels aren't in memory, so we'll
+     assume there are blank pixels (this only adds a check on every
+     pixel). */
+  p->hasblank = p->bandrows ? 1 : gal_blank_present(p->objects, 1);
 
 
   /* Prepare WCS information for final table meta-data. */
@@ -1299,7 +1388,7 @@ ui_preparation_check_size_read_tiles(struct mkcatalogparams *p,
 
 /* Subtract 'sky' from the input dataset depending on its size (it may be
    the whole array or a tile-values array).. */
-static void
+void
 ui_subtract_sky(struct mkcatalogparams *p)
 {
   size_t tid;
@@ -1367,26 +1456,36 @@ ui_preparations_read_inputs(struct mkcatalogparams *p)
               "dataset is in another file, please use '--valuesfile' to "
               "give the filename", p->usedvaluesfile);
 
-      /* Read the values dataset. */
-      p->values=gal_array_read_one_ch_to_type(p->usedvaluesfile,
-                                              p->valueshdu,
-                                              NULL, GAL_TYPE_FLOAT32,
-                                              p->cp.minmapsize,
-                                              p->cp.quietmmap,
-                                              "--valueshdu");
-      p->values->ndim=gal_dimension_remove_extra(p->values->ndim,
-                                                 p->values->dsize, NULL);
-
-      /* Make sure it has the correct size. */
-      if( gal_dimension_is_different(p->objects, p->values) )
-        error(EXIT_FAILURE, 0, "'%s' (hdu: %s) and '%s' (hdu: %s) have a"
-              "different dimension/size", p->usedvaluesfile, p->valueshdu,
-              p->objectsfile, p->cp.hdu);
+      /* In band mode, only allocate the space for one band (its size is
+         checked there). */
+      if(p->bandrows)
+        p->values=band_alloc(p, p->usedvaluesfile, p->valueshdu,
+                             GAL_TYPE_FLOAT32, "--valueshdu");
+      else
+        {
+          /* Read the values dataset. */
+          p->values=gal_array_read_one_ch_to_type(p->usedvaluesfile,
+                                                  p->valueshdu,
+                                                  NULL, GAL_TYPE_FLOAT32,
+                                                  p->cp.minmapsize,
+                                                  p->cp.quietmmap,
+                                                  "--valueshdu");
+          p->values->ndim=gal_dimension_remove_extra(p->values->ndim,
+                                                     p->values->dsize,
+                                                     NULL);
 
-      /* Initially, 'p->hasblank' was set based on the objects image, but
-         it may happen that the objects image only has zero values for
-         blank pixels, so we'll also do a check on the input image. */
-      p->hasblank = gal_blank_present(p->values, 1);
+          /* Make sure it has the correct size. */
+          if( gal_dimension_is_different(p->objects, p->values) )
+            error(EXIT_FAILURE, 0, "'%s' (hdu: %s) and '%s' (hdu: %s) "
+                  "have a different dimension/size", p->usedvaluesfile,
+                  p->valueshdu, p->objectsfile, p->cp.hdu);
+
+          /* Initially, 'p->hasblank' was set based on the objects image,
+             but it may happen that the objects image only has zero values
+             for blank pixels, so we'll also do a check on the input
+             image. */
+          p->hasblank = gal_blank_present(p->values, 1);
+        }
 
       /* Reset the units of the value-based columns if the input dataset
          has defined units. */
@@ -1425,22 +1524,32 @@ ui_preparations_read_inputs(struct mkcatalogparams *p)
                   "the dataset is in another file, please use '--skyin' "
                   "to give the filename", p->usedskyfile);
 
-          /* Read the Sky dataset. */
-          p->sky=gal_array_read_one_ch_to_type(p->usedskyfile, p->skyhdu,
-                                               NULL, GAL_TYPE_FLOAT32,
-                                               p->cp.minmapsize,
-                                               p->cp.quietmmap,
-                                               "--skyhdu");
-          p->sky->ndim=gal_dimension_remove_extra(p->sky->ndim,
-                                                  p->sky->dsize, NULL);
-
-          /* Check its size and prepare tile structure. */
-          ui_preparation_check_size_read_tiles(p, p->sky, p->usedskyfile,
-                                               p->skyhdu);
+          /* Read the Sky dataset (only one band in band mode). */
+          if(p->bandrows)
+            p->sky=band_alloc(p, p->usedskyfile, p->skyhdu,
+                              GAL_TYPE_FLOAT32, "--skyhdu");
+          else
+            {
+              p->sky=gal_array_read_one_ch_to_type(p->usedskyfile,
+                                                   p->skyhdu, NULL,
+                                                   GAL_TYPE_FLOAT32,
+                                                   p->cp.minmapsize,
+                                                   p->cp.quietmmap,
+                                                   "--skyhdu");
+              p->sky->ndim=gal_dimension_remove_extra(p->sky->ndim,
+                                                      p->sky->dsize,
+                                                      NULL);
+
+              /* Check its size and prepare tile structure. */
+              ui_preparation_check_size_read_tiles(p, p->sky,
+                                                   p->usedskyfile,
+                                                   p->skyhdu);
+            }
         }
 
-      /* Subtract the Sky value. */
-      if(p->subtractsky) ui_subtract_sky(p);
+      /* Subtract the Sky value (in band mode, it is subtracted from each
+         band after it is read). */
+      if(p->subtractsky && p->bandrows==0) ui_subtract_sky(p);
     }
 
 
@@ -1458,17 +1567,25 @@ ui_preparations_read_inputs(struct mkcatalogparams *p)
               "file, please use '--stdin' to give the filename",
               p->usedstdfile);
 
-      /* Read the Sky standard deviation image into memory. */
-      p->std=gal_array_read_one_ch_to_type(p->usedstdfile, p->stdhdu,
-                                           NULL, GAL_TYPE_FLOAT32,
-                                           p->cp.minmapsize,
-                                           p->cp.quietmmap, "--stdhdu");
-      p->std->ndim=gal_dimension_remove_extra(p->std->ndim,
-                                              p->std->dsize, NULL);
-
-      /* Check its size and prepare tile structure. */
-      ui_preparation_check_size_read_tiles(p, p->std, p->usedstdfile,
-                                           p->stdhdu);
+      /* Read the Sky standard deviation image into memory (only one
+         band in band mode). */
+      if(p->bandrows)
+        p->std=band_alloc(p, p->usedstdfile, p->stdhdu, GAL_TYPE_FLOAT32,
+                          "--stdhdu");
+      else
+        {
+          p->std=gal_array_read_one_ch_to_type(p->usedstdfile, p->stdhdu,
+                                               NULL, GAL_TYPE_FLOAT32,
+                                               p->cp.minmapsize,
+                                               p->cp.quietmmap,
+                                               "--stdhdu");
+          p->std->ndim=gal_dimension_remove_extra(p->std->ndim,
+                                                  p->std->dsize, NULL);
+
+          /* Check its size and prepare tile structure. */
+          ui_preparation_check_size_read_tiles(p, p->std, p->usedstdfile,
+                                               p->stdhdu);
+        }
     }
 
 
@@ -1566,7 +1683,14 @@ ui_preparations_read_keywords(struct mkcatalogparams *p)
              need the minimum for 'p->cpscorr'. */
           if(keys[1].status)
             {
-              if(p->forcereadstd)
+              if(p->forcereadstd && p->bandrows)
+                error(EXIT_FAILURE, 0, "%s (hdu: %s): no 'MEDSTD' keyword. "
+                      "When the inputs are read in bands of rows "
+                      "('--bandrows'), the median standard deviation "
+                      "(needed by '--forcereadstd') can't be found from "
+                      "the image. Please write it in the 'MEDSTD' keyword "
+                      "of this HDU", p->usedstdfile, p->stdhdu);
+              else if(p->forcereadstd)
                 {
                   tmp=gal_statistics_median(p->std, 0);
                   p->medstd=*((float *)(tmp->array));
@@ -1577,9 +1701,15 @@ ui_preparations_read_keywords(struct mkcatalogparams *p)
           if(keys[0].status)
             {
               /* Calculate the minimum STD. */
-              tmp=gal_statistics_minimum(p->std);
-              minstd=*((float *)(tmp->array));
-              gal_data_free(tmp);
+              if(p->bandrows)
+                minstd=band_minimum(p, p->std, p->usedstdfile, p->stdhdu,
+                                    "--stdhdu");
+              else
+                {
+                  tmp=gal_statistics_minimum(p->std);
+                  minstd=*((float *)(tmp->array));
+                  gal_data_free(tmp);
+                }
 
               /* If the units are in variance, then take the square root. */
               if(p->variance) minstd=sqrt(minstd);
@@ -1812,6 +1942,49 @@ ui_preparations_upperlimit(struct mkcatalogparams *p)
 
 
 
+/* With '--bandrows', each object's pixels are only visited once (in
+   separate bands), so only the measurements that are a sum over the
+   pixels can be done. */
+static void
+ui_check_band(struct mkcatalogparams *p)
+{
+  uint8_t *oif=p->oiflag;
+
+  /* The upper-limit measurements need random positions over the whole
+     image. */
+  if(p->upperlimit)
+    error(EXIT_FAILURE, 0, "the upper-limit measurements can't be done "
+          "when the inputs are read in bands of rows ('--bandrows')");
+
+  /* The order-based measurements (for example the median) need all the
+     values of an object at once, and the position of the extrema needs
+     the extrema. */
+  if(    oif[ OCOL_MEDIAN        ]
+      || oif[ OCOL_MAXIMUM       ]
+      || oif[ OCOL_SIGCLIPNUM    ]
+      || oif[ OCOL_SIGCLIPSTD    ]
+      || oif[ OCOL_SIGCLIPMEAN   ]
+      || oif[ OCOL_SIGCLIPMEDIAN ]
+      || oif[ OCOL_HALFMAXNUM    ]
+      || oif[ OCOL_HALFMAXSUM    ]
+      || oif[ OCOL_HALFSUMNUM    ]
+      || oif[ OCOL_FRACMAX1NUM   ]
+      || oif[ OCOL_FRACMAX1SUM   ]
+      || oif[ OCOL_FRACMAX2NUM   ]
+      || oif[ OCOL_FRACMAX2SUM   ]
+      || oif[ OCOL_MINVNUM       ]
+      || oif[ OCOL_MAXVNUM       ] )
+    error(EXIT_FAILURE, 0, "the order-based measurements (for example "
+          "the median, maximum, sigma-clipped or half-maximum columns) "
+          "and the position of the minimum or maximum value can't be "
+          "measured when the inputs are read in bands of rows "
+          "('--bandrows')");
+}
+
+
+
+
+
 void
 ui_preparations(struct mkcatalogparams *p)
 {
@@ -1829,8 +2002,10 @@ ui_preparations(struct mkcatalogparams *p)
   ui_read_labels(p);
 
 
-  /* Prepare the output columns. */
+  /* Prepare the output columns (and check if they can be measured in
+     band mode). */
   columns_define_alloc(p);
+  if(p->bandrows) ui_check_band(p);
 
 
   /* Read the inputs. */
@@ -1964,6 +2139,8 @@ ui_read_check_inputs_setup(int argc, char *argv[],
       printf("  - Using %zu CPU thread%s\n", p->cp.numthreads,
              p->cp.numthreads==1 ? "." : "s.");
       printf("  - Objects: %s (hdu: %s)\n", p->objectsfile, p->cp.hdu);
+      if(p->bandrows)
+        printf("  - Inputs read in bands of %zu rows.\n", p->bandrows);
       if(p->clumps)
         printf("  - Clumps:  %s (hdu: %s)\n", p->usedclumpsfile,
                p->clumpshdu);
@@ -2076,6 +2253,7 @@ ui_free_report(struct mkcatalogparams *p, struct timeval *t1)
   gal_data_free(p->upmask);
   gal_data_free(p->clumps);
   gal_data_free(p->objects);
+  if(p->minmax) free(p->minmax);
   if(p->outlabs) free(p->outlabs);
   gal_list_data_free(p->clumpcols);
   gal_list_data_free(p->objectcols);
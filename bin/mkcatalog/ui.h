@@ -99,6 +99,7 @@ enum option_keys_enum
   UI_KEY_NOCLUMPSORT,
   UI_KEY_FRACMAX,
   UI_KEY_SPATIALRESOLUTION,
+  UI_KEY_BANDROWS,
 
   UI_KEY_OBJID,                         /* Catalog columns. */
   UI_KEY_IDINHOSTOBJ,
@@ -217,6 +218,9 @@ enum option_keys_enum
 
 
 
+void
+ui_subtract_sky(struct mkcatalogparams *p);
+
 void
 ui_read_check_inputs_setup(int argc, char *argv[], struct mkcatalogparams *p);
 
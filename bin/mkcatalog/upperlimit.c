@@ -147,6 +147,370 @@ upperlimit_make_clump_tiles(struct mkcatalog_passparams *pp)
 
 
 
+/*********************************************************************/
+/*******************   Summed-area of used pixels  ********************/
+/*********************************************************************/
+/* Number of elements (along the faster dimensions) in each action when
+   accumulating the summed-area table along the slower dimensions. */
+#define UPPERLIMIT_SAT_CHUNK 4096
+
+/* Parameters to build the summed-area table. */
+struct upperlimit_sat_params
+{
+  struct mkcatalogparams  *p;   /* Main MakeCatalog parameters.         */
+  uint32_t              *sat;   /* Summed-area table.                   */
+  size_t                 len;   /* Length of the accumulated dimension. */
+  size_t               inner;   /* Elements after the accumulated dim.  */
+  size_t              nchunk;   /* Number of chunks in 'inner'.         */
+};
+
+
+
+
+
+/* Each action either fills one row along the fastest dimension (when
+   'inner==1'): setting the pixels that can't be used for a random
+   footprint (labeled, masked or blank) to 1, and accumulating them along
+   the row. Or, it accumulates a chunk of the elements over the slower
+   dimension. */
+static void *
+upperlimit_sat_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct upperlimit_sat_params *prm=tprm->params;
+  struct mkcatalogparams *p=prm->p;
+
+  float *v;
+  uint8_t *m;
+  int32_t *o;
+  uint32_t s, *a, *b;
+  size_t i, j, k, a_i, j0, j1, inner=prm->inner;
+
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
+    {
+      a_i=tprm->indexs[i];
+      if(inner==1)
+        {
+          /* Pointers to the start of this row. */
+          a = prm->sat + a_i*prm->len;
+          o = (int32_t *)(p->objects->array) + a_i*prm->len;
+          v = (float *)(p->values->array) + a_i*prm->len;
+          m = ( p->upmask
+                ? (uint8_t *)(p->upmask->array) + a_i*prm->len
+                : NULL );
+
+          /* Fill the row. */
+          s=0;
+          for(j=0;j<prm->len;++j)
+            a[j] = s += ( o[j]!=0
+                          || (m && m[j])
+                          || (p->hasblank && isnan(v[j])) );
+        }
+      else
+        {
+          /* Range of this chunk. */
+          j0 = (a_i%prm->nchunk) * UPPERLIMIT_SAT_CHUNK;
+          j1 = ( j0+UPPERLIMIT_SAT_CHUNK < inner
+                 ? j0+UPPERLIMIT_SAT_CHUNK : inner );
+          a  = prm->sat + a_i/prm->nchunk * prm->len * inner;
+
+          /* Accumulate along the slower dimension. */
+          for(k=1;k<prm->len;++k)
+            {
+              b=a+k*inner;
+              for(j=j0;j<j1;++j) b[j] += b[j-inner];
+            }
+        }
+    }
+
+  /* Wait for all threads to finish and return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* The random footprints can't overlap with any labeled, masked or blank
+   pixel. To check this quickly for the full bounding box of each random
+   position, we build a summed-area table of those pixels: each element
+   is the number of such pixels in the box between the first pixel of the
+   image and it. The table is 32-bit, but since unsigned integer
+   arithmetic is modular, the number of used pixels in any box with less
+   than 2^32 pixels is still correct. */
+void
+upperlimit_prepare(struct mkcatalogparams *p)
+{
+  size_t d, ndim=p->objects->ndim, *dsize=p->objects->dsize;
+  struct upperlimit_sat_params prm;
+
+  /* Allocate the table. */
+  p->upsat=gal_data_alloc(NULL, GAL_TYPE_UINT32, ndim, dsize, NULL, 0,
+                          p->cp.minmapsize, p->cp.quietmmap, NULL, NULL,
+                          NULL);
+
+  /* Fill (and accumulate) each row. */
+  prm.p=p;
+  prm.inner=1;
+  prm.nchunk=1;
+  prm.sat=p->upsat->array;
+  prm.len=dsize[ndim-1];
+  gal_threads_spin_off(upperlimit_sat_worker, &prm,
+                       p->objects->size/prm.len, p->cp.numthreads,
+                       p->cp.minmapsize, p->cp.quietmmap);
+
+  /* Accumulate along the slower dimensions. */
+  for(d=ndim-1;d>0;--d)
+    {
+      prm.inner *= dsize[d];
+      prm.len    = dsize[d-1];
+      prm.nchunk = (prm.inner+UPPERLIMIT_SAT_CHUNK-1)/UPPERLIMIT_SAT_CHUNK;
+      gal_threads_spin_off(upperlimit_sat_worker, &prm,
+                           p->objects->size/(prm.len*prm.inner)*prm.nchunk,
+                           p->cp.numthreads, p->cp.minmapsize,
+                           p->cp.quietmmap);
+    }
+
+  /* When there are fewer objects than threads, some threads would be
+     idle during the upper-limit measurements. In that case, the random
+     positions of each object are evaluated with multiple threads. */
+  p->upthreads = ( p->numobjects < p->cp.numthreads
+                   ? p->cp.numthreads/p->numobjects : 1 );
+}
+
+
+
+
+
+/* Number of used pixels in the box starting at 'start' with 'size'
+   pixels along each dimension. Through the summed-area table, this is
+   the sum (with alternating signs) of the values at the corners of the
+   box. */
+static uint32_t
+upperlimit_sat_box(struct mkcatalogparams *p, size_t *start, size_t *size)
+{
+  int neg;
+  uint32_t sum=0, *sat=p->upsat->array;
+  size_t c, d, ind, ndim=p->objects->ndim, *dsize=p->objects->dsize;
+
+  /* Along each dimension, the corner is either the last pixel of the box
+     or the one before its first (which doesn't exist at the start). */
+  for(c=0; c < (1U<<ndim); ++c)
+    {
+      neg=0;
+      ind=0;
+      for(d=0;d<ndim;++d)
+        if( c & (1U<<d) )
+          {
+            if(start[d]==0) break;
+            ind = ind*dsize[d] + start[d]-1;
+            neg = !neg;
+          }
+        else
+          ind = ind*dsize[d] + start[d]+size[d]-1;
+      if(d==ndim) sum = neg ? sum-sat[ind] : sum+sat[ind];
+    }
+  return sum;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*********************************************************************/
+/*******************    Footprint of each label   ********************/
+/*********************************************************************/
+/* Run-length description of the pixels of an object or clump: each run
+   is a contiguous set of pixels along the fastest dimension. */
+struct upperlimit_footprint
+{
+  size_t           numruns;   /* Number of runs.                        */
+  size_t              *off;   /* Offset of first pixel from tile start. */
+  size_t              *len;   /* Number of pixels in each run.          */
+  size_t            *coord;   /* Coordinates of first pixel in tile.    */
+};
+
+
+
+
+
+/* Build the footprint of the object (when 'clumplab==0') or one of its
+   clumps within the given tile from the object's pixel index. */
+static void
+upperlimit_footprint_make(struct mkcatalog_passparams *pp, gal_data_t *tile,
+                          int32_t clumplab, struct upperlimit_footprint *fp)
+{
+  struct mkcatalogparams *p=pp->p;
+  size_t ndim=p->objects->ndim, *dsize=p->objects->dsize;
+
+  size_t i, d, ind, prev=0, tstart, n=0, tcoord[3];
+  int32_t *clumps = clumplab ? p->clumps->array : NULL;
+
+  /* Coordinates of the tile's first pixel. */
+  tstart=gal_pointer_num_between(p->objects->array, tile->array,
+                                 p->objects->type);
+  gal_dimension_index_to_coord(tstart, ndim, dsize, tcoord);
+
+  /* Allocate the (maximum possible) space. */
+  fp->off=gal_pointer_allocate(GAL_TYPE_SIZE_T, pp->numpix, 0, __func__,
+                               "fp->off");
+  fp->len=gal_pointer_allocate(GAL_TYPE_SIZE_T, pp->numpix, 0, __func__,
+                               "fp->len");
+  fp->coord=gal_pointer_allocate(GAL_TYPE_SIZE_T, pp->numpix*ndim, 0,
+                                 __func__, "fp->coord");
+
+  /* Go over the pixels (that are sorted by index) and merge the
+     neighboring pixels of each row into one run. */
+  for(i=0;i<pp->numpix;++i)
+    {
+      ind=pp->pixind[i];
+      if(clumps && clumps[ind]!=clumplab) continue;
+      if( n && ind==prev+1 && ind%dsize[ndim-1] )
+        ++fp->len[n-1];
+      else
+        {
+          fp->off[n]=ind-tstart;
+          fp->len[n]=1;
+          gal_dimension_index_to_coord(ind, ndim, dsize,
+                                       &fp->coord[n*ndim]);
+          for(d=0;d<ndim;++d) fp->coord[n*ndim+d]-=tcoord[d];
+          ++n;
+        }
+      prev=ind;
+    }
+  fp->numruns=n;
+}
+
+
+
+
+
+static void
+upperlimit_footprint_free(struct upperlimit_footprint *fp)
+{
+  free(fp->off);
+  free(fp->len);
+  free(fp->coord);
+}
+
+
+
+
+
+/* See if the footprint can be placed with its tile's first pixel at
+   'rcoord'. If so, put the sum of its values in 'sum' and return 1. */
+static int
+upperlimit_footprint_place(struct mkcatalogparams *p, gal_data_t *tile,
+                           struct upperlimit_footprint *fp, size_t *rcoord,
+                           double *sum)
+{
+  size_t ndim=p->objects->ndim, *dsize=p->objects->dsize;
+
+  float *V;
+  double s=0.0f;
+  size_t i, d, k, start[3], size[3];
+  size_t r0=gal_dimension_coord_to_index(ndim, dsize, rcoord);
+
+  /* If there is any used pixel within the tile's bounding box, we need to
+     check each run of the footprint (a box with a width of one along all
+     but the fastest dimension). */
+  if( upperlimit_sat_box(p, rcoord, tile->dsize) )
+    {
+      for(d=0;d<ndim-1;++d) size[d]=1;
+      for(i=0;i<fp->numruns;++i)
+        {
+          for(d=0;d<ndim;++d) start[d]=rcoord[d]+fp->coord[i*ndim+d];
+          size[ndim-1]=fp->len[i];
+          if( upperlimit_sat_box(p, start, size) ) return 0;
+        }
+    }
+
+  /* The footprint is usable, sum the values (in the same order as the
+     pixels of the image). */
+  for(i=0;i<fp->numruns;++i)
+    {
+      V=(float *)(p->values->array) + r0 + fp->off[i];
+      for(k=0;k<fp->len[i];++k) s+=V[k];
+    }
+  *sum=s;
+  return 1;
+}
+
+
+
+
+
+/* Parameters to evaluate a batch of random positions on many threads. */
+struct upperlimit_batch_params
+{
+  struct mkcatalogparams      *p; /* Main MakeCatalog parameters.       */
+  gal_data_t               *tile; /* Tile of the object or clump.       */
+  struct upperlimit_footprint *fp; /* Footprint of object or clump.     */
+  size_t                 *rcoord; /* Random positions.                  */
+  double                   *sums; /* Sum of values at each position.    */
+  uint8_t                  *good; /* ==1: the position is usable.       */
+};
+
+
+
+
+
+static void *
+upperlimit_batch_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct upperlimit_batch_params *prm=tprm->params;
+
+  size_t i, b, ndim=prm->p->objects->ndim;
+
+  for(i=0; tprm->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
+    {
+      b=tprm->indexs[i];
+      prm->good[b]=upperlimit_footprint_place(prm->p, prm->tile, prm->fp,
+                                              &prm->rcoord[b*ndim],
+                                              &prm->sums[b]);
+    }
+
+  /* Wait for all threads to finish and return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /*********************************************************************/
 /*******************         For one tile         ********************/
 /*********************************************************************/
@@ -556,22 +920,20 @@ upperlimit_one_tile(struct mkcatalog_passparams *pp, gal_data_t *tile,
                     unsigned long seed, int32_t clumplab)
 {
   struct mkcatalogparams *p=pp->p;
-  size_t ndim=p->objects->ndim, *dsize=p->objects->dsize;
+  size_t ndim=p->objects->ndim;
 
-  double sum;
-  void *tarray;
-  uint8_t *M=NULL, *st_m=NULL;
-  int continueparse, writecheck=0;
+  double *sums;
+  uint8_t *good;
+  int writecheck=0;
+  size_t *rcoord, *rc;
+  struct upperlimit_footprint fp;
   struct gal_list_f32_t *check_s=NULL;
-  size_t d, counter=0, se_inc[2], nfailed=0;
-  float *V, *st_v, *uparr=pp->up_vals->array;
-  size_t min[3], max[3], increment, num_increment;
-  int32_t *O, *OO, *oO, *st_o, *st_oo, *st_oc, *oC=NULL;
+  struct upperlimit_batch_params bprm;
+  float *uparr=pp->up_vals->array;
+  size_t b, d, nb, counter=0, nfailed=0, min[3], max[3];
   size_t hw2, hw0=tile->dsize[0]/2, hw1=tile->dsize[1]/2;
   size_t maxfails = p->upnum * MKCATALOG_UPPERLIMIT_MAXFAILS_MULTIP;
   struct gal_list_sizet_t *check_x=NULL, *check_y=NULL, *check_z=NULL;
-  size_t *rcoord=gal_pointer_allocate(GAL_TYPE_SIZE_T, ndim, 0, __func__,
-                                      "rcoord");
 
   /* See if a check table must be created for this distribution. */
   if( p->checkuplim[0]==pp->object )
@@ -589,128 +951,95 @@ upperlimit_one_tile(struct mkcatalog_passparams *pp, gal_data_t *tile,
 
 
   /* Initializations. */
-  tarray=tile->array;
   gsl_rng_set(pp->rng, seed);
   pp->up_vals->flag &= ~GAL_DATA_FLAG_SORT_CH;
   hw2 = tile->ndim==3 ? tile->dsize[2]/2 : GAL_BLANK_SIZE_T;
+  sums=gal_pointer_allocate(GAL_TYPE_FLOAT64, MKCATALOG_UPPERLIMIT_BATCH,
+                            0, __func__, "sums");
+  good=gal_pointer_allocate(GAL_TYPE_UINT8, MKCATALOG_UPPERLIMIT_BATCH, 0,
+                            __func__, "good");
+  rcoord=gal_pointer_allocate(GAL_TYPE_SIZE_T,
+                              MKCATALOG_UPPERLIMIT_BATCH*ndim, 0,
+                              __func__, "rcoord");
 
 
-  /* Set the range of random values for this tile. */
+  /* Set the range of random values for this tile and the footprint of
+     the object/clump within it. */
   upperlimit_random_range(pp, tile, min, max, clumplab);
-
-
-  /* 'se_inc' is just used temporarily, the important thing here is
-     'st_oo'. */
-  st_oo = ( clumplab
-            ? gal_tile_start_end_ind_inclusive(tile, p->objects, se_inc)
-            : pp->st_o );
-  st_oc = clumplab ? (int32_t *)(p->clumps->array) + se_inc[0] : NULL;
-
-
-  /* Continue measuring randomly until we get the desired total number. */
+  upperlimit_footprint_make(pp, tile, clumplab, &fp);
+  bprm.p=p;
+  bprm.fp=&fp;
+  bprm.tile=tile;
+  bprm.sums=sums;
+  bprm.good=good;
+  bprm.rcoord=rcoord;
+
+
+  /* Continue measuring randomly until we get the desired total number. The
+     random positions are taken and evaluated in batches, but they are
+     used in the same order they were taken. So the result is identical to
+     taking and using them one by one (the random numbers that are taken
+     after the last used position are irrelevant). */
   while(nfailed<maxfails && counter<p->upnum)
     {
-      /* Get the random coordinates. */
-      for(d=0;d<ndim;++d)
-        rcoord[d] = upperlimit_random_position(pp, tile, d, min, max);
-
-      /* Set the tile's new starting pointer. */
-      tile->array = gal_pointer_increment(p->objects->array,
-                          gal_dimension_coord_to_index(ndim, dsize, rcoord),
-                                          p->objects->type);
-
-      /* Starting and ending coordinates for this random position, note
-         that in 'pp' we have the starting and ending coordinates of the
-         actual tile. */
-      increment     = 0;
-      num_increment = 1;
-      continueparse = 1;
-      sum           = 0.0f;
-
-      /* Starting pointers for the random tile. */
-      st_v   = gal_tile_start_end_ind_inclusive(tile, p->values, se_inc);
-      st_o               = (int32_t *)(p->objects->array) + se_inc[0];
-      if(p->upmask) st_m = (uint8_t *)(p->upmask->array)  + se_inc[0];
-
-      /* Parse over this object/clump. */
-      while( se_inc[0] + increment <= se_inc[1] )
+      /* Get the random coordinates of this batch. */
+      nb = ( p->upnum-counter < MKCATALOG_UPPERLIMIT_BATCH
+             ? p->upnum-counter : MKCATALOG_UPPERLIMIT_BATCH );
+      for(b=0;b<nb;++b)
+        for(d=0;d<ndim;++d)
+          rcoord[b*ndim+d] = upperlimit_random_position(pp, tile, d,
+                                                        min, max);
+
+      /* Evaluate the random positions. */
+      if(p->upthreads>1)
+        gal_threads_spin_off(upperlimit_batch_worker, &bprm, nb,
+                             p->upthreads, p->cp.minmapsize,
+                             p->cp.quietmmap);
+      else
+        for(b=0;b<nb;++b)
+          good[b]=upperlimit_footprint_place(p, tile, &fp,
+                                             &rcoord[b*ndim], &sums[b]);
+
+      /* Use the positions in order. */
+      for(b=0; b<nb && nfailed<maxfails && counter<p->upnum; ++b)
         {
-          /* Set the pointers. */
-          V               = st_v  + increment;    /* Random tile.   */
-          O               = st_o  + increment;    /* Random tile.   */
-          if(st_m) M      = st_m  + increment;    /* Random tile.   */
-          oO              = st_oo + increment;    /* Original tile. */
-          if(clumplab) oC = st_oc + increment;    /* Original tile. */
-
-
-          /* Parse over this contiguous region, similar to the first and
-             second pass functions. */
-          OO = O + tile->dsize[ndim-1];
-          do
+          /* If this random position was usable, we must reset 'nfailed'
+             to zero again. */
+          if(good[b])
             {
-              /* Only use pixels over this object/clump. */
-              if( *oO==pp->object && ( oC==NULL || *oC==clumplab ) )
-                {
-                  /* If this pixel is a non-zero object code, or is masked,
-                     or has a blank value, then stop parsing. */
-                  if( *O || (M && *M) || ( p->hasblank && isnan(*V) ) )
-                    continueparse=0;
-                  else
-                    sum += *V;
-                }
-
-              /* Increment the other pointers. */
-              ++V;
-              ++oO;
-              if(M) ++M;
-              if(oC) ++oC;
+              nfailed=0;
+              uparr[ counter++ ] = sums[b];
             }
-          while(continueparse && ++O<OO);
-
-
-          /* Increment to the next contiguous region of this tile. */
-          if(continueparse)
-            increment += ( gal_tile_block_increment(p->objects, dsize,
-                                                    num_increment++, NULL) );
-          else break;
-        }
-
-
-      /* Further processing is only necessary if this random tile was fully
-         parsed. If it was, we must reset 'nfailed' to zero again. */
-      if(continueparse)
-        {
-          nfailed=0;
-          uparr[ counter++ ] = sum;
-        }
-      else ++nfailed;
-
-
-      /* If a check is necessary, put the center of the tile independent of
-         the values/labels (in FITS coordinates). Note that 'rcoord' is the
-         position of the first pixel of the tile, so we need to add half
-         the width of the tile (the 'hw*' variables). */
-      if(writecheck)
-        {
-          switch(ndim)
+          else ++nfailed;
+
+          /* If a check is necessary, put the center of the tile
+             independent of the values/labels (in FITS coordinates). Note
+             that 'rc' is the position of the first pixel of the tile, so
+             we need to add half the width of the tile (the 'hw*'
+             variables). */
+          if(writecheck)
             {
-            case 2:
-              gal_list_sizet_add(&check_x, rcoord[1]+1 + hw1);
-              gal_list_sizet_add(&check_y, rcoord[0]+1 + hw0);
-              break;
-
-            case 3:
-              gal_list_sizet_add(&check_x, rcoord[2]+1 + hw2);
-              gal_list_sizet_add(&check_y, rcoord[1]+1 + hw1);
-              gal_list_sizet_add(&check_z, rcoord[0]+1 + hw0);
-              break;
-
-            default:
-              error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s "
-                    "to fix the problem. 'ndim' value of %zu is not "
-                    "recognized", __func__, PACKAGE_BUGREPORT, ndim);
+              rc=&rcoord[b*ndim];
+              switch(ndim)
+                {
+                case 2:
+                  gal_list_sizet_add(&check_x, rc[1]+1 + hw1);
+                  gal_list_sizet_add(&check_y, rc[0]+1 + hw0);
+                  break;
+
+                case 3:
+                  gal_list_sizet_add(&check_x, rc[2]+1 + hw2);
+                  gal_list_sizet_add(&check_y, rc[1]+1 + hw1);
+                  gal_list_sizet_add(&check_z, rc[0]+1 + hw0);
+                  break;
+
+                default:
+                  error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at "
+                        "%s to fix the problem. 'ndim' value of %zu is not "
+                        "recognized", __func__, PACKAGE_BUGREPORT, ndim);
+                }
+              gal_list_f32_add(&check_s, good[b] ? sums[b] : NAN);
             }
-          gal_list_f32_add(&check_s, continueparse ? sum : NAN);
         }
     }
 
@@ -721,12 +1050,15 @@ upperlimit_one_tile(struct mkcatalog_passparams *pp, gal_data_t *tile,
   /* Do the measurement on the random distribution. */
   upperlimit_measure(pp, clumplab, counter==p->upnum);
 
-  /* Reset the tile's array pointer, clean up and return. */
+  /* Clean up and return. */
+  free(good);
+  free(sums);
   free(rcoord);
-  tile->array=tarray;
+  upperlimit_footprint_free(&fp);
   gal_list_f32_free(check_s);
   gal_list_sizet_free(check_x);
   gal_list_sizet_free(check_y);
+  gal_list_sizet_free(check_z);
 }
 
 
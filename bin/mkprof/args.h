@@ -269,6 +269,19 @@ struct argp_option program_options[] =
       GAL_OPTIONS_MANDATORY,
       GAL_OPTIONS_NOT_SET
     },
+    {
+      "radialtable",
+      UI_KEY_RADIALTABLE,
+      "FLT",
+      0,
+      "Tolerance of radial look-up table (0: disable).",
+      UI_GROUP_PROFILES,
+      &p->radialtable,
+      GAL_TYPE_FLOAT32,
+      GAL_OPTIONS_RANGE_GE_0_LE_1,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET
+    },
     {
       "tunitinp",
       UI_KEY_TUNITINP,
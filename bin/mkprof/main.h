@@ -40,6 +40,9 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 /* Some constants */
 #define EPSREL_FOR_INTEG   2
+#define RTABLE_MINNUM      65
+#define RTABLE_SIZEFRAC    16
+#define MERGE_BATCH_NUMPIX 1000000
 #define DEGREESTORADIANS   M_PI/180.0
 #define RADIANSTODEGREES   180.0/M_PI
 
@@ -133,6 +136,7 @@ struct mkprofparams
   char             *typestr;  /* Type of finally merged output image.     */
   size_t          numrandom;  /* Number of radom points for integration.  */
   float           tolerance;  /* Accuracy to stop integration.            */
+  float         radialtable;  /* Accuracy of radial look-up table.        */
   uint8_t          tunitinp;  /* ==1: Truncation is in pixels, not radial.*/
   size_t             *shift;  /* Shift along axeses position of profiles. */
   uint8_t       prepforconv;  /* Shift and expand by size of first psf.   */
@@ -194,7 +198,12 @@ struct mkprofparams
   gal_data_t           *log;  /* Log data to be printed.                  */
   struct builtqueue     *bq;  /* Top (last) elem of build queue.          */
   pthread_cond_t     qready;  /* bq is ready to be written.               */
-  pthread_mutex_t     qlock;  /* Mutex lock to change builtq.             */
+  pthread_mutex_t     qlock;  /* Mutex for waiting on 'qready'.           */
+  int             qsleeping;  /* ==1: writer is waiting on 'qready'.      */
+  pthread_cond_t    qpaused;  /* A builder paused or finished.            */
+  pthread_cond_t    qresume;  /* Builders can continue after a merge.     */
+  int                mpause;  /* ==1: builders must pause (merging).      */
+  size_t          nbuilding;  /* Number of builders that are not paused.  */
   double          halfpixel;  /* Half pixel in oversampled image.         */
   char              *wcsstr;  /* The WCS keywords derived from main img.  */
   int            wcsnkeyrec;  /* The number of keywords in the WCS header.*/
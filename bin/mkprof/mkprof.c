@@ -240,6 +240,10 @@ saveindividual(struct mkonthread *mkp)
                         &p->tolerance, 0,
                         "Tolerance level to stop random integration",
                         0, NULL, 0);
+  gal_fits_key_list_add(&keys, GAL_TYPE_FLOAT32, "RADTABLE", 0,
+                        &p->radialtable, 0,
+                        "Tolerance of radial look-up table (0: none)",
+                        0, NULL, 0);
   gal_fits_key_list_add(&keys, GAL_TYPE_STRING, "MODE", 0,
                         p->mode==MKPROF_MODE_IMG?"img":"wcs", 0,
                         "Coordinates in image or WCS units", 0, NULL, 0);
@@ -397,59 +401,88 @@ mkprof_build_single(struct mkonthread *mkp, long *fpixel_i, long *lpixel_i,
 
 
 /* The profile has been built, now add it to the queue of profiles that
-   must be written into the final merged image. */
+   must be written into the final merged image. The queue ('p->bq') is a
+   lock-free stack: any number of builder threads can push into it
+   (with an atomic compare-and-swap), while the single writer thread
+   takes all of its elements at once (with an atomic exchange, see
+   'mkprof_write_queue_pop'). The mutex and condition variable are only
+   used when the writer has nothing to do and is sleeping: in that case
+   it has set 'p->qsleeping' and must be woken up. */
 static void
-mkprof_add_built_to_write_queue(struct mkonthread *mkp,
-                                struct builtqueue *ibq,
-                                struct builtqueue **fbq, size_t counter)
+mkprof_write_queue_push(struct mkprofparams *p, struct builtqueue *ibq)
 {
-  struct mkprofparams *p = mkp->p;
+  struct builtqueue *head=__atomic_load_n(&p->bq, __ATOMIC_RELAXED);
+
+  /* Put this element on top of the queue. */
+  do ibq->next=head;
+  while( !__atomic_compare_exchange_n(&p->bq, &head, ibq, 1,
+                                      __ATOMIC_SEQ_CST, __ATOMIC_RELAXED) );
+
+  /* If the writer is sleeping, wake it up. Note that the writer sets
+     'qsleeping' (while it holds the mutex) before checking the queue a
+     final time, so either it will see this element, or this thread
+     will see that it is sleeping (and can only get the mutex when the
+     writer is actually waiting on the condition variable). */
+  if( __atomic_load_n(&p->qsleeping, __ATOMIC_SEQ_CST) )
+    {
+      pthread_mutex_lock(&p->qlock);
+      pthread_cond_signal(&p->qready);
+      pthread_mutex_unlock(&p->qlock);
+    }
+}
+
+
+
 
-  int lockresult;
-  pthread_mutex_t *qlock=&p->qlock;
-  pthread_cond_t *qready=&p->qready;
-
-  /* Try locking the mutex so no thread can change the value of p->bq. If
-     you can lock it, then put the internal builtqueue on top of the
-     general builtqueue. If you can't, continue adding to the internal
-     builtqueue (make the next profiles) until you find a chance to lock
-     the mutex. */
-  lockresult=pthread_mutex_trylock(qlock);
-  if(lockresult==0)     /* Mutex was successfully locked. */
+
+/* Take all the built profiles from the queue (if the queue is empty,
+   wait until a builder adds a profile to it). */
+static struct builtqueue *
+mkprof_write_queue_pop(struct mkprofparams *p)
+{
+  struct builtqueue *bq;
+
+  bq=__atomic_exchange_n(&p->bq, NULL, __ATOMIC_SEQ_CST);
+  if(bq==NULL)
     {
-      /* Add this internal queue to system queue. */
-      (*fbq)->next=p->bq;
-      p->bq=ibq;
-
-      /* If the list was empty when you locked the mutex, then either
-         'mkprof_write' is waiting behind a condition variable for you to
-         fill it up or not (either it hasn't got to setting the condition
-         variable yet (this function locked the mutex before
-         'mkprof_write') or it just got the list to be made and is busy
-         writing the arrays in the output). In either case,
-         pthread_cond_signal will work. */
-      if((*fbq)->next==NULL)
-        pthread_cond_signal(qready);
-      pthread_mutex_unlock(qlock);
-
-      /* Finally set both the internal queue and the first internal queue
-         element to NULL.*/
-      (*fbq)=NULL;
-      mkp->ibq=NULL;
+      pthread_mutex_lock(&p->qlock);
+      __atomic_store_n(&p->qsleeping, 1, __ATOMIC_SEQ_CST);
+      while( (bq=__atomic_exchange_n(&p->bq, NULL, __ATOMIC_SEQ_CST))
+             ==NULL )
+        pthread_cond_wait(&p->qready, &p->qlock);
+      __atomic_store_n(&p->qsleeping, 0, __ATOMIC_SEQ_CST);
+      pthread_mutex_unlock(&p->qlock);
     }
+  return bq;
+}
+
+
+
+
 
-  /* The mutex couldn't be locked and there are no more objects for this
-     thread to build (giving a chance for this thread to add up its built
-     profiles). So we have to lock the mutex to pass on this built
-     structure to the builtqueue. */
-  else if (mkp->indexs[counter+1]==GAL_BLANK_SIZE_T)
+/* While the writer merges a batch of profiles on all the threads (see
+   'mkprof_merge'), the builders have to pause (otherwise, the CPU will
+   be over-subscribed). A builder only checks 'p->mpause' (without
+   locking) before building each profile, so it doesn't affect the
+   builders when there is no merge. When the pause is requested, the
+   builder announces that it is no longer building and waits until the
+   writer has finished the merge. When 'done' is non-zero, the builder
+   has finished all its profiles, so it only announces that. */
+static void
+mkprof_build_pause(struct mkprofparams *p, int done)
+{
+  if( done==0 && __atomic_load_n(&p->mpause, __ATOMIC_SEQ_CST)==0 )
+    return;
+
+  pthread_mutex_lock(&p->qlock);
+  --p->nbuilding;
+  pthread_cond_signal(&p->qpaused);
+  if(done==0)
     {
-      pthread_mutex_lock(qlock);
-      (*fbq)->next=p->bq;
-      p->bq=ibq;
-      pthread_cond_signal(qready);
-      pthread_mutex_unlock(qlock);
+      while(p->mpause) pthread_cond_wait(&p->qresume, &p->qlock);
+      ++p->nbuilding;
     }
+  pthread_mutex_unlock(&p->qlock);
 }
 
 
@@ -490,8 +523,8 @@ mkprof_build(void *inparam)
   struct mkonthread *mkp=(struct mkonthread *)inparam;
   struct mkprofparams *p=mkp->p;
 
+  struct builtqueue *ibq;
   size_t i, id, ndim=p->ndim;
-  struct builtqueue *ibq, *fbq=NULL;
   double center[3], semiaxes[3], euler_deg[3];
   long fpixel_i[3], lpixel_i[3], fpixel_o[3], lpixel_o[3];
 
@@ -499,16 +532,15 @@ mkprof_build(void *inparam)
   /* Make each profile that was specified for this thread. */
   for(i=0; mkp->indexs[i]!=GAL_BLANK_SIZE_T; ++i)
     {
-      /* Create a new builtqueue element with all the information. 'fbq'
-         will be used when we want to add 'ibq' to 'p->bq'. It is defined
-         so we don't have to waste time traversing the 'ibq'. Its
-         characteristic compared to the other elements of 'ibq' is that
-         'fbq->next==NULL'. So to add ibq to p->bq, we just have to set
-         'fbq->next=p->bq' and then set 'p->bq' to 'ibq'.*/
+      /* Wait if the writer is merging on all threads. */
+      if(p->cp.numthreads>1) mkprof_build_pause(p, 0);
+
+      /* Create a new builtqueue element with all the information. When
+         there is only one thread, the elements are kept in 'mkp->ibq'
+         to be written after all are built. */
       builtqueue_addempty(&mkp->ibq);
       ibq=mkp->ibq;
       id=ibq->id=mkp->indexs[i];
-      if(fbq==NULL) fbq=ibq;
 
       /* Write the necessary parameters for this profile into 'mkp'.*/
       oneprofile_set_prof_params(mkp);
@@ -576,7 +608,10 @@ mkprof_build(void *inparam)
       /* Add this profile to the list of profiles that must be written onto
          the final merged image with another thread. */
       if(p->cp.numthreads>1)
-        mkprof_add_built_to_write_queue(mkp, ibq, &fbq, i);
+        {
+          mkprof_write_queue_push(p, ibq);
+          mkp->ibq=NULL;
+        }
     }
 
   /* Free the allocated space for this thread and wait until all other
@@ -585,7 +620,10 @@ mkprof_build(void *inparam)
   if(p->cp.numthreads==1)
     p->bq=mkp->ibq;
   else
-    pthread_barrier_wait(mkp->b);
+    {
+      mkprof_build_pause(p, 1);
+      pthread_barrier_wait(mkp->b);
+    }
 
   return NULL;
 }
@@ -610,51 +648,200 @@ mkprof_build(void *inparam)
 
 
 /**************************************************************/
-/************              The writer             *************/
+/************        Merging in parallel          *************/
 /**************************************************************/
+/* The output image is divided into stripes (along its slowest
+   dimension) and each stripe is only written by one thread. So the
+   profiles can be merged into the output in parallel without any
+   locks. */
+struct mkprof_merge_params
+{
+  struct mkprofparams    *p;  /* Main program parameters.             */
+  struct builtqueue **batch;  /* Profiles to merge.                   */
+  size_t           numbatch;  /* Number of profiles in 'batch'.       */
+  size_t           nstripes;  /* Number of stripes in the output.     */
+  double              *sums;  /* Sum of each profile in each stripe.  */
+};
+
+
+
+
+
+/* Merge the part of all the profiles in the batch that overlaps with
+   one stripe of the output. */
 static void
-mkprof_write(struct mkprofparams *p)
+mkprof_merge_stripe(struct mkprof_merge_params *mprm, size_t s)
 {
-  double sum;
-  char *jobname;
-  struct timeval t1;
-  gal_data_t *out=p->out, *log;
-  struct builtqueue *ibq=NULL, *tbq;
-  size_t complete=0, num=p->num, clog;
+  struct mkprofparams *p=mprm->p;
 
-  /* Write each image into the output array. */
-  while(complete<p->num)
+  double sum;
+  struct builtqueue *ibq;
+  gal_data_t ti, tm, *tip=&ti, *tmp=&tm;
+  size_t j, d, c0, first, last, dsize[3], ndim=p->out->ndim;
+  size_t rows=p->out->dsize[0];
+  size_t width=(rows+mprm->nstripes-1)/mprm->nstripes;
+  size_t r0=s*width, r1 = r0+width < rows ? r0+width : rows;
+  size_t orow=p->out->size/rows, irow;
+
+  /* Go over all the profiles in this batch. */
+  for(j=0;j<mprm->numbatch;++j)
     {
-      /* Set ibq. */
-      if(ibq==NULL)
-        {
-          if(p->cp.numthreads==1)
-            ibq=p->bq;
-          else
-            {
-              pthread_mutex_lock(&p->qlock);
-              while(p->bq==NULL)
-                pthread_cond_wait(&p->qready, &p->qlock);
-              ibq=p->bq;
-              p->bq=NULL;
-              pthread_mutex_unlock(&p->qlock);
-            }
-        }
+      /* Ignore profiles that don't overlap with the output. */
+      ibq=mprm->batch[j];
+      if(ibq->overlaps==0) continue;
+
+      /* Find the rows of this profile's overlap that are in this
+         stripe. */
+      c0 = gal_pointer_num_between(p->out->array, ibq->overlap_m->array,
+                                   p->out->type) / orow;
+      first = c0>r0 ? c0 : r0;
+      last  = c0+ibq->overlap_m->dsize[0];
+      if(last>r1) last=r1;
+      if(first>=last) continue;
+
+      /* Define the two tiles over the rows of this stripe. */
+      ti=*ibq->overlap_i;
+      tm=*ibq->overlap_m;
+      dsize[0]=last-first;
+      for(d=1;d<ndim;++d) dsize[d]=ibq->overlap_m->dsize[d];
+      ti.dsize=tm.dsize=dsize;
+      ti.size=tm.size=gal_dimension_total_size(ndim, dsize);
+      irow=ibq->image->size/ibq->image->dsize[0];
+      ti.array=(float *)(ibq->overlap_i->array) + (first-c0)*irow;
+      tm.array=(float *)(ibq->overlap_m->array) + (first-c0)*orow;
+
+      /* Add the profile's pixels into the output. */
       sum=0.0f;
+      GAL_TILE_PO_OISET(float,float,tip,tmp,1,0, {
+          *o  = p->replace ? ( *i>*o ? *i : *o ) :  (*i + *o);
+          sum += *i;
+        });
+      mprm->sums[j*mprm->nstripes+s]=sum;
+    }
+}
+
+
+
+
+
+static void *
+mkprof_merge_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct mkprof_merge_params *mprm=(struct mkprof_merge_params *)tprm->params;
+
+  size_t i;
+
+  /* Go over all the stripes that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    mkprof_merge_stripe(mprm, tprm->indexs[i]);
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
 
 
-      /* During the build process, we also defined the overlap tiles of
-         both the individual array and the final merged array, here we will
-         use those to put the required profile pixels into the final
-         array. */
-      if(ibq->overlaps && out)
-        GAL_TILE_PO_OISET(float,float,ibq->overlap_i,ibq->overlap_m,1,0, {
-            *o  = p->replace ? ( *i>*o ? *i : *o ) :  (*i + *o);
-            sum += *i;
-          });
 
 
+
+/* Add the profiles of the batch into the output image and put the sum
+   of the pixels of each profile (that were added) in 'sums'. */
+static void
+mkprof_merge(struct mkprofparams *p, struct builtqueue **batch,
+             size_t numbatch, double *sums)
+{
+  size_t j, s, nt=p->cp.numthreads;
+  struct mkprof_merge_params mprm;
+
+  /* Set the parameters (one stripe for each thread, but not more than
+     the number of rows). */
+  mprm.p=p;
+  mprm.batch=batch;
+  mprm.numbatch=numbatch;
+  mprm.nstripes = nt < p->out->dsize[0] ? nt : p->out->dsize[0];
+  mprm.sums=gal_pointer_allocate(GAL_TYPE_FLOAT64,
+                                 numbatch*mprm.nstripes, 1, __func__,
+                                 "mprm.sums");
+
+  /* Merge the stripes. When the builders are running on other threads,
+     they are paused until the merge is complete: the merge uses all the
+     threads. */
+  if(mprm.nstripes==1)
+    mkprof_merge_stripe(&mprm, 0);
+  else
+    {
+      pthread_mutex_lock(&p->qlock);
+      __atomic_store_n(&p->mpause, 1, __ATOMIC_SEQ_CST);
+      while(p->nbuilding) pthread_cond_wait(&p->qpaused, &p->qlock);
+      pthread_mutex_unlock(&p->qlock);
+
+      gal_threads_spin_off(mkprof_merge_worker, &mprm, mprm.nstripes,
+                           nt, p->cp.minmapsize, p->cp.quietmmap);
+
+      pthread_mutex_lock(&p->qlock);
+      __atomic_store_n(&p->mpause, 0, __ATOMIC_SEQ_CST);
+      pthread_cond_broadcast(&p->qresume);
+      pthread_mutex_unlock(&p->qlock);
+    }
+
+  /* Sum of each profile over all stripes. */
+  for(j=0;j<numbatch;++j)
+    {
+      sums[j]=0.0f;
+      for(s=0;s<mprm.nstripes;++s) sums[j]+=mprm.sums[j*mprm.nstripes+s];
+    }
+
+  /* Clean up. */
+  free(mprm.sums);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/**************************************************************/
+/************              The writer             *************/
+/**************************************************************/
+/* Merge a batch of built profiles into the output, fill their log
+   information and free them. */
+static void
+mkprof_write_batch(struct mkprofparams *p, struct builtqueue **batch,
+                   size_t numbatch, size_t *complete)
+{
+  double *sums;
+  char *jobname;
+  gal_data_t *log;
+  size_t j, clog;
+  struct builtqueue *ibq;
+
+  /* During the build process, we also defined the overlap tiles of both
+     the individual array and the final merged array, here we will use
+     those to put the required profile pixels into the final array. */
+  sums=gal_pointer_allocate(GAL_TYPE_FLOAT64, numbatch, 1, __func__,
+                            "sums");
+  if(p->out) mkprof_merge(p, batch, numbatch, sums);
+
+  /* Go over the profiles of this batch. */
+  for(j=0;j<numbatch;++j)
+    {
       /* Fill the log array. */
+      ibq=batch[j];
       if(p->cp.log)
         {
           clog=0;
@@ -672,7 +859,7 @@ mkprof_write(struct mkprofparams *p)
                 break;
               case 2:
                 ((float *)(log->array))[ibq->id] =
-                  gal_units_counts_to_mag(sum, p->zeropoint);
+                  gal_units_counts_to_mag(sums[j], p->zeropoint);
                 break;
               case 1:
                 ((unsigned long *)(log->array))[ibq->id]=ibq->id+1;
@@ -682,28 +869,85 @@ mkprof_write(struct mkprofparams *p)
 
 
       /* Report if in verbose mode. */
-      ++complete;
+      ++(*complete);
       if(!p->cp.quiet && p->num>1)
         {
           if( asprintf(&jobname, "row %zu complete, %zu left to go",
-                       ibq->id+1, num-complete)<0 )
+                       ibq->id+1, p->num-*complete)<0 )
             error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
           gal_timing_report(NULL, jobname, 2);
           free(jobname);
         }
 
 
-      /* Free the array and the queue element and change it to the next one
-         and increment complete. Note that there is no problem to free a
-         NULL pointer (when the built array didn't overlap). */
+      /* Free the array and the queue element. Note that there is no
+         problem to free a NULL pointer (when the built array didn't
+         overlap). */
       gal_data_free(ibq->overlap_i);
       gal_data_free(ibq->overlap_m);
       gal_data_free(ibq->image);
-      tbq=ibq->next;
       free(ibq);
-      ibq=tbq;
     }
 
+  /* Clean up. */
+  free(sums);
+}
+
+
+
+
+
+static void
+mkprof_write(struct mkprofparams *p)
+{
+  char *jobname;
+  struct timeval t1;
+  gal_data_t *out=p->out;
+  struct builtqueue *ibq, *tbq, **batch;
+  size_t complete=0, numbatch=0, batchsize=64, batchpix=0;
+
+  /* Allocate the array to keep a batch of built profiles. */
+  errno=0;
+  batch=malloc(batchsize*sizeof *batch);
+  if(batch==NULL)
+    error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for 'batch'",
+          __func__, batchsize*sizeof *batch);
+
+  /* Write each image into the output array. */
+  while(complete<p->num)
+    {
+      /* Take the profiles that have been built until now. With one
+         thread, all the profiles have already been built. */
+      if(p->cp.numthreads==1) { ibq=p->bq; p->bq=NULL; }
+      else ibq=mkprof_write_queue_pop(p);
+
+      /* Add the profiles to the batch. When the batch has enough pixels
+         (or all profiles have been built), merge them into the output
+         (in parallel). */
+      for(; ibq!=NULL; ibq=tbq)
+        {
+          tbq=ibq->next;
+          if(numbatch==batchsize)
+            {
+              batchsize*=2;
+              errno=0;
+              batch=realloc(batch, batchsize*sizeof *batch);
+              if(batch==NULL)
+                error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu "
+                      "bytes for 'batch'", __func__,
+                      batchsize*sizeof *batch);
+            }
+          batch[numbatch++]=ibq;
+          if(ibq->overlaps && out) batchpix+=ibq->overlap_i->size;
+          if(batchpix>=MERGE_BATCH_NUMPIX || complete+numbatch==p->num)
+            {
+              mkprof_write_batch(p, batch, numbatch, &complete);
+              numbatch=batchpix=0;
+            }
+        }
+    }
+  free(batch);
+
 
   /* Write the final array to the output FITS image if a merged image is to
      be created. */
@@ -835,6 +1079,18 @@ mkprof(struct mkprofparams *p)
       err=pthread_cond_init(&p->qready, NULL);
       if(err) error(EXIT_FAILURE, 0, "%s: condition variable not "
                     "initialized", __func__);
+      err=pthread_cond_init(&p->qpaused, NULL);
+      if(err) error(EXIT_FAILURE, 0, "%s: condition variable not "
+                    "initialized", __func__);
+      err=pthread_cond_init(&p->qresume, NULL);
+      if(err) error(EXIT_FAILURE, 0, "%s: condition variable not "
+                    "initialized", __func__);
+
+      /* Count the builders (before any of them starts). */
+      p->mpause=0;
+      p->nbuilding=0;
+      for(i=0;i<nt;++i)
+        if(indexs[i*thrdcols]!=GAL_BLANK_SIZE_T) ++p->nbuilding;
 
       /* Spin off the threads: */
       for(i=0;i<nt;++i)
@@ -898,6 +1154,8 @@ mkprof(struct mkprofparams *p)
       pthread_attr_destroy(&attr);
       pthread_barrier_destroy(&b);
       pthread_cond_destroy(&p->qready);
+      pthread_cond_destroy(&p->qpaused);
+      pthread_cond_destroy(&p->qresume);
       pthread_mutex_destroy(&p->qlock);
     }
 
@@ -66,6 +66,12 @@ struct mkonthread
 
   double       fixedvalue;   /* Value of a point source.              */
 
+  /* Radial look-up table (when 'rtable!=NULL'). */
+  double          *rtable;   /* Profile value on regular radii.       */
+  size_t          rtablen;   /* Number of elements in 'rtable'.       */
+  double          rtabmin;   /* Radius of first element of 'rtable'.  */
+  double          rtabinv;   /* Inverse of radial step of 'rtable'.   */
+
   /* General parameters */
   struct mkprofparams  *p;   /* Pointer to the main.h structure.      */
   size_t          *indexs;   /* Indexs to build on this thread.       */
@@ -321,6 +321,252 @@ integ2d(struct mkonthread *mkp)
 
 
 
+/**************************************************************/
+/************       Ordered queue of pixels       *************/
+/**************************************************************/
+/* In the central region of the profile, the pixels have to be built in
+   order of their distance to the center (the integration stops once the
+   central pixel value is accurate enough). Pixels with the same distance
+   are popped in the order they were added (through 'seq'). */
+struct oneprofile_heap_item
+{
+  size_t         ind;       /* Index of pixel in the image.         */
+  size_t         seq;       /* Order that it was added to the heap. */
+  float            s;       /* Circular distance (to sort).         */
+};
+
+struct oneprofile_heap
+{
+  struct oneprofile_heap_item *items;   /* Array of heap elements. */
+  size_t                         num;   /* Number of used elements.*/
+  size_t                        size;   /* Allocated elements.     */
+  size_t                         seq;   /* Counter for 'seq'.      */
+};
+
+
+
+
+
+static int
+oneprofile_heap_less(struct oneprofile_heap_item *a,
+                     struct oneprofile_heap_item *b)
+{
+  return a->s < b->s || ( a->s==b->s && a->seq < b->seq );
+}
+
+
+
+
+
+static void
+oneprofile_heap_push(struct oneprofile_heap *h, size_t ind, float s)
+{
+  size_t i, parent;
+  struct oneprofile_heap_item tmp, *items;
+
+  /* Allocate more space if necessary. */
+  if(h->num==h->size)
+    {
+      h->size = h->size ? 2*h->size : 128;
+      errno=0;
+      h->items=realloc(h->items, h->size*sizeof *h->items);
+      if(h->items==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+              "the heap", __func__, h->size*sizeof *h->items);
+    }
+
+  /* Put the new element at the end and move it up to its place. */
+  items=h->items;
+  tmp.ind=ind; tmp.seq=h->seq++; tmp.s=s;
+  for(i=h->num++; i>0; i=parent)
+    {
+      parent=(i-1)/2;
+      if( oneprofile_heap_less(&tmp, &items[parent])==0 ) break;
+      items[i]=items[parent];
+    }
+  items[i]=tmp;
+}
+
+
+
+
+
+static size_t
+oneprofile_heap_pop(struct oneprofile_heap *h, float *s)
+{
+  size_t i, child;
+  struct oneprofile_heap_item out, last, *items=h->items;
+
+  /* Keep the top (smallest) element, then sift the last element down
+     from the top. */
+  out=items[0];
+  last=items[--h->num];
+  for(i=0; (child=2*i+1) < h->num; i=child)
+    {
+      if( child+1 < h->num
+          && oneprofile_heap_less(&items[child+1], &items[child]) )
+        ++child;
+      if( oneprofile_heap_less(&items[child], &last)==0 ) break;
+      items[i]=items[child];
+    }
+  if(h->num) items[i]=last;
+
+  /* Return the popped element. */
+  *s=out.s;
+  return out.ind;
+}
+
+
+
+
+
+/* Make sure the array-based stack of 'oneprofile_pix_by_pix' has space
+   for one more element. */
+static size_t *
+oneprofile_stack_grow(size_t **stack, size_t *stacksize)
+{
+  *stacksize *= 2;
+  errno=0;
+  *stack=realloc(*stack, *stacksize * sizeof **stack);
+  if(*stack==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't re-allocate %zu bytes for "
+          "the stack", __func__, *stacksize * sizeof **stack);
+  return *stack;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/**************************************************************/
+/************        Radial look-up table         *************/
+/**************************************************************/
+/* Outside the central (accurately integrated) region, the Sersic, Moffat
+   and Gaussian profiles are only a function of the elliptical radius. So
+   when '--radialtable' is given, their values can be linearly
+   interpolated from a table on regularly spaced radii between 'rmin' and
+   the truncation radius. The number of elements is doubled (the
+   previously checked mid-points become the new elements) until the
+   interpolated value at the middle of every interval is within the
+   requested relative tolerance of the actual value. If this needs more
+   than 'maxnum' elements (when it won't be faster than evaluating the
+   profile on every pixel), no table is made and 'mkp->rtable' will be
+   NULL. */
+static void
+oneprofile_rtable_make(struct mkonthread *mkp, double rmin, size_t maxnum)
+{
+  int accurate;
+  size_t i, num=RTABLE_MINNUM;
+  double *tab, *mid, *tmp, step, interp;
+  double r_before=mkp->r, tol=mkp->p->radialtable;
+
+  /* If the table isn't necessary or is too large, don't build it. */
+  mkp->rtable=NULL;
+  if( rmin>=mkp->truncr || num>maxnum ) return;
+
+  /* Fill the initial table. */
+  step=(mkp->truncr-rmin)/(num-1);
+  tab=gal_pointer_allocate(GAL_TYPE_FLOAT64, num, 0, __func__, "tab");
+  for(i=0;i<num;++i) { mkp->r=rmin+i*step; tab[i]=mkp->profile(mkp); }
+
+  /* Check the middle of all the intervals and refine the table until it
+     is accurate enough. */
+  while(1)
+    {
+      accurate=1;
+      step=(mkp->truncr-rmin)/(num-1);
+      mid=gal_pointer_allocate(GAL_TYPE_FLOAT64, num-1, 0, __func__, "mid");
+      for(i=0;i<num-1;++i)
+        {
+          mkp->r = rmin + (i+0.5)*step;
+          mid[i] = mkp->profile(mkp);
+          interp = (tab[i]+tab[i+1])/2;
+          if( interp!=mid[i] && fabs(interp-mid[i]) > tol*fabs(mid[i]) )
+            accurate=0;
+        }
+
+      /* The table is accurate enough. */
+      if(accurate) { free(mid); break; }
+
+      /* The table can't become any larger. */
+      if(2*num-1>maxnum) { free(mid); free(tab); tab=NULL; break; }
+
+      /* Interleave the mid-points into the table. */
+      tmp=gal_pointer_allocate(GAL_TYPE_FLOAT64, 2*num-1, 0, __func__,
+                               "tmp");
+      for(i=0;i<num-1;++i) { tmp[2*i]=tab[i]; tmp[2*i+1]=mid[i]; }
+      tmp[2*(num-1)]=tab[num-1];
+      free(tab);
+      free(mid);
+      tab=tmp;
+      num=2*num-1;
+    }
+
+  /* Set the table parameters and reset the radius. */
+  if(tab)
+    {
+      mkp->rtable=tab;
+      mkp->rtablen=num;
+      mkp->rtabmin=rmin;
+      mkp->rtabinv=(num-1)/(mkp->truncr-rmin);
+    }
+  mkp->r=r_before;
+}
+
+
+
+
+
+/* Profile value from the radial look-up table. Radii that are smaller
+   than the table's first element (not expected outside the central
+   region) are evaluated directly. */
+static double
+oneprofile_rtable_value(struct mkonthread *mkp)
+{
+  size_t i;
+  double x;
+
+  if(mkp->r < mkp->rtabmin) return mkp->profile(mkp);
+  x = (mkp->r - mkp->rtabmin) * mkp->rtabinv;
+  i = x;
+  if(i>mkp->rtablen-2) i=mkp->rtablen-2;
+  return mkp->rtable[i] + (x-i)*(mkp->rtable[i+1]-mkp->rtable[i]);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /**************************************************************/
 /************       Pixel by pixel building       *************/
 /*********        Positions are in C not FITS         *********/
@@ -359,16 +605,14 @@ oneprofile_pix_by_pix(struct mkonthread *mkp)
   size_t ndim=ibq->image->ndim, *dsize=ibq->image->dsize;
 
   uint8_t *byt;
-  gal_list_sizet_t *Q=NULL;
   int use_rand_points=1, ispeak=1;
   double tolerance=mkp->p->tolerance;
-  float circ_r, *array=mkp->ibq->image->array;
+  struct oneprofile_heap h={NULL, 0, 0, 0};
+  float circ_r=0.0f, *array=mkp->ibq->image->array;
   double (*profile)(struct mkonthread *)=mkp->profile;
   double truncr=mkp->truncr, approx, hp=0.5f/mkp->p->oversample;
-  size_t i, p, *dinc=gal_dimension_increment(ndim, dsize);
-
-  /* lQ: Largest. sQ: Smallest in queue */
-  gal_list_dosizet_t *lQ=NULL, *sQ;
+  size_t i, p, *stack, stacksize, numstack=0, size=ibq->image->size;
+  size_t *dinc=gal_dimension_increment(ndim, dsize);
 
   /* Find the nearest pixel to the profile center and add it to the
      queue. */
@@ -377,17 +621,15 @@ oneprofile_pix_by_pix(struct mkonthread *mkp)
   /* If this is a point source, just fill that one pixel and leave this
      function. */
   if(mkp->func==PROFILE_POINT)
-    { array[p] = mkp->fixedvalue; return; }
+    { array[p] = mkp->fixedvalue; free(dinc); return; }
 
   /* Allocate the 'byt' array. It is used as a flag to make sure that we
      don't re-calculate the profile value on a pixel more than once. */
-  byt = gal_pointer_allocate(GAL_TYPE_UINT8,
-                             gal_dimension_total_size(ndim, dsize), 1,
-                             __func__, "byt");
+  byt = gal_pointer_allocate(GAL_TYPE_UINT8, size, 1, __func__, "byt");
 
   /* Start the queue: */
   byt[p]=1;
-  gal_list_dosizet_add( &lQ, &sQ, p, oneprofile_r_circle(p, mkp) );
+  oneprofile_heap_push(&h, p, oneprofile_r_circle(p, mkp));
 
   /* If random points are necessary, then do it: */
   switch(mkp->func)
@@ -395,18 +637,13 @@ oneprofile_pix_by_pix(struct mkonthread *mkp)
     case PROFILE_SERSIC:
     case PROFILE_MOFFAT:
     case PROFILE_GAUSSIAN:
-      while(sQ)
+      while(h.num)
         {
-          /* In case you want to see the status of the twosided ordered
-             queue, increasing and decreasing side by side, uncomment this
-             line. Note that there will be a lot of lines printed! */
-          /*print_tossll(lQ, sQ);*/
-
-          /* Pop a pixel from the queue, convert its index into coordinates
-             and use them to estimate the elliptical radius of the
-             pixel. If the pixel is outside the truncation radius, ignore
-             it. */
-          p=gal_list_dosizet_pop_smallest(&lQ, &sQ, &circ_r);
+          /* Pop the nearest pixel from the queue, convert its index into
+             coordinates and use them to estimate the elliptical radius
+             of the pixel. If the pixel is outside the truncation radius,
+             ignore it. */
+          p=oneprofile_heap_pop(&h, &circ_r);
           oneprofile_set_coord(mkp, p);
           oneprofile_r_el(mkp);
           if(mkp->r > truncr) continue;
@@ -444,25 +681,39 @@ oneprofile_pix_by_pix(struct mkonthread *mkp)
               if(byt[nind]==0)
                 {
                   byt[nind]=1;
-                  gal_list_dosizet_add( &lQ, &sQ, nind,
-                                        oneprofile_r_circle(nind, mkp) );
+                  oneprofile_heap_push(&h, nind,
+                                       oneprofile_r_circle(nind, mkp));
                 }
             } );
 
           if(use_rand_points==0) break;
         }
+
+      /* If requested, the remaining pixels (that are all further from
+         the center) can use a radial look-up table. */
+      if(h.num && mkp->p->radialtable>0.0f)
+        {
+          oneprofile_rtable_make(mkp, circ_r/mkp->p->oversample,
+                                 size/RTABLE_SIZEFRAC);
+          if(mkp->rtable) profile=oneprofile_rtable_value;
+        }
     }
 
 
   /* All the pixels that required integration or random points are now
-     done, so we don't need an ordered array any more. */
-  gal_list_dosizet_to_sizet(lQ, &Q);
+     done, so we don't need an ordered array any more: the remaining
+     pixels are put in a simple array-based stack. */
+  stacksize = h.num>64 ? h.num : 64;
+  stack=gal_pointer_allocate(GAL_TYPE_SIZE_T, stacksize, 0, __func__,
+                             "stack");
+  for(i=0;i<h.num;++i) stack[numstack++]=h.items[i].ind;
+  free(h.items);
 
 
   /* Order doesn't matter any more, add all the pixels you find. */
-  while(Q)
+  while(numstack)
     {
-      p=gal_list_sizet_pop(&Q);
+      p=stack[--numstack];
       oneprofile_set_coord(mkp, p);
       oneprofile_r_el(mkp);
 
@@ -495,7 +746,9 @@ oneprofile_pix_by_pix(struct mkonthread *mkp)
           if(byt[nind]==0)
             {
               byt[nind]=1;
-              gal_list_sizet_add(&Q, nind);
+              if(numstack==stacksize)
+                oneprofile_stack_grow(&stack, &stacksize);
+              stack[numstack++]=nind;
             }
         } );
     }
@@ -503,6 +756,8 @@ oneprofile_pix_by_pix(struct mkonthread *mkp)
   /* Clean up. */
   free(byt);
   free(dinc);
+  free(stack);
+  if(mkp->rtable) { free(mkp->rtable); mkp->rtable=NULL; }
 }
 
 
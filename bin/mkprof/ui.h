@@ -99,6 +99,7 @@ enum option_keys_enum
   UI_KEY_CUSTOMTABLE,
   UI_KEY_CUSTOMIMGHDU,
   UI_KEY_CUSTOMTABLEHDU,
+  UI_KEY_RADIALTABLE,
 };
 
 
@@ -168,8 +168,10 @@ detection_initial(struct noisechiselparams *p)
 
 
   /* Label the connected components. */
-  p->numinitialdets=gal_binary_connected_components(p->binary, &p->olabel,
-                                                    p->binary->ndim);
+  p->numinitialdets=gal_binary_connected_components_threads(p->binary,
+                                                            &p->olabel,
+                                                            p->binary->ndim,
+                                                            p->cp.numthreads);
   if(p->detectionname)
     {
       p->olabel->name="OPENED-AND-LABELED";
@@ -480,7 +482,8 @@ detection_pseudo_find(struct noisechiselparams *p, gal_data_t *workbin,
       do if(*b==GAL_BLANK_UINT8) *b = !s0d1; while(++b<bf);
     }
   */
-  return gal_binary_connected_components(workbin, &worklab, con);
+  return gal_binary_connected_components_threads(workbin, &worklab, con,
+                                                 p->cp.numthreads);
 }
 
 
@@ -1085,8 +1088,10 @@ detection_quantile_expand(struct noisechiselparams *p, gal_data_t *workbin)
       gal_binary_holes_fill(workbin, 1, p->detgrowmaxholesize);
 
       /* Get the labeled image. */
-      numexpanded=gal_binary_connected_components(workbin, &p->olabel,
-                                                  workbin->ndim);
+      numexpanded=gal_binary_connected_components_threads(workbin,
+                                                          &p->olabel,
+                                                          workbin->ndim,
+                                                          p->cp.numthreads);
 
       /* Set all the input's blank pixels to blank in the labeled and
          binary arrays. */
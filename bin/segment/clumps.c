@@ -624,7 +624,11 @@ clumps_true_find_sn_thresh(struct segmentparams *p)
      steps, we need to break out of the processing get an over-all output,
      then reset the input and call it again. So it will be slower, but its
      is natural, since the user is testing to find the correct combination
-     of parameters for later use. */
+     of parameters for later use.
+
+     The processing time of each tile can be very different (tiles over
+     bright galaxies take much longer), so the tiles are given to the
+     threads dynamically (one by one, when a thread is free). */
   if(p->segmentationname)
     {
       /* Necessary initializations. */
@@ -641,9 +645,10 @@ clumps_true_find_sn_thresh(struct segmentparams *p)
                    claborig->size*gal_type_sizeof(claborig->type));
 
           /* Do this step. */
-          gal_threads_spin_off(clumps_find_make_sn_table, &clprm,
-                               p->ltl.tottiles, p->cp.numthreads,
-                               p->cp.minmapsize, p->cp.quietmmap);
+          gal_threads_spin_off_schedule(clumps_find_make_sn_table, &clprm,
+                                        p->ltl.tottiles, p->cp.numthreads,
+                                        GAL_THREADS_SCHEDULE_DYNAMIC, 1,
+                                        p->cp.minmapsize, p->cp.quietmmap);
 
           /* Set the extension name. */
           switch(clprm.step)
@@ -674,9 +679,10 @@ clumps_true_find_sn_thresh(struct segmentparams *p)
   else
     {
       clprm.step=0;
-      gal_threads_spin_off(clumps_find_make_sn_table, &clprm,
-                           p->ltl.tottiles, p->cp.numthreads,
-                           p->cp.minmapsize, p->cp.quietmmap);
+      gal_threads_spin_off_schedule(clumps_find_make_sn_table, &clprm,
+                                    p->ltl.tottiles, p->cp.numthreads,
+                                    GAL_THREADS_SCHEDULE_DYNAMIC, 1,
+                                    p->cp.minmapsize, p->cp.quietmmap);
     }
 
 
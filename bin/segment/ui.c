@@ -513,8 +513,9 @@ ui_prepare_inputs(struct segmentparams *p)
       if( p->numdetections == 1 )
         {
           ccin=gal_data_copy_to_new_type_free(p->olabel, GAL_TYPE_UINT8);
-          p->numdetections=gal_binary_connected_components(ccin, &ccout,
-                                                           ccin->ndim);
+          p->numdetections=gal_binary_connected_components_threads(ccin,
+                                                  &ccout, ccin->ndim,
+                                                  p->cp.numthreads);
           gal_data_free(ccin);
           p->olabel=ccout;
         }
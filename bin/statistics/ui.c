@@ -672,7 +672,7 @@ ui_check_options_and_arguments(struct statisticsparams *p)
 static void
 ui_out_of_range_to_blank(struct statisticsparams *p)
 {
-  size_t one=1;
+  size_t one=1, two=2;
   unsigned char flags=GAL_ARITHMETIC_FLAG_NUMOK;
   unsigned char flagsor = ( GAL_ARITHMETIC_FLAG_INPLACE
                             | GAL_ARITHMETIC_FLAG_NUMOK );
@@ -690,15 +690,19 @@ ui_out_of_range_to_blank(struct statisticsparams *p)
       /* If only one value was given, set the maximum quantile range. */
       if( isnan(p->quantmax) ) p->quantmax = 1 - p->quantmin;
 
-      /* Set the greater-equal value. */
-      tmp=gal_statistics_quantile(ref, p->quantmin, 1);
-      tmp=gal_data_copy_to_new_type_free(tmp, GAL_TYPE_FLOAT32);
-      p->greaterequal=*((float *)(tmp->array));
-
-      /* Set the lower-than value. */
-      tmp=gal_statistics_quantile(ref, p->quantmax, 1);
-      tmp=gal_data_copy_to_new_type_free(tmp, GAL_TYPE_FLOAT32);
-      p->lessthan=*((float *)(tmp->array));
+      /* Find the values at both quantiles in one selection. */
+      tmp=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &two, NULL, 0, -1, 1,
+                         NULL, NULL, NULL);
+      ((double *)(tmp->array))[0]=p->quantmin;
+      ((double *)(tmp->array))[1]=p->quantmax;
+      tmp2=gal_statistics_quantiles(ref, tmp, 1);
+      tmp2=gal_data_copy_to_new_type_free(tmp2, GAL_TYPE_FLOAT32);
+
+      /* Set the greater-equal and lower-than values. */
+      p->greaterequal=((float *)(tmp2->array))[0];
+      p->lessthan=((float *)(tmp2->array))[1];
+      gal_data_free(tmp2);
+      gal_data_free(tmp);
     }
 
 
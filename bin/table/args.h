@@ -547,6 +547,19 @@ struct argp_option program_options[] =
       GAL_OPTIONS_NOT_MANDATORY,
       GAL_OPTIONS_NOT_SET,
     },
+    {
+      "rowchunk",
+      UI_KEY_ROWCHUNK,
+      "INT",
+      0,
+      "Read (FITS) and select by value in row chunks.",
+      UI_GROUP_OUTROWS,
+      &p->rowchunk,
+      GAL_TYPE_SIZE_T,
+      GAL_OPTIONS_RANGE_GT_0,
+      GAL_OPTIONS_NOT_MANDATORY,
+      GAL_OPTIONS_NOT_SET,
+    },
     {
       "envseed",
       UI_KEY_ENVSEED,
@@ -641,7 +641,7 @@ arithmetic_wcs(struct tableparams *p, gal_data_t **stack, int operator)
   if(operator==ARITHMETIC_TABLE_OP_WCSTOIMG)
     {
       /* Do the conversion. */
-      gal_wcs_world_to_img(coord[0], wcs, 1);
+      gal_wcs_world_to_img_threads(coord[0], wcs, 1, p->cp.numthreads);
 
       /* For image coordinates, we don't need much precision. */
       for(i=0;i<ndim;++i)
@@ -658,7 +658,7 @@ arithmetic_wcs(struct tableparams *p, gal_data_t **stack, int operator)
     }
   else
     {
-      gal_wcs_img_to_world(coord[0], wcs, 1);
+      gal_wcs_img_to_world_threads(coord[0], wcs, 1, p->cp.numthreads);
       arithmetic_update_metadata(coord[0], wcs->ctype[0], wcs->cunit[0],
                                  "Converted from pixel coordinates");
       arithmetic_update_metadata(coord[1], coord[1]?wcs->ctype[1]:NULL,
@@ -754,10 +754,10 @@ arithmetic_curved_flat(struct tableparams *p, gal_data_t **stack,
   switch(operator)
     {
     case ARITHMETIC_TABLE_OP_EQJ2000TOFLAT:
-      gal_wcs_world_to_img(w1, wcs, 1);
+      gal_wcs_world_to_img_threads(w1, wcs, 1, p->cp.numthreads);
       break;
     case ARITHMETIC_TABLE_OP_EQJ2000FROMFLAT:
-      gal_wcs_img_to_world(w1, wcs, 1);
+      gal_wcs_img_to_world_threads(w1, wcs, 1, p->cp.numthreads);
       break;
     default:
       error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at '%s' to "
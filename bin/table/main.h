@@ -117,6 +117,7 @@ struct tableparams
   size_t                 tail;  /* Output only the no. of bottom rows.  */
   gal_data_t        *rowrange;  /* Output rows in row-counter range.    */
   size_t            rowrandom;  /* Number of rows to show randomly.     */
+  size_t             rowchunk;  /* Read and select rows in chunks.      */
   uint8_t             envseed;  /* Use the environment for random seed. */
   gal_list_str_t *catcolumnfile;/* Filename to concat column wise.      */
   gal_list_str_t *catcolumnhdu; /* HDU/extension for the catcolumn.     */
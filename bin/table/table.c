@@ -167,18 +167,19 @@ table_bring_to_top(gal_data_t *table, gal_data_t *rowids)
 
 
 static gal_data_t *
-table_selection_range(struct tableparams *p, gal_data_t *col)
+table_selection_range(struct tableparams *p, gal_data_t *col,
+                      gal_data_t *range)
 {
   size_t one=1;
   double *darr;
   int numok=GAL_ARITHMETIC_FLAG_NUMOK;
   int inplace=GAL_ARITHMETIC_FLAG_INPLACE;
-  gal_data_t *min=NULL, *max=NULL, *tmp, *ltmin, *gemax=NULL;
+  gal_data_t *min=NULL, *max=NULL, *ltmin, *gemax=NULL;
 
   /* First, make sure everything is OK. */
-  if(p->range==NULL)
+  if(range==NULL)
     error(EXIT_FAILURE, 0, "%s: a bug! Please contact us to fix the "
-          "problem at %s. 'p->range' should not be NULL at this point",
+          "problem at %s. 'range' should not be NULL at this point",
           __func__, PACKAGE_BUGREPORT);
 
   /* Allocations. */
@@ -187,17 +188,12 @@ table_selection_range(struct tableparams *p, gal_data_t *col)
   max=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &one, NULL, 0, -1, 1,
                      NULL, NULL, NULL);
 
-  /* Read the range of values for this column. */
-  darr=p->range->array;
+  /* Read the range of values for this column (the list of ranges isn't
+     modified: when the table is read in chunks, it is used again). */
+  darr=range->array;
   ((double *)(min->array))[0] = darr[0];
   ((double *)(max->array))[0] = darr[1];
 
-  /* Move 'p->range' to the next element in the list and free the current
-     one (we have already read its values and don't need it any more). */
-  tmp=p->range;
-  p->range=p->range->next;
-  gal_data_free(tmp);
-
   /* Find all the elements outside this range (smaller than the minimum,
      larger than the maximum or blank) as separate binary flags. */
   ltmin=gal_arithmetic(GAL_ARITHMETIC_OP_LT, 1, numok, col, min);
@@ -337,7 +333,7 @@ table_selection_string_eq_ne(gal_data_t *column, char *reference, int e0n1)
 
 static gal_data_t *
 table_selection_equal_or_notequal(struct tableparams *p, gal_data_t *col,
-                                  int e0n1)
+                                  gal_data_t *arg, int e0n1)
 {
   void *varr;
   char **strarr;
@@ -345,7 +341,6 @@ table_selection_equal_or_notequal(struct tableparams *p, gal_data_t *col,
   int numok=GAL_ARITHMETIC_FLAG_NUMOK;
   int inplace=GAL_ARITHMETIC_FLAG_INPLACE;
   gal_data_t *eq, *out=NULL, *value=NULL;
-  gal_data_t *arg = e0n1 ? p->notequal : p->equal;
 
   /* Note that this operator is used to make the "masked" array, so when
      'e0n1==0' the operator should be 'GAL_ARITHMETIC_OP_NE' and
@@ -359,7 +354,7 @@ table_selection_equal_or_notequal(struct tableparams *p, gal_data_t *col,
   /* First, make sure everything is OK. */
   if(arg==NULL)
     error(EXIT_FAILURE, 0, "%s: a bug! Please contact us to fix the "
-          "problem at %s. 'p->range' should not be NULL at this point",
+          "problem at %s. 'arg' should not be NULL at this point",
           __func__, PACKAGE_BUGREPORT);
 
   /* To easily parse the given values. */
@@ -410,15 +405,8 @@ table_selection_equal_or_notequal(struct tableparams *p, gal_data_t *col,
   */
 
 
-  /* Move the main pointer to the next possible call of the given
-     option. Note that 'arg' already points to 'p->equal' or 'p->notequal',
-     so it will automatically be freed with the next step. */
-  if(e0n1) p->notequal=p->notequal->next;
-  else     p->equal=p->equal->next;
-
   /* Clean up and return. */
   gal_data_free(value);
-  gal_data_free(arg);
   return out;
 }
 
@@ -426,20 +414,40 @@ table_selection_equal_or_notequal(struct tableparams *p, gal_data_t *col,
 
 
 
+/* Free the columns that were only used for selection by value. */
 static void
+table_select_free(struct tableparams *p)
+{
+  size_t i=0;
+  struct list_select *tmp;
+
+  for(tmp=p->selectcol;tmp!=NULL;tmp=tmp->next)
+    { if(p->freeselect[i]) {gal_data_free(tmp->col); tmp->col=NULL;} ++i; }
+  ui_list_select_free(p->selectcol, 0);
+  free(p->freeselect);
+  p->selectcol=NULL;
+  p->freeselect=NULL;
+}
+
+
+
+
+
+void
 table_select_by_value(struct tableparams *p)
 {
   gal_data_t *rowids;
-  size_t i, *s, ngood=0;
+  size_t *s, ngood=0;
   struct list_select *tmp;
   uint8_t *u, *uf, *ustart;
   int inplace=GAL_ARITHMETIC_FLAG_INPLACE;
   gal_data_t *mask, *col, *blmask, *addmask=NULL;
+  gal_data_t *range=p->range, *equal=p->equal, *notequal=p->notequal;
 
   /* It may happen that the input table is empty! In such cases, just
-     return and don't bother with this step. */
+     free the selection columns and return. */
   if(p->table->size==0 || p->table->array==NULL || p->table->dsize==NULL)
-    return;
+    { table_select_free(p); return; }
 
   /* Allocate datasets for the necessary numbers and write them in. */
   mask=gal_data_alloc(NULL, GAL_TYPE_UINT8, 1, &p->table->dsize[0],
@@ -474,7 +482,8 @@ table_select_by_value(struct tableparams *p)
       switch(tmp->type)
         {
         case SELECT_TYPE_RANGE:
-          addmask=table_selection_range(p, tmp->col);
+          addmask=table_selection_range(p, tmp->col, range);
+          range=range->next;
           break;
 
         /* '--inpolygon' and '--outpolygon' need two columns. */
@@ -486,11 +495,14 @@ table_select_by_value(struct tableparams *p)
           break;
 
         case SELECT_TYPE_EQUAL:
-          addmask=table_selection_equal_or_notequal(p, tmp->col, 0);
+          addmask=table_selection_equal_or_notequal(p, tmp->col, equal, 0);
+          equal=equal->next;
           break;
 
         case SELECT_TYPE_NOTEQUAL:
-          addmask=table_selection_equal_or_notequal(p, tmp->col, 1);
+          addmask=table_selection_equal_or_notequal(p, tmp->col, notequal,
+                                                    1);
+          notequal=notequal->next;
           break;
 
         case SELECT_TYPE_NOBLANK:
@@ -561,11 +573,7 @@ table_select_by_value(struct tableparams *p)
   if(p->sortcol && p->sortin==0) table_bring_to_top(p->sortcol, rowids);
 
   /* Clean up. */
-  i=0;
-  for(tmp=p->selectcol;tmp!=NULL;tmp=tmp->next)
-    { if(p->freeselect[i]) {gal_data_free(tmp->col); tmp->col=NULL;} ++i; }
-  ui_list_select_free(p->selectcol, 0);
-  free(p->freeselect);
+  table_select_free(p);
   gal_data_free(mask);
   gal_data_free(rowids);
 }
@@ -579,7 +587,6 @@ table_sort(struct tableparams *p)
 {
   gal_data_t *perm;
   size_t c=0, *s, *sf, dsize0=p->table->dsize[0];
-  int (*qsortfn)(const void *, const void *)=NULL;
 
   /* In case there are no columns to sort, skip this function. */
   if(p->table->size==0 || p->table->array==NULL || p->table->dsize==NULL)
@@ -607,47 +614,10 @@ table_sort(struct tableparams *p)
           "section of the book/manual):\n\n"
           "    $ info gnuastro \"gnuastro text table format\"");
 
-  /* Set the proper qsort function. */
-  if(p->descending)
-    switch(p->sortcol->type)
-      {
-      case GAL_TYPE_UINT8:   qsortfn=gal_qsort_index_single_uint8_d;   break;
-      case GAL_TYPE_INT8:    qsortfn=gal_qsort_index_single_int8_d;    break;
-      case GAL_TYPE_UINT16:  qsortfn=gal_qsort_index_single_uint16_d;  break;
-      case GAL_TYPE_INT16:   qsortfn=gal_qsort_index_single_int16_d;   break;
-      case GAL_TYPE_UINT32:  qsortfn=gal_qsort_index_single_uint32_d;  break;
-      case GAL_TYPE_INT32:   qsortfn=gal_qsort_index_single_int32_d;   break;
-      case GAL_TYPE_UINT64:  qsortfn=gal_qsort_index_single_uint64_d;  break;
-      case GAL_TYPE_INT64:   qsortfn=gal_qsort_index_single_int64_d;   break;
-      case GAL_TYPE_FLOAT32: qsortfn=gal_qsort_index_single_float32_d; break;
-      case GAL_TYPE_FLOAT64: qsortfn=gal_qsort_index_single_float64_d; break;
-      default:
-        error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
-              "the problem. The code '%u' wasn't recognized as a data type",
-              __func__, PACKAGE_BUGREPORT, p->sortcol->type);
-      }
-  else
-    switch(p->sortcol->type)
-      {
-      case GAL_TYPE_UINT8:   qsortfn=gal_qsort_index_single_uint8_i;   break;
-      case GAL_TYPE_INT8:    qsortfn=gal_qsort_index_single_int8_i;    break;
-      case GAL_TYPE_UINT16:  qsortfn=gal_qsort_index_single_uint16_i;  break;
-      case GAL_TYPE_INT16:   qsortfn=gal_qsort_index_single_int16_i;   break;
-      case GAL_TYPE_UINT32:  qsortfn=gal_qsort_index_single_uint32_i;  break;
-      case GAL_TYPE_INT32:   qsortfn=gal_qsort_index_single_int32_i;   break;
-      case GAL_TYPE_UINT64:  qsortfn=gal_qsort_index_single_uint64_i;  break;
-      case GAL_TYPE_INT64:   qsortfn=gal_qsort_index_single_int64_i;   break;
-      case GAL_TYPE_FLOAT32: qsortfn=gal_qsort_index_single_float32_i; break;
-      case GAL_TYPE_FLOAT64: qsortfn=gal_qsort_index_single_float64_i; break;
-      default:
-        error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
-              "the problem. The code '%u' wasn't recognized as a data type",
-              __func__, PACKAGE_BUGREPORT, p->sortcol->type);
-      }
-
   /* Sort the indexs from the values. */
-  gal_qsort_index_single=p->sortcol->array;
-  qsort(perm->array, perm->size, sizeof *s, qsortfn);
+  gal_qsort_index_radix(perm->array, perm->size, p->sortcol->array,
+                        p->sortcol->type, p->descending, p->cp.numthreads,
+                        p->cp.minmapsize, p->cp.quietmmap);
 
   /* For a check (only on float32 type 'sortcol'):
   {
@@ -1603,8 +1573,9 @@ table(struct tableparams *p)
   if(p->table)
     {
       table_txt_formats(p);
-      gal_table_write(p->table, NULL, NULL, p->cp.tableformat,
-                      p->cp.output, "TABLE", p->colinfoinstdout, 0);
+      gal_table_write_threads(p->table, NULL, NULL, p->cp.tableformat,
+                              p->cp.output, "TABLE", p->colinfoinstdout,
+                              0, p->cp.numthreads);
     }
   else
     error(EXIT_FAILURE, 0, "no output columns");
@@ -23,6 +23,9 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #ifndef TABLE_H
 #define TABLE_H
 
+void
+table_select_by_value(struct tableparams *p);
+
 void
 table(struct tableparams *p);
 
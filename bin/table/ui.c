@@ -43,6 +43,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include "main.h"
 
 #include "ui.h"
+#include "table.h"
 #include "arithmetic.h"
 #include "authors-cite.h"
 
@@ -1319,6 +1320,227 @@ ui_check_select_sort_after(struct tableparams *p, size_t nselect,
 
 
 
+/* Row selection by value can be applied while the table is read in
+   chunks of rows (so the rows that aren't selected are never kept in
+   memory together) when the input is a FITS table and no operation that
+   needs all the input rows is done before the selection: column
+   arithmetic (and concatenation of columns from other files) is done
+   before the row-based operations by default, and rows from other files
+   are added before the selection. */
+static int
+ui_read_chunks_possible(struct tableparams *p)
+{
+  if(p->rowchunk==0) return 0;
+
+  if( p->selection==0
+      || p->filename==NULL
+      || p->catrowfile
+      || gal_fits_file_recognized(p->filename)==0
+      || ( p->rowfirst==0 && (p->colpack || p->catcolumnfile) ) )
+    {
+      if(!p->cp.quiet)
+        error(EXIT_SUCCESS, 0, "WARNING: '--rowchunk' is ignored (the "
+              "full table is read): it is only used with row selection "
+              "by value (for example '--range') on FITS tables, when no "
+              "column arithmetic or '--catcolumnfile' is requested "
+              "before the row-based operations (see '--rowfirst') and "
+              "no '--catrowfile' is given");
+      return 0;
+    }
+  return 1;
+}
+
+
+
+
+
+/* Merge the selected rows of all the chunks (each element of 'chunks' is
+   the list of columns of one chunk) into one table, the chunks are freed
+   afterwards. */
+static gal_data_t *
+ui_read_chunks_merge(struct tableparams *p, gal_list_void_t *chunks)
+{
+  char **strarr;
+  size_t i, n, nrows=0, filled=0, dsize[2];
+  gal_data_t *out=NULL, *chunk, *col, *ocol;
+  gal_list_void_t *ch;
+
+  /* Find the final number of rows. */
+  for(ch=chunks; ch!=NULL; ch=ch->next)
+    nrows += ((gal_data_t *)(ch->v))->dsize[0];
+
+  /* When there is only one chunk (or no row was selected), the first
+     chunk can be used as the output. */
+  if(chunks->next==NULL || nrows==0)
+    {
+      out=gal_list_void_pop(&chunks);
+      while(chunks) gal_list_data_free( gal_list_void_pop(&chunks) );
+      return out;
+    }
+
+  /* Allocate the output columns (with the metadata of the first
+     chunk). */
+  for(col=chunks->v; col!=NULL; col=col->next)
+    {
+      dsize[0]=nrows;
+      if(col->ndim==2) dsize[1]=col->dsize[1];
+      ocol=gal_data_alloc(NULL, col->type, col->ndim, dsize, NULL, 0,
+                          p->cp.minmapsize, p->cp.quietmmap, col->name,
+                          col->unit, col->comment);
+      ocol->disp_fmt=col->disp_fmt;
+      ocol->disp_width=col->disp_width;
+      ocol->disp_precision=col->disp_precision;
+      gal_list_data_add(&out, ocol);
+    }
+  gal_list_data_reverse(&out);
+
+  /* Copy the rows of each chunk into the output and free it. */
+  while(chunks)
+    {
+      chunk=gal_list_void_pop(&chunks);
+      for(col=chunk, ocol=out; col!=NULL; col=col->next, ocol=ocol->next)
+        if(col->size)
+          {
+            /* Copy the rows (the column may be a vector). */
+            n = col->ndim==1 ? 1 : col->dsize[1];
+            memcpy(gal_pointer_increment(ocol->array, filled*n, col->type),
+                   col->array, col->size*gal_type_sizeof(col->type));
+
+            /* For strings, the pointers now belong to the output. */
+            if(col->type==GAL_TYPE_STRING)
+              {
+                strarr=col->array;
+                for(i=0;i<col->size;++i) strarr[i]=NULL;
+              }
+          }
+      filled += chunk->dsize[0];
+      gal_list_data_free(chunk);
+    }
+
+  /* Return the merged table. */
+  return out;
+}
+
+
+
+
+
+/* 'table_select_by_value' only moves the selected rows to the top of the
+   columns (without shrinking their allocated space). To only keep the
+   selected rows of each chunk in memory until the chunks are merged,
+   move them into newly allocated arrays and free the full chunk's
+   arrays. */
+static void
+ui_read_chunk_compact(struct tableparams *p, gal_data_t *table)
+{
+  void *array;
+  gal_data_t *col;
+  char *mmapname=NULL;
+
+  for(col=table; col!=NULL; col=col->next)
+    if(col->array && col->block==NULL)
+      {
+        /* Copy the selected rows (for strings, only the pointers are
+           copied, so the strings now belong to the new array). */
+        array=gal_pointer_allocate_ram_or_mmap(col->type, col->size, 0,
+                                               p->cp.minmapsize,
+                                               &mmapname,
+                                               p->cp.quietmmap, __func__,
+                                               "array");
+        memcpy(array, col->array, col->size*gal_type_sizeof(col->type));
+
+        /* Free the old array and put the new one in its place. */
+        if(col->mmapname)
+          gal_pointer_mmap_free(&col->mmapname, col->quietmmap);
+        else free(col->array);
+        col->array=array;
+        col->mmapname=mmapname;
+        mmapname=NULL;
+      }
+}
+
+
+
+
+
+/* Read the table in chunks of '--rowchunk' rows and apply the row
+   selection by value on each chunk as soon as it is read (see
+   'ui_read_chunks_possible'). The selected rows of all the chunks are then
+   merged into 'p->table', so no further selection is necessary. */
+static void
+ui_read_select_chunks(struct tableparams *p, size_t nselect,
+                      size_t origoutncols, size_t sortindout,
+                      size_t *selectindout, size_t *selecttypeout)
+{
+  size_t i, numread, rowstart;
+  gal_list_void_t *chunks=NULL;
+  gal_data_t *chunk, *tmp, *prev=NULL;
+  struct gal_options_common_params *cp=&p->cp;
+  int sortsep = p->sort && sortindout>=origoutncols;
+
+  /* Read the chunks until the end of the table. */
+  for(rowstart=0; ; rowstart+=p->rowchunk)
+    {
+      /* Read this chunk (all the necessary columns). */
+      chunk=gal_table_read_rows(p->filename, cp->hdu, NULL, p->columns,
+                                cp->searchin, cp->ignorecase, rowstart,
+                                p->rowchunk, cp->numthreads,
+                                cp->minmapsize, cp->quietmmap, p->colmatch,
+                                "--hdu");
+      if(chunk==NULL) break;
+      numread=chunk->dsize[0];
+
+      /* Separate the selection and sort columns, then only keep the
+         selected rows of this chunk. */
+      p->table=chunk;
+      p->selectcol=NULL;
+      ui_check_select_sort_after(p, nselect, origoutncols, sortindout,
+                                 selectindout, selecttypeout);
+      table_select_by_value(p);
+
+      /* Keep this chunk's selected rows (a separate sort column is kept
+         as the last column). */
+      if(sortsep) gal_list_data_last(p->table)->next=p->sortcol;
+      ui_read_chunk_compact(p, p->table);
+      gal_list_void_add(&chunks, p->table);
+
+      /* The last chunk has been read. */
+      if(numread<p->rowchunk) break;
+    }
+
+  /* Merge all the chunks into the final table. */
+  if(chunks)
+    {
+      gal_list_void_reverse(&chunks);
+      p->table=ui_read_chunks_merge(p, chunks);
+    }
+  else p->table=NULL;
+
+  /* Set the sort column in the merged table: a separate sort column was
+     kept at the end. */
+  p->sortcol=NULL;
+  if(p->table && p->sort)
+    {
+      i=0;
+      for(tmp=p->table; tmp!=NULL; tmp=tmp->next)
+        {
+          if(sortsep ? tmp->next==NULL : i==sortindout)
+            { p->sortcol=tmp; break; }
+          prev=tmp;
+          ++i;
+        }
+      if(sortsep) prev->next=NULL;
+    }
+
+  /* The selection has been applied. */
+  p->selection=0;
+}
+
+
+
+
+
+
 static void
 ui_preparations(struct tableparams *p)
 {
@@ -1364,22 +1586,28 @@ ui_preparations(struct tableparams *p)
                   : NULL);
 
 
-  /* Read the necessary columns. */
-  p->table=gal_table_read(p->filename, cp->hdu, lines, p->columns,
-                          cp->searchin, cp->ignorecase, cp->numthreads,
-                          cp->minmapsize, p->cp.quietmmap, p->colmatch,
-                          "--hdu");
+  /* Read the necessary columns. When possible (and requested), the rows
+     are selected by value while the table is read in chunks. */
+  if( ui_read_chunks_possible(p) )
+    ui_read_select_chunks(p, nselect, origoutncols, sortindout,
+                          selectindout, selecttypeout);
+  else
+    {
+      p->table=gal_table_read(p->filename, cp->hdu, lines, p->columns,
+                              cp->searchin, cp->ignorecase, cp->numthreads,
+                              cp->minmapsize, p->cp.quietmmap, p->colmatch,
+                              "--hdu");
+
+      /* If row sorting or selection are requested, keep them as separate
+         datasets.*/
+      if(p->table && (p->selection || p->sort))
+        ui_check_select_sort_after(p, nselect, origoutncols, sortindout,
+                                   selectindout, selecttypeout);
+    }
   if(p->filename==NULL) p->filename="stdin";
   gal_list_str_free(lines, 1);
 
 
-  /* If row sorting or selection are requested, keep them as separate
-     datasets.*/
-  if(p->selection || p->sort)
-    ui_check_select_sort_after(p, nselect, origoutncols, sortindout,
-                               selectindout, selecttypeout);
-
-
   /* If there was no actual data in the file, then inform the user and
      abort. */
   if(p->table==NULL)
@@ -1519,6 +1747,9 @@ ui_free_report(struct tableparams *p)
   free(p->cp.hdu);
   free(p->cp.output);
   gal_list_data_free(p->table);
+  gal_list_data_free(p->range);
+  gal_list_data_free(p->equal);
+  gal_list_data_free(p->notequal);
   if(p->wcshdu) free(p->wcshdu);
   gal_list_data_free(p->noblank);
   gal_list_str_free(p->columns, 1);
@@ -84,6 +84,7 @@ enum option_keys_enum
   UI_KEY_TOVECTOR,
   UI_KEY_ROWFIRST,
   UI_KEY_ROWRANDOM,
+  UI_KEY_ROWCHUNK,
   UI_KEY_INPOLYGON,
   UI_KEY_TRANSPOSE,
   UI_KEY_OUTPOLYGON,
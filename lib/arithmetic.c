@@ -1920,9 +1920,9 @@ struct multioperandparams
 
 
 
-#define MULTIOPERAND_MEDIAN(TYPE, QSORT_F) {                            \
+#define MULTIOPERAND_MEDIAN(TYPE) {                                     \
     int use;                                                            \
-    size_t n, j;                                                        \
+    size_t n, j, ranks[2];                                              \
     float *o=p->out->array;                                             \
     TYPE *pixs=gal_pointer_allocate(p->list->type, p->dnum, 0,          \
                                     __func__, "pixs");                  \
@@ -1948,10 +1948,12 @@ struct multioperandparams
             if(use) pixs[n++]=a[i][j];                                  \
           }                                                             \
                                                                         \
-        /* Sort all the values for this pixel and return the median. */ \
+        /* Bring the middle value(s) of this pixel to their sorted */   \
+        /* position (no need to sort all) and return the median. */    \
         if(n)                                                           \
           {                                                             \
-            qsort(pixs, n, sizeof *pixs, QSORT_F);                      \
+            ranks[0]=(n-1)/2; ranks[1]=n/2;                             \
+            gal_qsort_select(pixs, n, p->list->type, ranks, 2);         \
             o[j] = n%2 ? pixs[n/2] : (pixs[n/2] + pixs[n/2-1])/2 ;      \
           }                                                             \
         else                                                            \
@@ -2163,7 +2165,7 @@ arithmetic_multioperand_number_write(struct multioperandparams *p,
 
 
 
-#define MULTIOPERAND_TYPE_SET(TYPE, QSORT_F) {                          \
+#define MULTIOPERAND_TYPE_SET(TYPE) {                                   \
     TYPE b, **a;                                                        \
     gal_data_t *tmp;                                                    \
     size_t i=0, tind;                                                   \
@@ -2214,7 +2216,7 @@ arithmetic_multioperand_number_write(struct multioperandparams *p,
         break;                                                          \
                                                                         \
       case GAL_ARITHMETIC_OP_MEDIAN:                                    \
-        MULTIOPERAND_MEDIAN(TYPE, QSORT_F);                             \
+        MULTIOPERAND_MEDIAN(TYPE);                                      \
         break;                                                          \
                                                                         \
       case GAL_ARITHMETIC_OP_QUANTILE:                                  \
@@ -2262,34 +2264,34 @@ multioperand_on_thread(void *in_prm)
   switch(p->list->type)
     {
     case GAL_TYPE_UINT8:
-      MULTIOPERAND_TYPE_SET(uint8_t,   gal_qsort_uint8_i);
+      MULTIOPERAND_TYPE_SET(uint8_t);
       break;
     case GAL_TYPE_INT8:
-      MULTIOPERAND_TYPE_SET(int8_t,    gal_qsort_int8_i);
+      MULTIOPERAND_TYPE_SET(int8_t);
       break;
     case GAL_TYPE_UINT16:
-      MULTIOPERAND_TYPE_SET(uint16_t,  gal_qsort_uint16_i);
+      MULTIOPERAND_TYPE_SET(uint16_t);
       break;
     case GAL_TYPE_INT16:
-      MULTIOPERAND_TYPE_SET(int16_t,   gal_qsort_int16_i);
+      MULTIOPERAND_TYPE_SET(int16_t);
       break;
     case GAL_TYPE_UINT32:
-      MULTIOPERAND_TYPE_SET(uint32_t,  gal_qsort_uint32_i);
+      MULTIOPERAND_TYPE_SET(uint32_t);
       break;
     case GAL_TYPE_INT32:
-      MULTIOPERAND_TYPE_SET(int32_t,   gal_qsort_int32_i);
+      MULTIOPERAND_TYPE_SET(int32_t);
       break;
     case GAL_TYPE_UINT64:
-      MULTIOPERAND_TYPE_SET(uint64_t,  gal_qsort_uint64_i);
+      MULTIOPERAND_TYPE_SET(uint64_t);
       break;
     case GAL_TYPE_INT64:
-      MULTIOPERAND_TYPE_SET(int64_t,   gal_qsort_int64_i);
+      MULTIOPERAND_TYPE_SET(int64_t);
       break;
     case GAL_TYPE_FLOAT32:
-      MULTIOPERAND_TYPE_SET(float,     gal_qsort_float32_i);
+      MULTIOPERAND_TYPE_SET(float);
       break;
     case GAL_TYPE_FLOAT64:
-      MULTIOPERAND_TYPE_SET(double,    gal_qsort_float64_i);
+      MULTIOPERAND_TYPE_SET(double);
       break;
     default:
       error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
@@ -2305,6 +2307,333 @@ multioperand_on_thread(void *in_prm)
 
 
 
+/* Sigma-clipping on blocks of pixels (for 32-bit floating point inputs).
+
+   Calling 'gal_statistics_clip_sigma' on every pixel is very slow when
+   there are many inputs: it allocates several datasets in each round and
+   sorts each pixel's values with 'qsort' (calling a function for every
+   comparison). The functions below give identical results, but operate on
+   blocks of 'MULTIOPERAND_SIGCLIP_BLOCK' neighboring pixels: the values
+   with the same index (or "rank", after sorting) in all the pixels of a
+   block are kept beside each other in memory. The sorting (with a sorting
+   network) and the sums of each round are therefore simple loops over all
+   the pixels of the block that the compiler can vectorize. */
+#define MULTIOPERAND_SIGCLIP_BLOCK 16
+
+
+
+
+
+/* Sort the 'm' ranks of all the pixels in 'r' (in increasing order) with
+   a bitonic sorting network ('m' is a power of two). In each step, the
+   compared ranks are in two contiguous groups of 'j' ranks, so each
+   compare-exchange is a simple loop over 'j*MULTIOPERAND_SIGCLIP_BLOCK'
+   values (the same for all the pixels). */
+static void
+multioperand_sigclip_sort(float *r, size_t m)
+{
+  float u, v, *x, *y, *t;
+  size_t b, j, k, q, n;
+
+  for(k=2;k<=m;k*=2)
+    for(j=k/2;j>0;j/=2)
+      for(b=0;b<m;b+=2*j)
+        {
+          /* The larger values go to 'y'. */
+          n=j*MULTIOPERAND_SIGCLIP_BLOCK;
+          x=r+b*MULTIOPERAND_SIGCLIP_BLOCK;
+          y=x+n;
+          if(b&k) { t=x; x=y; y=t; }
+          for(q=0;q<n;++q)
+            {
+              u=x[q]; v=y[q];
+              x[q] = v<u ? v : u;
+              y[q] = u<v ? v : u;
+            }
+        }
+}
+
+
+
+
+
+/* Similar to 'gal_statistics_is_sorted': 0 when 'x' isn't sorted, 1 when
+   it is increasing and 2 when it is decreasing. */
+static int
+multioperand_sigclip_is_sorted(float *x, size_t n)
+{
+  size_t i;
+  if(n<2) return 1;
+  if(x[1]>=x[0]) { for(i=1;i<n-1;++i) if(x[i+1]<x[i]) return 0; return 1; }
+  else           { for(i=1;i<n-1;++i) if(x[i+1]>x[i]) return 0; return 2; }
+}
+
+
+
+
+
+/* Sigma-clip the 'nl' pixels that start at 'j0' and write the results
+   in the outputs (like 'MULTIOPERAND_CLIP'). 'vals' and 'ranked' are
+   allocated by the caller: 'vals' has 'p->dnum*MULTIOPERAND_SIGCLIP_BLOCK'
+   elements and 'ranked' has the smallest power of two that is larger
+   than (or equal to) 'p->dnum' times 'MULTIOPERAND_SIGCLIP_BLOCK'. The
+   steps of each round are the same as 'statistics_clip' (with 'CLIPALL'),
+   so the results are identical. The only extra measurement (in
+   'p->clipflags') that is done here is the mean. */
+static void
+multioperand_sigclip_block(struct multioperandparams *p, float **a,
+                           size_t j0, size_t nl, float *vals,
+                           float *ranked)
+{
+  long k, lo, hi;
+  float v, *x, *o=p->out?p->out->array:NULL;
+  float *cen=p->center?p->center->array:NULL;
+  float *spr=p->spread?p->spread->array:NULL;
+  float multip=p->p1, param=p->p2, carr[GAL_STATISTICS_CLIP_OUT_SIZE];
+  uint8_t bytolerance = param>=1.0f ? 0 : 1;
+  size_t maxnum = param>=1.0f?param:GAL_STATISTICS_CLIP_MAX_CONVERGE;
+  size_t i, l, c, m, rmin, rmax, nactive, dnum=p->dnum;
+  size_t nin[MULTIOPERAND_SIGCLIP_BLOCK], num[MULTIOPERAND_SIGCLIP_BLOCK];
+  size_t st[MULTIOPERAND_SIGCLIP_BLOCK],  en[MULTIOPERAND_SIGCLIP_BLOCK];
+  size_t size[MULTIOPERAND_SIGCLIP_BLOCK];
+  double d, s[MULTIOPERAND_SIGCLIP_BLOCK], s2[MULTIOPERAND_SIGCLIP_BLOCK];
+  double mean[MULTIOPERAND_SIGCLIP_BLOCK];
+  double center[MULTIOPERAND_SIGCLIP_BLOCK];
+  double spread[MULTIOPERAND_SIGCLIP_BLOCK];
+  double oldspread[MULTIOPERAND_SIGCLIP_BLOCK];
+  int dec[MULTIOPERAND_SIGCLIP_BLOCK], active[MULTIOPERAND_SIGCLIP_BLOCK];
+
+  /* Put the usable (non-NaN) values of each pixel beside each other. */
+  for(l=0;l<MULTIOPERAND_SIGCLIP_BLOCK;++l) nin[l]=0;
+  for(i=0;i<dnum;++i)
+    for(l=0;l<nl;++l)
+      {
+        v=a[i][j0+l];
+        if(v==v) vals[l*dnum + nin[l]++]=v;  /* Only non-NaN values. */
+      }
+
+  /* Put the values of the same index in all pixels beside each other
+     (the extra ranks are filled with infinity so they remain at the end
+     after sorting) and sort them. Like 'gal_statistics_no_blank_sorted',
+     the values of a pixel that are in decreasing order are not sorted, so
+     they are put back after the sorting. */
+  for(m=1, l=0; l<MULTIOPERAND_SIGCLIP_BLOCK; ++l) while(m<nin[l]) m*=2;
+  for(l=0;l<MULTIOPERAND_SIGCLIP_BLOCK;++l)
+    {
+      x=vals+l*dnum;
+      for(i=0;i<nin[l];++i) ranked[i*MULTIOPERAND_SIGCLIP_BLOCK+l]=x[i];
+      for(i=nin[l];i<m;++i) ranked[i*MULTIOPERAND_SIGCLIP_BLOCK+l]=INFINITY;
+    }
+  multioperand_sigclip_sort(ranked, m);
+  for(l=0;l<MULTIOPERAND_SIGCLIP_BLOCK;++l)
+    if( (dec[l] = multioperand_sigclip_is_sorted(vals+l*dnum, nin[l])==2) )
+      for(x=vals+l*dnum, i=0; i<nin[l]; ++i)
+        ranked[i*MULTIOPERAND_SIGCLIP_BLOCK+l]=x[i];
+
+  /* Initialize the clipping of each pixel: the used ranks of each pixel
+     are 'st' to 'en' (the last plus one). */
+  nactive=0;
+  for(l=0;l<MULTIOPERAND_SIGCLIP_BLOCK;++l)
+    {
+      num[l]=0;
+      st[l]=0; en[l]=size[l]=nin[l];
+      mean[l]=oldspread[l]=center[l]=spread[l]=NAN;
+      if( (active[l] = nin[l]>1) ) ++nactive;
+    }
+
+  /* Do the clipping rounds on all the pixels together. */
+  while(nactive)
+    {
+      /* Median of the used ranks (in 32-bit floating point, like
+         'statistics_median_in_sorted_no_blank') and the full range of
+         ranks that are used in this round. */
+      rmin=dnum; rmax=0;
+      for(l=0;l<MULTIOPERAND_SIGCLIP_BLOCK;++l)
+        if(active[l])
+          {
+            c=en[l]-st[l];
+            x=ranked+(st[l]+c/2)*MULTIOPERAND_SIGCLIP_BLOCK+l;
+            center[l] = ( c%2
+                          ? x[0]
+                          : (x[0]+x[-MULTIOPERAND_SIGCLIP_BLOCK])/2 );
+            if(st[l]<rmin) rmin=st[l];
+            if(en[l]>rmax) rmax=en[l];
+          }
+
+      /* Sum of the used values and their squares (in the same order as
+         'gal_statistics_std'). Ranks that are not used in a pixel add
+         zero, so this loop is the same for all pixels. */
+      for(l=0;l<MULTIOPERAND_SIGCLIP_BLOCK;++l) s[l]=s2[l]=0.0f;
+      for(i=rmin;i<rmax;++i)
+        {
+          x=ranked+i*MULTIOPERAND_SIGCLIP_BLOCK;
+          for(l=0;l<MULTIOPERAND_SIGCLIP_BLOCK;++l)
+            {
+              d = ( i>=st[l] && i<en[l] ) ? x[l] : 0.0f;
+              s[l]  += d;
+              s2[l] += d*d;
+            }
+        }
+
+      /* Check the convergence of each pixel and clip it. */
+      for(l=0;l<MULTIOPERAND_SIGCLIP_BLOCK;++l)
+        if(active[l])
+          {
+            c=en[l]-st[l];
+            mean[l]=s[l]/c;
+            spread[l]=gal_statistics_std_from_sums(s[l], s2[l], c);
+
+            /* See if we should stop (see 'statistics_clip'). */
+            if( spread[l]==0 || (bytolerance && num[l]>0) )
+              if( spread[l]==0
+                  || ((oldspread[l] - spread[l]) / spread[l]) < param )
+                { size[l]=c; active[l]=0; --nactive; continue; }
+
+            /* Remove the out-of-range values from the start and end of
+               the used ranks (when no value is found, the start or end
+               is not changed, like 'CLIPALL'). */
+            x=ranked+l;
+            for(lo=st[l]; lo<(long)en[l]; ++lo)
+              if( dec[l]
+                  ? x[lo*MULTIOPERAND_SIGCLIP_BLOCK]
+                    < center[l] + multip*spread[l]
+                  : x[lo*MULTIOPERAND_SIGCLIP_BLOCK]
+                    > center[l] - multip*spread[l] ) break;
+            for(hi=en[l]-1; hi>=(long)st[l]; --hi)
+              if( dec[l]
+                  ? x[hi*MULTIOPERAND_SIGCLIP_BLOCK]
+                    > center[l] - multip*spread[l]
+                  : x[hi*MULTIOPERAND_SIGCLIP_BLOCK]
+                    < center[l] + multip*spread[l] ) break;
+            if(hi>=(long)st[l])
+              {
+                if(lo==(long)en[l]) st[l]=en[l];
+                else { st[l]=lo; en[l] = hi+1>lo ? hi+1 : lo; }
+              }
+            else if(lo<(long)en[l]) st[l]=lo;
+            size[l]=en[l]-st[l];
+
+            /* Prepare for the next round. */
+            oldspread[l]=spread[l];
+            if( ++num[l]>=maxnum || size[l]==0 )
+              { active[l]=0; --nactive; }
+          }
+    }
+
+  /* Write the results. */
+  for(l=0;l<nl;++l)
+    {
+      /* No usable elements. */
+      if(nin[l]==0)
+        {
+          if(o) o[j0+l]=NAN;
+          arithmetic_multioperand_number_write(p, NULL, j0+l);
+          continue;
+        }
+
+      /* Fill the clipping outputs like 'gal_statistics_clip_sigma'. */
+      for(k=0;k<GAL_STATISTICS_CLIP_OUT_SIZE;++k) carr[k]=NAN;
+      if(nin[l]==1)
+        {
+          carr[ GAL_STATISTICS_CLIP_OUTCOL_MEDIAN      ] = ranked[l];
+          carr[ GAL_STATISTICS_CLIP_OUTCOL_NUMBER_USED ] = 1;
+          carr[ GAL_STATISTICS_CLIP_OUTCOL_STD         ] = 0;
+          if(p->clipflags & GAL_STATISTICS_CLIP_OUTCOL_OPTIONAL_MEAN)
+            carr[ GAL_STATISTICS_CLIP_OUTCOL_MEAN      ] = ranked[l];
+        }
+      else
+        {
+          if( size[l] && !(bytolerance && num[l]==maxnum) )
+            {
+              carr[ GAL_STATISTICS_CLIP_OUTCOL_MEDIAN      ] = center[l];
+              carr[ GAL_STATISTICS_CLIP_OUTCOL_NUMBER_USED ] = size[l];
+              carr[ GAL_STATISTICS_CLIP_OUTCOL_STD         ] = spread[l];
+            }
+          if(p->clipflags & GAL_STATISTICS_CLIP_OUTCOL_OPTIONAL_MEAN)
+            carr[ GAL_STATISTICS_CLIP_OUTCOL_MEAN ] = mean[l];
+        }
+
+      /* Write them in the outputs. */
+      if(o)
+        switch(p->operator)
+          {
+          case GAL_ARITHMETIC_OP_SIGCLIP_STD:
+            o[j0+l]=carr[GAL_STATISTICS_CLIP_OUTCOL_STD];    break;
+          case GAL_ARITHMETIC_OP_SIGCLIP_MEAN:
+            o[j0+l]=carr[GAL_STATISTICS_CLIP_OUTCOL_MEAN];   break;
+          case GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN:
+            o[j0+l]=carr[GAL_STATISTICS_CLIP_OUTCOL_MEDIAN]; break;
+          default:
+            error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at '%s' "
+                  "to fix the problem. The code %d is not valid for this "
+                  "function", __func__, PACKAGE_BUGREPORT, p->operator);
+          }
+      arithmetic_multioperand_number_write(p, carr, j0+l);
+      if(cen)
+        {
+          cen[j0+l]=carr[GAL_STATISTICS_CLIP_OUTCOL_MEDIAN];
+          spr[j0+l]=carr[GAL_STATISTICS_CLIP_OUTCOL_STD];
+        }
+    }
+}
+
+
+
+
+
+/* Worker function on each thread for the blocks of pixels. */
+static void *
+multioperand_sigclip_on_thread(void *in_prm)
+{
+  /* Low-level definitions to be done first. */
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct multioperandparams *p=(struct multioperandparams *)tprm->params;
+
+  /* Subsequent definitions. */
+  float **a;
+  gal_data_t *tmp;
+  float *vals, *ranked;
+  size_t i=0, m=1, tind, j0, size=p->list->size;
+
+  /* Allocate the work arrays (see 'multioperand_sigclip_block'). */
+  while(m<p->dnum) m*=2;
+  vals=gal_pointer_allocate(GAL_TYPE_FLOAT32,
+                            p->dnum*MULTIOPERAND_SIGCLIP_BLOCK, 0,
+                            __func__, "vals");
+  ranked=gal_pointer_allocate(GAL_TYPE_FLOAT32,
+                              m*MULTIOPERAND_SIGCLIP_BLOCK, 0,
+                              __func__, "ranked");
+
+  /* Pointers to the arrays of the inputs. */
+  errno=0;
+  a=malloc(p->dnum*sizeof *a);
+  if(a==NULL)
+    error(EXIT_FAILURE, errno, "%s: %zu bytes for 'a'", __func__,
+          p->dnum*sizeof *a);
+  for(tmp=p->list;tmp!=NULL;tmp=tmp->next) a[i++]=tmp->array;
+
+  /* Go over all the blocks assigned to this thread. */
+  for(tind=0; tprm->indexs[tind] != GAL_BLANK_SIZE_T; ++tind)
+    {
+      j0=tprm->indexs[tind]*MULTIOPERAND_SIGCLIP_BLOCK;
+      multioperand_sigclip_block(p, a, j0,
+                                 ( size-j0 < MULTIOPERAND_SIGCLIP_BLOCK
+                                   ? size-j0 : MULTIOPERAND_SIGCLIP_BLOCK ),
+                                 vals, ranked);
+    }
+
+  /* Clean up, wait for all the other threads to finish, then return. */
+  free(a);
+  free(vals);
+  free(ranked);
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
 static void
 arithmetic_multioperand_prepare(struct multioperandparams *p, int flags,
                                 gal_data_t *params)
@@ -2631,9 +2960,34 @@ arithmetic_multioperand(int operator, int flags, gal_data_t *list,
   p.operator=operator;
   arithmetic_multioperand_prepare(&p, flags, params);
 
-  /* Spin off the threads apply the operator. */
-  gal_threads_spin_off(multioperand_on_thread, &p, list->size,
-                       numthreads, list->minmapsize, list->quietmmap);
+  /* Spin off the threads apply the operator. Sigma-clipping of 32-bit
+     floating point inputs is done on blocks of pixels. The only extra
+     measurement there is the mean, so with any other extra measurement
+     (for example the MAD in 'sigclip-mad'), it is done on each pixel. */
+  if( list->type==GAL_TYPE_FLOAT32
+      && (p.clipflags & ~GAL_STATISTICS_CLIP_OUTCOL_OPTIONAL_MEAN)==0
+      && ( operator==GAL_ARITHMETIC_OP_SIGCLIP_STD
+           || operator==GAL_ARITHMETIC_OP_SIGCLIP_MEAN
+           || operator==GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN
+           || operator==GAL_ARITHMETIC_OP_SIGCLIP_MASKFILLED ) )
+    {
+      /* Same sanity checks as 'gal_statistics_clip_sigma' (that isn't
+         called on the blocks). */
+      if( p.p1<=0 || p.p2<=0 || (p.p2>=1.0f && ceil(p.p2)!=p.p2) )
+        error(EXIT_FAILURE, 0, "%s: the multiple of sigma (%g) and the "
+              "tolerance or number of clips (%g) must be larger than "
+              "zero (when the latter is larger than 1.0, it is the "
+              "number of clips and must be an integer)", __func__,
+              p.p1, p.p2);
+      gal_threads_spin_off(multioperand_sigclip_on_thread, &p,
+                           ( list->size/MULTIOPERAND_SIGCLIP_BLOCK
+                             + ( list->size%MULTIOPERAND_SIGCLIP_BLOCK
+                                 ? 1 : 0 ) ),
+                           numthreads, list->minmapsize, list->quietmmap);
+    }
+  else
+    gal_threads_spin_off(multioperand_on_thread, &p, list->size,
+                         numthreads, list->minmapsize, list->quietmmap);
 
   /* Do the masking if requested. */
   switch(operator)
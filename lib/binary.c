@@ -32,6 +32,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/tile.h>
 #include <gnuastro/blank.h>
 #include <gnuastro/binary.h>
+#include <gnuastro/threads.h>
 #include <gnuastro/pointer.h>
 #include <gnuastro/dimension.h>
 
@@ -485,16 +486,282 @@ gal_binary_number_neighbors(gal_data_t *input, int connectivity, int inplace)
 /*********************************************************************/
 /*****************      Connected components      ********************/
 /*********************************************************************/
+/* Make sure the array-based stack of 'binary_connected_label_range' has
+   space for one more element. */
+static size_t *
+binary_connected_stack_grow(size_t **stack, size_t *stacksize)
+{
+  *stacksize *= 2;
+  errno=0;
+  *stack=realloc(*stack, *stacksize * sizeof **stack);
+  if(*stack==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't re-allocate %zu bytes for "
+          "the stack", __func__, *stacksize * sizeof **stack);
+  return *stack;
+}
+
+
+
+
+
+/* Label the connected components of the '[start, end)' range of pixels
+   (in their raster order) and return the number of labels found. Only
+   neighbors within the range are checked. Labels start from 1 and are
+   given in the order that the first pixel of each component is seen, so
+   the pixels of each component are followed with an array-based stack of
+   indexs instead of allocating a list element for every pixel. */
+static size_t
+binary_connected_label_range(uint8_t *b, int32_t *l, size_t start,
+                             size_t end, size_t ndim, size_t *dsize,
+                             size_t *dinc, int connectivity,
+                             size_t **stack, size_t *stacksize)
+{
+  size_t p, i, nq, curlab=1;
+
+  for(i=start;i<end;++i)
+
+    /* Check if this pixel is already labeled. */
+    if( b[i] && l[i]==0 )
+      {
+        /* This is the first pixel of this connected region that we have
+           got to, put it in the stack. */
+        l[i]=curlab;
+        (*stack)[0]=i;
+        nq=1;
+
+        /* While a pixel remains in the stack, continue labelling and
+           searching for neighbors. Pixels are labeled as they are added
+           to the stack, so each pixel is only added once. */
+        while(nq)
+          {
+            p=(*stack)[--nq];
+            GAL_DIMENSION_NEIGHBOR_OP(p, ndim, dsize, connectivity, dinc,
+              {
+                if( nind>=start && nind<end && b[ nind ] && l[ nind ]==0 )
+                  {
+                    l[ nind ] = curlab;
+                    if(nq==*stacksize)
+                      binary_connected_stack_grow(stack, stacksize);
+                    (*stack)[nq++]=nind;
+                  }
+              } );
+          }
+
+        /* This object has been fully labeled, so increment the current
+           label. */
+        ++curlab;
+      }
+
+  /* Return the number of labels. */
+  return curlab-1;
+}
+
+
+
+
+
+/* Parameters for the multi-threaded connected components. */
+struct binary_connected_params
+{
+  uint8_t           *b;  /* Input binary array.                        */
+  int32_t           *l;  /* Output labels array.                       */
+  size_t          ndim;  /* Number of dimensions.                      */
+  size_t        *dsize;  /* Size of each dimension.                    */
+  size_t         *dinc;  /* Increment to go along each dimension.      */
+  int     connectivity;  /* Connectivity to define neighbors.          */
+  size_t       *bounds;  /* First pixel of each strip (and the end).   */
+  size_t      *numlabs;  /* Number of labels in each strip.            */
+  size_t       *offset;  /* Number of labels before each strip.        */
+  size_t        *final;  /* Final label of each strip's label.         */
+};
+
+
+
+
+
+/* Independently label the pixels in each strip. */
+static void *
+binary_connected_strips(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct binary_connected_params *p=tprm->params;
+
+  size_t i, s, stacksize=1024;
+  size_t *stack=gal_pointer_allocate(GAL_TYPE_SIZE_T, stacksize, 0,
+                                     __func__, "stack");
+
+  /* Go over all the strips that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      s=tprm->indexs[i];
+      p->numlabs[s]=binary_connected_label_range(p->b, p->l, p->bounds[s],
+                                                 p->bounds[s+1], p->ndim,
+                                                 p->dsize, p->dinc,
+                                                 p->connectivity, &stack,
+                                                 &stacksize);
+    }
+
+  /* Clean up and wait for other threads to finish, then return. */
+  free(stack);
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Replace the strip-local labels with the final labels. */
+static void *
+binary_connected_relabel(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct binary_connected_params *p=tprm->params;
+
+  int32_t *l=p->l;
+  size_t i, j, s, *final;
+
+  /* Go over all the strips that were assigned to this thread. Note that
+     blank pixels have a negative label, so they are not touched. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      s=tprm->indexs[i];
+      final=p->final+p->offset[s];
+      for(j=p->bounds[s]; j<p->bounds[s+1]; ++j)
+        if(l[j]>0) l[j]=final[ l[j] ];
+    }
+
+  /* Wait for other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Find the root of an element in the union-find array. The root of each
+   set is always its smallest element, so 'parent[i]<=i'. */
+static size_t
+binary_connected_find(size_t *parent, size_t i)
+{
+  while(parent[i]!=i)
+    i = parent[i] = parent[ parent[i] ];
+  return i;
+}
+
+
+
+
+
+/* Label the strips in parallel, then merge the labels that touch across
+   the strip boundaries and give each final component its label. */
+static size_t
+binary_connected_threaded(gal_data_t *binary, gal_data_t *lab,
+                          size_t *dinc, int connectivity, size_t numstrips,
+                          size_t numthreads)
+{
+  int32_t *l=lab->array;
+  size_t ndim=binary->ndim, *dsize=binary->dsize;
+  size_t i, s, a, c, ra, rb, total, numlabs=0, *parent;
+  size_t rowsize=binary->size/dsize[0];
+  struct binary_connected_params p;
+
+  /* Allocate the per-strip arrays and set the strip boundaries along the
+     slowest dimension (so each strip is contiguous in memory). */
+  p.b=binary->array; p.l=l; p.ndim=ndim; p.dsize=dsize; p.dinc=dinc;
+  p.connectivity=connectivity;
+  p.bounds=gal_pointer_allocate(GAL_TYPE_SIZE_T, 3*numstrips+1, 0,
+                                __func__, "p.bounds");
+  p.numlabs=p.bounds+numstrips+1;
+  p.offset=p.numlabs+numstrips;
+  for(s=0;s<=numstrips;++s)
+    p.bounds[s] = (s*dsize[0]/numstrips) * rowsize;
+
+  /* Label each strip independently. */
+  gal_threads_spin_off(binary_connected_strips, &p, numstrips, numthreads,
+                       binary->minmapsize, binary->quietmmap);
+
+  /* Each strip's labels are placed after the labels of the strips before
+     it. Since the labels within each strip are in the raster order of
+     their first pixel, this global label is also in that order. */
+  total=0;
+  for(s=0;s<numstrips;++s) { p.offset[s]=total; total+=p.numlabs[s]; }
+  parent=gal_pointer_allocate(GAL_TYPE_SIZE_T, total+1, 0, __func__,
+                              "parent");
+  for(i=0;i<=total;++i) parent[i]=i;
+
+  /* Merge the labels that touch across each strip boundary: the
+     neighbors of the first row of a strip in the previous strip are all
+     in the last row of the previous strip. */
+  for(s=1;s<numstrips;++s)
+    for(i=p.bounds[s]; i<p.bounds[s]+rowsize; ++i)
+      if(l[i]>0)
+        {
+          a=p.offset[s]+l[i];
+          GAL_DIMENSION_NEIGHBOR_OP(i, ndim, dsize, connectivity, dinc,
+            {
+              if( nind<p.bounds[s] && l[ nind ]>0 )
+                {
+                  ra=binary_connected_find(parent, a);
+                  rb=binary_connected_find(parent, p.offset[s-1]+l[nind]);
+                  if(ra<rb) parent[rb]=ra;
+                  else      parent[ra]=rb;
+                }
+            } );
+        }
+
+  /* Point all elements directly to their root, then replace each root
+     with its final label. Roots are the smallest element in their set, so
+     going up in order, they are labeled in the raster order of each
+     component's first pixel (exactly like the single-threaded labels). */
+  for(i=1;i<=total;++i) parent[i]=parent[ parent[i] ];
+  for(i=1;i<=total;++i)
+    {
+      c=parent[i];
+      parent[i] = c==i ? ++numlabs : parent[c];
+    }
+
+  /* Write the final labels. */
+  p.final=parent;
+  gal_threads_spin_off(binary_connected_relabel, &p, numstrips, numthreads,
+                       binary->minmapsize, binary->quietmmap);
+
+  /* Clean up and return. */
+  free(parent);
+  free(p.bounds);
+  return numlabs;
+}
+
+
+
+
+
 /* Find connected components in an intput dataset. */
 size_t
 gal_binary_connected_components(gal_data_t *binary, gal_data_t **out,
                                 int connectivity)
+{
+  return gal_binary_connected_components_threads(binary, out,
+                                                 connectivity, 1);
+}
+
+
+
+
+
+/* Find connected components in an intput dataset with multiple
+   threads. */
+size_t
+gal_binary_connected_components_threads(gal_data_t *binary,
+                                        gal_data_t **out,
+                                        int connectivity,
+                                        size_t numthreads)
 {
   int32_t *l;
   uint8_t *b, *bf;
   gal_data_t *lab;
-  size_t p, i, curlab=1;
-  gal_list_sizet_t *Q=NULL;
+  size_t numlabs, numstrips, stacksize=1024, *stack;
   size_t *dinc=gal_dimension_increment(binary->ndim, binary->dsize);
 
   /* Two small sanity checks. */
@@ -542,58 +809,37 @@ gal_binary_connected_components(gal_data_t *binary, gal_data_t **out,
     do *l++ = *b==GAL_BLANK_UINT8 ? GAL_BLANK_INT32 : 0; while(++b<bf);
 
 
-  /* Go over all the pixels and do a breadth-first: any pixel that is not
-     labeled is used to label the full object by checking neighbors before
-     going onto the next pixels. */
-  l=lab->array;
-  b=binary->array;
-  for(i=0;i<binary->size;++i)
-
-    /* Check if this pixel is already labeled. */
-    if( b[i] && l[i]==0 )
-      {
-        /* This is the first pixel of this connected region that we have
-           got to. */
-        l[i]=curlab;
-
-        /* Add this pixel to the queue of pixels to work with. */
-        gal_list_sizet_add(&Q, i);
-
-        /* While a pixel remains in the queue, continue labelling and
-           searching for neighbors. */
-        while(Q!=NULL)
-          {
-            /* Pop an element from the queue. */
-            p=gal_list_sizet_pop(&Q);
-
-            /* Go over all its neighbors and add them to the list if they
-               haven't already been labeled. */
-            GAL_DIMENSION_NEIGHBOR_OP(p, binary->ndim, binary->dsize,
-                                      connectivity, dinc,
-              {
-                if( b[ nind ] && l[ nind ]==0 )
-                  {
-                    l[ nind ] = curlab;
-                    gal_list_sizet_add(&Q, nind);
-                  }
-              } );
-          }
-
-        /* This object has been fully labeled, so increment the current
-           label. */
-        ++curlab;
-      }
+  /* With more than one thread, the dataset is broken into strips along
+     the slowest dimension that are labeled independently and merged
+     afterwards. Otherwise, go over all the pixels and find all the pixels
+     of each component before going onto the next. */
+  numstrips = numthreads < binary->dsize[0] ? numthreads : binary->dsize[0];
+  if(numstrips>1)
+    numlabs=binary_connected_threaded(binary, lab, dinc, connectivity,
+                                      numstrips, numthreads);
+  else
+    {
+      stack=gal_pointer_allocate(GAL_TYPE_SIZE_T, stacksize, 0, __func__,
+                                 "stack");
+      numlabs=binary_connected_label_range(binary->array, lab->array, 0,
+                                           binary->size, binary->ndim,
+                                           binary->dsize, dinc,
+                                           connectivity, &stack,
+                                           &stacksize);
+      free(stack);
+    }
 
 
   /* Clean up and return the total number. */
   free(dinc);
-  return curlab-1;
+  return numlabs;
 }
 
 
 
 
 
+
 /* Put the indexs of connected labels in a list of 'gal_data_t's, each with
    a one-dimensional array that has the indexs of that connected
    component.*/
@@ -22,6 +22,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 **********************************************************************/
 #include <config.h>
 
+#include <math.h>
 #include <stdio.h>
 #include <errno.h>
 #include <error.h>
@@ -30,11 +31,13 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 #include <gnuastro/list.h>
 #include <gnuastro/tile.h>
+#include <gnuastro/blank.h>
 #include <gnuastro/threads.h>
 #include <gnuastro/pointer.h>
 #include <gnuastro/convolve.h>
 #include <gnuastro/dimension.h>
 
+#include <gnuastro-internal/simd.h>
 #include <gnuastro-internal/checkset.h>
 
 
@@ -85,6 +88,380 @@ convolve_tile_is_on_edge(size_t *h, size_t *start_end_coord, size_t *k,
 
 
 
+/*********************************************************************/
+/********************    Separable convolution    ********************/
+/*********************************************************************/
+/* The separable engine convolves with the best rank-1 approximation of
+   the kernel (the outer product of its first singular vectors, scaled by
+   the largest singular value). It is only used when the sum of the
+   absolute residuals (kernel minus its rank-1 approximation) is at most
+   this fraction of the sum of the absolute values of the kernel: a few
+   times the precision of the 32-bit floating point kernel. In other
+   words, only kernels that are separable to within their round-off
+   errors (for example the outer product of two 1D kernels) are used,
+   and the output only differs from the exact (generic) convolution by
+   round-off errors. Kernels that are only approximately separable (like
+   NoiseChisel's default kernel, where the pixels are integrated with
+   random points and whose residual is about 8e-4) are convolved with
+   the generic method. */
+#define CONVOLVE_SEPARABLE_TOLERANCE 1e-6
+
+/* Maximum number of power iterations to find the singular vectors. */
+#define CONVOLVE_SEPARABLE_MAXITER 100
+
+/* Parameters of separable convolution. */
+struct separable_params
+{
+  float           *in;     /* Input array.                               */
+  float          *out;     /* Output array.                              */
+  double         *tmp;     /* Input convolved along the fastest dim.     */
+  double        *tmpm;     /* Non-blank flag convolved along fastest dim.*/
+  double         *col;     /* 1D kernel along the slowest dimension.     */
+  double         *row;     /* 1D kernel along the fastest dimension.     */
+  size_t        *dsize;    /* Size of the input.                         */
+  size_t        *ksize;    /* Size of the kernel.                        */
+  double      *rowsum;     /* Sum of 'row' that overlaps each column.    */
+  double      *colsum;     /* Sum of 'col' that overlaps each row.       */
+  int          colpass;    /* ==1: the second (slow dimension) pass.     */
+  int         hasblank;    /* Input has blank values.                    */
+  int   edgecorrection;    /* Correct convolution's edge effects.        */
+  uint8_t conv_on_blank;   /* Do convolution over blank pixels also.     */
+};
+
+
+
+
+
+/* If the 2D kernel is separable within 'CONVOLVE_SEPARABLE_TOLERANCE'
+   (see above), put the two 1D kernels of its rank-1 approximation in
+   'col' and 'row' and return 1. Otherwise, return 0. Circularly symmetric
+   Gaussian kernels (the most common kernels) are separable, but kernels
+   built with MakeProfiles are not exactly separable: the central pixels
+   are integrated with random points and the profile is truncated at a
+   certain radius.
+
+   The first singular vectors are found with power iteration on
+   'kernel^T kernel' (starting from the row of the largest element): the
+   kernels are small, and for the (nearly) rank-1 kernels that we want,
+   the second singular value is much smaller than the first, so it
+   converges in a few iterations. */
+static int
+convolve_separable_decompose(gal_data_t *kernel, double **col,
+                             double **row)
+{
+  float *k=kernel->array;
+  double *u, *v, norm, max=0.0f, sumabs=0.0f, res, prev;
+  size_t i, j, p=0, iter, kh=kernel->dsize[0], kw=kernel->dsize[1];
+
+  /* Find the row of the element with the largest absolute value and the
+     sum of the absolute values. */
+  for(i=0;i<kernel->size;++i)
+    {
+      sumabs+=fabs(k[i]);
+      if( fabs(k[i]) > max ) { max=fabs(k[i]); p=i/kw; }
+    }
+  if(max==0.0f) return 0;
+
+  /* Power iteration: 'u' is the (normalized) column vector and 'v' the
+     row vector, so their outer product is the rank-1 approximation. */
+  u=*col=gal_pointer_allocate(GAL_TYPE_FLOAT64, kh, 0, __func__, "col");
+  v=*row=gal_pointer_allocate(GAL_TYPE_FLOAT64, kw, 0, __func__, "row");
+  for(j=0;j<kw;++j) v[j]=k[p*kw+j];
+  res=prev=NAN;
+  for(iter=0; iter<CONVOLVE_SEPARABLE_MAXITER; ++iter)
+    {
+      /* u = K v / |K v|. */
+      norm=0.0f;
+      for(i=0;i<kh;++i)
+        {
+          u[i]=0.0f;
+          for(j=0;j<kw;++j) u[i]+=k[i*kw+j]*v[j];
+          norm+=u[i]*u[i];
+        }
+      if(norm==0.0f) break;
+      norm=sqrt(norm);
+      for(i=0;i<kh;++i) u[i]/=norm;
+
+      /* v = K^T u (so 'v' also has the singular value). */
+      for(j=0;j<kw;++j)
+        {
+          v[j]=0.0f;
+          for(i=0;i<kh;++i) v[j]+=k[i*kw+j]*u[i];
+        }
+
+      /* The sum of absolute residuals: stop when it doesn't change. */
+      res=0.0f;
+      for(i=0;i<kh;++i)
+        for(j=0;j<kw;++j)
+          res+=fabs( k[i*kw+j] - u[i]*v[j] );
+      if( res==prev || fabs(res-prev) < 1e-3*res ) break;
+      prev=res;
+    }
+
+  /* See if the rank-1 approximation is close enough to the kernel. */
+  if( !(res <= CONVOLVE_SEPARABLE_TOLERANCE*sumabs) )
+    {
+      free(*col);
+      free(*row);
+      *col=*row=NULL;
+      return 0;
+    }
+
+  /* The kernel is separable. */
+  return 1;
+}
+
+
+
+
+
+/* Convolve 'num' contiguous elements of 'in' with the 1D kernel 'k'
+   (with 'knum' elements) that are separated by 'stride' elements and put
+   the result into 'out'. Only the elements within the 'num' elements are
+   used (like convolution over an image's edge). To allow vectorization,
+   we don't go over each output, but over each kernel element: adding its
+   contribution to all the outputs. The output is kept in double
+   precision (like the sum of the generic convolution), so the second
+   pass doesn't add the rounding of an intermediate 'float'. This
+   function is deliberately not defined with 'GAL_SIMD_CLONES': the
+   AVX2 and AVX-512 versions would fuse the multiplication and addition
+   (FMA), so the output would depend on the running CPU. */
+static void
+convolve_separable_1d(float *in, size_t num, size_t stride, double *k,
+                      size_t knum, double *out)
+{
+  size_t i, x, lo, hi;
+  ssize_t shift, half=knum/2;
+
+  /* Initialize the output. */
+  for(i=0;i<num;++i) out[i]=0.0;
+
+  /* Add the contribution of each kernel element. */
+  for(x=0;x<knum;++x)
+    {
+      shift=(ssize_t)x-half;
+      lo = shift<0 ? -shift : 0;
+      hi = shift>0 ? ( (size_t)shift<num ? num-shift : 0 ) : num;
+      if(stride==1)
+        for(i=lo;i<hi;++i) out[i] += in[i+shift] * k[x];
+      else
+        for(i=lo;i<hi;++i) out[i] += in[(i+shift)*stride] * k[x];
+    }
+}
+
+
+
+
+
+/* Worker function for separable convolution: the actions are the rows of
+   the output (slowest dimension). On the first pass (when 'colpass==0'),
+   each row of the input is convolved with the 1D 'row' kernel and written
+   into 'tmp'. On the second pass, the column kernel is applied over the
+   rows of 'tmp' (so the output of the whole row can be accumulated
+   together). */
+static void *
+convolve_separable_on_thread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct separable_params *sp=(struct separable_params *)tprm->params;
+
+  float v, *rin;
+  double *acc, *macc, *rtmp, ksum;
+  float *clean=NULL, *flag=NULL;
+  size_t i, x, y, ky, yy, h=sp->dsize[0], w=sp->dsize[1];
+  size_t kh=sp->ksize[0], kw=sp->ksize[1];
+
+  /* Allocate the per-thread buffers (the first pass writes directly
+     into the rows of 'tmp'). */
+  acc=macc=NULL;
+  if(sp->colpass)
+    {
+      acc=gal_pointer_allocate(GAL_TYPE_FLOAT64, w, 0, __func__, "acc");
+      macc=gal_pointer_allocate(GAL_TYPE_FLOAT64, w, 0, __func__, "macc");
+    }
+  else if(sp->hasblank)
+    {
+      clean=gal_pointer_allocate(GAL_TYPE_FLOAT32, w, 0, __func__, "clean");
+      flag=gal_pointer_allocate(GAL_TYPE_FLOAT32, w, 0, __func__, "flag");
+    }
+
+  /* Go over the rows given to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      y=tprm->indexs[i];
+      rin=sp->in+y*w;
+      if(sp->colpass==0)
+        {
+          /* When there are blank values, they should not contribute to
+             the convolution, so we'll set them to zero in a copy of the
+             row and keep the flag of non-blank pixels (for the
+             normalization in edge correction). */
+          if(sp->hasblank)
+            {
+              for(x=0;x<w;++x)
+                {
+                  v=rin[x];
+                  clean[x] = isnan(v) ? 0.0f : v;
+                  flag[x]  = isnan(v) ? 0.0f : 1.0f;
+                }
+              convolve_separable_1d(clean, w, 1, sp->row, kw,
+                                    sp->tmp+y*w);
+              if(sp->tmpm)
+                convolve_separable_1d(flag, w, 1, sp->row, kw,
+                                      sp->tmpm+y*w);
+            }
+          else
+            convolve_separable_1d(rin, w, 1, sp->row, kw, sp->tmp+y*w);
+        }
+      else
+        {
+          /* Add the contribution of the rows of 'tmp' that overlap with
+             the column kernel. */
+          for(x=0;x<w;++x) acc[x]=macc[x]=0.0;
+          for(ky=0;ky<kh;++ky)
+            {
+              yy=y+ky;
+              if(yy<kh/2 || yy-kh/2>=h) continue;
+              yy-=kh/2;
+              rtmp=sp->tmp+yy*w;
+              for(x=0;x<w;++x) acc[x] += rtmp[x] * sp->col[ky];
+              if(sp->tmpm)
+                {
+                  rtmp=sp->tmpm+yy*w;
+                  for(x=0;x<w;++x) macc[x] += rtmp[x] * sp->col[ky];
+                }
+            }
+
+          /* Write the output (similar to the generic spatial
+             convolution). */
+          for(x=0;x<w;++x)
+            if( isnan(rin[x]) && sp->conv_on_blank==0 )
+              sp->out[y*w+x]=NAN;
+            else
+              {
+                ksum = ( sp->edgecorrection
+                         ? ( sp->tmpm
+                             ? macc[x]
+                             : sp->colsum[y] * sp->rowsum[x] )
+                         : 1.0 );
+                sp->out[y*w+x] = ksum==0.0 ? NAN : acc[x]/ksum;
+              }
+        }
+    }
+
+  /* Clean up. */
+  if(acc) { free(acc); free(macc); }
+  if(clean) { free(clean); free(flag); }
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Sum of the elements of the 1D kernel 'k' (with 'knum' elements) that
+   overlap with each of the 'num' elements of a dimension (necessary for
+   edge correction when there are no blank values). */
+static double *
+convolve_separable_overlap_sum(double *k, size_t knum, size_t num)
+{
+  size_t i, x, half=knum/2;
+  double *out=gal_pointer_allocate(GAL_TYPE_FLOAT64, num, 1, __func__,
+                                   "out");
+  for(i=0;i<num;++i)
+    for(x=0;x<knum;++x)
+      if( i+x>=half && i+x-half<num )
+        out[i] += k[x];
+  return out;
+}
+
+
+
+
+
+/* Convolve a 2D image with a separable kernel: first along the fastest
+   dimension (rows), then along the slowest dimension (columns). For a
+   kernel with 'kh' rows and 'kw' columns, the number of operations on
+   each pixel decreases from 'kh*kw' to 'kh+kw'. */
+static void
+convolve_separable(gal_data_t *block, gal_data_t *kernel, gal_data_t *out,
+                   double *col, double *row, size_t numthreads,
+                   int edgecorrection, uint8_t conv_on_blank)
+{
+  struct separable_params sp;
+  char *tmpmmap=NULL, *tmpmmmap=NULL;
+
+  /* Set the parameters. */
+  sp.col=col;
+  sp.row=row;
+  sp.out=out->array;
+  sp.in=block->array;
+  sp.dsize=block->dsize;
+  sp.ksize=kernel->dsize;
+  sp.rowsum=sp.colsum=NULL;
+  sp.conv_on_blank=conv_on_blank;
+  sp.edgecorrection=edgecorrection;
+  sp.hasblank=gal_blank_present(block, 0);
+  sp.tmp=gal_pointer_allocate_ram_or_mmap(GAL_TYPE_FLOAT64, block->size, 0,
+                                          block->minmapsize, &tmpmmap,
+                                          block->quietmmap, __func__,
+                                          "sp.tmp");
+  if(edgecorrection && sp.hasblank)
+    sp.tmpm=gal_pointer_allocate_ram_or_mmap(GAL_TYPE_FLOAT64, block->size,
+                                             0, block->minmapsize,
+                                             &tmpmmmap, block->quietmmap,
+                                             __func__, "sp.tmpm");
+  else
+    {
+      sp.tmpm=NULL;
+      if(edgecorrection)
+        {
+          sp.colsum=convolve_separable_overlap_sum(col, kernel->dsize[0],
+                                                   block->dsize[0]);
+          sp.rowsum=convolve_separable_overlap_sum(row, kernel->dsize[1],
+                                                   block->dsize[1]);
+        }
+    }
+
+  /* Do the two passes. */
+  for(sp.colpass=0; sp.colpass<2; ++sp.colpass)
+    gal_threads_spin_off_schedule(convolve_separable_on_thread, &sp,
+                                  block->dsize[0], numthreads,
+                                  GAL_THREADS_SCHEDULE_BLOCK, 0,
+                                  block->minmapsize, block->quietmmap);
+
+  /* Clean up (see the comments at the end of 'gal_threads_spin_off' for
+     the memory-mapped arrays). */
+  if(tmpmmap) gal_pointer_mmap_free(&tmpmmap, block->quietmmap);
+  else        free(sp.tmp);
+  if(sp.tmpm)
+    {
+      if(tmpmmmap) gal_pointer_mmap_free(&tmpmmmap, block->quietmmap);
+      else         free(sp.tmpm);
+    }
+  if(sp.rowsum) { free(sp.rowsum); free(sp.colsum); }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /*********************************************************************/
 /********************     Spatial convolution     ********************/
 /*********************************************************************/
@@ -122,6 +499,13 @@ struct spatial_params
   int    edgecorrection;     /* Correct convolution's edge effects.       */
   uint8_t conv_on_blank;     /* Do convolution over blank pixels also.    */
   struct per_thread_spatial_prm *pprm; /* Array of per-thread parameters. */
+
+  /* For the interior pixels (where the kernel is fully within the host). */
+  size_t        kcenter;     /* Kernel center to its start (in block).    */
+  size_t        *krowoff;    /* Start of each kernel row (from kernel     */
+                             /* start, in block).                         */
+  size_t         nkrows;     /* Number of rows in kernel ('size/dsize[n]')*/
+  double       kernelsum;    /* Sum of kernel (in order of convolution).  */
 };
 
 
@@ -292,6 +676,177 @@ convolve_spatial_overlap(struct per_thread_spatial_prm *pprm, int tocorrect)
 
 
 
+/* Prepare the parameters that are necessary for convolving the interior
+   pixels (where the kernel is fully within the host). The interior pixels
+   are the vast majority of pixels in an image, so we don't need to find
+   the overlap of the kernel and image for every one of them. All that is
+   necessary is the offset of the start of each "kernel row" (contiguous
+   kernel elements along the fastest dimension) in the block from the
+   first element of the kernel. */
+static void
+convolve_spatial_interior_prepare(struct spatial_params *cprm)
+{
+  gal_data_t *block=cprm->block, *kernel=cprm->kernel;
+  size_t d, r, c, ndim=block->ndim, *k=kernel->dsize;
+  size_t *stride=gal_dimension_increment(ndim, block->dsize);
+  float *kv=kernel->array, *kvf=kv+kernel->size;
+
+  /* The offset of the kernel center (from its first element). */
+  cprm->kcenter=0;
+  for(d=0;d<ndim;++d) cprm->kcenter += k[d]/2 * stride[d];
+
+  /* Offset of each kernel row. */
+  cprm->nkrows=kernel->size/k[ndim-1];
+  cprm->krowoff=gal_pointer_allocate(GAL_TYPE_SIZE_T, cprm->nkrows, 0,
+                                     __func__, "cprm->krowoff");
+  for(r=0;r<cprm->nkrows;++r)
+    {
+      c=r;
+      cprm->krowoff[r]=0;
+      for(d=ndim-1;d>0;--d)
+        {
+          cprm->krowoff[r] += c % k[d-1] * stride[d-1];
+          c /= k[d-1];
+        }
+    }
+
+  /* Sum of the kernel (in the same order that the kernel is parsed in the
+     convolution, so the result is identical). */
+  cprm->kernelsum=0.0;
+  do cprm->kernelsum += *kv; while(++kv<kvf);
+
+  /* Clean up. */
+  free(stride);
+}
+
+
+
+
+
+/* See if there is any blank value under the kernel for the 'num'
+   contiguous pixels that start with 'win' (the first element of the
+   kernel over the first pixel). */
+static int
+convolve_spatial_interior_has_blank(struct spatial_params *cprm, float *win,
+                                    size_t num)
+{
+  float *f, *ff;
+  size_t r, kw=cprm->kernel->dsize[cprm->kernel->ndim-1];
+
+  for(r=0;r<cprm->nkrows;++r)
+    {
+      ff=(f=win+cprm->krowoff[r])+num+kw-1;
+      do if(isnan(*f)) return 1; while(++f<ff);
+    }
+  return 0;
+}
+
+
+
+
+
+/* Convolve 'num' contiguous interior pixels of the input that start at
+   'in'. Unlike the generic (edge) pixels, the pixels are not convolved
+   one by one: the output of a block of pixels is accumulated together, so
+   the innermost loop (over the pixels of the block) can be vectorized
+   while the order of summation for each pixel is the same as the generic
+   case (the result is identical). */
+GAL_SIMD_CLONES
+static void
+convolve_spatial_interior(struct spatial_params *cprm, float *in,
+                          float *out, size_t num)
+{
+  float kv, *krow, *win;
+  size_t b, j, n, r, x, ndim=cprm->kernel->ndim;
+  int hasblank, edgecorr=cprm->edgecorrection;
+  size_t kw=cprm->kernel->dsize[ndim-1];
+  double sum[GAL_SIMD_BLOCK], ksum[GAL_SIMD_BLOCK];
+  float *kernel=cprm->kernel->array;
+  const float *a;
+
+  for(b=0;b<num;b+=GAL_SIMD_BLOCK)
+    {
+      /* Initialize the block. */
+      n = num-b < GAL_SIMD_BLOCK ? num-b : GAL_SIMD_BLOCK;
+      win = in + b - cprm->kcenter;
+      hasblank=convolve_spatial_interior_has_blank(cprm, win, n);
+      for(j=0;j<GAL_SIMD_BLOCK;++j) sum[j]=ksum[j]=0.0;
+
+      /* Parse over the kernel. */
+      for(r=0;r<cprm->nkrows;++r)
+        {
+          krow=kernel+r*kw;
+          for(x=0;x<kw;++x)
+            {
+              kv=krow[x];
+              a=win+cprm->krowoff[r]+x;
+              if(hasblank)
+                {
+                  for(j=0;j<n;++j)
+                    if( !isnan(a[j]) )
+                      {
+                        sum[j] += a[j] * kv;
+                        if(edgecorr) ksum[j] += kv;
+                      }
+                }
+              else if(n==GAL_SIMD_BLOCK)
+                for(j=0;j<GAL_SIMD_BLOCK;++j) sum[j] += a[j] * kv;
+              else
+                for(j=0;j<n;++j)              sum[j] += a[j] * kv;
+            }
+        }
+
+      /* Write the output values. */
+      for(j=0;j<n;++j)
+        {
+          if( isnan(in[b+j]) && cprm->conv_on_blank==0 ) out[b+j]=NAN;
+          else
+            {
+              if(edgecorr==0) ksum[j]=1.0;
+              else if(hasblank==0) ksum[j]=cprm->kernelsum;
+              out[b+j] = ksum[j]==0.0 ? NAN : sum[j]/ksum[j];
+            }
+        }
+    }
+}
+
+
+
+
+
+/* Find the range of pixels in the contiguous patch of 'num' pixels
+   (starting from the coordinates in 'pprm->pix') where the kernel is fully
+   within the host. If there is no such pixel, 'start' and 'end' will be
+   equal. */
+static void
+convolve_spatial_interior_range(struct per_thread_spatial_prm *pprm,
+                                size_t num, size_t *start, size_t *end)
+{
+  size_t d, ndim=pprm->host->ndim;
+  size_t *h=pprm->host->dsize, *k=pprm->cprm->kernel->dsize;
+  size_t p=pprm->pix[ndim-1], f=ndim-1;
+
+  /* Initialize to no interior pixels. */
+  *start=*end=0;
+
+  /* The slower dimensions: if this patch is on the edge, no pixel in it
+     will be interior. */
+  for(d=0;d<f;++d)
+    if( pprm->pix[d] < k[d]/2 || pprm->pix[d] + k[d]/2 >= h[d] )
+      return;
+
+  /* The fastest dimension. */
+  if(h[f] < k[f]) return;
+  *start = p < k[f]/2 ? k[f]/2 - p : 0;
+  *end   = p + k[f]/2 < h[f] ? h[f] - k[f]/2 - p : 0;
+  if(*end > num) *end=num;
+  if(*start > *end) *start=*end;
+}
+
+
+
+
+
 /* Convolve over one tile that is not touching the edge. */
 static void
 convolve_spatial_tile(struct per_thread_spatial_prm *pprm)
@@ -307,7 +862,7 @@ convolve_spatial_tile(struct per_thread_spatial_prm *pprm)
 
   /* Variables for scanning a tile ('i_*') and the region around every
      pixel of a tile ('o_*'). */
-  size_t start_fastdim;
+  size_t start_fastdim, int_start, int_end;
   size_t i_inc, i_ninc, i_st_en[2];
 
   /* These variables depend on the type of the input. */
@@ -350,12 +905,31 @@ convolve_spatial_tile(struct per_thread_spatial_prm *pprm)
          incremented during 'gal_tile_block_increment'). */
       pprm->pix[ndim-1]=start_fastdim;
 
+      /* Find the range of pixels in this contiguous patch where the
+         kernel is fully within the host (they don't need the generic
+         treatment). When correcting an already convolved image, those
+         pixels should be ignored, so we'll just set an empty range. */
+      if(cprm->tocorrect) int_start=int_end=0;
+      else convolve_spatial_interior_range(pprm, csize, &int_start,
+                                           &int_end);
+
       /* Go over each pixel to convolve. */
       for(j=0;j<csize;++j)
         {
           /* Pointer to the pixel under consideration. */
           in_v = i_start + i_inc + j;
 
+          /* This pixel (and the next ones in the interior range) can be
+             convolved without finding the overlap. */
+          if(j==int_start && int_end>int_start)
+            {
+              convolve_spatial_interior(cprm, in_v, out + (in_v - in),
+                                        int_end-int_start);
+              pprm->pix[ndim-1] += int_end-int_start;
+              j=int_end-1;
+              continue;
+            }
+
           /* If the input on this pixel is a NaN, then just set the output
              to NaN too and go onto the next pixel. 'in_v' is the pointer
              on this pixel. */
@@ -491,8 +1065,10 @@ gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
                              int convoverch, uint8_t conv_on_blank,
                              gal_data_t *tocorrect)
 {
+  size_t tsize=0;
+  double *col, *row;
   struct spatial_params params;
-  gal_data_t *out, *block=gal_tile_block(tiles);
+  gal_data_t *tile, *out, *host, *block=gal_tile_block(tiles);
 
 
   /* Small sanity checks. */
@@ -531,6 +1107,26 @@ gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
     }
 
 
+  /* When the kernel is separable, the tiles cover the whole image and it
+     is a single host (the convolution of one channel doesn't need to be
+     independent of the others), it is much faster to do the convolution
+     in two 1D passes. */
+  host = ( convoverch || tiles->block==NULL ) ? block : tiles->block;
+  for(tile=tiles; tile!=NULL; tile=tile->next) tsize+=tile->size;
+  if( tocorrect==NULL
+      && block->ndim==2
+      && tsize==block->size
+      && host->size==block->size
+      && convolve_separable_decompose(kernel, &col, &row) )
+    {
+      convolve_separable(block, kernel, out, col, row, numthreads,
+                         edgecorrection, conv_on_blank);
+      free(col);
+      free(row);
+      return out;
+    }
+
+
   /* Set the pointers in the parameters structure. */
   params.out=out;
   params.tiles=tiles;
@@ -540,6 +1136,8 @@ gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
   params.convoverch=convoverch;
   params.conv_on_blank=conv_on_blank;
   params.edgecorrection=edgecorrection;
+  if(tocorrect) params.krowoff=NULL;
+  else          convolve_spatial_interior_prepare(&params);
 
 
   /* Allocate the per-thread parameters. */
@@ -558,6 +1156,7 @@ gal_convolve_spatial_general(gal_data_t *tiles, gal_data_t *kernel,
 
   /* Clean up and return the output array. */
   free(params.pprm);
+  if(params.krowoff) free(params.krowoff);
   return out;
 }
 
@@ -25,11 +25,13 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <time.h>
 #include <errno.h>
 #include <error.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #include <gsl/gsl_version.h>
 
@@ -40,6 +42,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/fits.h>
 #include <gnuastro/tile.h>
 #include <gnuastro/blank.h>
+#include <gnuastro/dimension.h>
 #include <gnuastro/threads.h>
 #include <gnuastro/pointer.h>
 
@@ -2584,10 +2587,390 @@ gal_fits_img_info_dim(char *filename, char *hdu, size_t *ndim,
 
 
 
-/* Read a FITS image HDU into a Gnuastro data structure. */
+/* Number of elements in each strip when the data unit is read or written
+   directly (see 'fits_img_read_parallel'). */
+#define FITS_IMG_NATIVE_CHUNK 262144
+
+/* Swap the bytes of an unsigned integer (the compiler will use the
+   specialized instruction when available). */
+#define FITS_BSWAP8(x)  (x)
+#define FITS_BSWAP16(x) ((uint16_t)( ((x)>>8) | ((x)<<8) ))
+#define FITS_BSWAP32(x) ( ((x)>>24) | (((x)>>8)&0xff00)                 \
+                          | (((x)<<8)&0xff0000) | ((x)<<24) )
+#define FITS_BSWAP64(x) ( (uint64_t)FITS_BSWAP32((uint32_t)(x))<<32     \
+                          | FITS_BSWAP32((uint32_t)((x)>>32)) )
+
+/* Parameters to convert a raw FITS data unit (that is big-endian, may
+   have FITS's offset for unsigned integers and integer blank values) into
+   the native representation (in place). */
+struct fits_img_native_params
+{
+  size_t           size;  /* Number of elements.                          */
+  size_t          width;  /* Number of bytes in each element.             */
+  int              swap;  /* ==1: bytes have to be swapped.               */
+  uint64_t         flip;  /* Bits to flip (FITS's unsigned integers).     */
+  int          hasblank;  /* ==1: integer data with a 'BLANK' keyword.    */
+  uint64_t     rawblank;  /* Value of 'BLANK' in the raw (file) type.     */
+  uint64_t     galblank;  /* Gnuastro's blank value in the final type.    */
+};
+
+
+
+
+
+#define FITS_IMG_NATIVE_CONVERT(IT, SWAP) {                             \
+    IT *a=(IT *)in, *af=a+num, *o=(IT *)out, v;                         \
+    IT flip=p->flip, rb=p->rawblank, gb=p->galblank;                    \
+    if(p->hasblank)                                                     \
+      do { v = p->swap ? SWAP(*a) : *a; *o++ = v==rb ? gb : v^flip; }   \
+      while(++a<af);                                                    \
+    else if(p->swap)                                                    \
+      do *o++ = SWAP(*a)^flip; while(++a<af);                           \
+    else                                                                \
+      do *o++ = *a^flip; while(++a<af);                                 \
+  }
+
+/* Convert 'num' elements of the raw data unit (in 'in') into the native
+   representation (in 'out'). 'in' and 'out' can be the same. */
+static void
+fits_img_native_convert(struct fits_img_native_params *p, void *in,
+                        void *out, size_t num)
+{
+  switch(p->width)
+    {
+    case 1: FITS_IMG_NATIVE_CONVERT(uint8_t,  FITS_BSWAP8);  break;
+    case 2: FITS_IMG_NATIVE_CONVERT(uint16_t, FITS_BSWAP16); break;
+    case 4: FITS_IMG_NATIVE_CONVERT(uint32_t, FITS_BSWAP32); break;
+    case 8: FITS_IMG_NATIVE_CONVERT(uint64_t, FITS_BSWAP64); break;
+    default:
+      error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to "
+            "fix the problem. The width %zu is not recognized",
+            __func__, PACKAGE_BUGREPORT, p->width);
+    }
+}
+
+
+
+
+
+/* The inverse of 'FITS_IMG_NATIVE_CONVERT' (for writing): like CFITSIO's
+   'fits_write_img', blank values are not treated separately (the 'BLANK'
+   keyword is written in the file's representation). */
+#define FITS_IMG_NATIVE_UNCONVERT(IT, SWAP) {                           \
+    IT *a=(IT *)array, *af=a+num, flip=p->flip;                         \
+    if(p->swap) do *a = SWAP( (IT)(*a^flip) ); while(++a<af);           \
+    else        do *a ^= flip;                 while(++a<af);           \
+  }
+
+static void
+fits_img_native_unconvert(struct fits_img_native_params *p, void *array,
+                          size_t num)
+{
+  switch(p->width)
+    {
+    case 1: FITS_IMG_NATIVE_UNCONVERT(uint8_t,  FITS_BSWAP8);  break;
+    case 2: FITS_IMG_NATIVE_UNCONVERT(uint16_t, FITS_BSWAP16); break;
+    case 4: FITS_IMG_NATIVE_UNCONVERT(uint32_t, FITS_BSWAP32); break;
+    case 8: FITS_IMG_NATIVE_UNCONVERT(uint64_t, FITS_BSWAP64); break;
+    default:
+      error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to "
+            "fix the problem. The width %zu is not recognized",
+            __func__, PACKAGE_BUGREPORT, p->width);
+    }
+}
+
+
+
+
+
+/* See if the data unit of the already opened HDU can be accessed
+   directly in the file (read and written without CFITSIO): the HDU must
+   be an uncompressed image in a plain (not compressed, for example
+   '.gz') file and its values must not need any scaling (other than the
+   FITS standard's offset for unsigned integers). If it can, the necessary
+   conversions are written in 'p' ('p->size' must be set before calling)
+   and the name of the file and offset of the data unit are returned. */
+static char *
+fits_img_native_check(fitsfile *fptr, uint8_t type,
+                      struct fits_img_native_params *p, size_t *offset)
+{
+  ssize_t r;
+  struct stat st;
+  long long blank;
+  double bscale, bzero;
+  uint16_t endian=1;
+  uint8_t rawtype, *gblank;
+  unsigned char start[8];
+  LONGLONG headstart, datastart, dataend;
+  int filedes, bitpix, naxis, status=0;
+  char *filename, realname[FLEN_FILENAME];
+
+  /* The file should be an uncompressed image. */
+  if( fits_is_compressed_image(fptr, &status) ) return NULL;
+  if( fits_get_img_param(fptr, 0, &bitpix, &naxis, NULL, &status) )
+    gal_fits_io_error(status, NULL);
+  rawtype=gal_fits_bitpix_to_type(bitpix);
+
+  /* Read the scaling keywords (if they don't exist, no scaling is
+     necessary). */
+  if( fits_read_key(fptr, TDOUBLE, "BSCALE", &bscale, NULL, &status) )
+    { bscale=1.0f; status=0; }
+  if( fits_read_key(fptr, TDOUBLE, "BZERO", &bzero, NULL, &status) )
+    { bzero=0.0f; status=0; }
+  if( fits_read_key(fptr, TLONGLONG, "BLANK", &blank, NULL, &status) )
+    { p->hasblank=0; status=0; }
+  else p->hasblank = rawtype!=GAL_TYPE_FLOAT32 && rawtype!=GAL_TYPE_FLOAT64;
+
+  /* Only the standard offsets for unsigned (or signed 8-bit) integers
+     can be done in place (see 'fits_type_correct'). */
+  if(bscale!=1.0f) return NULL;
+  if(type==rawtype) { if(bzero!=0.0f) return NULL; p->flip=0; }
+  else
+    switch(type)
+      {
+      case GAL_TYPE_INT8:   p->flip=0x80;                  break;
+      case GAL_TYPE_UINT16: p->flip=0x8000;                break;
+      case GAL_TYPE_UINT32: p->flip=0x80000000;            break;
+      case GAL_TYPE_UINT64: p->flip=0x8000000000000000ULL; break;
+      default:              return NULL;
+      }
+
+  /* The blank values: the raw one is in the type of the file (to compare
+     before flipping), Gnuastro's is in the final type. */
+  p->width=gal_type_sizeof(type);
+  if(p->hasblank)
+    {
+      gblank=gal_blank_alloc_write(type);
+      p->rawblank=blank;
+      switch(p->width)
+        {
+        case 1: p->galblank=*gblank;              break;
+        case 2: p->galblank=*(uint16_t *)gblank;  break;
+        case 4: p->galblank=*(uint32_t *)gblank;  break;
+        case 8: p->galblank=*(uint64_t *)gblank;  break;
+        }
+      free(gblank);
+    }
+
+  /* Bytes only need to be swapped on little-endian hosts (FITS is
+     big-endian). */
+  p->swap = p->width>1 && *(uint8_t *)(&endian)==1;
+
+  /* Location of the data unit and name of the file. */
+  if( fits_get_hduaddrll(fptr, &headstart, &datastart, &dataend, &status)
+      || fits_file_name(fptr, realname, &status) )
+    gal_fits_io_error(status, NULL);
+
+  /* CFITSIO can also open compressed files or other sources (that are
+     decompressed or read into memory): so make sure that the file
+     actually contains this HDU at this position. */
+  filedes=open(realname, O_RDONLY);
+  if(filedes==-1) return NULL;
+  r = ( fstat(filedes, &st)==0
+        && (size_t)st.st_size >= datastart + p->size*p->width
+        ? pread(filedes, start, sizeof start, headstart)
+        : -1 );
+  close(filedes);
+  if( r!=sizeof start
+      || ( strncmp((char *)start, "SIMPLE  ", 8)
+           && strncmp((char *)start, "XTENSION", 8) ) )
+    return NULL;
+
+  /* Return the file name and offset. */
+  *offset=datastart;
+  gal_checkset_allocate_copy(realname, &filename);
+  return filename;
+}
+
+
+
+
+
+/* Parameters for reading or writing an image in strips. */
+struct fits_img_strip_params
+{
+  char                 *filename;  /* Name of the file.                    */
+  char                      *hdu;  /* HDU of the image.                    */
+  char          *hdu_option_name;  /* HDU option name (for error message). */
+  gal_data_t                *img;  /* Dataset to read into or write.       */
+  void                    *blank;  /* Blank value (for CFITSIO's reading). */
+  size_t               stripsize;  /* Number of elements in each strip.    */
+  int                    filedes;  /* File descriptor (==-1: use CFITSIO). */
+  size_t                  offset;  /* Offset of the data unit in the file. */
+  struct fits_img_native_params conv; /* Conversions for direct I/O.       */
+};
+
+
+
+
+
+/* Read (with 'write==0') or write (otherwise) 'nbytes' from/to 'filedes'
+   starting at 'offset'. The system calls may transfer fewer bytes than
+   requested in each call, so they are repeated until all are done. */
+static void
+fits_img_strip_io(struct fits_img_strip_params *p, void *array,
+                  size_t nbytes, size_t offset, int write)
+{
+  ssize_t r;
+  unsigned char *a=array;
+
+  while(nbytes)
+    {
+      errno=0;
+      r = ( write
+            ? pwrite(p->filedes, a, nbytes, offset)
+            : pread(p->filedes, a, nbytes, offset) );
+      if(r<=0)
+        {
+          if(r==-1 && errno==EINTR) continue;
+          error(EXIT_FAILURE, errno, "%s: %s %zu bytes at offset %zu of "
+                "the file", p->filename, write ? "writing" : "reading",
+                nbytes, offset);
+        }
+      a+=r;
+      nbytes-=r;
+      offset+=r;
+    }
+}
+
+
+
+
+
+static void *
+fits_img_read_strip(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct fits_img_strip_params *p
+    = (struct fits_img_strip_params *)tprm->params;
+
+  char *ptr;
+  fitsfile *fptr=NULL;
+  int anynul=0, status=0;
+  size_t i, start, num, width=gal_type_sizeof(p->img->type);
+  int datatype=gal_fits_type_to_datatype(p->img->type);
+
+  /* Without direct access, each thread needs its own CFITSIO pointer. */
+  if(p->filedes==-1)
+    fptr=gal_fits_hdu_open_format(p->filename, p->hdu, 0,
+                                  p->hdu_option_name);
+
+  /* Go over all the strips that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Elements of this strip. */
+      start=tprm->indexs[i]*p->stripsize;
+      num = ( start+p->stripsize > p->img->size
+              ? p->img->size-start : p->stripsize );
+
+      /* Read them. */
+      if(fptr)
+        {
+          if( fits_read_img(fptr, datatype, start+1, num, p->blank,
+                            (char *)(p->img->array)+start*width, &anynul,
+                            &status) )
+            gal_fits_io_error(status, NULL);
+        }
+      else
+        {
+          ptr=(char *)(p->img->array)+start*width;
+          fits_img_strip_io(p, ptr, num*width, p->offset+start*width, 0);
+          fits_img_native_convert(&p->conv, ptr, ptr, num);
+        }
+    }
+
+  /* Clean up. */
+  if(fptr)
+    {
+      fits_close_file(fptr, &status);
+      gal_fits_io_error(status, NULL);
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Read the image in the already opened HDU ('fptr') into the already
+   allocated 'img' with 'numthreads' threads. When the data unit can be
+   accessed directly, the threads read and convert separate strips of it
+   with the operating system's 'pread' (without CFITSIO's single
+   buffer). Otherwise, if CFITSIO is thread-safe, each thread opens its own
+   CFITSIO pointer to the HDU and reads its own strip of rows. If the image
+   can't be read in parallel, this function returns 0 (and nothing is
+   read). */
+static int
+fits_img_read_parallel(fitsfile *fptr, char *filename, char *hdu,
+                       gal_data_t *img, void *blank, size_t numthreads,
+                       char *hdu_option_name)
+{
+  char *realname;
+  size_t rowsize, nrows;
+  struct fits_img_strip_params p;
+
+  /* Basic settings. */
+  if(img->size==0) return 0;
+  memset(&p, 0, sizeof p);
+  p.img=img;
+  p.hdu=hdu;
+  p.blank=blank;
+  p.filedes=-1;
+  p.filename=filename;
+  p.hdu_option_name=hdu_option_name;
+
+  /* See if the data unit can be accessed directly. */
+  p.conv.size=img->size;
+  realname=fits_img_native_check(fptr, img->type, &p.conv, &p.offset);
+  if(realname)
+    {
+      p.filedes=open(realname, O_RDONLY);
+      free(realname);
+    }
+
+  /* Set the size of each strip: with direct access, the strips are small
+     (so all threads finish at a similar time). With CFITSIO, every opened
+     pointer has to read the header (and for compressed images, the full
+     tiles that overlap with each strip), so each thread gets one strip
+     of full rows. */
+  if(p.filedes!=-1)
+    p.stripsize=FITS_IMG_NATIVE_CHUNK;
+  else
+    {
+#if GAL_CONFIG_HAVE_FITS_IS_REENTRANT == 1
+      if( fits_is_reentrant()==0 ) return 0;
+#else
+      return 0;
+#endif
+      rowsize=img->dsize[img->ndim-1];
+      nrows=img->size/rowsize;
+      p.stripsize = (nrows+numthreads-1)/numthreads * rowsize;
+    }
+
+  /* Read the strips. */
+  gal_threads_spin_off(fits_img_read_strip, &p,
+                       (img->size+p.stripsize-1)/p.stripsize, numthreads,
+                       img->minmapsize, img->quietmmap);
+
+  /* Clean up and return. */
+  if(p.filedes!=-1) close(p.filedes);
+  return 1;
+}
+
+
+
+
+
+/* Read a FITS image HDU into a Gnuastro data structure. When
+   'numthreads>1', the image is read in strips, in parallel (see
+   'fits_img_read_parallel'). */
 gal_data_t *
-gal_fits_img_read(char *filename, char *hdu, size_t minmapsize,
-                  int quietmmap, char *hdu_option_name)
+gal_fits_img_read_threads(char *filename, char *hdu, size_t minmapsize,
+                          int quietmmap, size_t numthreads,
+                          char *hdu_option_name)
 {
   void *blank;
   long *fpixel;
@@ -2639,9 +3022,14 @@ gal_fits_img_read(char *filename, char *hdu, size_t minmapsize,
 
 
   /* Read the image into the allocated array: */
-  fits_read_pix(fptr, gal_fits_type_to_datatype(type), fpixel,
-                img->size, blank, img->array, &anyblank, &status);
-  if(status) gal_fits_io_error(status, NULL);
+  if( numthreads<2
+      || fits_img_read_parallel(fptr, filename, hdu, img, blank,
+                                numthreads, hdu_option_name)==0 )
+    {
+      fits_read_pix(fptr, gal_fits_type_to_datatype(type), fpixel,
+                    img->size, blank, img->array, &anyblank, &status);
+      if(status) gal_fits_io_error(status, NULL);
+    }
   free(fpixel);
   free(blank);
 
@@ -2659,6 +3047,18 @@ gal_fits_img_read(char *filename, char *hdu, size_t minmapsize,
 
 
 
+gal_data_t *
+gal_fits_img_read(char *filename, char *hdu, size_t minmapsize,
+                  int quietmmap, char *hdu_option_name)
+{
+  return gal_fits_img_read_threads(filename, hdu, minmapsize, quietmmap,
+                                   1, hdu_option_name);
+}
+
+
+
+
+
 /* The user has specified an input file + extension, and your program needs
    this input to be a special type. For such cases, this function can be
    used to convert the input file to the desired type. */
@@ -2809,12 +3209,111 @@ gal_fits_img_write_to_ptr_keys(fitsfile *fptr, gal_data_t *towrite,
 
 
 
+static void *
+fits_img_write_strip(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct fits_img_strip_params *p
+    = (struct fits_img_strip_params *)tprm->params;
+
+  void *buf;
+  size_t i, start, num, width=p->conv.width;
+
+  /* The values have to be converted before writing, so each thread
+     needs its own buffer. */
+  buf=gal_pointer_allocate(GAL_TYPE_UINT8, p->stripsize*width, 0,
+                           __func__, "buf");
+
+  /* Go over all the strips that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Elements of this strip. */
+      start=tprm->indexs[i]*p->stripsize;
+      num = ( start+p->stripsize > p->img->size
+              ? p->img->size-start : p->stripsize );
+
+      /* Convert them to the file's representation and write them. */
+      memcpy(buf, (char *)(p->img->array)+start*width, num*width);
+      if(p->conv.swap || p->conv.flip)
+        fits_img_native_unconvert(&p->conv, buf, num);
+      fits_img_strip_io(p, buf, num*width, p->offset+start*width, 1);
+    }
+
+  /* Clean up, wait for all the other threads to finish, then return. */
+  free(buf);
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Write the image in 'towrite' into the data unit of the already created
+   (and resized) HDU of 'fptr' with 'numthreads' threads. CFITSIO only
+   writes the last element (so the full data unit is allocated in the
+   file) and its buffers are flushed and cleared. When the data unit can
+   be accessed directly, the threads then convert and write separate
+   strips of it with the operating system's 'pwrite'. If this isn't
+   possible, 0 is returned and the image has to be written with
+   CFITSIO. */
+static int
+fits_img_write_parallel(fitsfile *fptr, gal_data_t *towrite, int datatype,
+                        size_t numthreads)
+{
+  int status=0;
+  char *realname;
+  struct fits_img_strip_params p;
+  size_t width=gal_type_sizeof(towrite->type);
+
+  /* For small images, it isn't worth the overhead. */
+  if(towrite->size<=FITS_IMG_NATIVE_CHUNK) return 0;
+
+  /* Write the last element and flush CFITSIO's buffers into the file
+     (clearing them, so CFITSIO doesn't over-write our strips with its
+     old copy later). */
+  if( fits_write_img(fptr, datatype, towrite->size, 1,
+                     (char *)(towrite->array)+(towrite->size-1)*width,
+                     &status)
+      || fits_flush_buffer(fptr, 1, &status) )
+    gal_fits_io_error(status, NULL);
+
+  /* See if the data unit can be accessed directly. */
+  memset(&p, 0, sizeof p);
+  p.conv.size=towrite->size;
+  realname=fits_img_native_check(fptr, towrite->type, &p.conv, &p.offset);
+  if(realname==NULL) return 0;
+  p.filedes=open(realname, O_WRONLY);
+  if(p.filedes==-1) { free(realname); return 0; }
+
+  /* Write the strips. */
+  p.img=towrite;
+  p.filename=realname;
+  p.stripsize=FITS_IMG_NATIVE_CHUNK;
+  gal_threads_spin_off(fits_img_write_strip, &p,
+                       (towrite->size+p.stripsize-1)/p.stripsize,
+                       numthreads, towrite->minmapsize,
+                       towrite->quietmmap);
+
+  /* Clean up and return. */
+  errno=0;
+  if( close(p.filedes) )
+    error(EXIT_FAILURE, errno, "%s: closing the file", realname);
+  free(realname);
+  return 1;
+}
+
+
+
+
+
 /* This function will write all the data array information (including its
    WCS information) into a FITS file, but will not close it. Instead it
    will pass along the FITS pointer for further modification. */
 fitsfile *
-gal_fits_img_write_to_ptr(gal_data_t *input, char *filename,
-                          gal_fits_list_key_t *keylist, int freekeys)
+gal_fits_img_write_to_ptr_threads(gal_data_t *input, char *filename,
+                                  gal_fits_list_key_t *keylist,
+                                  int freekeys, size_t numthreads)
 {
   int64_t *i64;
   char *u64key;
@@ -2884,18 +3383,13 @@ gal_fits_img_write_to_ptr(gal_data_t *input, char *filename,
                              NULL, 0, block->minmapsize, block->quietmmap,
                              NULL, NULL, NULL);
 
-      /* Copy the values while making the conversion. */
+      /* Copy the values while making the conversion. Note that the
+         blank value ('UINT64_MAX') becomes 'INT64_MAX' with this shift,
+         which is the 'BLANK' keyword's value for this type (see
+         'gal_fits_key_img_blank'). */
       i64=i64data->array;
       u64f=(u64=towrite->array)+towrite->size;
-      if(hasblank)
-        {
-          do *i64++ = ( *u64==GAL_BLANK_UINT64
-                        ? GAL_BLANK_INT64
-                        : (*u64 + INT64_MIN) );
-          while(++u64<u64f);
-        }
-      else
-        do *i64++ = (*u64 + INT64_MIN); while(++u64<u64f);
+      do *i64++ = (*u64 + INT64_MIN); while(++u64<u64f);
 
       /* We can now use CFITSIO's signed-int64 type macros and create the
          image HDU. However, if we have keywords, first, we will create a 1
@@ -2945,10 +3439,14 @@ gal_fits_img_write_to_ptr(gal_data_t *input, char *filename,
       gal_fits_img_write_to_ptr_keys(fptr, towrite, datatype, hasblank,
                                      keylist, freekeys);
 
-      /* Write the image into the file. */
+      /* Write the image into the file (in parallel if requested). */
       if(keylist) fits_resize_img(fptr, bitpix, ndim, naxes, &status);
-      fits_write_img(fptr, datatype, fpixel, towrite->size, towrite->array,
-                     &status);
+      gal_fits_io_error(status, NULL);
+      if( numthreads<2
+          || fits_img_write_parallel(fptr, towrite, datatype,
+                                     numthreads)==0 )
+        fits_write_img(fptr, datatype, fpixel, towrite->size,
+                       towrite->array, &status);
       gal_fits_io_error(status, NULL);
     }
 
@@ -2963,15 +3461,29 @@ gal_fits_img_write_to_ptr(gal_data_t *input, char *filename,
 
 
 
+fitsfile *
+gal_fits_img_write_to_ptr(gal_data_t *input, char *filename,
+                          gal_fits_list_key_t *keylist, int freekeys)
+{
+  return gal_fits_img_write_to_ptr_threads(input, filename, keylist,
+                                           freekeys, 1);
+}
+
+
+
+
+
 void
-gal_fits_img_write(gal_data_t *data, char *filename,
-                   gal_fits_list_key_t *keylist, int freekeys)
+gal_fits_img_write_threads(gal_data_t *data, char *filename,
+                           gal_fits_list_key_t *keylist, int freekeys,
+                           size_t numthreads)
 {
   int status=0;
   fitsfile *fptr=NULL;
 
   /* Write the data array into a FITS file and keep it open: */
-  fptr=gal_fits_img_write_to_ptr(data, filename, keylist, freekeys);
+  fptr=gal_fits_img_write_to_ptr_threads(data, filename, keylist, freekeys,
+                                         numthreads);
 
   /* Close the FITS file. */
   fits_close_file(fptr, &status);
@@ -2982,6 +3494,17 @@ gal_fits_img_write(gal_data_t *data, char *filename,
 
 
 
+void
+gal_fits_img_write(gal_data_t *data, char *filename,
+                   gal_fits_list_key_t *keylist, int freekeys)
+{
+  gal_fits_img_write_threads(data, filename, keylist, freekeys, 1);
+}
+
+
+
+
+
 void
 gal_fits_img_write_to_type(gal_data_t *data, char *filename,
                            gal_fits_list_key_t *headers, int type,
@@ -3596,8 +4119,9 @@ gal_fits_tab_info(char *filename, char *hdu, size_t *numcols,
 static void
 fits_tab_read_ascii_float_special(char *filename, char *hdu,
                                   fitsfile *fptr, gal_data_t *out,
-                                  size_t colnum, size_t numrows,
-                                  size_t minmapsize, int quietmmap)
+                                  size_t colnum, size_t rowstart,
+                                  size_t numrows, size_t minmapsize,
+                                  int quietmmap)
 {
   double tmp;
   char **strarr;
@@ -3622,7 +4146,7 @@ fits_tab_read_ascii_float_special(char *filename, char *hdu,
     }
 
   /* Read the column as a string. */
-  fits_read_col(fptr, TSTRING, colnum, 1, 1, out->size, NULL,
+  fits_read_col(fptr, TSTRING, colnum, rowstart+1, 1, out->size, NULL,
                 strrows->array, &anynul, &status);
   gal_fits_io_error(status, NULL);
 
@@ -3654,6 +4178,7 @@ struct fits_tab_read_onecol_params
 {
   char              *filename;  /* Name of FITS file with table.        */
   char                   *hdu;  /* HDU of input table.                  */
+  size_t             rowstart;  /* First row to read (counting from 0). */
   size_t              numrows;  /* Number of rows in table to read.     */
   size_t              numcols;  /* Number of columns.                   */
   size_t           minmapsize;  /* Minimum space to memory-map.         */
@@ -3785,8 +4310,8 @@ fits_tab_read_onecol(void *in_prm)
                        ? *((char **)blank)
                        : blank);
           fits_read_col(fptr, gal_fits_type_to_datatype(col->type),
-                        indin+1, 1, 1, col->size, blankuse, col->array,
-                        &anynul, &status);
+                        indin+1, p->rowstart+1, 1, col->size, blankuse,
+                        col->array, &anynul, &status);
 
           /* In the ASCII table format some things need to be checked. */
           if( hdutype==ASCII_TBL )
@@ -3798,6 +4323,7 @@ fits_tab_read_onecol(void *in_prm)
                 {
                   fits_tab_read_ascii_float_special(p->filename, p->hdu,
                                                     fptr, col, indin+1,
+                                                    p->rowstart,
                                                     p->numrows,
                                                     p->minmapsize,
                                                     p->quietmmap);
@@ -3832,12 +4358,14 @@ fits_tab_read_onecol(void *in_prm)
 
 
 
-/* Read the column indexs into a dataset. */
+/* Read the column indexs into a dataset. Only 'numrows' rows, starting
+   from row 'rowstart' (counting from zero) are read. */
 gal_data_t *
-gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
-                  gal_data_t *allcols, gal_list_sizet_t *indexll,
-                  size_t numthreads, size_t minmapsize, int quietmmap,
-                  char *hdu_option_name)
+gal_fits_tab_read_rows(char *filename, char *hdu, size_t rowstart,
+                       size_t numrows, gal_data_t *allcols,
+                       gal_list_sizet_t *indexll, size_t numthreads,
+                       size_t minmapsize, int quietmmap,
+                       char *hdu_option_name)
 {
   size_t i;
   gal_data_t *out=NULL;
@@ -3870,6 +4398,7 @@ gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
       p.allcols = allcols;
       p.numrows = numrows;
       p.indexll = indexll;
+      p.rowstart = rowstart;
       p.filename = filename;
       p.quietmmap = quietmmap;
       p.minmapsize = minmapsize;
@@ -3923,6 +4452,21 @@ gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
 
 
 
+gal_data_t *
+gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
+                  gal_data_t *allcols, gal_list_sizet_t *indexll,
+                  size_t numthreads, size_t minmapsize, int quietmmap,
+                  char *hdu_option_name)
+{
+  return gal_fits_tab_read_rows(filename, hdu, 0, numrows, allcols,
+                                indexll, numthreads, minmapsize, quietmmap,
+                                hdu_option_name);
+}
+
+
+
+
+
 /* This function will allocate new copies for all elements to have the same
    length as the maximum length and set all trailing elements to '\0' for
    those that are shorter than the length. The return value is the
@@ -0,0 +1,82 @@
+/*********************************************************************
+Macros for SIMD (vectorized) parts of Gnuastro's library.
+This is part of GNU Astronomy Utilities (Gnuastro) package.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#ifndef __GAL_SIMD_H__
+#define __GAL_SIMD_H__
+
+/* Include other headers if necessary here. Note that other header files
+   must be included before the C++ preparations below */
+
+
+/* This header is only used within Gnuastro's build (it is not installed),
+   so 'config.h' has already been included by the '.c' file. */
+
+
+/* C++ Preparations */
+#undef __BEGIN_C_DECLS
+#undef __END_C_DECLS
+#ifdef __cplusplus
+# define __BEGIN_C_DECLS extern "C" {
+# define __END_C_DECLS }
+#else
+# define __BEGIN_C_DECLS                /* empty */
+# define __END_C_DECLS                  /* empty */
+#endif
+/* End of C++ preparations */
+
+
+
+/* Actual header contants (the above were for the Pre-processor). */
+__BEGIN_C_DECLS  /* From C++ preparations */
+
+
+
+/* Function multi-versioning: when the compiler supports it (checked in
+   'configure.ac'), a function that is defined with this attribute will
+   be compiled for AVX-512, AVX2 and the default (generic) instruction
+   sets. The best version for the running CPU is chosen at run-time. So
+   loops within these functions that the compiler can vectorize will use
+   the widest SIMD registers of the CPU, while the same binary still runs
+   on older CPUs (with the default, scalar or SSE, version).
+
+   To help the compiler vectorize the loops, the innermost loops should
+   not have any branches and their number of iterations should preferably
+   be known at compile time (see 'GAL_SIMD_BLOCK'). */
+#if HAVE_TARGET_CLONES
+#define GAL_SIMD_CLONES \
+  __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define GAL_SIMD_CLONES
+#endif
+
+
+/* Number of elements to process in one "block" of the vectorized loops:
+   it is a multiple of the number of 'double's in the widest SIMD register
+   (AVX-512), but small enough for all the accumulators of a block to
+   remain in the L1 cache. */
+#define GAL_SIMD_BLOCK 64
+
+
+
+__END_C_DECLS    /* From C++ preparations */
+
+#endif           /* __GAL_SIMD_H__ */
@@ -58,6 +58,9 @@ gal_timing_time_based_rng_seed();
 void
 gal_timing_report(struct timeval *t1, char *jobname, size_t level);
 
+double
+gal_timing_rate(struct timeval *t1, size_t nbytes);
+
 
 
 __END_C_DECLS    /* From C++ preparations */
@@ -95,6 +95,12 @@ size_t
 gal_binary_connected_components(gal_data_t *binary, gal_data_t **out,
                                 int connectivity);
 
+size_t
+gal_binary_connected_components_threads(gal_data_t *binary,
+                                        gal_data_t **out,
+                                        int connectivity,
+                                        size_t numthreads);
+
 gal_data_t *
 gal_binary_connected_indexs(gal_data_t *binary, int connectivity);
 
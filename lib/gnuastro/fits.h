@@ -305,6 +305,11 @@ gal_data_t *
 gal_fits_img_read(char *filename, char *hdu, size_t minmapsize,
                   int quietmmap, char *hdu_option_name);
 
+gal_data_t *
+gal_fits_img_read_threads(char *filename, char *hdu, size_t minmapsize,
+                          int quietmmap, size_t numthreads,
+                          char *hdu_option_name);
+
 gal_data_t *
 gal_fits_img_read_to_type(char *inputname, char *hdu, uint8_t type,
                           size_t minmapsize, int quietmmap,
@@ -318,10 +323,20 @@ fitsfile *
 gal_fits_img_write_to_ptr(gal_data_t *data, char *filename,
                           gal_fits_list_key_t *keylist, int freekeys);
 
+fitsfile *
+gal_fits_img_write_to_ptr_threads(gal_data_t *input, char *filename,
+                                  gal_fits_list_key_t *keylist,
+                                  int freekeys, size_t numthreads);
+
 void
 gal_fits_img_write(gal_data_t *data, char *filename,
                    gal_fits_list_key_t *keylist, int freekeys);
 
+void
+gal_fits_img_write_threads(gal_data_t *data, char *filename,
+                           gal_fits_list_key_t *keylist, int freekeys,
+                           size_t numthreads);
+
 void
 gal_fits_img_write_to_type(gal_data_t *data, char *filename,
                            gal_fits_list_key_t *keylist, int type,
@@ -356,6 +371,13 @@ gal_fits_tab_read(char *filename, char *hdu, size_t numrows,
                   size_t numthreads, size_t minmapsize, int quietmmap,
                   char *hdu_option_name);
 
+gal_data_t *
+gal_fits_tab_read_rows(char *filename, char *hdu, size_t rowstart,
+                       size_t numrows, gal_data_t *allcols,
+                       gal_list_sizet_t *indexll, size_t numthreads,
+                       size_t minmapsize, int quietmmap,
+                       char *hdu_option_name);
+
 void
 gal_fits_tab_write(gal_data_t *cols, gal_list_str_t *comments,
                    int tableformat, char *filename, char *extname,
@@ -48,6 +48,11 @@ __BEGIN_C_DECLS  /* From C++ preparations */
 
 
 
+/* Flat (cache-friendly) layout of a k-d tree for the batch queries. */
+typedef struct gal_kdtree_flat_t gal_kdtree_flat_t;
+
+
+
 gal_data_t *
 gal_kdtree_create(gal_data_t *coords_raw, size_t *root);
 
@@ -55,6 +60,23 @@ size_t
 gal_kdtree_nearest_neighbour(gal_data_t *coords_raw, gal_data_t *kdtree,
                              size_t root, double *point, double *least_dist);
 
+gal_kdtree_flat_t *
+gal_kdtree_flat_build(gal_data_t *coords_raw, gal_data_t *kdtree,
+                      size_t root, size_t minmapsize, int quietmmap);
+
+void
+gal_kdtree_flat_free(gal_kdtree_flat_t *flat);
+
+gal_data_t *
+gal_kdtree_nearest_neighbours(gal_kdtree_flat_t *flat, gal_data_t *points,
+                              size_t k, double maxdist, size_t numthreads,
+                              size_t minmapsize, int quietmmap);
+
+gal_data_t *
+gal_kdtree_range(gal_kdtree_flat_t *flat, gal_data_t *points,
+                 double radius, size_t numthreads, size_t minmapsize,
+                 int quietmmap);
+
 
 
 __END_C_DECLS    /* From C++ preparations */
@@ -25,7 +25,8 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 
 /* Include other headers if necessary here. Note that other header files
    must be included before the C++ preparations below */
-
+#include <stddef.h>
+#include <stdint.h>
 
 
 /* C++ Preparations */
@@ -201,6 +202,21 @@ gal_qsort_index_multi_d(const void *a, const void *b);
 int
 gal_qsort_index_multi_i(const void *a, const void *b);
 
+void
+gal_qsort_index_radix(size_t *index, size_t size, void *values,
+                      uint8_t type, int decreasing, size_t numthreads,
+                      size_t minmapsize, int quietmmap);
+
+
+
+
+/*****************************************************************/
+/**********        Selection (partial sorting)    ****************/
+/*****************************************************************/
+void
+gal_qsort_select(void *array, size_t size, uint8_t type, size_t *ranks,
+                 size_t numranks);
+
 
 
 __END_C_DECLS    /* From C++ preparations */
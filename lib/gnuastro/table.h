@@ -156,6 +156,13 @@ gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
                size_t numthreads, size_t minmapsize, int quietmmap,
                size_t *colmatch, char *hdu_option_name);
 
+gal_data_t *
+gal_table_read_rows(char *filename, char *hdu, gal_list_str_t *lines,
+                    gal_list_str_t *cols, int searchin, int ignorecase,
+                    size_t rowstart, size_t numrows, size_t numthreads,
+                    size_t minmapsize, int quietmmap, size_t *colmatch,
+                    char *hdu_option_name);
+
 gal_list_sizet_t *
 gal_table_list_of_indexs(gal_list_str_t *cols, gal_data_t *allcols,
                          size_t numcols, int searchin, int ignorecase,
@@ -175,6 +182,14 @@ gal_table_write(gal_data_t *cols, struct gal_fits_list_key_t *keylist,
                 gal_list_str_t *comments, int tableformat, char *filename,
                 char *extname, uint8_t colinfoinstdout, int freekeys);
 
+void
+gal_table_write_threads(gal_data_t *cols,
+                        struct gal_fits_list_key_t *keylist,
+                        gal_list_str_t *comments, int tableformat,
+                        char *filename, char *extname,
+                        uint8_t colinfoinstdout, int freekeys,
+                        size_t numthreads);
+
 void
 gal_table_write_log(gal_data_t *logll, char *program_string,
                     time_t *rawtime, gal_list_str_t *comments,
@@ -99,6 +99,16 @@ pthread_barrier_destroy(pthread_barrier_t *b);
 /*******************************************************************/
 /************              Thread utilities           **************/
 /*******************************************************************/
+/* How the actions should be distributed between the threads. */
+enum gal_threads_schedule
+{
+  GAL_THREADS_SCHEDULE_INVALID,  /* ==0 by C standard.                   */
+
+  GAL_THREADS_SCHEDULE_CYCLIC,   /* Action 'i' to thread 'i%numthreads'. */
+  GAL_THREADS_SCHEDULE_BLOCK,    /* Contiguous block of actions/thread.  */
+  GAL_THREADS_SCHEDULE_DYNAMIC,  /* Chunks given while threads run.      */
+};
+
 size_t
 gal_threads_number();
 
@@ -107,6 +117,12 @@ gal_threads_dist_in_threads(size_t numactions, size_t numthreads,
                             size_t minmapsize, int quietmmap,
                             size_t **outthrds, size_t *outthrdcols);
 
+char *
+gal_threads_dist_in_threads_schedule(size_t numactions, size_t numthreads,
+                                     int schedule, size_t minmapsize,
+                                     int quietmmap, size_t **outthrds,
+                                     size_t *outthrdcols);
+
 void
 gal_threads_attr_barrier_init(pthread_attr_t *attr, pthread_barrier_t *b,
                               size_t limit);
@@ -130,6 +146,12 @@ gal_threads_spin_off(void *(*worker)(void *), void *caller_params,
                      size_t numactions, size_t numthreads,
                      size_t minmapsize, int quietmmap);
 
+void
+gal_threads_spin_off_schedule(void *(*worker)(void *), void *caller_params,
+                              size_t numactions, size_t numthreads,
+                              int schedule, size_t chunksize,
+                              size_t minmapsize, int quietmmap);
+
 
 __END_C_DECLS    /* From C++ preparations */
 
@@ -285,6 +285,14 @@ gal_wcs_world_to_img(gal_data_t *coords, struct wcsprm *wcs, int inplace);
 gal_data_t *
 gal_wcs_img_to_world(gal_data_t *coords, struct wcsprm *wcs, int inplace);
 
+gal_data_t *
+gal_wcs_world_to_img_threads(gal_data_t *coords, struct wcsprm *wcs,
+                             int inplace, size_t numthreads);
+
+gal_data_t *
+gal_wcs_img_to_world_threads(gal_data_t *coords, struct wcsprm *wcs,
+                             int inplace, size_t numthreads);
+
 
 
 
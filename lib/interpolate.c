@@ -22,6 +22,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 **********************************************************************/
 #include <config.h>
 
+#include <math.h>
 #include <stdio.h>
 #include <errno.h>
 #include <error.h>
@@ -31,6 +32,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/list.h>
 #include <gnuastro/fits.h>
 #include <gnuastro/blank.h>
+#include <gnuastro/kdtree.h>
 #include <gnuastro/pointer.h>
 #include <gnuastro/threads.h>
 #include <gnuastro/dimension.h>
@@ -69,6 +71,10 @@ struct interpolate_ngb_params
   int                        onlyblank;
   gal_list_void_t            *ngb_vals;
   float (*metric)(size_t *, size_t *, size_t );
+  size_t                      *queries;  /* k-d tree: elements to fill. */
+  size_t                       *ngbind;  /* k-d tree: their neighbors.  */
+  size_t                         *band;  /* k-d tree: index of points.  */
+  uint8_t                    *resolved;  /* k-d tree: neighbors final.  */
 
   struct gal_tile_two_layer_params *tl;
 };
@@ -77,6 +83,78 @@ struct interpolate_ngb_params
 
 
 
+/* Put the space that is allocated for the neighbor values of this thread
+   into a list of datasets (one for each input) for easy processing. */
+static gal_data_t *
+interpolate_neighbors_nearest(struct interpolate_ngb_params *prm,
+                              size_t id)
+{
+  void *nv;
+  gal_list_void_t *tvll;
+  gal_data_t *tin=prm->input, *nearest=NULL;
+
+  for(tvll=prm->ngb_vals; tvll!=NULL; tvll=tvll->next)
+    {
+      nv=gal_pointer_increment(tvll->v, id*prm->numneighbors, tin->type);
+      gal_list_data_add_alloc(&nearest, nv, tin->type, 1,
+                              &prm->numneighbors, NULL, 0, -1, 1,
+                              NULL, NULL, NULL);
+      tin=tin->next;
+    }
+  gal_list_data_reverse(&nearest);
+  return nearest;
+}
+
+
+
+
+
+/* Calculate the desired statistic from the values of the neighbors, and
+   write it in element 'fullind' of the output(s). */
+static void
+interpolate_neighbors_write(struct interpolate_ngb_params *prm,
+                            gal_data_t *nearest, size_t fullind)
+{
+  gal_data_t *tnear, *tout=prm->out, *value=NULL;
+
+  for(tnear=nearest; tnear!=NULL; tnear=tnear->next)
+    {
+      /* Find the desired statistic and copy it, but first, reset the
+         flags (which remain from the last time). */
+      tnear->flag &= ~(GAL_DATA_FLAG_SORT_CH | GAL_DATA_FLAG_BLANK_CH);
+      switch(prm->function)
+        {
+        case GAL_INTERPOLATE_NEIGHBORS_FUNC_MIN:
+          value=gal_statistics_minimum(tnear); break;
+          break;
+        case GAL_INTERPOLATE_NEIGHBORS_FUNC_MAX:
+          value=gal_statistics_maximum(tnear); break;
+          break;
+        case GAL_INTERPOLATE_NEIGHBORS_FUNC_MEAN:
+          value=gal_statistics_mean(tnear); /* Out can be a diff. type */
+          value=gal_data_copy_to_new_type_free(value, tnear->type);
+          break;
+        case GAL_INTERPOLATE_NEIGHBORS_FUNC_MEDIAN:
+          value=gal_statistics_median(tnear, 1); break;
+        default:
+          error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s "
+                "to fix the problem. The value %d is not a recognized "
+                "interpolation function identifier", __func__,
+                PACKAGE_BUGREPORT, prm->function);
+        }
+      memcpy(gal_pointer_increment(tout->array, fullind, tout->type),
+             value->array, gal_type_sizeof(tout->type));
+
+      /* Clean up and go to next array. */
+      gal_data_free(value);
+      tout=tout->next;
+    }
+}
+
+
+
+
+
 /* Run the interpolation on many threads. */
 static void *
 interpolate_neighbors_on_thread(void *in_prm)
@@ -92,14 +170,12 @@ interpolate_neighbors_on_thread(void *in_prm)
   gal_data_t *input=prm->input;
 
   /* Rest of variables. */
-  void *nv;
   float dist, pdist;
   uint8_t *b, *bf, *bb;
-  gal_list_void_t *tvll;
   size_t ngb_counter, pind;
   gal_list_dosizet_t *lQ, *sQ;
   size_t i, index, fullind, chstart=0, ndim=input->ndim;
-  gal_data_t *tin, *tout, *tnear, *value=NULL, *nearest=NULL;
+  gal_data_t *tin, *tout, *tnear, *nearest;
   size_t size = (correct_index ? tl->tottilesinch : input->size);
   size_t *dsize = (correct_index ? tl->numtilesinch : input->dsize);
   size_t *icoord=gal_pointer_allocate(GAL_TYPE_SIZE_T, ndim, 0, __func__,
@@ -126,17 +202,7 @@ interpolate_neighbors_on_thread(void *in_prm)
 
   /* Put the allocated space to keep the neighbor values into a structure
      for easy processing. */
-  tin=input;
-  for(tvll=prm->ngb_vals; tvll!=NULL; tvll=tvll->next)
-    {
-      nv=gal_pointer_increment(tvll->v, tprm->id*prm->numneighbors,
-                               input->type);
-      gal_list_data_add_alloc(&nearest, nv, tin->type, 1,
-                              &prm->numneighbors, NULL, 0, -1, 1,
-                              NULL, NULL, NULL);
-      tin=tin->next;
-    }
-  gal_list_data_reverse(&nearest);
+  nearest=interpolate_neighbors_nearest(prm, tprm->id);
 
 
   /* Go over all the points given to this thread. */
@@ -270,39 +336,7 @@ interpolate_neighbors_on_thread(void *in_prm)
         }
 
       /* Calculate the desired statistic, and write it in the output. */
-      tout=prm->out;
-      for(tnear=nearest; tnear!=NULL; tnear=tnear->next)
-        {
-          /* Find the desired statistic and copy it, but first, reset the
-             flags (which remain from the last time). */
-          tnear->flag &= ~(GAL_DATA_FLAG_SORT_CH | GAL_DATA_FLAG_BLANK_CH);
-          switch(prm->function)
-            {
-            case GAL_INTERPOLATE_NEIGHBORS_FUNC_MIN:
-              value=gal_statistics_minimum(tnear); break;
-              break;
-            case GAL_INTERPOLATE_NEIGHBORS_FUNC_MAX:
-              value=gal_statistics_maximum(tnear); break;
-              break;
-            case GAL_INTERPOLATE_NEIGHBORS_FUNC_MEAN:
-              value=gal_statistics_mean(tnear); /* Out can be a diff. type */
-              value=gal_data_copy_to_new_type_free(value, tnear->type);
-              break;
-            case GAL_INTERPOLATE_NEIGHBORS_FUNC_MEDIAN:
-              value=gal_statistics_median(tnear, 1); break;
-            default:
-              error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s "
-                    "to fix the problem. The value %d is not a recognized "
-                    "interpolation function identifier", __func__,
-                    PACKAGE_BUGREPORT, prm->function);
-            }
-          memcpy(gal_pointer_increment(tout->array, fullind, tout->type),
-                 value->array, gal_type_sizeof(tout->type));
-
-          /* Clean up and go to next array. */
-          gal_data_free(value);
-          tout=tout->next;
-        }
+      interpolate_neighbors_write(prm, nearest, fullind);
     }
 
 
@@ -323,6 +357,303 @@ interpolate_neighbors_on_thread(void *in_prm)
 
 
 
+/* Worker function for the k-d tree based interpolation: the neighbors of
+   each element ('prm->queries') have already been found, so only their
+   values need to be used. */
+static void *
+interpolate_neighbors_kdtree_on_thread(void *in_prm)
+{
+  /* Low-level variables that others depend on. */
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct interpolate_ngb_params *prm=
+    (struct interpolate_ngb_params *)(tprm->params);
+
+  /* Rest of variables. */
+  size_t i, j, q, *ngb;
+  gal_data_t *tin, *tnear, *nearest;
+  size_t k=prm->numneighbors;
+
+  /* Put the allocated space to keep the neighbor values into a structure
+     for easy processing. */
+  nearest=interpolate_neighbors_nearest(prm, tprm->id);
+
+  /* Go over all the elements given to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      /* If this element's neighbors aren't certain yet, ignore it. */
+      q=tprm->indexs[i];
+      if(prm->resolved[q]==0) continue;
+
+      /* Copy the values of the neighbors. */
+      ngb=prm->ngbind+q*k;
+      tin=prm->input;
+      for(tnear=nearest; tnear!=NULL; tnear=tnear->next)
+        {
+          for(j=0;j<k;++j)
+            memcpy(gal_pointer_increment(tnear->array, j, tin->type),
+                   gal_pointer_increment(tin->array, prm->band[ngb[j]],
+                                         tin->type),
+                   gal_type_sizeof(tin->type));
+          tin=tin->next;
+        }
+
+      /* Calculate the desired statistic, and write it in the output. */
+      interpolate_neighbors_write(prm, nearest, prm->queries[q]);
+    }
+
+  /* Clean up, wait for all the other threads to finish and return. */
+  for(tnear=nearest; tnear!=NULL; tnear=tnear->next) tnear->array=NULL;
+  gal_list_data_free(nearest);
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Set all the elements within a distance of 't' (along every dimension)
+   of a flagged element in 'mask' (a box-shaped dilation). Each dimension
+   is dilated separately using the cumulative number of flagged elements
+   along each line (in 'cnt', which has one element more than the longest
+   dimension), so it is independent of 't'. */
+static void
+interpolate_neighbors_kdtree_dilate(uint8_t *mask, size_t ndim,
+                                    size_t *dsize, size_t t, size_t *cnt)
+{
+  uint8_t *m;
+  size_t d, i, o, in, lo, hi, len, stride;
+  size_t size=gal_dimension_total_size(ndim, dsize);
+
+  for(d=0;d<ndim;++d)
+    {
+      /* Length of the lines on this dimension and the distance between
+         their elements in memory. */
+      len=dsize[d];
+      for(stride=1, i=d+1; i<ndim; ++i) stride*=dsize[i];
+
+      /* Go over all the lines. */
+      for(o=0; o<size; o+=len*stride)
+        for(in=0; in<stride; ++in)
+          {
+            m=mask+o+in;
+            cnt[0]=0;
+            for(i=0;i<len;++i) cnt[i+1] = cnt[i] + (m[i*stride]!=0);
+            for(i=0;i<len;++i)
+              {
+                lo = i>t ? i-t : 0;
+                hi = i+t+1<len ? i+t+1 : len;
+                m[i*stride] = cnt[hi]>cnt[lo];
+              }
+          }
+    }
+}
+
+
+
+
+
+/* Put the coordinates of the given elements (in one channel) into a list
+   of 64-bit floating point datasets (one for each dimension), for the k-d
+   tree. */
+static gal_data_t *
+interpolate_neighbors_kdtree_coords(size_t *index, size_t num,
+                                    size_t chstart, size_t ndim,
+                                    size_t *dsize, size_t *coord,
+                                    size_t minmapsize, int quietmmap)
+{
+  size_t d, i;
+  double **c;
+  gal_data_t *tmp, *out=NULL;
+
+  /* Allocate the datasets. */
+  for(d=0;d<ndim;++d)
+    gal_list_data_add_alloc(&out, NULL, GAL_TYPE_FLOAT64, 1, &num, NULL,
+                            0, minmapsize, quietmmap, NULL, NULL, NULL);
+
+  /* Pointers to the arrays of each dimension. */
+  errno=0;
+  c=malloc(ndim*sizeof *c);
+  if(c==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for 'c'",
+          __func__, ndim*sizeof *c);
+  for(d=0, tmp=out; tmp!=NULL; ++d, tmp=tmp->next) c[d]=tmp->array;
+
+  /* Write the coordinates. */
+  for(i=0;i<num;++i)
+    {
+      gal_dimension_index_to_coord(index[i]-chstart, ndim, dsize, coord);
+      for(d=0;d<ndim;++d) c[d][i]=coord[d];
+    }
+
+  /* Clean up and return. */
+  free(c);
+  return out;
+}
+
+
+
+
+
+/* Interpolate with the radial metric, using a k-d tree of the non-blank
+   elements. For each element to fill, the 'numneighbors' nearest
+   non-blank elements are found in logarithmic time (independent of the
+   size of the blank regions, unlike the search in
+   'interpolate_neighbors_on_thread'), and the only memory that is
+   necessary for each thread is the space for the neighbor values.
+
+   To keep the k-d tree small (the inputs can be large images with few
+   blank elements), it is only built from the non-blank elements that are
+   within a distance of 't' (along every dimension) from the elements to
+   fill. Any element outside of this box is farther than 't', so the
+   neighbors of elements whose farthest neighbor is at most 't' away are
+   final. The remaining elements are deep in large blank regions: their
+   true neighbors are not farther than the neighbors found in the box, so
+   they are all final in the next round, where 't' is the distance of the
+   farthest of them. */
+static void
+interpolate_neighbors_kdtree(struct interpolate_ngb_params *prm,
+                             size_t numthreads)
+{
+  /* Basic definitions. */
+  gal_data_t *input=prm->input;
+  struct gal_tile_two_layer_params *tl=prm->tl;
+  int correct_index=(tl && tl->totchannels>1 && !tl->workoverch);
+
+  /* Rest of variables. */
+  int allinbox;
+  double dmax, *dist;
+  uint8_t *mask, *blank=prm->blanks->array;
+  gal_kdtree_flat_t *flat;
+  gal_data_t *coords, *points, *kdtree, *nn;
+  size_t c, d, i, j, nq, nb, t, t0, box, root, chstart, maxlen=0;
+  size_t ndim=input->ndim, k=prm->numneighbors, *cnt, *coord;
+  size_t nch = correct_index ? tl->totchannels : 1;
+  size_t size = correct_index ? tl->tottilesinch : input->size;
+  size_t *dsize = correct_index ? tl->numtilesinch : input->dsize;
+
+  /* Allocate the necessary arrays. */
+  for(d=0;d<ndim;++d) if(dsize[d]>maxlen) maxlen=dsize[d];
+  cnt=gal_pointer_allocate(GAL_TYPE_SIZE_T, maxlen+1, 0, __func__, "cnt");
+  coord=gal_pointer_allocate(GAL_TYPE_SIZE_T, ndim, 0, __func__, "coord");
+  mask=gal_pointer_allocate(GAL_TYPE_UINT8, size, 0, __func__, "mask");
+  prm->queries=gal_pointer_allocate(GAL_TYPE_SIZE_T, size, 0, __func__,
+                                    "prm->queries");
+  prm->resolved=gal_pointer_allocate(GAL_TYPE_UINT8, size, 0, __func__,
+                                     "prm->resolved");
+
+  /* The initial distance: the box should have a few times more elements
+     than the number of neighbors. */
+  for(t0=1;;++t0)
+    {
+      for(box=1, d=0; d<ndim; ++d) box*=2*t0+1;
+      if(box>=2*k) break;
+    }
+
+  /* Interpolate over each channel separately (when necessary). */
+  for(c=0;c<nch;++c)
+    {
+      /* The elements to fill in this channel. */
+      nq=0;
+      chstart=c*size;
+      for(i=chstart; i<chstart+size; ++i)
+        if(blank[i] || !prm->onlyblank) prm->queries[nq++]=i;
+
+      /* Find the neighbors in larger boxes until all are final. */
+      for(t=t0; nq; )
+        {
+          /* Flag the non-blank elements within the box around the
+             elements to fill (when the box covers the whole channel,
+             all non-blank elements are used). */
+          allinbox = t+1>=maxlen;
+          if(allinbox) memset(mask, 1, size);
+          else
+            {
+              memset(mask, 0, size);
+              for(i=0;i<nq;++i) mask[prm->queries[i]-chstart]=1;
+              interpolate_neighbors_kdtree_dilate(mask, ndim, dsize, t,
+                                                  cnt);
+            }
+          for(nb=i=0;i<size;++i)
+            if(mask[i] && blank[chstart+i]==0) ++nb;
+
+          /* If there aren't enough non-blank elements, go to a larger box
+             (if possible). */
+          if(nb<k)
+            {
+              if(allinbox)
+                error(EXIT_FAILURE, 0, "%s: only %zu neighbors found "
+                      "while you had asked to use %zu neighbors for close "
+                      "neighbor interpolation", __func__, nb, k);
+              t*=2;
+              continue;
+            }
+
+          /* Index of the non-blank elements in the box. */
+          prm->band=gal_pointer_allocate(GAL_TYPE_SIZE_T, nb, 0, __func__,
+                                         "prm->band");
+          for(nb=i=0;i<size;++i)
+            if(mask[i] && blank[chstart+i]==0) prm->band[nb++]=chstart+i;
+
+          /* Build the k-d tree and find the nearest neighbors. */
+          coords=interpolate_neighbors_kdtree_coords(prm->band, nb, chstart,
+                                                     ndim, dsize, coord,
+                                                     input->minmapsize,
+                                                     input->quietmmap);
+          points=interpolate_neighbors_kdtree_coords(prm->queries, nq,
+                                                     chstart, ndim, dsize,
+                                                     coord,
+                                                     input->minmapsize,
+                                                     input->quietmmap);
+          kdtree=gal_kdtree_create(coords, &root);
+          flat=gal_kdtree_flat_build(coords, kdtree, root,
+                                     input->minmapsize, input->quietmmap);
+          nn=gal_kdtree_nearest_neighbours(flat, points, k, NAN, numthreads,
+                                           input->minmapsize,
+                                           input->quietmmap);
+
+          /* The neighbors are final if the farthest one is within the
+             box. Otherwise, the next box should contain it. */
+          dmax=0.0f;
+          dist=nn->next->array;
+          for(i=0;i<nq;++i)
+            if( !(prm->resolved[i] = allinbox || dist[i*k+k-1]<=t) )
+              dmax = dist[i*k+k-1]>dmax ? dist[i*k+k-1] : dmax;
+          t=ceil(dmax);
+
+          /* Fill the elements whose neighbors are final. */
+          prm->ngbind=nn->array;
+          gal_threads_spin_off(interpolate_neighbors_kdtree_on_thread, prm,
+                               nq, numthreads, input->minmapsize,
+                               input->quietmmap);
+
+          /* Only keep the elements that should be checked again. */
+          for(j=i=0;i<nq;++i)
+            if(prm->resolved[i]==0) prm->queries[j++]=prm->queries[i];
+          nq=j;
+
+          /* Clean up. */
+          free(prm->band);
+          gal_list_data_free(nn);
+          gal_kdtree_flat_free(flat);
+          gal_list_data_free(kdtree);
+          gal_list_data_free(coords);
+          gal_list_data_free(points);
+        }
+    }
+
+  /* Clean up. */
+  free(cnt);
+  free(mask);
+  free(coord);
+  free(prm->queries);
+  free(prm->resolved);
+}
+
+
+
+
+
 /* When no interpolation is needed, then we can just copy the input into
    the output. */
 static gal_data_t *
@@ -464,17 +795,32 @@ gal_interpolate_neighbors(gal_data_t *input,
   gal_list_void_reverse(&prm.ngb_vals);
 
 
-  /* Allocate space for all the flag values of all the threads here (memory
-     in each thread is limited) and this is cleaner. */
-  prm.thread_flags=gal_pointer_allocate(GAL_TYPE_UINT8,
-                                        numthreads*input->size, 0, __func__,
-                                        "prm.thread_flags");
-
-
-  /* Spin-off the threads. */
-  gal_threads_spin_off(interpolate_neighbors_on_thread, &prm,
-                       input->size, numthreads, input->minmapsize,
-                       input->quietmmap);
+  /* With the radial metric, the neighbors are found with a k-d tree. In
+     this case, the elements that are not interpolated should be copied
+     into the output(s) here. */
+  if(metric==GAL_INTERPOLATE_NEIGHBORS_METRIC_RADIAL)
+    {
+      prm.thread_flags=NULL;
+      if(onlyblank)
+        for(tin=input, tout=prm.out; tout!=NULL;
+            tin=tin->next, tout=tout->next)
+          memcpy(tout->array, tin->array,
+                 tin->size*gal_type_sizeof(tin->type));
+      interpolate_neighbors_kdtree(&prm, numthreads);
+    }
+  else
+    {
+      /* Allocate space for all the flag values of all the threads here
+         (memory in each thread is limited) and this is cleaner. */
+      prm.thread_flags=gal_pointer_allocate(GAL_TYPE_UINT8,
+                                            numthreads*input->size, 0,
+                                            __func__, "prm.thread_flags");
+
+      /* Spin-off the threads. */
+      gal_threads_spin_off(interpolate_neighbors_on_thread, &prm,
+                           input->size, numthreads, input->minmapsize,
+                           input->quietmmap);
+    }
 
 
   /* If the values were permuted for the interpolation, then re-order the
@@ -27,12 +27,16 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <stdlib.h>
 #include <errno.h>
 #include <error.h>
+#include <math.h>
 #include <float.h>
+#include <string.h>
 
 #include <gnuastro/data.h>
 #include <gnuastro/table.h>
 #include <gnuastro/blank.h>
 #include <gnuastro/pointer.h>
+#include <gnuastro/threads.h>
+#include <gnuastro/kdtree.h>
 #include <gnuastro/permutation.h>
 
 
@@ -286,45 +290,42 @@ kdtree_cleanup(struct kdtree_params *p, gal_data_t *coords_raw)
 /****************************************************************
  ********                Create KD-Tree                   *******
  ****************************************************************/
-/* Divide the array into two parts, values more than that of k'th node
-   and values less than k'th node.
-
-   Return: Index of the node whose value is greater than all
-           the nodes before it.
+/* Divide the array into three parts: nodes with a value less than that of
+   the k'th node, nodes with the same value and nodes with a larger
+   value. Keeping the equal values together is important when many points
+   have the same coordinate (for example pixels of an image): otherwise
+   each round of the quickselect would only remove one of them.
+
+   Return: the first and last node with the same value as the k'th node
+           (in 'lt' and 'gt').
 */
-static size_t
+static void
 kdtree_make_partition(struct kdtree_params *p, size_t node_left,
                       size_t node_right, size_t node_k,
-                      double *coordinate)
-{
-  /* store_index is the index before which all values are smaller than
-     the value of k'th node. */
-  size_t i, store_index;
-  double k_node_value = coordinate[p->input_row[node_k]];
-
-  /* Move the k'th node to the right. */
-  kdtree_node_swap(p, node_k, node_right);
-
-  /* Move all nodes smaller than k'th node to its left and check
-     the number of elements smaller than the value present at the
-     k'th index. */
-  store_index = node_left;
-  for(i = node_left; i < node_right; ++i)
-    if(coordinate[p->input_row[i]] < k_node_value)
-      {
-        /* Move i'th node to the left side of the k'th index. */
-        kdtree_node_swap(p, store_index, i);
-
-        /* Prepare the place of next smaller node. */
-        store_index++;
-      }
-
-  /* Place k'th node after all the nodes that have lesser value
-     than it, as it was moved to the right initially. */
-  kdtree_node_swap(p, node_right, store_index);
-
-  /* Return the store_index. */
-  return store_index;
+                      double *coordinate, size_t *lt, size_t *gt)
+{
+  /* Nodes before 'l' are smaller than the value of the k'th node, nodes
+     after 'g' are larger and nodes from 'l' to 'i' are equal. */
+  size_t i, l=node_left, g=node_right;
+  double v, k_node_value = coordinate[p->input_row[node_k]];
+
+  /* Parse the nodes. */
+  i=node_left;
+  while(i<=g)
+    {
+      v=coordinate[p->input_row[i]];
+      if(v<k_node_value)      kdtree_node_swap(p, l++, i++);
+      else if(v>k_node_value)
+        {
+          kdtree_node_swap(p, i, g);
+          if(g==0) break; else --g;
+        }
+      else ++i;
+    }
+
+  /* Return the range of equal nodes. */
+  *lt=l;
+  *gt=g;
 }
 
 
@@ -345,7 +346,7 @@ static size_t
 kdtree_median_find(struct kdtree_params *p, size_t node_left,
                    size_t node_right, double *coordinate)
 {
-  size_t node_pivot, node_median;
+  size_t lt, gt, node_median;
 
   /* False state, this is a programming error. */
   if(node_right < node_left)
@@ -366,18 +367,18 @@ kdtree_median_find(struct kdtree_params *p, size_t node_left,
   /* Loop until the median of the current axis is returned. */
   while(1)
     {
-      /* Pivot node acts as a reference for the distance from the desired
-        (here median) node. */
-      node_pivot = kdtree_make_partition(p, node_left, node_right,
-                                         node_median, coordinate);
-      /* If median is found, break the loop and return median node. */
-      if(node_median == node_pivot) break;
-
-      /* Change the left or right node based on the position of
-         the pivot node with respect to the required median node. */
-      if(node_median < node_pivot)  node_right = node_pivot - 1;
-      else                          node_left  = node_pivot + 1;
+      /* Partition the nodes around the value of the median node. */
+      kdtree_make_partition(p, node_left, node_right, node_median,
+                            coordinate, &lt, &gt);
+
+      /* If the median node is within the nodes that have the same value,
+         it has been found, otherwise, change the left or right node based
+         on the position of the equal nodes. */
+      if(node_median < lt)       node_right = lt - 1;
+      else if(node_median > gt)  node_left  = gt + 1;
+      else break;
     }
+
   /* Return the median node. */
   return node_median;
 }
@@ -496,63 +497,202 @@ gal_kdtree_create(gal_data_t *coords_raw, size_t *root)
 /****************************************************************
  ********          Nearest-Neighbour Search               *******
  ****************************************************************/
-/* This is a helper function which finds the nearest neighbour of
-   the given point in a kdtree. It calculates the least distance
-   from the point, and the index of that nearest node (out_nn).
+/* The searches don't use recursion: the nodes that remain to be checked
+   are kept in an array-based stack. Each element keeps the node, its
+   depth and the smallest possible squared distance of the point to any
+   node in that subtree (from the splitting hyperplane of its parent). */
+struct kdtree_stack_item
+{
+  uint32_t   node;       /* Index of the node.                          */
+  size_t    depth;       /* Depth of the node in the tree.              */
+  double    bound;       /* Minimum squared distance to subtree.        */
+};
+
+struct kdtree_stack
+{
+  struct kdtree_stack_item *items; /* The array of stack items.         */
+  size_t                      num; /* Number of items in the stack.     */
+  size_t                     size; /* Allocated number of items.        */
+};
+
+/* Results of one query. For the k-nearest neighbours, this is a max-heap
+   (with the furthest of the current 'k' neighbours on the top). For the
+   range search, it is a growing array of all points within the range. */
+struct kdtree_node_dist
+{
+  double     dist;       /* Squared distance of the found node.         */
+  size_t    index;       /* Index of the found node.                    */
+};
+
+struct kdtree_found
+{
+  struct kdtree_node_dist *nd; /* Found nodes and their distances.      */
+  size_t                  num; /* Number of found nodes.                */
+  size_t                 size; /* Allocated number of elements.         */
+};
+
+
+
+
 
-   See `https://en.wikipedia.org/wiki/K-d_tree#Nearest_neighbour_search`
-   for more information.
-*/
 static void
-kdtree_nearest_neighbour(struct kdtree_params *p, uint32_t node_current,
-                         double *point, double *least_dist,
-                         size_t *out_nn, size_t depth)
+kdtree_stack_push(struct kdtree_stack *s, uint32_t node, size_t depth,
+                  double bound)
 {
-  double d, dx, dx2;
-  size_t axis=depth % p->ndim;    /* Set the working axis. */
-  double *coordinates=p->coords[axis]->array;
+  /* Non-existant subtrees are not put on the stack. */
+  if(node==GAL_BLANK_UINT32) return;
+
+  /* Allocate more space if necessary (the stack will not become much
+     larger than twice the tree's depth). */
+  if(s->num==s->size)
+    {
+      s->size = s->size ? 2*s->size : 128;
+      errno=0;
+      s->items=realloc(s->items, s->size*sizeof *s->items);
+      if(s->items==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+              "the stack", __func__, s->size*sizeof *s->items);
+    }
+
+  /* Put the item on top of the stack. */
+  s->items[s->num].node=node;
+  s->items[s->num].depth=depth;
+  s->items[s->num].bound=bound;
+  ++s->num;
+}
+
 
-  /* If no subtree present, don't search further. */
-  if(node_current==GAL_BLANK_UINT32) return;
 
-  /* The distance between search point to the current node. */
-  d = kdtree_distance_find(p, node_current, point);
 
-  /* Distance between the splitting coordinate of the search
-     point and current node. */
-  dx = coordinates[node_current]-point[axis];
 
-  /* Check if the current node is nearer than the previous
-     nearest node. */
-  if(d < *least_dist)
+/* Push the two children of a node, such that the child on the same side
+   of the splitting hyperplane as the point will be checked first. The
+   other child can only have points that are further than the distance of
+   the point to the hyperplane. */
+static void
+kdtree_stack_push_children(struct kdtree_params *p, struct kdtree_stack *s,
+                           uint32_t node, size_t depth, double *point)
+{
+  size_t axis=depth % p->ndim;
+  double dx=((double *)(p->coords[axis]->array))[node]-point[axis];
+
+  kdtree_stack_push(s, dx>0 ? p->right[node] : p->left[node],  depth+1,
+                    dx*dx);
+  kdtree_stack_push(s, dx>0 ? p->left[node]  : p->right[node], depth+1, 0);
+}
+
+
+
+
+
+/* Nodes are ordered by distance, and nodes at the same distance by their
+   index. */
+#define KDTREE_FOUND_GREATER(A,B)                                       \
+  ( (A).dist > (B).dist || ( (A).dist==(B).dist && (A).index > (B).index ) )
+
+/* Add a node to the max-heap of the 'k' nearest neighbours found so far:
+   if the heap is not full, it is added, otherwise it replaces the top
+   (furthest) node. */
+static void
+kdtree_found_heap_add(struct kdtree_found *f, size_t k, size_t node,
+                      double d)
+{
+  size_t i, c;
+  struct kdtree_node_dist t, *nd=f->nd;
+
+  /* Put the new node at the bottom of the heap (when there is space), or
+     on the top, then restore the heap order. */
+  if(f->num<k)
+    {
+      i=f->num++;
+      nd[i].dist=d;
+      nd[i].index=node;
+      while(i && KDTREE_FOUND_GREATER(nd[i], nd[(i-1)/2]))
+        {
+          c=(i-1)/2;
+          t=nd[c]; nd[c]=nd[i]; nd[i]=t;
+          i=c;
+        }
+    }
+  else
     {
-      *least_dist = d;
-      *out_nn = node_current;
+      i=0;
+      nd[0].dist=d;
+      nd[0].index=node;
+      while( (c=2*i+1) < f->num )
+        {
+          if(c+1<f->num && KDTREE_FOUND_GREATER(nd[c+1], nd[c])) ++c;
+          if( !KDTREE_FOUND_GREATER(nd[c], nd[i]) ) break;
+          t=nd[c]; nd[c]=nd[i]; nd[i]=t;
+          i=c;
+        }
     }
+}
+
+
+
+
+
+/* Find the (at most) 'k' nearest neighbours of 'point' that are closer
+   than 'maxdist2' (a squared distance). They are written into 'f' as a
+   max-heap (use 'kdtree_found_sort' to sort them by distance).
+
+   With 'k==1', the nodes are visited in the same order (and the same
+   branches are rejected) as the classical recursive nearest neighbour
+   search: the children on the same side of the point are put on top of
+   the stack, so their full subtree is checked before the other child is
+   popped.
 
-  /* If exact match found (least distance 0), return it. */
-  if(*least_dist==0.0f) return;
-
-  /* Recursively search in subtrees. */
-  kdtree_nearest_neighbour(p, dx > 0
-                              ? p->left[node_current]
-                              : p->right[node_current],
-                           point, least_dist, out_nn, depth+1);
-
-  /* Since the hyperplanes are all axis-aligned, to check if there is a
-     node in other branch which is nearer to the current node is done by a
-     simple comparison to see whether the distance between the splitting
-     coordinate (median node) of the search point and current node is
-     lesser (i.e on same side of hyperplane) than the distance (overall
-     coordinates) from the search point to the current nearest. */
-  dx2 = dx*dx;
-  if(dx2 >= *least_dist) return;
-
-  /* Recursively search other subtrees. */
-  kdtree_nearest_neighbour(p, dx > 0
-                              ? p->right[node_current]
-                              : p->left[node_current],
-                           point, least_dist, out_nn, depth+1);
+   See 'https://en.wikipedia.org/wiki/K-d_tree#Nearest_neighbour_search'
+   for more information. */
+static void
+kdtree_nearest_k(struct kdtree_params *p, struct kdtree_stack *s,
+                 struct kdtree_found *f, size_t root, double *point,
+                 size_t k, double maxdist2)
+{
+  double d, worst=maxdist2;
+  struct kdtree_stack_item it;
+
+  /* Initialize the stack with the root. */
+  f->num=0;
+  s->num=0;
+  kdtree_stack_push(s, root, 0, 0);
+
+  /* Check the nodes until the stack is empty. */
+  while(s->num)
+    {
+      /* Pop the top item, and ignore it if all its nodes are further than
+         the current 'k'-th neighbour. */
+      it=s->items[--s->num];
+      if(it.bound >= worst) continue;
+
+      /* The distance between search point to the current node. If it is
+         nearer than the furthest of the current neighbours, keep it. */
+      d = kdtree_distance_find(p, it.node, point);
+      if(d < worst)
+        {
+          kdtree_found_heap_add(f, k, it.node, d);
+          if(f->num==k) worst=f->nd[0].dist;
+        }
+
+      /* Search in its subtrees. */
+      kdtree_stack_push_children(p, s, it.node, it.depth, point);
+    }
+}
+
+
+
+
+
+/* Sort the found nodes by their distance. Nodes with the same distance
+   are sorted by their index to have a reproducible output. */
+static int
+kdtree_found_compare(const void *a, const void *b)
+{
+  const struct kdtree_node_dist *A=a, *B=b;
+  return ( A->dist < B->dist ? -1
+           : ( A->dist > B->dist ? 1
+               : (A->index > B->index) - (A->index < B->index) ) );
 }
 
 
@@ -570,28 +710,743 @@ gal_kdtree_nearest_neighbour(gal_data_t *coords_raw, gal_data_t *kdtree,
                              size_t root, double *point,
                              double *least_dist)
 {
+  size_t index;
   struct kdtree_params p={0};
-  size_t out_nn=GAL_BLANK_SIZE_T;
+  struct kdtree_node_dist nd;
+  struct kdtree_stack s={NULL, 0, 0};
+  struct kdtree_found f={&nd, 0, 1};
 
   /* Initialisation. */
   p.left_col=kdtree;
-  *least_dist=DBL_MAX;
   kdtree_prepare(&p, coords_raw);
 
   /* Use the low-level function to find th nearest neighbour. */
-  kdtree_nearest_neighbour(&p, root, point, least_dist, &out_nn, 0);
+  kdtree_nearest_k(&p, &s, &f, root, point, 1, DBL_MAX);
 
   /* least_dist is the square of the distance between the nearest
      neighbour and the point (used to improve processing).
      Square root of that is the actual distance. */
-  *least_dist = sqrt(*least_dist);
+  if(f.num) { index=nd.index;         *least_dist=sqrt(nd.dist); }
+  else      { index=GAL_BLANK_SIZE_T; *least_dist=sqrt(DBL_MAX); }
 
   /* For a check
   printf("%s: root=%zu, out_nn=%zu, least_dis=%f\n",
-         __func__, root, out_nn, least_dist);
+         __func__, root, index, *least_dist);
   */
 
   /* Clean up and return. */
+  free(s.items);
   kdtree_cleanup(&p, coords_raw);
-  return out_nn;
+  return index;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/****************************************************************
+ ********            Cache-friendly tree layout           *******
+ ****************************************************************/
+/* Maximum number of points in a leaf bucket of the flat tree. */
+#define KDTREE_BUCKET_SIZE 16
+
+/* In the k-d tree of 'gal_kdtree_create', every node is a point and its
+   children are found through the 'left' and 'right' columns (which are in
+   the input's row order). Therefore each step down the tree touches the
+   two columns and all the coordinate columns at unrelated places in
+   memory. For the batch queries, the tree is converted into the "flat"
+   layout below (in linear time, so trees that are read from a file can
+   also be used):
+
+   - The nodes are stored in depth-first (pre-order) order. Therefore the
+     left child of a node is usually the next node in memory and the nodes
+     of each subtree are contiguous.
+
+   - The coordinates are copied into the same order as the nodes, with
+     one contiguous array for each dimension (structure of arrays). So
+     the coordinates of the points in each subtree are also contiguous
+     along each dimension.
+
+   - Subtrees with 'KDTREE_BUCKET_SIZE' or fewer points are not divided
+     any further: they become a "leaf bucket" whose points are checked
+     together (with vectorized distance calculation).
+
+   The flat layout only depends on the tree and the coordinates, so it is
+   built once (with 'gal_kdtree_flat_build') and given to the batch
+   queries. The queries don't modify it, so any number of them can use it
+   (also in parallel). */
+struct kdtree_flat_node
+{
+  double       split;    /* Coordinate of node along its splitting axis.*/
+  uint32_t      left;    /* Left child node (or 'GAL_BLANK_UINT32').    */
+  uint32_t     right;    /* Right child node (or 'GAL_BLANK_UINT32').   */
+  size_t       start;    /* First point of this node (in tree order).   */
+  uint32_t       num;    /* Number of points in node (more in buckets). */
+  uint8_t       axis;    /* Splitting axis (only for internal nodes).   */
+};
+
+struct gal_kdtree_flat_t
+{
+  size_t                    ndim; /* Number of dimensions.              */
+  size_t               numpoints; /* Number of points.                  */
+  struct kdtree_flat_node *nodes; /* The nodes in depth-first order.    */
+  size_t                numnodes; /* Number of nodes.                   */
+  double                 *coords; /* Coordinates (one array per dim.).  */
+  size_t                    *row; /* Input row of each point.           */
+  gal_data_t               *ccol; /* Dataset containing 'coords'.       */
+  gal_data_t               *rcol; /* Dataset containing 'row'.          */
+};
+
+
+
+
+
+/* Find the number of points in the subtree of every node. */
+static size_t
+kdtree_flat_size(struct kdtree_params *p, uint32_t node, uint32_t *size)
+{
+  if(node==GAL_BLANK_UINT32) return 0;
+  return size[node] = ( 1 + kdtree_flat_size(p, p->left[node], size)
+                          + kdtree_flat_size(p, p->right[node], size) );
+}
+
+
+
+
+
+/* Number of flat nodes that will be necessary for a subtree. */
+static size_t
+kdtree_flat_count(struct kdtree_params *p, uint32_t node, uint32_t *size)
+{
+  if(node==GAL_BLANK_UINT32) return 0;
+  if(size[node]<=KDTREE_BUCKET_SIZE) return 1;
+  return ( 1 + kdtree_flat_count(p, p->left[node], size)
+             + kdtree_flat_count(p, p->right[node], size) );
+}
+
+
+
+
+
+/* Copy the point of a node into the tree-ordered arrays (at '*pos'). When
+   'subtree!=0', also copy all the points in its subtree (in pre-order). */
+static void
+kdtree_flat_points(struct kdtree_params *p, gal_kdtree_flat_t *f,
+                   uint32_t node, size_t *pos, int subtree)
+{
+  size_t d;
+
+  if(node==GAL_BLANK_UINT32) return;
+  for(d=0;d<f->ndim;++d)
+    f->coords[d*f->numpoints+*pos]=((double *)(p->coords[d]->array))[node];
+  f->row[(*pos)++]=node;
+  if(subtree)
+    {
+      kdtree_flat_points(p, f, p->left[node],  pos, 1);
+      kdtree_flat_points(p, f, p->right[node], pos, 1);
+    }
+}
+
+
+
+
+
+/* Make the flat node of the given (original) node and its subtree and
+   return its index in the flat array of nodes. */
+static uint32_t
+kdtree_flat_fill(struct kdtree_params *p, gal_kdtree_flat_t *f,
+                 uint32_t node, size_t depth, uint32_t *size, size_t *pos)
+{
+  uint32_t n;
+  struct kdtree_flat_node *fn;
+
+  /* If there is no subtree, return a blank index. */
+  if(node==GAL_BLANK_UINT32) return GAL_BLANK_UINT32;
+
+  /* Set the basic properties of this node. Note that the 'nodes' array
+     may not be used as a pointer across the recursive calls below
+     (since its elements are set there), so 'fn' is re-set after them. */
+  n=f->numnodes++;
+  fn=&f->nodes[n];
+  fn->start=*pos;
+  fn->axis=depth % p->ndim;
+  fn->split=((double *)(p->coords[fn->axis]->array))[node];
+
+  /* Small subtrees become a leaf bucket. */
+  if(size[node]<=KDTREE_BUCKET_SIZE)
+    {
+      fn->num=size[node];
+      fn->left=fn->right=GAL_BLANK_UINT32;
+      kdtree_flat_points(p, f, node, pos, 1);
+    }
+
+  /* Larger subtrees: only keep this node's point and fill the
+     children. */
+  else
+    {
+      fn->num=1;
+      kdtree_flat_points(p, f, node, pos, 0);
+      f->nodes[n].left =kdtree_flat_fill(p, f, p->left[node],  depth+1,
+                                         size, pos);
+      f->nodes[n].right=kdtree_flat_fill(p, f, p->right[node], depth+1,
+                                         size, pos);
+    }
+
+  /* Return the index of this node. */
+  return n;
+}
+
+
+
+
+
+/* Convert the k-d tree into the flat layout (see above) for the batch
+   queries. */
+gal_kdtree_flat_t *
+gal_kdtree_flat_build(gal_data_t *coords_raw, gal_data_t *kdtree,
+                      size_t root, size_t minmapsize, int quietmmap)
+{
+  uint32_t *size;
+  gal_kdtree_flat_t *f;
+  struct kdtree_params p={0};
+  size_t n, pos=0, dsize[2];
+
+  /* If there is no tree (the coordinates were empty), return NULL. */
+  if(kdtree==NULL) return NULL;
+
+  /* Prepare the k-d tree. */
+  p.left_col=kdtree;
+  kdtree_prepare(&p, coords_raw);
+  n=coords_raw->size;
+  dsize[0]=p.ndim;
+  dsize[1]=n;
+
+  /* Find the size of every subtree and the number of flat nodes. */
+  size=gal_pointer_allocate(GAL_TYPE_UINT32, n, 0, __func__, "size");
+  kdtree_flat_size(&p, root, size);
+
+  /* Allocate the flat tree. */
+  errno=0;
+  f=malloc(sizeof *f);
+  if(f==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for 'f'",
+          __func__, sizeof *f);
+  f->ndim=p.ndim;
+  f->numpoints=n;
+  f->numnodes=kdtree_flat_count(&p, root, size);
+  errno=0;
+  f->nodes=malloc(f->numnodes*sizeof *f->nodes);
+  if(f->nodes==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'f->nodes'", __func__, f->numnodes*sizeof *f->nodes);
+  f->ccol=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 2, dsize, NULL, 0,
+                         minmapsize, quietmmap, NULL, NULL, NULL);
+  f->rcol=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &n, NULL, 0,
+                         minmapsize, quietmmap, NULL, NULL, NULL);
+  f->row=f->rcol->array;
+  f->coords=f->ccol->array;
+
+  /* Fill the nodes (starting from the root) and clean up. */
+  f->numnodes=0;
+  kdtree_flat_fill(&p, f, root, 0, size, &pos);
+  kdtree_cleanup(&p, coords_raw);
+  free(size);
+  return f;
+}
+
+
+
+
+
+void
+gal_kdtree_flat_free(gal_kdtree_flat_t *f)
+{
+  if(f==NULL) return;
+  free(f->nodes);
+  gal_data_free(f->ccol);
+  gal_data_free(f->rcol);
+  free(f);
+}
+
+
+
+
+
+/* Squared distance of 'num' contiguous points (in tree order) from
+   'point'. The coordinates of the points are contiguous along each
+   dimension and the loops have no branches, so they are vectorized by
+   the compiler. The dimensions are added in the same order as
+   'kdtree_distance_find', so the distances are identical. This function
+   is deliberately not defined with 'GAL_SIMD_CLONES': the AVX2 and
+   AVX-512 versions would fuse the multiplication and addition (FMA), so
+   the distances (and thus the selected neighbours) would depend on the
+   running CPU. */
+static void
+kdtree_flat_distances(gal_kdtree_flat_t *f, size_t start, size_t num,
+                      double *point, double *dist)
+{
+  size_t i, d;
+  double t, pd, *c;
+
+  for(i=0;i<num;++i) dist[i]=0.0;
+  for(d=0;d<f->ndim;++d)
+    {
+      pd=point[d];
+      c=f->coords+d*f->numpoints+start;
+      for(i=0;i<num;++i) { t=c[i]-pd; dist[i] += t*t; }
+    }
+}
+
+
+
+
+
+/* Push the children of a flat node on the stack (see
+   'kdtree_stack_push_children'). */
+static void
+kdtree_flat_push_children(struct kdtree_flat_node *fn,
+                          struct kdtree_stack *s, double *point)
+{
+  double dx=fn->split-point[fn->axis];
+
+  kdtree_stack_push(s, dx>0 ? fn->right : fn->left,  0, dx*dx);
+  kdtree_stack_push(s, dx>0 ? fn->left  : fn->right, 0, 0);
+}
+
+
+
+
+
+/* Find the (at most) 'k' nearest neighbours of 'point' in the flat tree
+   that are closer than 'maxdist2' (a squared distance). Neighbours at the
+   same distance are selected by their (input) index, so the output
+   doesn't depend on the order that the nodes are checked. */
+static void
+kdtree_flat_nearest_k(gal_kdtree_flat_t *f, struct kdtree_stack *s,
+                      struct kdtree_found *found, double *point, size_t k,
+                      double maxdist2)
+{
+  size_t i, row;
+  struct kdtree_stack_item it;
+  struct kdtree_flat_node *fn;
+  double dist[KDTREE_BUCKET_SIZE];
+
+  /* Initialize the stack with the root. */
+  s->num=0;
+  found->num=0;
+  if(f->numnodes) kdtree_stack_push(s, 0, 0, 0);
+
+  /* Check the nodes until the stack is empty. */
+  while(s->num)
+    {
+      /* Ignore subtrees that can't have a nearer point than the current
+         'k' neighbours (or the maximum distance). */
+      it=s->items[--s->num];
+      if( found->num==k
+          ? it.bound > found->nd[0].dist
+          : it.bound >= maxdist2 )
+        continue;
+
+      /* Check all the points of this node. */
+      fn=&f->nodes[it.node];
+      kdtree_flat_distances(f, fn->start, fn->num, point, dist);
+      for(i=0;i<fn->num;++i)
+        {
+          row=f->row[fn->start+i];
+          if( found->num==k
+              ? ( dist[i] < found->nd[0].dist
+                  || ( dist[i]==found->nd[0].dist
+                       && row < found->nd[0].index ) )
+              : dist[i] < maxdist2 )
+            kdtree_found_heap_add(found, k, row, dist[i]);
+        }
+
+      /* Search in its subtrees. */
+      kdtree_flat_push_children(fn, s, point);
+    }
+}
+
+
+
+
+
+/* Find all the points within the squared distance of 'radius2'
+   (inclusive) of 'point' in the flat tree. */
+static void
+kdtree_flat_range(gal_kdtree_flat_t *f, struct kdtree_stack *s,
+                  struct kdtree_found *found, double *point,
+                  double radius2)
+{
+  size_t i;
+  struct kdtree_stack_item it;
+  struct kdtree_flat_node *fn;
+  double dist[KDTREE_BUCKET_SIZE];
+
+  /* Initialize the stack with the root. */
+  s->num=0;
+  found->num=0;
+  if(f->numnodes) kdtree_stack_push(s, 0, 0, 0);
+
+  /* Check the nodes until the stack is empty. */
+  while(s->num)
+    {
+      /* Ignore subtrees that are completely out of the range. */
+      it=s->items[--s->num];
+      if(it.bound > radius2) continue;
+
+      /* Keep the points of this node that are in the range. */
+      fn=&f->nodes[it.node];
+      kdtree_flat_distances(f, fn->start, fn->num, point, dist);
+      for(i=0;i<fn->num;++i)
+        if(dist[i] <= radius2)
+          {
+            if(found->num==found->size)
+              {
+                found->size = found->size ? 2*found->size : 64;
+                errno=0;
+                found->nd=realloc(found->nd,
+                                  found->size*sizeof *found->nd);
+                if(found->nd==NULL)
+                  error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu "
+                        "bytes for the found nodes", __func__,
+                        found->size*sizeof *found->nd);
+              }
+            found->nd[found->num].dist=dist[i];
+            found->nd[found->num].index=f->row[fn->start+i];
+            ++found->num;
+          }
+
+      /* Search in its subtrees. */
+      kdtree_flat_push_children(fn, s, point);
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/****************************************************************
+ ********              Batch of query points              *******
+ ****************************************************************/
+/* Number of query points in each action of the threads. */
+#define KDTREE_BATCH_SIZE 1024
+
+/* Parameters for the batch queries. */
+struct kdtree_batch_params
+{
+  gal_kdtree_flat_t     *f;   /* Flat k-d tree.                         */
+  double          **points;   /* Coordinates of the query points.       */
+  size_t         numpoints;   /* Number of query points.                */
+  size_t                 k;   /* Number of nearest neighbours.          */
+  double             dist2;   /* Squared maximum (or range) distance.   */
+  int              isrange;   /* Fixed-radius (range) search.           */
+  size_t            *index;   /* Nearest: index of the neighbours.      */
+  double             *dist;   /* Nearest: distance of the neighbours.   */
+  size_t           *offset;   /* Range: offset of each point's nodes.   */
+  struct kdtree_found *bfound; /* Range: found nodes of each batch.     */
+};
+
+
+
+
+
+/* Query all the points in the batches that are given to this thread. */
+static void *
+kdtree_batch_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct kdtree_batch_params *bp=tprm->params;
+  gal_kdtree_flat_t *fl=bp->f;
+
+  double *point;
+  struct kdtree_found f={0}, *bf;
+  struct kdtree_stack s={NULL, 0, 0};
+  size_t i, j, a, b, pt, start, end, k=bp->k;
+
+  /* Allocate the space for the point and the heap of neighbours. */
+  point=gal_pointer_allocate(GAL_TYPE_FLOAT64, fl->ndim, 0, __func__,
+                             "point");
+  if(bp->isrange==0)
+    {
+      f.size=k;
+      errno=0;
+      f.nd=malloc(k*sizeof *f.nd);
+      if(f.nd==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+              "'f.nd'", __func__, k*sizeof *f.nd);
+    }
+
+  /* Go over all the batches that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      b=tprm->indexs[i];
+      bf=bp->isrange ? &bp->bfound[b] : NULL;
+      start=b*KDTREE_BATCH_SIZE;
+      end = start+KDTREE_BATCH_SIZE < bp->numpoints
+            ? start+KDTREE_BATCH_SIZE : bp->numpoints;
+      for(pt=start; pt<end; ++pt)
+        {
+          /* Fill the point, if any of its coordinates is blank, it will
+             not have any neighbour. */
+          f.num=0;
+          for(j=0;j<fl->ndim;++j)
+            if( isnan( point[j]=bp->points[j][pt] ) ) break;
+
+          /* Do the search and sort the found nodes by distance. */
+          if(j==fl->ndim)
+            {
+              if(bp->isrange)
+                kdtree_flat_range(fl, &s, &f, point, bp->dist2);
+              else
+                kdtree_flat_nearest_k(fl, &s, &f, point, k, bp->dist2);
+              qsort(f.nd, f.num, sizeof *f.nd, kdtree_found_compare);
+            }
+
+          /* Write the results. */
+          if(bp->isrange)
+            {
+              /* Keep the number of found nodes and add them to the nodes
+                 of this batch. */
+              bp->offset[pt+1]=f.num;
+              if(bf->num+f.num > bf->size)
+                {
+                  bf->size = bf->num+f.num > 2*bf->size
+                             ? bf->num+f.num : 2*bf->size;
+                  errno=0;
+                  bf->nd=realloc(bf->nd, bf->size*sizeof *bf->nd);
+                  if(bf->nd==NULL)
+                    error(EXIT_FAILURE, errno, "%s: couldn't allocate "
+                          "%zu bytes for the found nodes", __func__,
+                          bf->size*sizeof *bf->nd);
+                }
+              memcpy(bf->nd+bf->num, f.nd, f.num*sizeof *f.nd);
+              bf->num+=f.num;
+            }
+          else
+            for(a=0;a<k;++a)
+              if(a<f.num)
+                {
+                  bp->index[pt*k+a]=f.nd[a].index;
+                  bp->dist[pt*k+a]=sqrt(f.nd[a].dist);
+                }
+              else
+                {
+                  bp->index[pt*k+a]=GAL_BLANK_SIZE_T;
+                  bp->dist[pt*k+a]=NAN;
+                }
+        }
+    }
+
+  /* Clean up. */
+  free(point);
+  free(f.nd);
+  free(s.items);
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Prepare the k-d tree and the query points, and spin-off the threads. */
+static void
+kdtree_batch(struct kdtree_batch_params *bp, gal_kdtree_flat_t *f,
+             gal_data_t *points, size_t numthreads, size_t minmapsize,
+             int quietmmap)
+{
+  size_t i;
+  gal_data_t *tmp, **conv;
+
+  /* Sanity checks. */
+  if(gal_list_data_number(points)!=f->ndim)
+    error(EXIT_FAILURE, 0, "%s: the number of query point columns (%zu) "
+          "and the k-d tree coordinate columns (%zu) must be the same",
+          __func__, gal_list_data_number(points), f->ndim);
+  for(tmp=points->next; tmp!=NULL; tmp=tmp->next)
+    if(tmp->size!=points->size)
+      error(EXIT_FAILURE, 0, "%s: all the query point columns must have "
+            "the same number of elements", __func__);
+
+  /* Direct pointers to the query point coordinates (in double
+     precision). */
+  bp->f=f;
+  bp->numpoints=points->size;
+  errno=0;
+  bp->points=malloc(f->ndim*sizeof *bp->points);
+  conv=calloc(f->ndim, sizeof *conv);
+  if(bp->points==NULL || conv==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'bp->points' and 'conv'", __func__,
+          f->ndim*(sizeof *bp->points + sizeof *conv));
+  for(i=0, tmp=points; tmp!=NULL; ++i, tmp=tmp->next)
+    bp->points[i] = ( tmp->type==GAL_TYPE_FLOAT64
+                      ? tmp->array
+                      : ( conv[i]=gal_data_copy_to_new_type(tmp,
+                                                   GAL_TYPE_FLOAT64) )->array );
+
+  /* Do the queries in batches of points. */
+  gal_threads_spin_off(kdtree_batch_worker, bp,
+                       (bp->numpoints + KDTREE_BATCH_SIZE - 1)
+                       / KDTREE_BATCH_SIZE, numthreads, minmapsize,
+                       quietmmap);
+
+  /* Clean up. */
+  for(i=0;i<f->ndim;++i) gal_data_free(conv[i]);
+  free(bp->points);
+  free(conv);
+}
+
+
+
+
+
+/* Find the 'k' nearest neighbours of all the query points (within
+   'maxdist'). */
+gal_data_t *
+gal_kdtree_nearest_neighbours(gal_kdtree_flat_t *flat, gal_data_t *points,
+                              size_t k, double maxdist, size_t numthreads,
+                              size_t minmapsize, int quietmmap)
+{
+  gal_data_t *index, *dist;
+  struct kdtree_batch_params bp={0};
+  size_t dsize[2]={points->size, k};
+
+  /* Sanity check. */
+  if(k==0)
+    error(EXIT_FAILURE, 0, "%s: the number of neighbours ('k') cannot be "
+          "zero", __func__);
+
+  /* Allocate the outputs (one row for each query point). */
+  index=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, k==1 ? 1 : 2, dsize, NULL,
+                       0, minmapsize, quietmmap, "INDEX", "counter",
+                       "Index of the nearest neighbours.");
+  dist=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, k==1 ? 1 : 2, dsize, NULL,
+                      0, minmapsize, quietmmap, "DISTANCE", NULL,
+                      "Distance to the nearest neighbours.");
+  index->next=dist;
+
+  /* If there is no tree (the coordinates were empty), no point has a
+     neighbour. */
+  if(flat==NULL)
+    {
+      gal_blank_initialize(index);
+      gal_blank_initialize(dist);
+      return index;
+    }
+  if(points->size==0) return index;
+
+  /* Do the search. */
+  bp.k=k;
+  bp.index=index->array;
+  bp.dist=dist->array;
+  bp.dist2 = isnan(maxdist) ? DBL_MAX : maxdist*maxdist;
+  kdtree_batch(&bp, flat, points, numthreads, minmapsize, quietmmap);
+
+  /* Return the output. */
+  return index;
+}
+
+
+
+
+
+/* Find all the nodes within 'radius' of all the query points. */
+gal_data_t *
+gal_kdtree_range(gal_kdtree_flat_t *flat, gal_data_t *points,
+                 double radius, size_t numthreads, size_t minmapsize,
+                 int quietmmap)
+{
+  size_t b, i, numbatch, total=0, *o, *index;
+  gal_data_t *out, *offset;
+  double *dist;
+  struct kdtree_batch_params bp={0};
+  size_t numoffset=points->size+1;
+
+  /* Allocate the offset of each point's neighbours: the neighbours of
+     point 'i' will be in the range 'offset[i]' to 'offset[i+1]'. */
+  offset=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &numoffset, NULL, 1,
+                        minmapsize, quietmmap, "OFFSET", "counter",
+                        "Offset of the neighbours of each point.");
+
+  /* Find the neighbours of each batch (if there is no tree, the
+     coordinates were empty and no point has a neighbour). */
+  if(points->size && flat)
+    {
+      numbatch=(points->size + KDTREE_BATCH_SIZE - 1) / KDTREE_BATCH_SIZE;
+      errno=0;
+      bp.bfound=calloc(numbatch, sizeof *bp.bfound);
+      if(bp.bfound==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+              "'bp.bfound'", __func__, numbatch*sizeof *bp.bfound);
+      bp.k=1;
+      bp.isrange=1;
+      bp.offset=offset->array;
+      bp.dist2=radius*radius;
+      kdtree_batch(&bp, flat, points, numthreads, minmapsize,
+                   quietmmap);
+
+      /* Convert the number of neighbours of each point into offsets. */
+      o=offset->array;
+      for(i=1;i<numoffset;++i) o[i]+=o[i-1];
+      total=o[points->size];
+    }
+  else numbatch=0;
+
+  /* Allocate the outputs and put the neighbours of each batch in them
+     (the batches are in the same order as the points). */
+  out=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &total, NULL, 0,
+                     minmapsize, quietmmap, "INDEX", "counter",
+                     "Index of the neighbours in range.");
+  out->next=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &total, NULL, 0,
+                           minmapsize, quietmmap, "DISTANCE", NULL,
+                           "Distance to the neighbours in range.");
+  out->next->next=offset;
+  index=out->array;
+  dist=out->next->array;
+  for(b=0;b<numbatch;++b)
+    {
+      for(i=0;i<bp.bfound[b].num;++i)
+        {
+          *index++ = bp.bfound[b].nd[i].index;
+          *dist++  = sqrt(bp.bfound[b].nd[i].dist);
+        }
+      free(bp.bfound[b].nd);
+    }
+
+  /* Clean up and return. */
+  free(bp.bfound);
+  return out;
 }
@@ -29,16 +29,12 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <float.h>
 #include <stdlib.h>
 
-#include <gsl/gsl_sort.h>
-
 #include <gnuastro/box.h>
 #include <gnuastro/list.h>
+#include <gnuastro/qsort.h>
 #include <gnuastro/blank.h>
-#include <gnuastro/binary.h>
 #include <gnuastro/kdtree.h>
 #include <gnuastro/pointer.h>
-#include <gnuastro/threads.h>
-#include <gnuastro/statistics.h>
 #include <gnuastro/permutation.h>
 
 
@@ -617,8 +613,9 @@ match_sort_based_prepare_sort(gal_data_t *coords, size_t minmapsize)
   size_t *permutation=gal_pointer_allocate(GAL_TYPE_SIZE_T, coords->size,
                                            0, __func__, "permutation");
 
-  /* Unfortunately 'gsl_sort_index' doesn't account for NaN elements. So we
-     need to set them to the maximum possible floating point value. */
+  /* NaN elements can't be compared with any other value in the matching,
+     so set them to the maximum possible floating point value (they will
+     also be sorted to the end). */
   if( gal_blank_present(coords, 1) )
     {
       darr=coords->array;
@@ -628,7 +625,9 @@ match_sort_based_prepare_sort(gal_data_t *coords, size_t minmapsize)
 
   /* Get the permutation necessary to sort all the columns (based on the
      first column). */
-  gsl_sort_index(permutation, coords->array, 1, coords->size);
+  for(i=0;i<coords->size;++i) permutation[i]=i;
+  gal_qsort_index_radix(permutation, coords->size, coords->array,
+                        coords->type, 0, 1, minmapsize, 1);
 
   /* For a check.
   if(coords->size>1)
@@ -987,151 +986,12 @@ struct match_kdtree_params
   double              *a[3];  /* Direct pointers to column arrays.    */
   double              *b[3];  /* Direct pointers to column arrays.    */
   struct match_sfll  **bina;  /* Second cat. items in first.          */
-  gal_data_t        *Aexist;  /* If any element of A exists in bins.  */
-  double         *Abinwidth;  /* Width of bins along each dimension.  */
-  double              *Amin;  /* Minimum value of A along each dim.   */
-  double              *Amax;  /* Maximum value of A along each dim.   */
 };
 
 
 
 
 
-/* Find the "coverage" of A along each dimension to help in rejecting
-   non-matches without even calling the k-d tree function.
-
-   The 'MATCH_KDTREE_COVERAGE_MAXBINS' is currently just a place-holder to
-   get the other parts of the algorithm going. But most probably there is a
-   way to optimally select the maximum number automatically. */
-#define MATCH_KDTREE_COVERAGE_MAXBINS 10000
-static void
-match_kdtree_A_coverage(struct match_kdtree_params *p)
-{
-  double *d, min, max;
-  size_t *s, *sf, dim, two=2, numbins;
-  gal_data_t *tmp, *stat, *hist, *range=NULL, *bins=NULL;
-
-  /* Allocate the space to keep the range of first input dimensions. */
-  p->Amin=gal_pointer_allocate(GAL_TYPE_FLOAT64, p->ndim, 0,
-                               __func__, "p->Amin");
-  p->Amax=gal_pointer_allocate(GAL_TYPE_FLOAT64, p->ndim, 0,
-                               __func__, "p->Amax");
-  p->Abinwidth=gal_pointer_allocate(GAL_TYPE_FLOAT64, p->ndim, 0,
-                                    __func__, "p->Abinwidth");
-
-  /* Set the coverage along each dimension. */
-  dim=0;
-  p->Aexist=NULL;
-  for(tmp=p->A; tmp!=NULL; tmp=tmp->next)
-    {
-      /* Find the number of bins based on the range and aperture size. */
-      stat=gal_statistics_minimum(tmp);
-      min=((double *)(stat->array))[0];
-      gal_data_free(stat);
-      stat=gal_statistics_maximum(tmp);
-      max=((double *)(stat->array))[0];
-      gal_data_free(stat);
-
-      /* Set the generic constants. */
-      p->Amin[dim] = min - p->aperture[0];
-      p->Amax[dim] = max + p->aperture[0];
-      numbins=(p->Amax[dim] - p->Amin[dim])/p->aperture[0];
-      if(numbins>MATCH_KDTREE_COVERAGE_MAXBINS)
-        numbins=MATCH_KDTREE_COVERAGE_MAXBINS;
-      if(numbins==0) numbins=1;
-
-      /*************************/
-      //numbins=1;
-      /*************************/
-
-      /* Generate the 'Aexist' list for this dimension. Note that if we
-         have a single bin in this dimension, we can just set everything
-         automatically. */
-      if(numbins==1)
-        {
-          /* We only have one bin, so set the width and a single-element
-             histogram. */
-          p->Abinwidth[dim] = p->Amax[dim] - p->Amin[dim];
-          hist=gal_data_alloc(NULL, GAL_TYPE_UINT8, 1, &numbins, NULL,
-                              0, -1, 1, NULL, NULL, NULL);
-          ((uint8_t *)(hist->array))[0]=1;
-        }
-      else
-        {
-          /* Set the 'range' for the bins. */
-          range=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &two, NULL,
-                               0, -1, 1, NULL, NULL, NULL);
-          d=range->array;
-          d[0]=p->Amin[dim];
-          d[1]=p->Amax[dim];
-
-          /* Generate the histogram of elements in this dimension. */
-          bins=gal_statistics_regular_bins(tmp, range, numbins, NAN);
-          hist=gal_statistics_histogram(tmp, bins, 0, 0);
-
-          /* Set all histograms with atleast one element to 1 and convert
-             it to 8-bit unsigned integer. */
-          sf = (s=hist->array) + hist->size; do *s=*s>0; while(++s<sf);
-          hist=gal_data_copy_to_new_type_free(hist, GAL_TYPE_UINT8);
-
-          /* Dilate the binary histogram to avoid bin-edge-effect (missing
-             a match because the two points are on opposite sides of the
-             bin boundary). Note that we know that the bins are
-             equal/larger than ther user's given aperture and that these
-             bins are only for rejecting points before the k-d tree (they
-             aren't used within the k-d tree matching). */
-          gal_binary_dilate(hist, 1, 1, 1);
-
-          /* Set the general bin properties along this dimension. */
-          d=bins->array;
-          p->Abinwidth[dim] = d[1]-d[0];
-          p->Amin[dim]      = d[ 0            ] - p->Abinwidth[dim]/2;
-          p->Amax[dim]      = d[ bins->size-1 ] + p->Abinwidth[dim]/2;
-        }
-
-      /* For a check.
-      {
-        size_t i;
-        double *d;
-        uint8_t *u=hist->array;
-        printf("\ndim: %zu\n", dim);
-        printf("min: %g\n", p->Amin[dim]);
-        printf("max: %g\n", p->Amax[dim]);
-        printf("binwidth: %g\n", p->Abinwidth[dim]);
-        printf("----------------\n");
-        if(bins)
-          {
-            d=bins->array;
-            for(i=0;i<bins->size;++i)
-              printf("%zu: %-15.8f%-15.8f%u\n", i, d[i]-p->Abinwidth[dim]/2,
-                     d[i]+p->Abinwidth[dim]/2, u[i]);
-          }
-        else
-          printf("0: %-15.8f%-15.8f%u\n", p->Amin[dim],
-                 p->Amax[dim], u[0]);
-        printf("----------------\n");
-      } */
-
-      /* Add the histogram to the list and increment the dimensionality. */
-      gal_list_data_add(&p->Aexist, hist);
-      ++dim;
-
-      /* Clean up (these are done here in case the 'For a check' is
-         uncommented, and we want to debug things). */
-      if(bins)  { gal_data_free(bins);  bins=NULL;  }
-      if(range) { gal_data_free(range); range=NULL; }
-    }
-
-  //printf("%s: Good!\n", __func__); exit(0);
-
-  /* Reverse the list to be in the proper dimensional order. */
-  gal_list_data_reverse(&p->Aexist);
-}
-
-
-
-
-
 static void
 match_kdtree_sanity_check(struct match_kdtree_params *p)
 {
@@ -1196,130 +1056,28 @@ match_kdtree_sanity_check(struct match_kdtree_params *p)
       p->b[1]=p->B->next->array;
       if( p->B->next->next ) p->b[2]=p->B->next->next->array;
     }
-
-  /* Find the bins of the first input along all its dimensions and select
-     those that contain data. This is very important in optimal k-d tree
-     based matching because confirming a non-match in a k-d tree is very
-     computationally expensive. */
-  match_kdtree_A_coverage(p);
 }
 
 
 
 
 
-/* Main k-d tree matching function. */
-static void *
-match_kdtree_worker(void *in_prm)
-{
-  /* Low-level definitions to be done first. */
-  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
-  struct match_kdtree_params *p=(struct match_kdtree_params *)tprm->params;
-
-  /* High level definitions. */
-  int iscovered;
-  uint8_t *existA;
-  double r, delta[3];
-  size_t i, j, ai, bi, h_i;
-  gal_data_t *ccol, *Aexist;
-  double po, *point=NULL, least_dist;
-
-  /* Allocate space for all the matching points (based on the number of
-     dimensions). */
-  point=gal_pointer_allocate(GAL_TYPE_FLOAT64, p->ndim, 0, __func__,
-                             "point");
-
-  /* Go over all the rows in the second catalog that were assigned to this
-     thread. */
-  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
-    {
-      /* Set the easy-to-read indexs: this is the index in the second
-         catalog, hence 'bi'. */
-      bi = tprm->indexs[i];
-
-      /* Fill the 'point' for this thread. But first, check if each of its
-         dimensions fall within the coverage of A. */
-      j=0;
-      iscovered=1;
-      Aexist=p->Aexist;
-      for(ccol=p->B; ccol!=NULL; ccol=ccol->next)
-        {
-          if(iscovered)
-            {
-              /* Fill the point location in this dimension and set the
-                 pointer. */
-              existA=Aexist->array;
-              po = point[j] = ((double *)(ccol->array))[ bi ];
-
-              /* Make sure it covers the range of A (following the same set
-                 of tests as in 'gal_statistics_histogram'). */
-              if( po >= p->Amin[j] && po <= p->Amax[j] )
-                {
-                  h_i=(po-p->Amin[j])/p->Abinwidth[j];
-                  if( existA[ h_i - (h_i==p->Aexist->size ? 1 : 0) ] == 0 )
-                    iscovered=0;
-                }
-              else
-                iscovered=0;
-            }
-
-          /* Increment the dimensionality counter. */
-          ++j;
-          Aexist=Aexist->next;
-        }
-
-      /* Continue with the match if the point is in-range. */
-      if(iscovered)
-        {
-          /* Find the index of the nearest neighbor in the first catalog to
-             this point in the second catalog. */
-          ai = gal_kdtree_nearest_neighbour(p->A, p->A_kdtree,
-                                            p->kdtree_root, point,
-                                            &least_dist);
-
-          /* If nothing was found within the least distance, then the 'ai'
-             will be 'GAL_BLANK_SIZE_T'. */
-          if(ai!=GAL_BLANK_SIZE_T)
-            {
-              /* Make sure the matched point is within the given aperture
-                 (which may be elliptical). */
-              for(j=0;j<p->ndim;++j)
-                delta[j]=p->b[j][bi] - p->a[j][ai];
-              r=match_distance(delta, p->iscircle, p->ndim, p->aperture,
-                               p->c, p->s);
-
-              /* If the radial distance is smaller than the radial measure,
-                 then add this item to a match with 'ai'. */
-              if(r<p->aperture[0])
-                match_add_to_sfll(&p->bina[ai], bi, r);
-            }
-
-          /* For a check:
-          if(ai==GAL_BLANK_SIZE_T)
-            printf("second[%zu] matched with first[%zu].\n", bi);
-          else
-            printf("second[%zu] DIDN'T match with first.\n", bi, bi);
-          */
-        }
-    }
-
-  /* Clean up. */
-  free(point);
-
-  /* Wait for all the other threads to finish, then return. */
-  if(tprm->b) pthread_barrier_wait(tprm->b);
-  return NULL;
-}
-
-
-
-
+/* Find the nearest neighbour of all the second catalog's points in the
+   first (in parallel) and keep those that are within the aperture.
 
+   The nearest neighbour search is limited to the largest radius of the
+   aperture, so non-matches are rejected early within the k-d tree: the
+   (possibly elliptical) distance of a point within the aperture is never
+   smaller than its Euclidean distance. */
 static void
 match_kdtree_second_in_first(struct match_kdtree_params *p,
                              size_t numthreads, size_t minmapsize,
                              int quietmmap)
 {
+  gal_data_t *nn;
+  double r, delta[3];
+  gal_kdtree_flat_t *flat;
+  size_t j, ai, bi, *nni;
   double dist[3]; /* Just a place-holder in 'aperture_prepare'. */
 
   /* Prepare the aperture-related checks. */
@@ -1327,9 +1085,36 @@ match_kdtree_second_in_first(struct match_kdtree_params *p,
                          p->ndim, p->a, p->b, dist, p->c,
                          p->s, &p->iscircle);
 
-  /* Distribute the jobs in multiple threads. */
-  gal_threads_spin_off(match_kdtree_worker, p, p->B->size,
-                       numthreads, minmapsize, quietmmap);
+  /* Find the index of the nearest neighbor in the first catalog to all
+     the points in the second catalog. If nothing was found within the
+     aperture, the index will be 'GAL_BLANK_SIZE_T'. */
+  flat=gal_kdtree_flat_build(p->A, p->A_kdtree, p->kdtree_root,
+                             minmapsize, quietmmap);
+  nn=gal_kdtree_nearest_neighbours(flat, p->B, 1, p->aperture[0],
+                                   numthreads, minmapsize, quietmmap);
+  gal_kdtree_flat_free(flat);
+
+  /* Make sure the matched point is within the given aperture (which may
+     be elliptical). If the radial distance is smaller than the radial
+     measure, then add this item to a match with 'ai'. */
+  nni=nn->array;
+  for(bi=0;bi<p->B->size;++bi)
+    if( (ai=nni[bi]) != GAL_BLANK_SIZE_T )
+      {
+        for(j=0;j<p->ndim;++j)
+          delta[j]=p->b[j][bi] - p->a[j][ai];
+        r=match_distance(delta, p->iscircle, p->ndim, p->aperture,
+                         p->c, p->s);
+        if(r<p->aperture[0])
+          match_add_to_sfll(&p->bina[ai], bi, r);
+
+        /* For a check:
+        printf("second[%zu] matched with first[%zu].\n", bi, ai);
+        */
+      }
+
+  /* Clean up. */
+  gal_list_data_free(nn);
 }
 
 
@@ -1374,9 +1159,5 @@ gal_match_kdtree(gal_data_t *coord1, gal_data_t *coord2,
 
   /* Clean up and return. */
   free(p.bina);
-  free(p.Amin);
-  free(p.Amax);
-  free(p.Abinwidth);
-  gal_list_data_free(p.Aexist);
   return out;
 }
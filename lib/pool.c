@@ -23,6 +23,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 **********************************************************************/
 #include <config.h>
 
+#include <math.h>
 #include <stdio.h>
 #include <errno.h>
 #include <error.h>
@@ -33,10 +34,11 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/type.h>
 #include <gnuastro/fits.h>
 #include <gnuastro/pool.h>
+#include <gnuastro/blank.h>
+#include <gnuastro/qsort.h>
 #include <gnuastro/pointer.h>
 #include <gnuastro/threads.h>
 #include <gnuastro/dimension.h>
-#include <gnuastro/statistics.h>
 
 #include <gnuastro-internal/checkset.h>
 
@@ -78,18 +80,121 @@ struct pooling
 
 
 
+/* Find the window of the given output pixel in the input: its starting
+   coordinate ('start') and its width along each dimension ('wsize'). The
+   windows that are on the outer edge of the input may be smaller than
+   the pool size. The returned value is the number of lines (along the
+   fastest dimension) within the window. */
+static size_t
+pool_window(struct pooling *pp, size_t oind, size_t *start, size_t *wsize)
+{
+  size_t d, nlines=1, ndim=pp->input->ndim, *dsize=pp->input->dsize;
+
+  gal_dimension_index_to_coord(oind, ndim, pp->osize, start);
+  for(d=0;d<ndim;++d)
+    {
+      start[d] *= pp->pstride;
+      wsize[d] = ( start[d]+pp->poolsize <= dsize[d]
+                   ? pp->poolsize
+                   : dsize[d]-start[d] );
+      if(d<ndim-1) nlines *= wsize[d];
+    }
+  return nlines;
+}
+
+
+
+
+
+/* Parse the non-blank elements of the current window (that are put in
+   'v'), line by line. 'lcoord' is the coordinate of the start of each
+   line and is incremented like an odometer. */
+#define POOL_PARSE(OP) {                                                \
+    memcpy(lcoord, start, ndim*sizeof *start);                          \
+    for(l=0;l<nlines;++l)                                               \
+      {                                                                 \
+        iind=gal_dimension_coord_to_index(ndim, input->dsize, lcoord);  \
+        for(k=0;k<wsize[ndim-1];++k)                                    \
+          {                                                             \
+            v=in[iind+k];                                               \
+            if( b==b ? v!=b : v==v ) { OP; }                            \
+          }                                                             \
+        for(d=ndim-1; d-->0;)                                           \
+          if( ++lcoord[d] < start[d]+wsize[d] ) break;                  \
+          else lcoord[d]=start[d];                                      \
+      }                                                                 \
+  }
+
+/* Do the operation on all the output pixels of this thread. The output
+   value is directly written into the output (for the median, the values
+   are gathered in the thread's scratch buffer 'sv'). Similar to the
+   statistics library functions, blank values are ignored and when there
+   are no usable elements, the output is blank. */
+#define POOL_KERNEL(IT) {                                               \
+    IT b, v, m, *in=input->array, *sv=scratch, *o=pp->out->array;       \
+    double s, *od=pp->out->array;                                       \
+    gal_blank_write(&b, input->type);                                   \
+    for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)                  \
+      {                                                                 \
+        oind=tprm->indexs[i];                                           \
+        nlines=pool_window(pp, oind, start, wsize);                     \
+        n=0;                                                            \
+        switch(pp->operator)                                            \
+          {                                                             \
+          case POOL_MAX:                                                \
+            gal_type_min(input->type, &m);                              \
+            POOL_PARSE( if(v>m) m=v; ++n );                             \
+            o[oind] = n ? m : b;                                        \
+            break;                                                      \
+          case POOL_MIN:                                                \
+            gal_type_max(input->type, &m);                              \
+            POOL_PARSE( if(v<m) m=v; ++n );                             \
+            o[oind] = n ? m : b;                                        \
+            break;                                                      \
+          case POOL_SUM:                                                \
+          case POOL_MEAN:                                               \
+            s=0.0f;                                                     \
+            POOL_PARSE( s+=v; ++n );                                    \
+            od[oind] = ( n                                              \
+                         ? (pp->operator==POOL_SUM ? s : s/n)           \
+                         : NAN );                                       \
+            break;                                                      \
+          case POOL_MEDIAN:                                             \
+            POOL_PARSE( sv[n++]=v );                                    \
+            if(n)                                                       \
+              {                                                         \
+                ranks[0]=(n-1)/2; ranks[1]=n/2;                         \
+                gal_qsort_select(sv, n, input->type, ranks, 2);         \
+                o[oind] = n%2 ? sv[n/2] : (sv[n/2]+sv[n/2-1])/2;        \
+              }                                                         \
+            else o[oind]=b;                                             \
+            break;                                                      \
+          default:                                                      \
+            error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at "   \
+                  "%s to fix the problem. 'operator' code %d is not "   \
+                  "recognized.", __func__, PACKAGE_BUGREPORT,           \
+                  pp->operator);                                        \
+          }                                                             \
+      }                                                                 \
+  }
+
 /* Do the pooling on each thread.
 
    Current assumptions:
 
    - The size of pooling can be every single number (the pooling window
-     is a square).
-   - The width and height of the input are not necessarily divisible
-     by the size of the pooling. In other words, the image can be both
-     square and rectangular.
+     is a square, or a cube in 3D, with the same width along all
+     dimensions).
+   - The lengths of the input are not necessarily divisible by the size
+     of the pooling. In other words, the input can be both square and
+     rectangular.
    - We apply pooling to our input with any stride length that may be
      differ from the poolsize. Remember that, the size of the poolsize
-     must be greater than the stride size. */
+     must be greater than the stride size.
+
+   No memory is allocated for each output pixel: the values of each
+   window are parsed directly from the input and the result is written
+   directly in the output. */
 static void *
 pool_type_on_thread(void *in_prm)
 {
@@ -97,96 +202,41 @@ pool_type_on_thread(void *in_prm)
   struct pooling *pp=(struct pooling *)tprm->params;
   gal_data_t *input=pp->input;
 
-  size_t strd=pp->pstride;
+  void *scratch=NULL;
   size_t ndim=input->ndim;
-  size_t pools=pp->poolsize;
-  size_t w=input->dsize[1], wr;
-  gal_data_t *statv=NULL, *result=NULL;
-  size_t i, a, b, oind, iind, vc, numpixs, coord[POOLING_DIM], index;
+  size_t i, d, k, l, n, oind, iind, nlines, numpixs=1, ranks[2];
+  size_t start[POOLING_DIM], wsize[POOLING_DIM], lcoord[POOLING_DIM];
 
-  /* All number of pixels that we selected each time par the pooling. */
-  numpixs=pools*pools;
-
-  /* Allocated memory for selected pixels of input to feed into the
-     statisitical operation. */
-  statv=gal_data_alloc(NULL, input->type, 1, &numpixs, NULL, 0,
-                       input->minmapsize, input->quietmmap,
-                       NULL, NULL, NULL);
+  /* For the median, the values of each window are necessary, so allocate
+     a buffer to keep them (to be used for all the pixels of this
+     thread). */
+  if(pp->operator==POOL_MEDIAN)
+    {
+      for(d=0;d<ndim;++d) numpixs*=pp->poolsize;
+      scratch=gal_pointer_allocate(input->type, numpixs, 0, __func__,
+                                   "scratch");
+    }
 
   /* Go over all the pixels that were assigned to this thread. */
-  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+  switch(input->type)
     {
-      /* For easy reading, put the index in 'oind'. */
-      oind=tprm->indexs[i];
-
-      /* Get the coordinate of the pixel. */
-      gal_dimension_index_to_coord(oind, ndim, pp->osize, coord);
-
-      /* Convert the pixel coordinate to the desired pixel that we must
-         select to set the pooling's starting pointer. */
-      iind=strd*w*coord[0]+strd*coord[1];
-      wr=iind%w;
-
-      /* In some cases, the pooling window doesn't cover a whole squared
-         window and only has maybe one pixel. So since we initialize the
-         statv by Null (=0 in C), some of these values fill with input
-         values and others remain zero. So these zeros will affect the
-         outputs. Therefore we initialize the statv by blank value. */
-      gal_blank_initialize(statv);
-
-      /* Set the sorted and blank check flags to 0 so the statistical
-         operators re-check everytime for sorted or blank elements. */
-      statv->flag=0;
-
-      /* Depending on the size of pooling, we condider a set of pixels
-	 and fill the temporary 'values' array. Then we do the required
-         operation on them. */
-      vc=0;
-      for(a=0;a<pools;++a)
-	for(b=0;b<pools && wr+b<input->dsize[1];++b)
-	  {
-	    index=iind + a*w + b;
-	    if (index<input->size)
-	      {
-                memcpy(gal_pointer_increment(statv->array, vc,
-                                             statv->type),
-                       gal_pointer_increment(input->array, index,
-                                             input->type),
-                       gal_type_sizeof(input->type));
-                vc++;
-	      }
-	  }
-
-      /* Do the necessary calculation. */
-      switch(pp->operator)
-        {
-        case POOL_MAX:    result=gal_statistics_maximum(statv);   break;
-        case POOL_MIN:    result=gal_statistics_minimum(statv);   break;
-        case POOL_SUM:    result=gal_statistics_sum(statv);       break;
-        case POOL_MEAN:   result=gal_statistics_mean(statv);      break;
-        case POOL_MEDIAN: result=gal_statistics_median(statv, 1); break;
-        default:
-          error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s "
-                "to fix the problem. 'operator' code %d is not "
-                "recognized.", PACKAGE_BUGREPORT, __func__,
-                pp->operator);
-        }
-
-      /* Make sure the output array type and the type of result are the
-         same. */
-      if(result->type!=pp->out->type)
-        result=gal_data_copy_to_new_type_free(result, pp->out->type);
-
-      /* Copy the result into the output array. */
-      memcpy(gal_pointer_increment(pp->out->array, oind, pp->out->type),
-             result->array, gal_type_sizeof(pp->out->type));
-
-      /* Clean up. */
-      gal_data_free(result);
+    case GAL_TYPE_UINT8:     POOL_KERNEL( uint8_t  );    break;
+    case GAL_TYPE_INT8:      POOL_KERNEL( int8_t   );    break;
+    case GAL_TYPE_UINT16:    POOL_KERNEL( uint16_t );    break;
+    case GAL_TYPE_INT16:     POOL_KERNEL( int16_t  );    break;
+    case GAL_TYPE_UINT32:    POOL_KERNEL( uint32_t );    break;
+    case GAL_TYPE_INT32:     POOL_KERNEL( int32_t  );    break;
+    case GAL_TYPE_UINT64:    POOL_KERNEL( uint64_t );    break;
+    case GAL_TYPE_INT64:     POOL_KERNEL( int64_t  );    break;
+    case GAL_TYPE_FLOAT32:   POOL_KERNEL( float    );    break;
+    case GAL_TYPE_FLOAT64:   POOL_KERNEL( double   );    break;
+    default:
+      error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+            __func__, input->type);
     }
 
   /* Clean up. */
-  gal_data_free(statv);
+  free(scratch);
 
   /* Wait for all the other threads to finish, then return. */
   if(tprm->b) pthread_barrier_wait(tprm->b);
@@ -215,9 +265,16 @@ pool_generic(gal_data_t *input, size_t psize, size_t stride, int operator,
     error(EXIT_FAILURE, 0, "the value of stride must be positive, and "
           "non zero)");
 
-  /* Make sure the given poolsize is lower than the input's width or
-     height. */
-  if(psize>input->dsize[0] && psize>input->dsize[1])
+  /* Make sure the number of dimensions is supported. */
+  if(input->ndim>POOLING_DIM)
+    error(EXIT_FAILURE, 0, "%s: currently only datasets with less than "
+          "%d dimensions are acceptable. The input has %zu dimensions",
+          __func__, POOLING_DIM, input->ndim);
+
+  /* Make sure the given poolsize is lower than the input's length in at
+     least one dimension. */
+  for(i=0;i<input->ndim;++i) if(psize<=input->dsize[i]) break;
+  if(i==input->ndim)
     error(EXIT_FAILURE, 0, "%s: the pool size along dimension must be "
          "lower than the input's width or height in that dimension",
          __func__);
@@ -278,9 +335,13 @@ pool_generic(gal_data_t *input, size_t psize, size_t stride, int operator,
                             pp.input->minmapsize, pp.input->quietmmap, NULL,
                             NULL, NULL);
 
-      /* Spin-off the threads and do the processing on each thread. */
-      gal_threads_spin_off(pool_type_on_thread, &pp, pp.out->size, numthreads,
-                           pp.input->minmapsize, pp.input->quietmmap);
+      /* Spin-off the threads and do the processing on each thread. Each
+         thread is given a contiguous block of output pixels (so the input
+         pixels it reads are also close to each other in memory). */
+      gal_threads_spin_off_schedule(pool_type_on_thread, &pp, pp.out->size,
+                                    numthreads, GAL_THREADS_SCHEDULE_BLOCK,
+                                    0, pp.input->minmapsize,
+                                    pp.input->quietmmap);
     }
 
   /* Correct the WCS (if it has one). */
@@ -295,10 +356,11 @@ pool_generic(gal_data_t *input, size_t psize, size_t stride, int operator,
 
       /* Copy the input WCS to the output and correct the values. */
       pp.out->wcs=gal_wcs_copy(pp.input->wcs);
-      pp.out->wcs->crpix[0]/=psize;
-      pp.out->wcs->crpix[1]/=psize;
-      pp.out->wcs->cdelt[0]*=psize;
-      pp.out->wcs->cdelt[1]*=psize;
+      for(i=0;i<(size_t)(pp.out->wcs->naxis);++i)
+        {
+          pp.out->wcs->crpix[i]/=psize;
+          pp.out->wcs->cdelt[i]*=psize;
+        }
     }
 
   /* Clean up and return. */
@@ -23,12 +23,17 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <config.h>
 
 #include <math.h>
+#include <error.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <fitsio.h>
 
+#include <gnuastro/type.h>
+#include <gnuastro/data.h>
 #include <gnuastro/qsort.h>
+#include <gnuastro/threads.h>
 
 
 /*****************************************************************/
@@ -414,3 +419,493 @@ gal_qsort_index_multi_i(const void *a, const void *b)
   int out=(ta > tb) - (ta < tb);
   return out ? out : COMPARE_FLOAT_POSTPROCESS;
 }
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*****************************************************************/
+/***************     Sorting indexs (radix)     ******************/
+/*****************************************************************/
+/* Number of bits in each digit of the radix sort. */
+#define QSORT_RADIX_BITS    8
+#define QSORT_RADIX_NUM     (1<<QSORT_RADIX_BITS)
+
+/* Below this number of elements, a single thread is used. */
+#define QSORT_RADIX_MINTHREAD 65536
+
+/* Below this number of elements, an insertion sort is used (the radix
+   sort's fixed cost of allocating its arrays and doing the passes over
+   all the 256 digits is larger than sorting them directly). */
+#define QSORT_RADIX_MINSIZE   128
+
+/* Parameters of the radix sort (shared between the threads). */
+struct qsort_radix_params
+{
+  void       *values;   /* Array of values.                           */
+  uint8_t       type;   /* Type of the values.                        */
+  int     decreasing;   /* ==1: sort by decreasing order.             */
+  size_t       *ind0;   /* Indexs (initially the input 'index').      */
+  size_t       *ind1;   /* Indexs after each pass.                    */
+  uint64_t     *key0;   /* Sorting keys of 'ind0'.                    */
+  uint64_t     *key1;   /* Sorting keys of 'ind1'.                    */
+  size_t        size;   /* Number of elements.                        */
+  size_t     nchunks;   /* Number of chunks (one for each thread).    */
+  size_t       shift;   /* Shift of this pass's digit in the keys.    */
+  size_t       *hist;   /* Histogram of each chunk ('nchunks' rows).  */
+  int           mode;   /* 0: make keys, 1: histogram, 2: scatter.    */
+};
+
+
+
+
+/* Unsigned integer key that has the same order as the value. For signed
+   integers, the sign bit is flipped. For floating points, the sign bit
+   is flipped for positive numbers and all the bits are flipped for
+   negative numbers (negative zero is first set to positive zero so they
+   are equal). When the sort is in decreasing order, all the bits are
+   flipped. In both cases, NaN values get the largest key (so they are
+   put in the end). */
+#define QSORT_RADIX_KEY_UINT(IT) {                                      \
+    IT *v=prm->values;                                                  \
+    for(i=from;i<to;++i)                                                \
+      { k=v[ind[i]]; key[i] = prm->decreasing ? ~k : k; }               \
+  }
+#define QSORT_RADIX_KEY_INT(IT, UT, SIGN) {                             \
+    IT *v=prm->values;                                                  \
+    for(i=from;i<to;++i)                                                \
+      {                                                                 \
+        k=(UT)(v[ind[i]]) ^ (SIGN);                                     \
+        key[i] = prm->decreasing ? ~k : k;                              \
+      }                                                                 \
+  }
+#define QSORT_RADIX_KEY_FLOAT(IT, UT, SIGN) {                           \
+    UT u;                                                               \
+    IT f, *v=prm->values;                                               \
+    for(i=from;i<to;++i)                                                \
+      {                                                                 \
+        f=v[ind[i]];                                                    \
+        if( isnan(f) ) key[i]=UINT64_MAX;                               \
+        else                                                            \
+          {                                                             \
+            if(f==0) f=0;                                               \
+            memcpy(&u, &f, sizeof u);                                   \
+            k = (u & (SIGN)) ? (UT)(~u) : (u | (SIGN));                 \
+            key[i] = prm->decreasing ? ~k : k;                          \
+          }                                                             \
+      }                                                                 \
+  }
+
+static void
+qsort_radix_chunk(struct qsort_radix_params *prm, size_t c)
+{
+  uint64_t k, *key=prm->key0;
+  size_t i, b, *h, *ind=prm->ind0;
+  size_t from=c*prm->size/prm->nchunks, to=(c+1)*prm->size/prm->nchunks;
+
+  switch(prm->mode)
+    {
+    /* Build the keys. */
+    case 0:
+      switch(prm->type)
+        {
+        case GAL_TYPE_UINT8:   QSORT_RADIX_KEY_UINT(uint8_t);         break;
+        case GAL_TYPE_UINT16:  QSORT_RADIX_KEY_UINT(uint16_t);        break;
+        case GAL_TYPE_UINT32:  QSORT_RADIX_KEY_UINT(uint32_t);        break;
+        case GAL_TYPE_UINT64:  QSORT_RADIX_KEY_UINT(uint64_t);        break;
+        case GAL_TYPE_INT8:
+          QSORT_RADIX_KEY_INT(int8_t, uint8_t, 0x80);                 break;
+        case GAL_TYPE_INT16:
+          QSORT_RADIX_KEY_INT(int16_t, uint16_t, 0x8000);             break;
+        case GAL_TYPE_INT32:
+          QSORT_RADIX_KEY_INT(int32_t, uint32_t, 0x80000000);         break;
+        case GAL_TYPE_INT64:
+          QSORT_RADIX_KEY_INT(int64_t, uint64_t, 0x8000000000000000); break;
+        case GAL_TYPE_FLOAT32:
+          QSORT_RADIX_KEY_FLOAT(float, uint32_t, 0x80000000);         break;
+        case GAL_TYPE_FLOAT64:
+          QSORT_RADIX_KEY_FLOAT(double, uint64_t, 0x8000000000000000);
+          break;
+        default:
+          error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+                __func__, prm->type);
+        }
+      break;
+
+    /* Histogram of this pass's digit. */
+    case 1:
+      h=prm->hist+c*QSORT_RADIX_NUM;
+      for(b=0;b<QSORT_RADIX_NUM;++b) h[b]=0;
+      for(i=from;i<to;++i)
+        ++h[ (key[i]>>prm->shift) & (QSORT_RADIX_NUM-1) ];
+      break;
+
+    /* Put the elements in their place for this pass (the histogram now
+       contains the first output position of each digit in this
+       chunk). */
+    case 2:
+      h=prm->hist+c*QSORT_RADIX_NUM;
+      for(i=from;i<to;++i)
+        {
+          b=h[ (key[i]>>prm->shift) & (QSORT_RADIX_NUM-1) ]++;
+          prm->key1[b]=key[i];
+          prm->ind1[b]=ind[i];
+        }
+      break;
+
+    default:
+      error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
+            "the problem. The value %d isn't recognized for 'mode'",
+            __func__, PACKAGE_BUGREPORT, prm->mode);
+    }
+}
+
+
+
+
+
+static void *
+qsort_radix_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct qsort_radix_params *prm=(struct qsort_radix_params *)tprm->params;
+
+  size_t i;
+
+  /* Go over all the chunks that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    qsort_radix_chunk(prm, tprm->indexs[i]);
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Run one step of the radix sort over all the chunks. */
+static void
+qsort_radix_step(struct qsort_radix_params *prm, int mode,
+                 size_t minmapsize, int quietmmap)
+{
+  prm->mode=mode;
+  if(prm->nchunks==1)
+    qsort_radix_chunk(prm, 0);
+  else
+    gal_threads_spin_off(qsort_radix_worker, prm, prm->nchunks,
+                         prm->nchunks, minmapsize, quietmmap);
+}
+
+
+
+
+
+/* Stable insertion sort for the small arrays (with less than
+   'QSORT_RADIX_MINSIZE' elements). The keys are built exactly like the
+   radix sort (so the order of NaN and equal values is the same), but they
+   are kept on the stack and nothing is allocated. */
+static void
+qsort_radix_small(struct qsort_radix_params *prm)
+{
+  size_t i, j, ind, *index=prm->ind0;
+  uint64_t k, key[QSORT_RADIX_MINSIZE];
+
+  /* Build the keys. */
+  prm->key0=key;
+  prm->nchunks=1;
+  prm->mode=0;
+  qsort_radix_chunk(prm, 0);
+
+  /* Insert each element after all the elements with a smaller or equal
+     key before it. */
+  for(i=1;i<prm->size;++i)
+    if(key[i]<key[i-1])
+      {
+        k=key[i];
+        ind=index[i];
+        for(j=i; j>0 && key[j-1]>k; --j)
+          { key[j]=key[j-1]; index[j]=index[j-1]; }
+        key[j]=k;
+        index[j]=ind;
+      }
+}
+
+
+
+
+
+/* Sort the 'size' elements of 'index' based on the values they point to
+   in 'values' (with type 'type'), with a stable (least significant digit
+   first) radix sort. The order is increasing when 'decreasing==0' and
+   decreasing otherwise; in both cases NaN values are put in the end.
+   Unlike 'qsort' with the 'gal_qsort_index_single_*' functions, this
+   doesn't use any global variable (so it can be called from multiple
+   threads), and it can use 'numthreads' threads: each pass (one for
+   every byte of the type, unless all the elements have the same value
+   in that byte) is done over separate chunks of the array. */
+void
+gal_qsort_index_radix(size_t *index, size_t size, void *values,
+                      uint8_t type, int decreasing, size_t numthreads,
+                      size_t minmapsize, int quietmmap)
+{
+  void *vtmp;
+  size_t b, c, t, sum, pass, npass;
+  struct qsort_radix_params prm;
+  gal_data_t *key0, *key1, *ind1, *hist;
+
+  /* Small arrays are already sorted. */
+  if(size<2) return;
+
+  /* The basic parameters. */
+  prm.type=type;
+  prm.size=size;
+  prm.values=values;
+  prm.ind0=index;
+  prm.decreasing=decreasing;
+
+  /* Small arrays are sorted directly. */
+  if(size<QSORT_RADIX_MINSIZE) { qsort_radix_small(&prm); return; }
+
+  /* Allocate the necessary arrays. */
+  npass=gal_type_sizeof(type);
+  key0=gal_data_alloc(NULL, GAL_TYPE_UINT64, 1, &size, NULL, 0,
+                      minmapsize, quietmmap, NULL, NULL, NULL);
+  key1=gal_data_alloc(NULL, GAL_TYPE_UINT64, 1, &size, NULL, 0,
+                      minmapsize, quietmmap, NULL, NULL, NULL);
+  ind1=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &size, NULL, 0,
+                      minmapsize, quietmmap, NULL, NULL, NULL);
+
+  /* Set the rest of the parameters. */
+  prm.ind1=ind1->array;
+  prm.key0=key0->array;
+  prm.key1=key1->array;
+  prm.nchunks = ( size<QSORT_RADIX_MINTHREAD || numthreads==0
+                  ? 1 : numthreads );
+  c=prm.nchunks*QSORT_RADIX_NUM;
+  hist=gal_data_alloc(NULL, GAL_TYPE_SIZE_T, 1, &c, NULL, 0, -1, 1,
+                      NULL, NULL, NULL);
+  prm.hist=hist->array;
+
+  /* Build the keys. */
+  qsort_radix_step(&prm, 0, minmapsize, quietmmap);
+
+  /* Do the passes. */
+  for(pass=0; pass<npass; ++pass)
+    {
+      /* Histogram of this digit in each chunk. */
+      prm.shift=pass*QSORT_RADIX_BITS;
+      qsort_radix_step(&prm, 1, minmapsize, quietmmap);
+
+      /* If all the elements have the same digit, this pass is not
+         necessary. */
+      for(b=0;b<QSORT_RADIX_NUM;++b)
+        {
+          for(sum=c=0;c<prm.nchunks;++c) sum+=prm.hist[c*QSORT_RADIX_NUM+b];
+          if(sum) break;
+        }
+      if(sum==size) continue;
+
+      /* Convert the histograms to the first output position of each
+         digit in each chunk (all the elements of smaller digits come
+         first, then those with the same digit in previous chunks). */
+      for(sum=b=0;b<QSORT_RADIX_NUM;++b)
+        for(c=0;c<prm.nchunks;++c)
+          {
+            t=prm.hist[c*QSORT_RADIX_NUM+b];
+            prm.hist[c*QSORT_RADIX_NUM+b]=sum;
+            sum+=t;
+          }
+
+      /* Put the elements in their place and swap the arrays. */
+      qsort_radix_step(&prm, 2, minmapsize, quietmmap);
+      vtmp=prm.key0; prm.key0=prm.key1; prm.key1=vtmp;
+      vtmp=prm.ind0; prm.ind0=prm.ind1; prm.ind1=vtmp;
+    }
+
+  /* If the final indexs are not in the input array, copy them there. */
+  if(prm.ind0!=index)
+    memcpy(index, prm.ind0, size*sizeof *index);
+
+  /* Clean up. */
+  gal_data_free(key0);
+  gal_data_free(key1);
+  gal_data_free(ind1);
+  gal_data_free(hist);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*****************************************************************/
+/**********        Selection (partial sorting)    ****************/
+/*****************************************************************/
+/* Small ranges are sorted with insertion sort. */
+#define QSORT_SELECT_SMALL 16
+
+/* Sort the elements in the range '[lo, hi)' with insertion sort. */
+#define QSORT_SELECT_INSERTION(IT) {                                    \
+    for(i=lo+1;i<hi;++i)                                                \
+      {                                                                 \
+        t=a[i];                                                         \
+        for(j=i; j>lo && a[j-1]>t; --j) a[j]=a[j-1];                    \
+        a[j]=t;                                                         \
+      }                                                                 \
+  }
+
+/* Sort the elements in the range '[lo, hi)' with heap-sort (this is only
+   used when the partitioning has not been effective). */
+#define QSORT_SELECT_SIFT(IT, ROOT, N) {                                \
+    for(j=(ROOT); 2*j+1<(N); j=k)                                       \
+      {                                                                 \
+        k=2*j+1;                                                        \
+        if(k+1<(N) && h[k+1]>h[k]) ++k;                                 \
+        if(h[j]>=h[k]) break;                                           \
+        t=h[j]; h[j]=h[k]; h[k]=t;                                      \
+      }                                                                 \
+  }
+#define QSORT_SELECT_HEAP(IT) {                                         \
+    IT *h=a+lo;                                                         \
+    size_t n=hi-lo;                                                     \
+    for(i=n/2; i>0; --i) QSORT_SELECT_SIFT(IT, i-1, n);                 \
+    for(i=n-1; i>0; --i)                                                \
+      { t=h[0]; h[0]=h[i]; h[i]=t; QSORT_SELECT_SIFT(IT, 0, i); }       \
+  }
+
+/* Each segment of the array is partitioned into three parts around a
+   pivot (median of three elements): smaller than, equal to and larger
+   than the pivot. The requested ranks within the equal part are already
+   in their final place, so only the parts that contain requested ranks
+   are partitioned again. One of them is kept in a stack (which will
+   never be deeper than the maximum depth) and the loop continues on the
+   other. */
+#define QSORT_SELECT(IT) {                                              \
+    IT p, t, x, y, z, *a=array;                                         \
+    top=0;                                                              \
+    stack[top][0]=0;  stack[top][1]=size;                               \
+    stack[top][2]=0;  stack[top][3]=numranks;                           \
+    stack[top++][4]=maxdepth;                                           \
+    while(top)                                                          \
+      {                                                                 \
+        --top;                                                          \
+        lo=stack[top][0]; hi=stack[top][1];                             \
+        r0=stack[top][2]; r1=stack[top][3]; depth=stack[top][4];        \
+        while(r0<r1)                                                    \
+          {                                                             \
+            /* Small or badly partitioned segments are just sorted. */  \
+            if(hi-lo<=QSORT_SELECT_SMALL)                               \
+              { QSORT_SELECT_INSERTION(IT); break; }                    \
+            if(depth==0) { QSORT_SELECT_HEAP(IT); break; }              \
+            --depth;                                                    \
+                                                                        \
+            /* Median of three as pivot. */                             \
+            x=a[lo]; y=a[lo+(hi-lo)/2]; z=a[hi-1];                      \
+            p = ( x<y                                                   \
+                  ? ( y<z ? y : (x<z ? z : x) )                         \
+                  : ( x<z ? x : (y<z ? z : y) ) );                      \
+                                                                        \
+            /* Three-way partitioning. */                               \
+            lt=i=lo; gt=hi;                                             \
+            while(i<gt)                                                 \
+              if(a[i]<p)      { t=a[lt]; a[lt++]=a[i]; a[i++]=t; }      \
+              else if(a[i]>p) { t=a[--gt]; a[gt]=a[i]; a[i]=t;   }      \
+              else ++i;                                                 \
+                                                                        \
+            /* Ranks in the smaller and equal parts. */                 \
+            for(k=r0; k<r1 && ranks[k]<lt; ++k) {}                      \
+            for(j=k;  j<r1 && ranks[j]<gt; ++j) {}                      \
+                                                                        \
+            /* Keep the smaller part (if necessary) for later and */    \
+            /* continue with the larger part. */                        \
+            if(k>r0)                                                    \
+              {                                                         \
+                stack[top][0]=lo;  stack[top][1]=lt;                    \
+                stack[top][2]=r0;  stack[top][3]=k;                     \
+                stack[top++][4]=depth;                                  \
+              }                                                         \
+            lo=gt; r0=j;                                                \
+          }                                                             \
+      }                                                                 \
+  }
+
+/* Re-order the elements of 'array' (with 'size' elements of type 'type')
+   such that the element at each of the 'numranks' indexs in 'ranks' is
+   the same as when the array is sorted in increasing order. All the
+   elements before each of these indexs will be smaller than (or equal
+   to) it and all the elements after it will be larger than (or equal
+   to) it. The elements of 'ranks' must be sorted (in increasing order)
+   and the array should not have any NaN values.
+
+   Irrespective of the number of ranks, the array is partitioned in one
+   pass (finding several ranks together), and only the parts of the
+   array that contain a requested rank are further partitioned. So on
+   average this needs O(size) operations (compared to O(size*log(size))
+   of sorting). */
+void
+gal_qsort_select(void *array, size_t size, uint8_t type, size_t *ranks,
+                 size_t numranks)
+{
+  size_t maxdepth=0, stack[2*sizeof(size_t)*8+2][5];
+  size_t i, j, k, lo, hi, lt, gt, r0, r1, top, depth;
+
+  /* Sanity check. */
+  if(numranks==0 || size<2) return;
+  if(ranks[numranks-1]>=size)
+    error(EXIT_FAILURE, 0, "%s: the largest requested rank (%zu) is "
+          "not smaller than the number of elements (%zu)", __func__,
+          ranks[numranks-1], size);
+
+  /* The maximum depth before the heap-sort is used (twice the number of
+     bits in 'size'). */
+  for(i=size; i; i>>=1) maxdepth+=2;
+
+  /* Do the selection. */
+  switch(type)
+    {
+    case GAL_TYPE_UINT8:     QSORT_SELECT( uint8_t  );    break;
+    case GAL_TYPE_INT8:      QSORT_SELECT( int8_t   );    break;
+    case GAL_TYPE_UINT16:    QSORT_SELECT( uint16_t );    break;
+    case GAL_TYPE_INT16:     QSORT_SELECT( int16_t  );    break;
+    case GAL_TYPE_UINT32:    QSORT_SELECT( uint32_t );    break;
+    case GAL_TYPE_INT32:     QSORT_SELECT( int32_t  );    break;
+    case GAL_TYPE_UINT64:    QSORT_SELECT( uint64_t );    break;
+    case GAL_TYPE_INT64:     QSORT_SELECT( int64_t  );    break;
+    case GAL_TYPE_FLOAT32:   QSORT_SELECT( float    );    break;
+    case GAL_TYPE_FLOAT64:   QSORT_SELECT( double   );    break;
+    default:
+      error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
+            __func__, type);
+    }
+}
@@ -324,6 +324,78 @@ gal_statistics_mean_std(gal_data_t *input)
 
 
 
+/* Return a dataset with no blank values where the elements that are
+   necessary for the requested quantiles are in the same position as a
+   sorted array (see 'gal_qsort_select'). In other words, the returned
+   dataset can be used like the output of 'gal_statistics_no_blank_sorted'
+   for reading those quantiles. The role of 'inplace' is also the same.
+
+   When a single (or a few) order statistics are necessary, there is no
+   need to sort the full array: selection needs O(n) operations, while
+   sorting needs O(n*log(n)). However, if the input is already sorted,
+   it is used directly. */
+static gal_data_t *
+statistics_no_blank_select(gal_data_t *input, int inplace,
+                           double *quantiles, size_t numquantiles)
+{
+  double findex;
+  gal_data_t *noblank;
+  size_t i, j, r, *ranks, numranks=0;
+
+  /* If the input is already sorted (or empty), there is no need to
+     select anything. Note that the sorting check is only reliable when
+     there are no blank values. */
+  if( input->size==0
+      || ( input->block==NULL
+           && gal_blank_present(input, 1)==0
+           && gal_statistics_is_sorted(input, 1) ) )
+    return gal_statistics_no_blank_sorted(input, inplace);
+
+  /* Remove the blank elements (tiles are always copied). */
+  noblank = inplace && input->block==NULL ? input : gal_data_copy(input);
+  gal_blank_remove(noblank);
+  if(noblank->size==0) return noblank;
+
+  /* Both the integers around the (floating point) index of each quantile
+     are necessary (for example the median of an even number of
+     elements). */
+  ranks=gal_pointer_allocate(GAL_TYPE_SIZE_T, 2*numquantiles, 0, __func__,
+                             "ranks");
+  for(i=0;i<numquantiles;++i)
+    {
+      if(quantiles[i]<0.0f || quantiles[i]>1.0f)
+        error(EXIT_FAILURE, 0, "%s: the input quantile should be between "
+              "0.0 and 1.0 (inclusive). You have asked for %g", __func__,
+              quantiles[i]);
+      findex=(double)(noblank->size-1)*quantiles[i];
+      ranks[numranks++]=findex;
+      if( findex > (size_t)findex ) ranks[numranks++]=(size_t)findex+1;
+    }
+
+  /* The ranks have to be sorted (there are only a few of them). */
+  for(i=1;i<numranks;++i)
+    {
+      r=ranks[i];
+      for(j=i; j>0 && ranks[j-1]>r; --j) ranks[j]=ranks[j-1];
+      ranks[j]=r;
+    }
+
+  /* Do the selection. The array is not sorted any more, so the sorting
+     flags should be removed (to be checked again if necessary). */
+  gal_qsort_select(noblank->array, noblank->size, noblank->type, ranks,
+                   numranks);
+  noblank->flag &= ~( GAL_DATA_FLAG_SORT_CH | GAL_DATA_FLAG_SORTED_I
+                      | GAL_DATA_FLAG_SORTED_D );
+
+  /* Clean up and return. */
+  free(ranks);
+  return noblank;
+}
+
+
+
+
+
 /* The input is a sorted array with no blank values, we want the median
    value to be put inside the already allocated space which is pointed to
    by 'median'. It is in the same type as the input. */
@@ -365,12 +437,13 @@ statistics_median_in_sorted_no_blank(gal_data_t *sorted, void *median)
 /* Return the median value of the dataset in the same type as the input as
    a one element dataset. If the 'inplace' flag is set, the input data
    structure will be modified: it will have no blank values and will be
-   sorted (increasing). */
+   partially sorted (see 'statistics_no_blank_select'). */
 gal_data_t *
 gal_statistics_median(gal_data_t *input, int inplace)
 {
   size_t dsize=1;
-  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
+  double half=0.5f;
+  gal_data_t *nbs=statistics_no_blank_select(input, inplace, &half, 1);
   gal_data_t *out=gal_data_alloc(NULL, nbs->type, 1, &dsize, NULL, 1, -1,
                                  1, NULL, NULL, NULL);
 
@@ -547,7 +620,7 @@ gal_statistics_quantile_index(size_t size, double quantile)
   */
   /* Note that in the conversion from float to size_t, the floor
      integer value of the float will be used. */
-  if( floatindex - (int)floatindex > 0.5 )
+  if( floatindex - (size_t)floatindex > 0.5 )
     return floatindex+1;
   else
     return floatindex;
@@ -565,15 +638,16 @@ gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
   void *blank;
   int increasing;
   size_t dsize=1, index;
-  gal_data_t *nbs=gal_statistics_no_blank_sorted(input, inplace);
+  gal_data_t *nbs=statistics_no_blank_select(input, inplace, &quantile, 1);
   gal_data_t *out=gal_data_alloc(NULL, nbs->type, 1, &dsize,
                                  NULL, 1, -1, 1, NULL, NULL, NULL);
 
   /* Only continue processing if there are non-blank elements. */
   if(nbs->size)
     {
-      /* Set the increasing value. */
-      increasing = nbs->flag & GAL_DATA_FLAG_SORTED_I;
+      /* Set the increasing value (the output of a selection is always
+         increasing). */
+      increasing = !(nbs->flag & GAL_DATA_FLAG_SORTED_D);
 
       /* Find the index of the quantile, note that if it sorted in
          decreasing order, then we'll need to get the index of the inverse
@@ -607,6 +681,58 @@ gal_statistics_quantile(gal_data_t *input, double quantile, int inplace)
 
 
 
+/* Return a dataset of the same type as input keeping the values at all
+   the quantiles in 'quantiles' (in the same order). All the quantiles
+   are found together in one selection (see 'statistics_no_blank_select'),
+   so it is faster than calling 'gal_statistics_quantile' for each. */
+gal_data_t *
+gal_statistics_quantiles(gal_data_t *input, gal_data_t *quantiles,
+                         int inplace)
+{
+  double *q;
+  size_t i, index;
+  gal_data_t *nbs, *out, *qs;
+  size_t width=gal_type_sizeof(input->type);
+
+  /* The quantiles should be in 64-bit floating point. */
+  qs = ( quantiles->type==GAL_TYPE_FLOAT64
+         ? quantiles
+         : gal_data_copy_to_new_type(quantiles, GAL_TYPE_FLOAT64) );
+  q=qs->array;
+
+  /* Prepare the input and allocate the output. */
+  nbs=statistics_no_blank_select(input, inplace, q, qs->size);
+  out=gal_data_alloc(NULL, nbs->type, 1, &qs->size, NULL, 0, -1, 1,
+                     NULL, NULL, NULL);
+
+  /* Write the value of each quantile into the output (see the comments
+     in 'gal_statistics_quantile'). */
+  for(i=0;i<qs->size;++i)
+    {
+      if(nbs->size)
+        {
+          index=gal_statistics_quantile_index(nbs->size,
+                                     ( nbs->flag & GAL_DATA_FLAG_SORTED_D
+                                       ? 1.0f - q[i] : q[i] ) );
+          memcpy(gal_pointer_increment(out->array, i, out->type),
+                 gal_pointer_increment(nbs->array, index, nbs->type),
+                 width);
+        }
+      else
+        gal_blank_write(gal_pointer_increment(out->array, i, out->type),
+                        out->type);
+    }
+
+  /* Clean up and return. */
+  if(qs!=quantiles) gal_data_free(qs);
+  if(nbs!=input) gal_data_free(nbs);
+  return out;
+}
+
+
+
+
+
 /* Return the index of the (first) point in the sorted dataset that has the
    closest value to 'value' (which has to be the same type as the 'input'
    dataset). */
@@ -480,25 +480,43 @@ gal_table_list_of_indexs(gal_list_str_t *cols, gal_data_t *allcols,
    columns, in this case, the order of output columns that correspond to
    that one input, are in order of the table (which column was read first).
    So the first requested column is the first popped data structure and so
-   on. */
+   on.
+
+   Only 'numrows' rows, starting from row 'rowstart' (counting from zero)
+   are read ('numrows' is truncated to the number of remaining rows, so
+   'GAL_BLANK_SIZE_T' can be used for all of them). This allows reading a
+   large table in chunks of rows (the columns of each chunk are independent
+   datasets): when 'rowstart' is after the last row, NULL is returned. */
 gal_data_t *
-gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
-               gal_list_str_t *cols, int searchin, int ignorecase,
-               size_t numthreads, size_t minmapsize, int quietmmap,
-               size_t *colmatch, char *hdu_option_name)
+gal_table_read_rows(char *filename, char *hdu, gal_list_str_t *lines,
+                    gal_list_str_t *cols, int searchin, int ignorecase,
+                    size_t rowstart, size_t numrows, size_t numthreads,
+                    size_t minmapsize, int quietmmap, size_t *colmatch,
+                    char *hdu_option_name)
 {
   int tableformat;
   gal_list_sizet_t *indexll;
-  size_t i, numcols, numrows;
+  size_t i, numcols, allrows;
   gal_data_t *allcols, *out=NULL;
 
   /* First get the information of all the columns. */
-  allcols=gal_table_info(filename, hdu, lines, &numcols, &numrows,
+  allcols=gal_table_info(filename, hdu, lines, &numcols, &allrows,
                          &tableformat, hdu_option_name);
 
   /* If there was no actual data in the file, then return NULL. */
   if(allcols==NULL) return NULL;
 
+  /* Set the number of rows to read: when the requested starting row is
+     after the end of the table, there is nothing to read. */
+  if(rowstart && rowstart>=allrows)
+    {
+      for(i=0;i<numcols;++i)
+        gal_data_free_contents(&allcols[i]);
+      free(allcols);
+      return NULL;
+    }
+  if(numrows > allrows-rowstart) numrows=allrows-rowstart;
+
   /* Get the list of indexs in the same order as the input list. */
   indexll=gal_table_list_of_indexs(cols, allcols, numcols, searchin,
                                    ignorecase, filename, hdu, colmatch);
@@ -509,15 +527,19 @@ gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
   switch(tableformat)
     {
     case GAL_TABLE_FORMAT_TXT:
-      out=gal_txt_table_read(filename, lines, numrows, allcols, indexll,
-                             minmapsize, quietmmap);
+      if(numrows!=allrows)
+        error(EXIT_FAILURE, 0, "%s: reading a range of rows is currently "
+              "only possible in FITS tables", filename ? filename : "stdin");
+      out=gal_txt_table_read_threads(filename, lines, numrows, allcols,
+                                     indexll, numthreads, minmapsize,
+                                     quietmmap);
       break;
 
     case GAL_TABLE_FORMAT_AFITS:
     case GAL_TABLE_FORMAT_BFITS:
-      out=gal_fits_tab_read(filename, hdu, numrows, allcols, indexll,
-                            numthreads, minmapsize, quietmmap,
-                            hdu_option_name);
+      out=gal_fits_tab_read_rows(filename, hdu, rowstart, numrows, allcols,
+                                 indexll, numthreads, minmapsize, quietmmap,
+                                 hdu_option_name);
       break;
 
     default:
@@ -539,6 +561,22 @@ gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
 
 
 
+gal_data_t *
+gal_table_read(char *filename, char *hdu, gal_list_str_t *lines,
+               gal_list_str_t *cols, int searchin, int ignorecase,
+               size_t numthreads, size_t minmapsize, int quietmmap,
+               size_t *colmatch, char *hdu_option_name)
+{
+  return gal_table_read_rows(filename, hdu, lines, cols, searchin,
+                             ignorecase, 0, GAL_BLANK_SIZE_T, numthreads,
+                             minmapsize, quietmmap, colmatch,
+                             hdu_option_name);
+}
+
+
+
+
+
 
 
 
@@ -593,11 +631,15 @@ gal_table_comments_add_intro(gal_list_str_t **comments,
 
 /* The input is a linked list of data structures and some comments. The
    table will then be written into 'filename' with a format that is
-   specified by 'tableformat'. */
+   specified by 'tableformat'. Plain text tables are formatted with
+   'numthreads' threads. */
 void
-gal_table_write(gal_data_t *cols, struct gal_fits_list_key_t *keylist,
-                gal_list_str_t *comments, int tableformat, char *filename,
-                char *extname, uint8_t colinfoinstdout, int freekeys)
+gal_table_write_threads(gal_data_t *cols,
+                        struct gal_fits_list_key_t *keylist,
+                        gal_list_str_t *comments, int tableformat,
+                        char *filename, char *extname,
+                        uint8_t colinfoinstdout, int freekeys,
+                        size_t numthreads)
 {
   /* If a filename was given, then the tableformat is relevant and must be
      used. When the filename is empty, a text table must be printed on the
@@ -608,13 +650,26 @@ gal_table_write(gal_data_t *cols, struct gal_fits_list_key_t *keylist,
         gal_fits_tab_write(cols, comments, tableformat, filename, extname,
                            keylist, freekeys);
       else
-        gal_txt_write(cols, keylist, comments, filename,
-                      colinfoinstdout, 0, freekeys);
+        gal_txt_write_threads(cols, keylist, comments, filename,
+                              colinfoinstdout, 0, freekeys, numthreads);
     }
   else
     /* Write to standard output. */
-    gal_txt_write(cols, keylist, comments, filename, colinfoinstdout, 0,
-                  freekeys);
+    gal_txt_write_threads(cols, keylist, comments, filename,
+                          colinfoinstdout, 0, freekeys, numthreads);
+}
+
+
+
+
+
+void
+gal_table_write(gal_data_t *cols, struct gal_fits_list_key_t *keylist,
+                gal_list_str_t *comments, int tableformat, char *filename,
+                char *extname, uint8_t colinfoinstdout, int freekeys)
+{
+  gal_table_write_threads(cols, keylist, comments, tableformat, filename,
+                          extname, colinfoinstdout, freekeys, 1);
 }
 
 
@@ -189,11 +189,59 @@ char *
 gal_threads_dist_in_threads(size_t numactions, size_t numthreads,
                             size_t minmapsize, int quietmmap,
                             size_t **outthrds, size_t *outthrdcols)
+{
+  return gal_threads_dist_in_threads_schedule(numactions, numthreads,
+                                              GAL_THREADS_SCHEDULE_CYCLIC,
+                                              minmapsize, quietmmap,
+                                              outthrds, outthrdcols);
+}
+
+
+
+
+
+/* Similar to 'gal_threads_dist_in_threads', but the user can specify how
+   the actions should be distributed between the threads:
+
+     - 'GAL_THREADS_SCHEDULE_CYCLIC': action 'i' is given to thread
+       'i%numthreads' (so neighbouring actions are on different threads).
+
+     - 'GAL_THREADS_SCHEDULE_BLOCK': each thread is given a contiguous
+       block of actions (the first 'numactions%numthreads' threads will
+       have one extra action). When the actions are pixels, this keeps
+       the pixels (and thus the cache lines) of each thread together. */
+char *
+gal_threads_dist_in_threads_schedule(size_t numactions, size_t numthreads,
+                                     int schedule, size_t minmapsize,
+                                     int quietmmap, size_t **outthrds,
+                                     size_t *outthrdcols)
 {
   size_t *sp, *fp;
   char *mmapname=NULL;
-  size_t i, *thrds, thrdcols;
-  *outthrdcols = thrdcols = numactions/numthreads+2;
+  size_t i, j, *thrds, thrdcols, start, base, extra;
+
+  /* Sanity check. */
+  if(numthreads==0)
+    error(EXIT_FAILURE, 0, "%s: the number of threads ('numthreads') "
+          "cannot be zero", __func__);
+
+  /* Set the number of columns. */
+  switch(schedule)
+    {
+    case GAL_THREADS_SCHEDULE_CYCLIC:
+    case GAL_THREADS_SCHEDULE_BLOCK:
+      *outthrdcols = thrdcols = numactions/numthreads+2;
+      break;
+    case GAL_THREADS_SCHEDULE_DYNAMIC:
+      error(EXIT_FAILURE, 0, "%s: 'GAL_THREADS_SCHEDULE_DYNAMIC' is only "
+            "usable in 'gal_threads_spin_off_schedule' (the actions are "
+            "distributed while the threads are running)", __func__);
+    default:
+      error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at %s to fix "
+            "the problem. The value '%d' isn't recognized for "
+            "'schedule'", __func__, PACKAGE_BUGREPORT, schedule);
+      thrdcols=0; /* To avoid compiler warnings, will never reach here. */
+    }
 
   /* Allocate the space to keep the identifiers. */
   thrds=*outthrds=gal_pointer_allocate_ram_or_mmap(GAL_TYPE_SIZE_T,
@@ -205,8 +253,22 @@ gal_threads_dist_in_threads(size_t numactions, size_t numthreads,
   do *sp=GAL_BLANK_SIZE_T; while(++sp<fp);
 
   /* Distribute the labels in the threads.  */
-  for(i=0;i<numactions;++i)
-    thrds[ (i%numthreads)*thrdcols+(i/numthreads) ] = i;
+  switch(schedule)
+    {
+    case GAL_THREADS_SCHEDULE_CYCLIC:
+      for(i=0;i<numactions;++i)
+        thrds[ (i%numthreads)*thrdcols+(i/numthreads) ] = i;
+      break;
+
+    case GAL_THREADS_SCHEDULE_BLOCK:
+      start=0;
+      base=numactions/numthreads;
+      extra=numactions%numthreads;
+      for(i=0;i<numthreads;++i)
+        for(j=0; j < base + (i<extra); ++j)
+          thrds[ i*thrdcols+j ] = start++;
+      break;
+    }
 
   /* In case you want to see the result:
   for(i=0;i<numthreads;++i)
@@ -262,6 +324,376 @@ gal_threads_attr_barrier_init(pthread_attr_t *attr, pthread_barrier_t *b,
 
 
 
+/*******************************************************************/
+/************        Persistent pool of threads       **************/
+/*******************************************************************/
+/* Creating the threads (and their attributes) on every call to
+   'gal_threads_spin_off' is expensive when it is called many times on
+   small datasets (for example NoiseChisel, Segment or MakeCatalog on many
+   small cutouts). So the threads that run the workers are only created
+   once (on the first call that needs them) and are then kept waiting on a
+   condition variable for the next job. A job is given to the pool by
+   incrementing 'generation': each thread will then run the worker on its
+   respective element of 'prm' (if its ID is smaller than 'numrun', each
+   element is 'prmsize' bytes). The
+   worker's contract with its caller is unchanged: it will wait on the
+   barrier within 'prm' when it finishes, and the spinning thread waits on
+   the same barrier. */
+struct threads_pool
+{
+  pthread_mutex_t  lock;        /* Mutex for all the elements below.    */
+  pthread_cond_t   cond;        /* For waking the threads on a new job. */
+  size_t           numthreads;  /* Number of threads in the pool.       */
+  size_t           generation;  /* Number of jobs given to the pool.    */
+  int              busy;        /* The pool is currently running a job. */
+  size_t           numrun;      /* Number of threads to run this job.   */
+  size_t           prmsize;     /* Size of each element of 'prm'.       */
+  char            *prm;         /* Parameters of each thread.           */
+  void          *(*worker)(void *);          /* Worker of this job.     */
+};
+
+static struct threads_pool threads_pool = { PTHREAD_MUTEX_INITIALIZER,
+                                            PTHREAD_COND_INITIALIZER,
+                                            0, 0, 0, 0, 0, NULL, NULL };
+
+
+
+
+
+/* Function that runs on each thread of the pool. The input is a
+   two-element array: the first is the ID of this thread within the pool
+   and the second is the generation of the pool when this thread was
+   created (it may be created by the same call that gives it a job, so it
+   shouldn't be read from the pool within the thread). */
+static void *
+threads_pool_run(void *in)
+{
+  size_t id=((size_t *)in)[0], gen=((size_t *)in)[1];
+  void *(*worker)(void *);
+  void *prm;
+
+  /* The input was only allocated to pass these two numbers. */
+  free(in);
+
+  /* Wait for a job, run it and go back to waiting for the next job. */
+  pthread_mutex_lock(&threads_pool.lock);
+  while(1)
+    {
+      /* Wait until a new job is given to the pool. */
+      while(threads_pool.generation==gen)
+        pthread_cond_wait(&threads_pool.cond, &threads_pool.lock);
+      gen=threads_pool.generation;
+
+      /* This thread isn't necessary for this job. */
+      if(id>=threads_pool.numrun) continue;
+
+      /* Run the worker (without holding the lock). The worker will wait
+         on the barrier of this job before returning. */
+      worker=threads_pool.worker;
+      prm=threads_pool.prm+id*threads_pool.prmsize;
+      pthread_mutex_unlock(&threads_pool.lock);
+      worker(prm);
+      pthread_mutex_lock(&threads_pool.lock);
+    }
+
+  /* Control never reaches here. */
+  return NULL;
+}
+
+
+
+
+
+/* After a 'fork', only the thread that called it exists in the child. So
+   the pool has to be emptied (it will be re-built on the next call). */
+static void
+threads_pool_atfork_child(void)
+{
+  pthread_mutex_init(&threads_pool.lock, NULL);
+  pthread_cond_init(&threads_pool.cond, NULL);
+  threads_pool.busy=0;
+  threads_pool.numrun=0;
+  threads_pool.prm=NULL;
+  threads_pool.prmsize=0;
+  threads_pool.worker=NULL;
+  threads_pool.numthreads=0;
+}
+
+
+
+
+
+/* Add threads to the pool until it has 'numthreads' threads. This is
+   called while the pool is locked. */
+static void
+threads_pool_grow(size_t numthreads)
+{
+  int err;
+  pthread_t t;
+  size_t *in;
+  pthread_attr_t attr;
+
+  /* On the first call, make sure that the pool is reset in any forked
+     child process. */
+  if(threads_pool.numthreads==0 && threads_pool.generation==0)
+    {
+      err=pthread_atfork(NULL, NULL, threads_pool_atfork_child);
+      if(err)
+        error(EXIT_FAILURE, err, "%s: couldn't register fork handler",
+              __func__);
+    }
+
+  /* The pool's threads are detached (they are never joined). */
+  err=pthread_attr_init(&attr);
+  if(err) error(EXIT_FAILURE, err, "%s: thread attr not initialized",
+                __func__);
+  err=pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if(err) error(EXIT_FAILURE, err, "%s: thread attr not detached",
+                __func__);
+
+  /* Create the new threads. */
+  while(threads_pool.numthreads<numthreads)
+    {
+      in=malloc(2*sizeof *in);
+      if(in==NULL)
+        error(EXIT_FAILURE, errno, "%s: %zu bytes for 'in'", __func__,
+              2*sizeof *in);
+      in[0]=threads_pool.numthreads;
+      in[1]=threads_pool.generation;
+      err=pthread_create(&t, &attr, threads_pool_run, in);
+      if(err)
+        error(EXIT_FAILURE, err, "%s: can't create thread %zu",
+              __func__, threads_pool.numthreads);
+      ++threads_pool.numthreads;
+    }
+
+  /* Clean up. */
+  pthread_attr_destroy(&attr);
+}
+
+
+
+
+
+/* Give the job to the pool. The 'prm' array should have 'numrun'
+   elements (each 'prmsize' bytes) and all of them should be used in this
+   job (each is passed to 'worker' on one thread). If the pool is
+   already busy (the caller is itself a worker of the pool or another
+   thread of the caller's program is using it), this function will return
+   0 and the caller should spin-off its own threads. Otherwise, it will
+   return 1 after giving the job to the pool. */
+static int
+threads_pool_dispatch(void *(*worker)(void *), void *prm, size_t prmsize,
+                      size_t numrun)
+{
+  size_t pnum;
+
+  /* See if the pool can take this job. */
+  pthread_mutex_lock(&threads_pool.lock);
+  if(threads_pool.busy)
+    {
+      pthread_mutex_unlock(&threads_pool.lock);
+      return 0;
+    }
+
+  /* Make sure there are enough threads in the pool: we'll use the
+     number of threads available to the program as a minimum to avoid
+     having to grow it on the next call. */
+  if(threads_pool.numthreads<numrun)
+    {
+      pnum=gal_threads_number();
+      threads_pool_grow(numrun>pnum ? numrun : pnum);
+    }
+
+  /* Give the job to the threads and wake them up. */
+  threads_pool.busy=1;
+  threads_pool.prm=prm;
+  threads_pool.numrun=numrun;
+  threads_pool.prmsize=prmsize;
+  threads_pool.worker=worker;
+  ++threads_pool.generation;
+  pthread_cond_broadcast(&threads_pool.cond);
+  pthread_mutex_unlock(&threads_pool.lock);
+  return 1;
+}
+
+
+
+
+
+/* The job given to the pool has finished (all its workers have passed
+   the barrier), so let the pool accept new jobs. */
+static void
+threads_pool_release(void)
+{
+  pthread_mutex_lock(&threads_pool.lock);
+  threads_pool.busy=0;
+  threads_pool.numrun=0;
+  threads_pool.prm=NULL;
+  threads_pool.prmsize=0;
+  threads_pool.worker=NULL;
+  pthread_mutex_unlock(&threads_pool.lock);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*******************************************************************/
+/************     Dynamic distribution of actions     **************/
+/*******************************************************************/
+/* With 'GAL_THREADS_SCHEDULE_DYNAMIC', the actions aren't distributed
+   before the threads start: each thread takes the next chunk of actions
+   from a shared counter when it has finished its previous chunk, so
+   threads with faster actions will simply do more chunks. The worker
+   will be called on every chunk (with 'b==NULL', so it won't wait on the
+   barrier) and this module's own function will wait on the barrier when
+   no more actions remain. */
+struct threads_dynamic
+{
+  size_t             next;    /* Next action to give to a thread.       */
+  size_t       numactions;    /* Total number of actions.               */
+  size_t       numthreads;    /* Number of threads.                     */
+  size_t        chunksize;    /* Actions in each chunk (0: decreasing). */
+  pthread_barrier_t    *b;    /* Barrier of all the threads.            */
+  void     *(*worker)(void *);      /* The caller's worker function.    */
+#ifndef __ATOMIC_RELAXED
+  pthread_mutex_t    lock;    /* When atomic built-ins aren't available.*/
+#endif
+};
+
+/* Parameters for each thread with the dynamic schedule. */
+struct threads_dynamic_params
+{
+  struct gal_threads_params tprm;  /* Parameters given to the worker.   */
+  struct threads_dynamic    *dyn;  /* Shared between all threads.       */
+};
+
+
+
+
+
+/* Number of actions to give in a chunk when 'cur' actions have already
+   been given. When the user hasn't given a chunk size, the chunk size
+   will decrease as less actions remain: large chunks at the start (when
+   there are many actions, to decrease the number of calls to the worker
+   and keep the actions of each thread together) and small chunks at the
+   end (to balance the load between the threads). */
+static size_t
+threads_dynamic_chunk(struct threads_dynamic *dyn, size_t cur)
+{
+  size_t num, remain=dyn->numactions-cur;
+
+  num = ( dyn->chunksize
+          ? dyn->chunksize
+          : remain/(2*dyn->numthreads) );
+  if(num==0) num=1;
+  return num<remain ? num : remain;
+}
+
+
+
+
+
+/* Put the first and last (not inclusive) indexs of the next chunk into
+   'start' and 'end' (and return 1). If there are no more actions, return
+   0. */
+static int
+threads_dynamic_next(struct threads_dynamic *dyn, size_t *start,
+                     size_t *end)
+{
+  size_t cur, num;
+
+#ifdef __ATOMIC_RELAXED
+  /* Atomic built-in functions are available (GCC and Clang), so there is
+     no need to lock: if another thread has changed 'dyn->next' since we
+     read it, 'cur' will be updated and we'll try again. */
+  cur=__atomic_load_n(&dyn->next, __ATOMIC_RELAXED);
+  do
+    {
+      if(cur>=dyn->numactions) return 0;
+      num=threads_dynamic_chunk(dyn, cur);
+    }
+  while( !__atomic_compare_exchange_n(&dyn->next, &cur, cur+num, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED) );
+#else
+  pthread_mutex_lock(&dyn->lock);
+  cur=dyn->next;
+  if(cur>=dyn->numactions)
+    {
+      pthread_mutex_unlock(&dyn->lock);
+      return 0;
+    }
+  num=threads_dynamic_chunk(dyn, cur);
+  dyn->next+=num;
+  pthread_mutex_unlock(&dyn->lock);
+#endif
+
+  /* Write the range. */
+  *start=cur;
+  *end=cur+num;
+  return 1;
+}
+
+
+
+
+
+/* Function that is run on each thread with the dynamic schedule. */
+static void *
+threads_dynamic_worker(void *in)
+{
+  struct threads_dynamic_params *dprm=(struct threads_dynamic_params *)in;
+  struct threads_dynamic *dyn=dprm->dyn;
+  size_t i, start, end;
+
+  /* Take chunks and run the worker on them until none remain. */
+  while( threads_dynamic_next(dyn, &start, &end) )
+    {
+      for(i=start;i<end;++i) dprm->tprm.indexs[i-start]=i;
+      dprm->tprm.indexs[end-start]=GAL_BLANK_SIZE_T;
+      dyn->worker(&dprm->tprm);
+    }
+
+  /* Wait for all the other threads to finish. */
+  pthread_barrier_wait(dyn->b);
+  return NULL;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
 /*******************************************************************/
 /************     Run a function on multiple threads  **************/
 /*******************************************************************/
@@ -338,14 +770,83 @@ void
 gal_threads_spin_off(void *(*worker)(void *), void *caller_params,
                      size_t numactions, size_t numthreads,
                      size_t minmapsize, int quietmmap)
+{
+  gal_threads_spin_off_schedule(worker, caller_params, numactions,
+                                numthreads, GAL_THREADS_SCHEDULE_CYCLIC, 0,
+                                minmapsize, quietmmap);
+}
+
+
+
+
+
+/* Run 'worker' on 'numrun' threads: the parameters of each thread are an
+   element of 'prm' (each element has 'prmsize' bytes). Each thread should
+   wait on the barrier 'b' (which should have been initialized for
+   'numrun+1' threads) when it is done and this function will return when
+   all have finished. */
+static void
+threads_run(void *(*worker)(void *), void *prm, size_t prmsize,
+            size_t numrun, pthread_barrier_t *b)
 {
   int err;
+  size_t i;
   pthread_t t;          /* All thread ids saved in this, not used. */
-  char *mmapname=NULL;
   pthread_attr_t attr;
+
+  /* Give the job to the persistent pool of threads. If the pool is busy
+     (for example this function has been called within one of its
+     workers), spin-off new (detached) threads. */
+  if( threads_pool_dispatch(worker, prm, prmsize, numrun) )
+    {
+      pthread_barrier_wait(b);
+      threads_pool_release();
+    }
+  else
+    {
+      err=pthread_attr_init(&attr);
+      if(err) error(EXIT_FAILURE, 0, "%s: thread attr not initialized",
+                    __func__);
+      err=pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+      if(err) error(EXIT_FAILURE, 0, "%s: thread attr not detached",
+                    __func__);
+      for(i=0;i<numrun;++i)
+        {
+          err=pthread_create(&t, &attr, worker, (char *)prm+i*prmsize);
+          if(err)
+            {
+              fprintf(stderr, "can't create thread %zu", i);
+              exit(EXIT_FAILURE);
+            }
+        }
+      pthread_barrier_wait(b);
+      pthread_attr_destroy(&attr);
+    }
+}
+
+
+
+
+
+/* Similar to 'gal_threads_spin_off', but the user can specify how the
+   actions should be distributed between the threads ('schedule' can
+   have any of the 'GAL_THREADS_SCHEDULE_*' values). With
+   'GAL_THREADS_SCHEDULE_DYNAMIC', 'chunksize' is the number of actions
+   that are given to the worker in every call (when it is zero, the chunks
+   will become smaller as less actions remain). */
+void
+gal_threads_spin_off_schedule(void *(*worker)(void *), void *caller_params,
+                              size_t numactions, size_t numthreads,
+                              int schedule, size_t chunksize,
+                              size_t minmapsize, int quietmmap)
+{
+  int err;
+  char *mmapname=NULL;
   pthread_barrier_t b;
+  struct threads_dynamic dyn;
   struct gal_threads_params *prm;
-  size_t i, *indexs, thrdcols, numbarriers;
+  struct threads_dynamic_params *dprm;
+  size_t i, *indexs, thrdcols, numrun, numbarriers;
 
   /* If there are no actions, then just return. */
   if(numactions==0) return;
@@ -355,62 +856,116 @@ gal_threads_spin_off(void *(*worker)(void *), void *caller_params,
     error(EXIT_FAILURE, 0, "%s: the number of threads ('numthreads') "
           "cannot be zero", __func__);
 
-  /* Allocate the array of parameters structure. */
-  errno=0;
-  prm=malloc(numthreads*sizeof *prm);
-  if(prm==NULL)
-    {
-      fprintf(stderr, "%zu bytes could not be allocated for prm.",
-              numthreads*sizeof *prm);
-      exit(EXIT_FAILURE);
-    }
-
-  /* Distribute the actions into the threads: */
-  mmapname=gal_threads_dist_in_threads(numactions, numthreads, minmapsize,
-                                       quietmmap, &indexs, &thrdcols);
-
   /* Do the job: when only one thread is necessary, there is no need to
      spin-off one thread, just call the workerfunction directly (spinning
      off threads is expensive). This is for the generic thread spinner
      function, not this simple function where 'numthreads' is a
-     constant. */
+     constant. With one thread, all schedules are identical. */
   if(numthreads==1)
     {
-      prm[0].id=0;
-      prm[0].b=NULL;
-      prm[0].indexs=indexs;
-      prm[0].params=caller_params;
-      worker(&prm[0]);
+      mmapname=gal_threads_dist_in_threads(numactions, 1, minmapsize,
+                                           quietmmap, &indexs, &thrdcols);
+      prm=gal_pointer_allocate(GAL_TYPE_UINT8, sizeof *prm, 0, __func__,
+                               "prm");
+      prm->id=0;
+      prm->b=NULL;
+      prm->indexs=indexs;
+      prm->params=caller_params;
+      worker(prm);
+      free(prm);
+    }
+
+  /* Dynamic schedule: each thread has a buffer (that can keep the largest
+     chunk) and the actions are given to them while they are running. */
+  else if(schedule==GAL_THREADS_SCHEDULE_DYNAMIC)
+    {
+      /* Initialize the shared structure. */
+      dyn.b=&b;
+      dyn.next=0;
+      dyn.worker=worker;
+      dyn.chunksize=chunksize;
+      dyn.numthreads=numthreads;
+      dyn.numactions=numactions;
+#ifndef __ATOMIC_RELAXED
+      err=pthread_mutex_init(&dyn.lock, NULL);
+      if(err) error(EXIT_FAILURE, err, "%s: mutex not initialized",
+                    __func__);
+#endif
+
+      /* Allocate the buffers of each thread (the first chunk is the
+         largest). */
+      thrdcols=threads_dynamic_chunk(&dyn, 0)+1;
+      indexs=gal_pointer_allocate_ram_or_mmap(GAL_TYPE_SIZE_T,
+                                              numthreads*thrdcols, 0,
+                                              minmapsize, &mmapname,
+                                              quietmmap, __func__,
+                                              "indexs");
+
+      /* Set the parameters of each thread. */
+      numrun = numactions<numthreads ? numactions : numthreads;
+      dprm=gal_pointer_allocate(GAL_TYPE_UINT8, numrun*sizeof *dprm, 0,
+                                __func__, "dprm");
+      for(i=0;i<numrun;++i)
+        {
+          dprm[i].dyn=&dyn;
+          dprm[i].tprm.id=i;
+          dprm[i].tprm.b=NULL;
+          dprm[i].tprm.params=caller_params;
+          dprm[i].tprm.indexs=&indexs[i*thrdcols];
+        }
+
+      /* Run the threads. Note that this running thread (that spins-off
+         the threads) is also a thread, so the number the barriers should
+         be one more than the number of threads spinned off. */
+      numbarriers = numrun + 1;
+      err=pthread_barrier_init(&b, NULL, numbarriers);
+      if(err) error(EXIT_FAILURE, 0, "%s: thread barrier not initialized",
+                    __func__);
+      threads_run(threads_dynamic_worker, dprm, sizeof *dprm, numrun, &b);
+      pthread_barrier_destroy(&b);
+
+      /* Clean up. */
+      free(dprm);
+#ifndef __ATOMIC_RELAXED
+      pthread_mutex_destroy(&dyn.lock);
+#endif
     }
+
+  /* Static schedules: the actions are distributed before spinning off
+     the threads. */
   else
     {
-      /* Initialize the attributes. Note that this running thread
-         (that spins-off the nt threads) is also a thread, so the
-         number the barriers should be one more than the number of
-         threads spinned off. */
-      numbarriers = (numactions<numthreads ? numactions : numthreads) + 1;
-      gal_threads_attr_barrier_init(&attr, &b, numbarriers);
-
-      /* Spin-off the threads: */
+      /* Distribute the actions into the threads: */
+      mmapname=gal_threads_dist_in_threads_schedule(numactions, numthreads,
+                                                    schedule, minmapsize,
+                                                    quietmmap, &indexs,
+                                                    &thrdcols);
+
+      /* Set the parameters of the threads that have a job. Note that
+         this running thread (that spins-off the threads) is also a
+         thread, so the number the barriers should be one more than the
+         number of threads spinned off. */
+      numrun=0;
+      prm=gal_pointer_allocate(GAL_TYPE_UINT8, numthreads*sizeof *prm, 0,
+                               __func__, "prm");
       for(i=0;i<numthreads;++i)
         if(indexs[i*thrdcols]!=GAL_BLANK_SIZE_T)
           {
-            prm[i].id=i;
-            prm[i].b=&b;
-            prm[i].params=caller_params;
-            prm[i].indexs=&indexs[i*thrdcols];
-            err=pthread_create(&t, &attr, worker, &prm[i]);
-            if(err)
-              {
-                fprintf(stderr, "can't create thread %zu", i);
-                exit(EXIT_FAILURE);
-              }
+            prm[numrun].id=i;
+            prm[numrun].b=&b;
+            prm[numrun].params=caller_params;
+            prm[numrun].indexs=&indexs[i*thrdcols];
+            ++numrun;
           }
+      numbarriers = numrun + 1;
 
-      /* Wait for all threads to finish and free the spaces. */
-      pthread_barrier_wait(&b);
-      pthread_attr_destroy(&attr);
+      /* Spin-off the threads and wait for them to finish. */
+      err=pthread_barrier_init(&b, NULL, numbarriers);
+      if(err) error(EXIT_FAILURE, 0, "%s: thread barrier not initialized",
+                    __func__);
+      threads_run(worker, prm, sizeof *prm, numrun, &b);
       pthread_barrier_destroy(&b);
+      free(prm);
     }
 
   /* If 'mmapname' is NULL, then 'indexs' is in RAM and we can safely
@@ -419,7 +974,4 @@ gal_threads_spin_off(void *(*worker)(void *), void *caller_params,
      to delete it through the proper function. */
   if(mmapname) gal_pointer_mmap_free(&mmapname, quietmmap);
   else         free(indexs);
-
-  /* Clean up. */
-  free(prm);
 }
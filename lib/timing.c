@@ -82,3 +82,21 @@ gal_timing_report(struct timeval *t1, char *jobname, size_t level)
       else printf("  ---- %s\n", jobname);
     }
 }
+
+
+
+
+
+/* Rate (in megabytes per second) of reading or writing 'nbytes' since
+   't1' (to report the speed of input/output operations). */
+double
+gal_timing_rate(struct timeval *t1, size_t nbytes)
+{
+  double dt;
+  struct timeval t2;
+
+  gettimeofday(&t2, NULL);
+  dt= ( ((double)t2.tv_sec+(double)t2.tv_usec/1e6) -
+        ((double)t1->tv_sec+(double)t1->tv_usec/1e6) );
+  return nbytes / 1e6 / (dt>1e-6 ? dt : 1e-6);
+}
@@ -29,7 +29,10 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <error.h>
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <gnuastro/txt.h>
 #include <gnuastro/list.h>
@@ -37,6 +40,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/blank.h>
 #include <gnuastro/table.h>
 #include <gnuastro/pointer.h>
+#include <gnuastro/threads.h>
 #include <gnuastro/statistics.h>
 
 #include <gnuastro-internal/checkset.h>
@@ -1410,10 +1414,491 @@ txt_read_prepare(gal_data_t *info, size_t *indsize,
 
 
 
+/* The plain-text files (not the standard input) are parsed directly from
+   a memory-mapped copy of the file, by multiple threads: the file is
+   split into chunks (each starting after a new-line character), and each
+   thread reads the rows of its chunks directly into the final output
+   arrays. When there is more than one chunk, the number of lines and data
+   rows in each chunk is found in a first (fast) pass. */
+#define TXT_READ_MMAP_MINCHUNK 1048576 /* Minimum bytes in each chunk. */
+struct txt_read_mmap_params
+{
+  char            *filename;  /* Name of input file (for errors).       */
+  int                format;  /* Format of input (table or image).      */
+  int                 count;  /* ==1: only count the lines and rows.    */
+  size_t          numchunks;  /* Number of chunks.                      */
+  char             **bounds;  /* Start of each chunk (and end of last). */
+  size_t          *firstrow;  /* Data row number at start of chunk.     */
+  size_t         *firstline;  /* Line number at start of chunk.         */
+  size_t         ntokforout;  /* Last token that is used in the output. */
+  size_t       *tokenvecind;  /* Vector index of each token.            */
+  gal_data_t   **tokeninout;  /* Output column of each token.           */
+  gal_data_t  **tokenininfo;  /* Information of each token.             */
+};
+
+
+
+
+
+/* Same as 'gal_txt_line_stat', but for a line that ends at 'end' (the
+   position of the new-line character or the end of the file). */
+static int
+txt_read_mmap_line_stat(char *line, char *end)
+{
+  for(;line<end;++line)
+    switch(*line)
+      {
+      case ' ': case ',': case '\t': break;
+      case '#': return GAL_TXT_LINESTAT_COMMENT;
+      default:  return GAL_TXT_LINESTAT_DATAROW;
+      }
+  return GAL_TXT_LINESTAT_BLANK;
+}
+
+
+
+
+
+/* If the token (from 'start' to 'end') is a plain integer (with less
+   than 19 digits, to avoid overflows), write it in 'out' and return 1,
+   otherwise, return 0. */
+static int
+txt_read_mmap_parse_int(char *start, char *end, int64_t *out)
+{
+  int neg=0;
+  int64_t v=0;
+  char *c=start;
+
+  if(c<end && (*c=='-' || *c=='+')) neg = *c++=='-';
+  if(c==end || end-c>18) return 0;
+  for(;c<end;++c)
+    {
+      if(*c<'0' || *c>'9') return 0;
+      v = v*10 + (*c-'0');
+    }
+  *out = neg ? -v : v;
+  return 1;
+}
+
+
+
+
+
+/* If the token (from 'start' to 'end') is a decimal number (with an
+   optional exponent) that can be converted exactly, write it in 'out' and
+   return 1, otherwise return 0 (so 'strtod' is used). The conversion is
+   exact (identical to 'strtod') when there are at most 19 significant
+   digits, the integer of the significant digits is not larger than 2^53
+   and the power of ten is within +-22: all these numbers are exactly
+   representable in a 'double', so the single multiplication or division
+   is correctly rounded. */
+static int
+txt_read_mmap_parse_float(char *start, char *end, double *out)
+{
+  double d;
+  uint64_t m=0;
+  char *c=start;
+  long e=0, ex=0;
+  int neg=0, eneg=0, ndig=0, anydigit=0;
+  static const double p10[]={1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                             1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                             1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                             1e18, 1e19, 1e20, 1e21, 1e22};
+
+  /* Sign and the digits before and after the decimal point (the leading
+     zeros are not significant). */
+  if(c<end && (*c=='-' || *c=='+')) neg = *c++=='-';
+  for(; c<end && *c>='0' && *c<='9'; ++c)
+    {
+      anydigit=1;
+      if(m==0 && *c=='0') continue;
+      if(++ndig>19) return 0;
+      m = m*10 + (*c-'0');
+    }
+  if(c<end && *c=='.')
+    for(++c; c<end && *c>='0' && *c<='9'; ++c)
+      {
+        anydigit=1; --e;
+        if(m==0 && *c=='0') continue;
+        if(++ndig>19) return 0;
+        m = m*10 + (*c-'0');
+      }
+  if(anydigit==0) return 0;
+
+  /* The exponent. */
+  if(c<end && (*c=='e' || *c=='E'))
+    {
+      if(++c<end && (*c=='-' || *c=='+')) eneg = *c++=='-';
+      if(c==end) return 0;
+      for(; c<end && *c>='0' && *c<='9'; ++c)
+        if( (ex = ex*10 + (*c-'0')) > 1000 ) return 0;
+      e += eneg ? -ex : ex;
+    }
+
+  /* The full token should have been parsed. */
+  if(c!=end) return 0;
+
+  /* Write the value. */
+  if(m==0) { *out = neg ? -0.0 : 0.0; return 1; }
+  if(m > ((uint64_t)1<<53) || e<-22 || e>22) return 0;
+  d = e<0 ? (double)m/p10[-e] : (double)m*p10[e];
+  *out = neg ? -d : d;
+  return 1;
+}
+
+
+
+
+
+/* Parse the simple numbers of a token without 'strtol' or 'strtod' (and
+   without copying the token). If the token needs any special treatment
+   (for example it is in the '_h_m_s' format, the blank value is a string,
+   or it can't be read), this function will return 0, so 'txt_read_token'
+   is used. */
+static int
+txt_read_mmap_token_fast(gal_data_t *data, gal_data_t *info, char *start,
+                         char *end, size_t i)
+{
+  double d=NAN;
+  int64_t l=0;
+
+  /* The token can be parsed here. */
+  if(info->flag & GAL_TABLEINTERN_FLAG_ARRAY_IS_BLANK_STRING) return 0;
+  switch(data->type)
+    {
+    case GAL_TYPE_STRING: return 0;
+    case GAL_TYPE_FLOAT32:
+    case GAL_TYPE_FLOAT64:
+      if( txt_read_mmap_parse_float(start, end, &d)==0 ) return 0;
+      break;
+    default:
+      if( txt_read_mmap_parse_int(start, end, &l)==0 ) return 0;
+    }
+
+  /* Write the value into the column, using the same conversions as
+     'txt_read_token'. */
+#define TXT_READ_FAST_INT(IT, BLANK) {                                  \
+    IT *a=data->array, *b=info->array;                                  \
+    a[i]=l; if( b && *b==a[i] ) a[i]=BLANK;                             \
+  } break;
+#define TXT_READ_FAST_FLT(IT, BLANK) {                                  \
+    IT *a=data->array, *b=info->array;                                  \
+    a[i]=d; if( b && ( (isnan(*b) && isnan(a[i])) || *b==a[i] ) )       \
+              a[i]=BLANK;                                               \
+  } break;
+  switch(data->type)
+    {
+    case GAL_TYPE_UINT8:   TXT_READ_FAST_INT(uint8_t,  GAL_BLANK_UINT8);
+    case GAL_TYPE_INT8:    TXT_READ_FAST_INT(int8_t,   GAL_BLANK_INT8);
+    case GAL_TYPE_UINT16:  TXT_READ_FAST_INT(uint16_t, GAL_BLANK_UINT16);
+    case GAL_TYPE_INT16:   TXT_READ_FAST_INT(int16_t,  GAL_BLANK_INT16);
+    case GAL_TYPE_UINT32:  TXT_READ_FAST_INT(uint32_t, GAL_BLANK_UINT32);
+    case GAL_TYPE_INT32:   TXT_READ_FAST_INT(int32_t,  GAL_BLANK_INT32);
+    case GAL_TYPE_UINT64:  TXT_READ_FAST_INT(uint64_t, GAL_BLANK_UINT64);
+    case GAL_TYPE_INT64:   TXT_READ_FAST_INT(int64_t,  GAL_BLANK_INT64);
+    case GAL_TYPE_FLOAT32: TXT_READ_FAST_FLT(float,    GAL_BLANK_FLOAT32);
+    case GAL_TYPE_FLOAT64: TXT_READ_FAST_FLT(double,   GAL_BLANK_FLOAT64);
+    default:
+      error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at '%s' to "
+            "fix the problem. Type code %d not recognized", __func__,
+            PACKAGE_BUGREPORT, data->type);
+    }
+#undef TXT_READ_FAST_INT
+#undef TXT_READ_FAST_FLT
+  return 1;
+}
+
+
+
+
+
+/* Read the token that starts at 'start' and finishes before 'end' into
+   element 'i' of 'data'. When the token can't be parsed in place, it is
+   copied (into the thread's '*buf' that has '*buflen' bytes) and given to
+   'txt_read_token'. */
+static void
+txt_read_mmap_token(gal_data_t *data, gal_data_t *info, char *start,
+                    char *end, size_t i, char *filename, size_t lineno,
+                    size_t toknum, char **buf, size_t *buflen)
+{
+  size_t len=end-start;
+
+  /* Simple numbers. */
+  if( txt_read_mmap_token_fast(data, info, start, end, i) ) return;
+
+  /* Copy the token into a "standard" string (ending with '\0'). */
+  if(len+1>*buflen)
+    {
+      errno=0;
+      *buflen=2*(len+1);
+      *buf=realloc(*buf, *buflen);
+      if(*buf==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+              "'buf'", __func__, *buflen);
+    }
+  memcpy(*buf, start, len);
+  (*buf)[len]='\0';
+
+  /* Parse the token. */
+  txt_read_token(data, info, *buf, i, filename, lineno, toknum);
+}
+
+
+
+
+
+/* Similar to 'txt_fill', but for a line in the memory-mapped file (that
+   isn't terminated with a '\0' and shouldn't be modified). 'end' is the
+   position of the new-line character (or the end of the file). */
+static void
+txt_read_mmap_fill(struct txt_read_mmap_params *p, char *line, char *end,
+                   size_t rowind, size_t lineno, char **buf,
+                   size_t *buflen)
+{
+  char *tstart;
+  gal_data_t *otmp, *info;
+  size_t n=0, ind, strwidth;
+
+  /* Ignore the carriage return (ASCII code 13) before the new-line
+     character (see 'txt_fill'). */
+  if( end-line>=2 && *(end-1)==13 ) --end;
+
+  /* Parse the line, token by token (see the comments in 'txt_fill'). */
+  while(n<=p->ntokforout)
+    {
+      info = p->tokenininfo[ p->format==TXT_FORMAT_TABLE ? n : 0 ];
+      if( p->format==TXT_FORMAT_TABLE && info->type==GAL_TYPE_STRING )
+        {
+          /* Go to the start of the string and read it. */
+          while( line<end && (isspace(*line) || *line==',') ) ++line;
+          if(line==end) break;
+          strwidth = (line+info->disp_width)<end ? info->disp_width
+                                                 : end-line;
+          for(otmp=p->tokeninout[n]; otmp!=NULL; otmp=otmp->block)
+            txt_read_mmap_token(otmp, info, line, line+strwidth, rowind,
+                                p->filename, lineno, n, buf, buflen);
+          line += strwidth;
+        }
+      else
+        {
+          /* Find the start and end of this token (the delimiters are
+             the same as 'GAL_TXT_DELIMITERS'). */
+          while( line<end && ( *line==' ' || *line==',' || *line=='\t'
+                               || *line=='\f' || *line=='\v' ) ) ++line;
+          if(line==end) break;
+          tstart=line;
+          while( line<end && *line!=' ' && *line!=',' && *line!='\t'
+                 && *line!='\f' && *line!='\v' ) ++line;
+
+          /* Write the token in the output(s). */
+          if(p->format==TXT_FORMAT_TABLE)
+            {
+              ind = rowind * info->minmapsize + p->tokenvecind[n];
+              for(otmp=p->tokeninout[n]; otmp!=NULL; otmp=otmp->block)
+                txt_read_mmap_token(otmp, info, tstart, line, ind,
+                                    p->filename, lineno, n, buf, buflen);
+            }
+          else
+            txt_read_mmap_token(p->tokeninout[0], info, tstart, line,
+                                rowind*p->tokeninout[0]->dsize[1]+n,
+                                p->filename, lineno, n, buf, buflen);
+        }
+
+      /* Increment the token counter. */
+      ++n;
+    }
+
+  /* Report an error if there weren't enough columns. */
+  if(n<=p->ntokforout)
+    error_at_line(EXIT_FAILURE, 0, p->filename, lineno, "not enough "
+                  "columns in this line");
+}
+
+
+
+
+
+/* Go over the lines of one chunk and count (or read) its data rows. */
+static void
+txt_read_mmap_chunk(struct txt_read_mmap_params *p, size_t c)
+{
+  size_t buflen=0;
+  char *line, *end, *buf=NULL, *cend=p->bounds[c+1];
+  size_t lineno=p->firstline[c], rowind=p->firstrow[c];
+
+  /* Go over the lines. */
+  for(line=p->bounds[c]; line<cend; line=end+1)
+    {
+      /* Find the end of this line. */
+      end=memchr(line, '\n', cend-line);
+      if(end==NULL) end=cend;
+
+      /* Count or read this line. */
+      ++lineno;
+      if( txt_read_mmap_line_stat(line, end) == GAL_TXT_LINESTAT_DATAROW )
+        {
+          if(p->count==0)
+            txt_read_mmap_fill(p, line, end, rowind, lineno, &buf,
+                               &buflen);
+          ++rowind;
+        }
+    }
+
+  /* When counting, keep the number of lines and rows in this chunk (they
+     will be converted to the starting numbers of each chunk later). */
+  if(p->count)
+    {
+      p->firstline[c]=lineno;
+      p->firstrow[c]=rowind;
+    }
+
+  /* Clean up. */
+  free(buf);
+}
+
+
+
+
+
+/* Worker function on each thread. */
+static void *
+txt_read_mmap_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct txt_read_mmap_params *p=(struct txt_read_mmap_params *)tprm->params;
+
+  size_t i;
+
+  /* Go over all the chunks that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    txt_read_mmap_chunk(p, tprm->indexs[i]);
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Map the 'size' bytes of 'filename' into memory. The mapping is private
+   (changes are never written into the file), so the parser can write
+   into it like the lines that are read with 'getline'. If the file can't
+   be mapped, NULL is returned. */
+static char *
+txt_read_mmap_file(char *filename, size_t size)
+{
+  int filedes;
+  char *start;
+
+  /* Open the file and map it. */
+  filedes=open(filename, O_RDONLY);
+  if(filedes==-1) { errno=0; return NULL; }
+  start=mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, filedes, 0);
+  close(filedes);
+
+  /* Return the mapped array. */
+  if(start==MAP_FAILED) { errno=0; return NULL; }
+  return start;
+}
+
+
+
+
+
+/* Read the file by memory-mapping it (see the comments above
+   'TXT_READ_MMAP_MINCHUNK'). If the file couldn't be mapped, this
+   function will return 0 (so the file is read with 'getline'). */
+static int
+txt_read_mmap(char *filename, int format, gal_data_t **tokeninout,
+              size_t ntokforout, gal_data_t **tokenininfo,
+              size_t *tokenvecind, size_t numthreads, size_t minmapsize,
+              int quietmmap)
+{
+  size_t c, nl, nr;
+  struct stat st;
+  char *start, *end, *nlptr;
+  struct txt_read_mmap_params p;
+
+  /* Map the file into memory (only regular files can be mapped). */
+  if( stat(filename, &st) || !S_ISREG(st.st_mode) || st.st_size==0 )
+    return 0;
+  start=txt_read_mmap_file(filename, st.st_size);
+  if(start==NULL) return 0;
+  end=start+st.st_size;
+
+  /* Set the number of chunks (so each chunk has a minimum size). */
+  p.numchunks=st.st_size/TXT_READ_MMAP_MINCHUNK;
+  if(p.numchunks>numthreads) p.numchunks=numthreads;
+  if(p.numchunks==0) p.numchunks=1;
+
+  /* Set the basic parameters. */
+  p.format=format;
+  p.filename=filename;
+  p.ntokforout=ntokforout;
+  p.tokeninout=tokeninout;
+  p.tokenvecind=tokenvecind;
+  p.tokenininfo=tokenininfo;
+  p.firstrow=gal_pointer_allocate(GAL_TYPE_SIZE_T, p.numchunks, 1,
+                                  __func__, "p.firstrow");
+  p.firstline=gal_pointer_allocate(GAL_TYPE_SIZE_T, p.numchunks, 1,
+                                   __func__, "p.firstline");
+  errno=0;
+  p.bounds=malloc((p.numchunks+1)*sizeof *p.bounds);
+  if(p.bounds==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'p.bounds'", __func__, (p.numchunks+1)*sizeof *p.bounds);
+
+  /* Set the boundaries of the chunks: each chunk should start after a
+     new-line character. */
+  p.bounds[0]=start;
+  p.bounds[p.numchunks]=end;
+  for(c=1;c<p.numchunks;++c)
+    {
+      p.bounds[c]=start + c*(st.st_size/p.numchunks);
+      if(p.bounds[c]<p.bounds[c-1]) p.bounds[c]=p.bounds[c-1];
+      nlptr=memchr(p.bounds[c], '\n', end-p.bounds[c]);
+      p.bounds[c] = nlptr ? nlptr+1 : end;
+    }
+
+  /* When there is more than one chunk, count the number of lines and data
+     rows in each chunk, then convert them to the starting line and row of
+     each chunk. */
+  if(p.numchunks>1)
+    {
+      p.count=1;
+      gal_threads_spin_off(txt_read_mmap_worker, &p, p.numchunks,
+                           numthreads, minmapsize, quietmmap);
+      nl=nr=0;
+      for(c=0;c<p.numchunks;++c)
+        {
+          nl+=p.firstline[c]; p.firstline[c]=nl-p.firstline[c];
+          nr+=p.firstrow[c];  p.firstrow[c]=nr-p.firstrow[c];
+        }
+    }
+
+  /* Read the rows of each chunk. */
+  p.count=0;
+  gal_threads_spin_off(txt_read_mmap_worker, &p, p.numchunks, numthreads,
+                       minmapsize, quietmmap);
+
+  /* Clean up and return. */
+  munmap(start, st.st_size);
+  free(p.firstline);
+  free(p.firstrow);
+  free(p.bounds);
+  return 1;
+}
+
+
+
+
+
 static gal_data_t *
 txt_read(char *filename, gal_list_str_t *lines, size_t *indsize,
-         gal_data_t *info, gal_list_sizet_t *indexll, size_t minmapsize,
-         int quietmmap, int format)
+         gal_data_t *info, gal_list_sizet_t *indexll, size_t numthreads,
+         size_t minmapsize, int quietmmap, int format)
 {
   FILE *fp;
   int test;
@@ -1435,30 +1920,38 @@ txt_read(char *filename, gal_list_str_t *lines, size_t *indsize,
                        format, &line, linelen, &tokeninout, &ntokforout,
                        &tokenininfo, &tokenvecind);
 
-  /* Read the input line by line. */
+  /* Read the input line by line. Files are read from a memory-mapped
+     copy with multiple threads when possible (see 'txt_read_mmap'). */
   if(filename) /* Input from a file. */
     {
-      /* Open the file. */
-      errno=0;
-      fp=fopen(filename, "r");
-      if(fp==NULL)
-        error(EXIT_FAILURE, errno, "%s: couldn't open to read as a text "
-              "table in %s", filename, __func__);
-
-      /* Read the file, line by line. */
-      while( getline(&line, &linelen, fp) != -1 )
+      if( txt_read_mmap(filename, format, tokeninout, ntokforout,
+                        tokenininfo, tokenvecind, numthreads, minmapsize,
+                        quietmmap)==0 )
         {
-          ++lineno;
-          if( gal_txt_line_stat(line) == GAL_TXT_LINESTAT_DATAROW )
-            txt_fill(line, tokeninout, ntokforout, tokenininfo,
-                     tokenvecind, rowind++, filename, lineno, 1, format);
-        }
+          /* Open the file. */
+          errno=0;
+          fp=fopen(filename, "r");
+          if(fp==NULL)
+            error(EXIT_FAILURE, errno, "%s: couldn't open to read as a "
+                  "text table in %s", filename, __func__);
+
+          /* Read the file, line by line. */
+          while( getline(&line, &linelen, fp) != -1 )
+            {
+              ++lineno;
+              if( gal_txt_line_stat(line) == GAL_TXT_LINESTAT_DATAROW )
+                txt_fill(line, tokeninout, ntokforout, tokenininfo,
+                         tokenvecind, rowind++, filename, lineno, 1,
+                         format);
+            }
 
-      /* Clean up and close the file. */
-      errno=0;
-      if(fclose(fp))
-        error(EXIT_FAILURE, errno, "%s: couldn't close file after reading "
-              "ASCII table information in %s", filename, __func__);
+          /* Clean up and close the file. */
+          errno=0;
+          if(fclose(fp))
+            error(EXIT_FAILURE, errno, "%s: couldn't close file after "
+                  "reading ASCII table information in %s", filename,
+                  __func__);
+        }
     }
 
   else /* Input from standard input. */
@@ -1496,8 +1989,22 @@ gal_txt_table_read(char *filename, gal_list_str_t *lines, size_t numrows,
                    gal_data_t *colinfo, gal_list_sizet_t *indexll,
                    size_t minmapsize, int quietmmap)
 {
-  return txt_read(filename, lines, &numrows, colinfo, indexll, minmapsize,
-                  quietmmap, TXT_FORMAT_TABLE);
+  return txt_read(filename, lines, &numrows, colinfo, indexll, 1,
+                  minmapsize, quietmmap, TXT_FORMAT_TABLE);
+}
+
+
+
+
+
+gal_data_t *
+gal_txt_table_read_threads(char *filename, gal_list_str_t *lines,
+                           size_t numrows, gal_data_t *colinfo,
+                           gal_list_sizet_t *indexll, size_t numthreads,
+                           size_t minmapsize, int quietmmap)
+{
+  return txt_read(filename, lines, &numrows, colinfo, indexll, numthreads,
+                  minmapsize, quietmmap, TXT_FORMAT_TABLE);
 }
 
 
@@ -1516,7 +2023,7 @@ gal_txt_image_read(char *filename, gal_list_str_t *lines,
   imginfo=gal_txt_image_info(filename, lines, &numimg, dsize);
 
   /* Read the table. */
-  img=txt_read(filename, lines, dsize, imginfo, indexll, minmapsize,
+  img=txt_read(filename, lines, dsize, imginfo, indexll, 1, minmapsize,
                quietmmap, TXT_FORMAT_IMAGE);
 
   /* Clean up and return. */
@@ -1837,43 +2344,504 @@ txt_fmts_for_printf(gal_data_t *datall, int leftadjust, int tab0_img1)
 
 
 
+/* The values are not printed with 'fprintf' (which needs to parse the
+   format string of each value): the rows are formatted into large buffers
+   (one for each thread, each formatting a block of rows) which are then
+   written into the output in order. The formats of each column (made by
+   'txt_fmts_for_printf') are only parsed once: integers and strings are
+   formatted directly, floating points are given to 'snprintf' (which
+   rounds the decimal digits correctly), so the output is identical to
+   printing each value with 'fprintf'. */
+#define TXT_WRITE_BLOCK_ROWS 10000
+struct txt_write_fmt
+{
+  char              *fmt;  /* The 'printf' format string.             */
+  int              space;  /* Put a space before positive numbers.    */
+  int               left;  /* Left-adjust the value.                  */
+  int              width;  /* Minimum width of the value.             */
+  int               prec;  /* Precision (-1 when not given).          */
+  char              conv;  /* Conversion character.                   */
+  int              trail;  /* Put a space after the value.            */
+};
+
+struct txt_write_buf
+{
+  char                *b;  /* The formatted characters.               */
+  size_t               n;  /* Number of used bytes in 'b'.            */
+  size_t            size;  /* Allocated bytes of 'b'.                 */
+};
+
+struct txt_write_params
+{
+  gal_data_t      *input;  /* The columns (or image) to write.         */
+  int          tab0_img1;  /* The input is a table (0) or image (1).   */
+  struct txt_write_fmt *f; /* Two formats for each column.            */
+  struct txt_write_buf *bufs; /* Buffer of each action.               */
+  size_t      firstblock;  /* Block of rows of the first action.      */
+  size_t         numrows;  /* Total number of rows.                   */
+};
+
+
+
+
+
+/* Parse the 'printf' format string (made by 'txt_fmts_for_printf'). */
+static void
+txt_write_fmt_parse(char *fmt, struct txt_write_fmt *f)
+{
+  char *c=fmt+1;      /* The first character is '%'. */
+
+  /* Initialize the values. */
+  f->fmt=fmt;
+  f->prec=-1;
+  f->space=f->left=f->width=0;
+
+  /* Parse the format. */
+  for(;*c==' ' || *c=='-';++c) if(*c==' ') f->space=1; else f->left=1;
+  while(isdigit(*c)) f->width = f->width*10 + (*c++-'0');
+  if(*c=='.') for(f->prec=0, ++c; isdigit(*c); ++c)
+                f->prec = f->prec*10 + (*c-'0');
+  while(*c=='l') ++c;
+  f->conv=*c++;
+  f->trail = *c==' ';
+}
+
+
+
+
+
+/* Make sure there are at least 'num' free bytes in the buffer. */
+static void
+txt_write_buf_need(struct txt_write_buf *buf, size_t num)
+{
+  if(buf->n+num <= buf->size) return;
+  buf->size = 2*buf->size > buf->n+num ? 2*buf->size : buf->n+num;
+  errno=0;
+  buf->b=realloc(buf->b, buf->size);
+  if(buf->b==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes",
+          __func__, buf->size);
+}
+
+
+
+
+
+/* Add 'num' copies of the character 'c' to the buffer (space has already
+   been allocated). */
+static void
+txt_write_buf_fill(struct txt_write_buf *buf, char c, size_t num)
+{
+  memset(buf->b+buf->n, c, num);
+  buf->n+=num;
+}
+
+
+
+
+
+/* Write an integer (with absolute value 'mag') like 'printf'. */
+static void
+txt_write_int(struct txt_write_buf *buf, struct txt_write_fmt *f,
+              uint64_t mag, int neg)
+{
+  char digits[24];
+  size_t i, nd=0, zeros, len, pad, base;
+  char sign = neg ? '-' : ( f->space && f->conv=='d' ? ' ' : '\0' );
+
+  /* Find the digits (in reverse). When the precision is zero, 'printf'
+     doesn't print anything for a zero value. */
+  base = f->conv=='o' ? 8 : ( f->conv=='X' ? 16 : 10 );
+  while(mag) { digits[nd++]="0123456789ABCDEF"[mag%base]; mag/=base; }
+  if(nd==0 && f->prec!=0) digits[nd++]='0';
+
+  /* Find the number of characters. */
+  zeros = f->prec>0 && (size_t)f->prec>nd ? f->prec-nd : 0;
+  len = (sign!='\0') + zeros + nd;
+  pad = (size_t)f->width>len ? f->width-len : 0;
+  txt_write_buf_need(buf, len+pad+1);
+
+  /* Write the value. */
+  if(f->left==0) txt_write_buf_fill(buf, ' ', pad);
+  if(sign) buf->b[buf->n++]=sign;
+  txt_write_buf_fill(buf, '0', zeros);
+  for(i=nd;i>0;--i) buf->b[buf->n++]=digits[i-1];
+  if(f->left) txt_write_buf_fill(buf, ' ', pad);
+  if(f->trail) buf->b[buf->n++]=' ';
+}
+
+
+
+
+
+/* Write a string like 'printf'. */
+static void
+txt_write_str(struct txt_write_buf *buf, struct txt_write_fmt *f,
+              char *str)
+{
+  size_t len=strlen(str), pad;
+
+  if(f->prec>=0 && len>(size_t)f->prec) len=f->prec;
+  pad = (size_t)f->width>len ? f->width-len : 0;
+  txt_write_buf_need(buf, len+pad+1);
+  if(f->left==0) txt_write_buf_fill(buf, ' ', pad);
+  memcpy(buf->b+buf->n, str, len); buf->n+=len;
+  if(f->left) txt_write_buf_fill(buf, ' ', pad);
+  if(f->trail) buf->b[buf->n++]=' ';
+}
+
+
+
+
+
+/* Floating point numbers are printed in the '%e' and '%f' formats with
+   exact integer arithmetic when 128-bit integers are available: the value
+   (m*2^e, where 'm' is a 53-bit integer) is multiplied by 10^k as a
+   fraction of two 128-bit integers, and divided with rounding to the
+   nearest (and to the even digit on ties, like 'printf'). This gives the
+   same digits as 'printf' and returns 0 when the numbers don't fit in 128
+   bits (so 'snprintf' is used). */
+#ifdef __SIZEOF_INT128__
+static const uint64_t txt_write_pow10[]=
+  { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL,
+    10000000000000000000ULL };
+
+static int
+txt_write_float_clz(unsigned __int128 x)
+{
+  uint64_t hi=x>>64, lo=x;
+  return hi ? __builtin_clzll(hi) : ( lo ? 64+__builtin_clzll(lo) : 128 );
+}
+
+
+
+
+
+/* Put round(|v|*10^k) into 'q' (return 0 if it can't be done exactly). */
+static int
+txt_write_float_scale(double v, int k, uint64_t *q)
+{
+  int i, ex, t;
+  unsigned __int128 num, den=1, r, qq, p5=1;
+
+  /* |v| = m*2^(ex-53), so |v|*10^k = m * 5^k * 2^(ex-53+k). */
+  num=(uint64_t)ldexp(frexp(fabs(v), &ex), 53);
+  t=ex-53+k;
+  if(k>32 || k<-54) return 0;
+  for(i=0;i<(k<0?-k:k);++i) p5*=5;
+  if(k>0) num*=p5; else den=p5;
+  if(t>0) { if(t>=txt_write_float_clz(num)) return 0; num<<=t;  }
+  if(t<0) { if(-t>=txt_write_float_clz(den)) return 0; den<<=-t; }
+
+  /* Divide and round to the nearest (to even on ties). */
+  qq=num/den;
+  r=num-qq*den;
+  if( r>den-r || (r==den-r && (qq&1)) ) ++qq;
+  if(qq>>64) return 0;
+  *q=qq;
+  return 1;
+}
+
+
+
+
+
+/* Write the number into 'str' (with at least 64 bytes) and return the
+   number of written characters (0 if it couldn't be written). */
+static size_t
+txt_write_float_exact(char *str, struct txt_write_fmt *f, double v)
+{
+  uint64_t q=0, ip;
+  char digits[24], *c=str;
+  int i, nd, p=f->prec, ex, E=0, iter;
+
+  /* Only the finite numbers in the '%e' and '%f' formats. */
+  if( !isfinite(v) || p<0 || p>17 || (f->conv!='e' && f->conv!='f') )
+    return 0;
+
+  /* Find the digits. */
+  if(f->conv=='e')
+    {
+      /* Find the exponent so the digits are within [10^p, 10^(p+1)). The
+         first estimate may be off by one, so it is corrected. */
+      if(v!=0.0)
+        {
+          frexp(v, &ex);
+          E=floor( (ex-1)*0.30102999566398120 );
+          for(iter=0;iter<4;++iter)
+            {
+              if( txt_write_float_scale(v, p-E, &q)==0 ) return 0;
+              if(q>=txt_write_pow10[p+1])  ++E;
+              else if(q<txt_write_pow10[p]) --E;
+              else break;
+            }
+          if(iter==4) return 0;
+        }
+    }
+  else
+    if( v!=0.0 && txt_write_float_scale(v, p, &q)==0 ) return 0;
+
+  /* The sign. */
+  if(signbit(v)) *c++='-';
+  else if(f->space) *c++=' ';
+
+  /* The integer part. */
+  ip=q/txt_write_pow10[p];
+  nd=0; do digits[nd++]='0'+ip%10; while( (ip/=10) );
+  while(nd) *c++=digits[--nd];
+
+  /* The fractional part. */
+  if(p)
+    {
+      *c++='.';
+      q%=txt_write_pow10[p];
+      for(i=p-1;i>=0;--i) { c[i]='0'+q%10; q/=10; }
+      c+=p;
+    }
+
+  /* The exponent (with at least two digits). */
+  if(f->conv=='e')
+    {
+      *c++='e';
+      *c++ = E<0 ? '-' : '+';
+      if(E<0) E=-E;
+      nd=0; do digits[nd++]='0'+E%10; while( (E/=10) );
+      if(nd==1) digits[nd++]='0';
+      while(nd) *c++=digits[--nd];
+    }
+  return c-str;
+}
+#endif
+
+
+
+
+
+/* Write a floating point number (the trailing space is in the format
+   string given to 'snprintf'). */
+static void
+txt_write_float(struct txt_write_buf *buf, struct txt_write_fmt *f,
+                double value)
+{
+  int r;
+#ifdef __SIZEOF_INT128__
+  char str[64];
+  size_t len, pad;
+
+  /* Exact conversion without 'snprintf'. */
+  if( (len=txt_write_float_exact(str, f, value)) )
+    {
+      pad = (size_t)f->width>len ? f->width-len : 0;
+      txt_write_buf_need(buf, len+pad+1);
+      if(f->left==0) txt_write_buf_fill(buf, ' ', pad);
+      memcpy(buf->b+buf->n, str, len); buf->n+=len;
+      if(f->left) txt_write_buf_fill(buf, ' ', pad);
+      if(f->trail) buf->b[buf->n++]=' ';
+      return;
+    }
+#endif
+
+  /* Use 'snprintf'. */
+  txt_write_buf_need(buf, 64);
+  r=snprintf(buf->b+buf->n, buf->size-buf->n, f->fmt, value);
+  if( (size_t)r >= buf->size-buf->n )
+    {
+      txt_write_buf_need(buf, r+1);
+      snprintf(buf->b+buf->n, buf->size-buf->n, f->fmt, value);
+    }
+  buf->n+=r;
+}
+
+
+
+
+
 static void
-txt_print_value(FILE *fp, gal_data_t *data, size_t ind, char *fmt)
+txt_write_value(struct txt_write_buf *buf, gal_data_t *data, size_t ind,
+                struct txt_write_fmt *f)
 {
+  int64_t l=0;
+  uint64_t u=0;
   void *a=data->array;
 
   switch(data->type)
     {
-      /* Numerical types. */
-    case GAL_TYPE_UINT8:   fprintf(fp, fmt, ((uint8_t *) a)[ind]); break;
-    case GAL_TYPE_INT8:    fprintf(fp, fmt, ((int8_t *)  a)[ind]); break;
-    case GAL_TYPE_UINT16:  fprintf(fp, fmt, ((uint16_t *)a)[ind]); break;
-    case GAL_TYPE_INT16:   fprintf(fp, fmt, ((int16_t *) a)[ind]); break;
-    case GAL_TYPE_UINT32:  fprintf(fp, fmt, ((uint32_t *)a)[ind]); break;
-    case GAL_TYPE_INT32:   fprintf(fp, fmt, ((int32_t *) a)[ind]); break;
-    case GAL_TYPE_UINT64:  fprintf(fp, fmt, ((uint64_t *)a)[ind]); break;
-    case GAL_TYPE_INT64:   fprintf(fp, fmt, ((int64_t *) a)[ind]); break;
-    case GAL_TYPE_FLOAT32: fprintf(fp, fmt, ((float *)   a)[ind]); break;
-    case GAL_TYPE_FLOAT64: fprintf(fp, fmt, ((double *)  a)[ind]); break;
-
-      /* Special consideration for strings. */
+      /* Integers. */
+    case GAL_TYPE_UINT8:   u=((uint8_t *) a)[ind];  break;
+    case GAL_TYPE_UINT16:  u=((uint16_t *)a)[ind];  break;
+    case GAL_TYPE_UINT32:  u=((uint32_t *)a)[ind];  break;
+    case GAL_TYPE_UINT64:  u=((uint64_t *)a)[ind];  break;
+    case GAL_TYPE_INT8:    l=((int8_t *)  a)[ind];  break;
+    case GAL_TYPE_INT16:   l=((int16_t *) a)[ind];  break;
+    case GAL_TYPE_INT32:   l=((int32_t *) a)[ind];  break;
+    case GAL_TYPE_INT64:   l=((int64_t *) a)[ind];  break;
+
+      /* Floating points. */
+    case GAL_TYPE_FLOAT32:
+      txt_write_float(buf, f, ((float *) a)[ind]);  return;
+    case GAL_TYPE_FLOAT64:
+      txt_write_float(buf, f, ((double *)a)[ind]);  return;
+
+      /* Strings. */
     case GAL_TYPE_STRING:
-      if( !strcmp( ((char **)a)[ind], GAL_BLANK_STRING ) )
-        fprintf(fp, fmt, GAL_BLANK_STRING);
-      else
-        fprintf(fp, fmt, ((char **)a)[ind]);
-      break;
+      txt_write_str(buf, f, ((char **)a)[ind]);     return;
 
     default:
       error(EXIT_FAILURE, 0, "%s: type code %d not recognized",
             __func__, data->type);
     }
+
+  /* Write the integer. */
+  if(l<0) txt_write_int(buf, f, -(uint64_t)l, 1);
+  else    txt_write_int(buf, f, l ? (uint64_t)l : u, 0);
+}
+
+
+
+
+
+/* Format one row of the output. Each column has two formats in 'f': the
+   second is for the last element of a vector column that is also the last
+   column (or the last element of each row in an image). */
+static void
+txt_write_row(struct txt_write_params *p, struct txt_write_buf *buf,
+              size_t i)
+{
+  gal_data_t *data;
+  size_t j, k=0, d1;
+
+  if(p->tab0_img1) /* Image. */
+    {
+      d1=p->input->dsize[1];
+      for(j=0;j<d1;++j)
+        txt_write_value(buf, p->input, i*d1+j, &p->f[j==d1-1 ? 1 : 0]);
+    }
+  else /* Table. */
+    for(data=p->input;data!=NULL;data=data->next)  /* Column. */
+      {
+        if(data->ndim>1)  /* Vector column. */
+          {
+            d1=data->dsize[1];
+            for(j=0;j<d1;++j)
+              txt_write_value(buf, data, i*d1+j,
+                              &p->f[ 2*k
+                                     + (j==d1-1 && data->next==NULL) ]);
+          }
+        else /* Non-vector column: simple! */
+          txt_write_value(buf, data, i, &p->f[2*k]);
+        ++k;
+      }
+
+  /* End the row. */
+  txt_write_buf_need(buf, 1);
+  buf->b[buf->n++]='\n';
+}
+
+
+
+
+
+/* Worker function on each thread: each action formats one block of
+   rows into its own buffer. */
+static void *
+txt_write_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct txt_write_params *p=(struct txt_write_params *)tprm->params;
+
+  struct txt_write_buf *buf;
+  size_t i, a, r, start, end;
+
+  /* Go over all the actions (blocks) that were assigned to this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Set the rows of this block. */
+      a=tprm->indexs[i];
+      buf=&p->bufs[a];
+      start=(p->firstblock+a)*TXT_WRITE_BLOCK_ROWS;
+      end = ( start+TXT_WRITE_BLOCK_ROWS < p->numrows
+              ? start+TXT_WRITE_BLOCK_ROWS : p->numrows );
+
+      /* Format the rows. */
+      buf->n=0;
+      for(r=start;r<end;++r) txt_write_row(p, buf, r);
+    }
+
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
 }
 
 
 
 
 
+/* Write all the rows of the input into 'fp'. */
+static void
+txt_write_rows(FILE *fp, gal_data_t *input, char **fmts, size_t numcols,
+               int tab0_img1, size_t numthreads)
+{
+  size_t i, nact, numblocks;
+  struct txt_write_params p;
+
+  /* Parse the formats of each column. */
+  p.input=input;
+  p.tab0_img1=tab0_img1;
+  p.numrows=input->dsize[0];
+  errno=0;
+  p.f=malloc(2*numcols*sizeof *p.f);
+  if(p.f==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'p.f'", __func__, 2*numcols*sizeof *p.f);
+  for(i=0;i<numcols;++i)
+    {
+      txt_write_fmt_parse(fmts[i*FMTS_COLS], &p.f[2*i]);
+      if(fmts[i*FMTS_COLS+3][0]!='\0')
+        txt_write_fmt_parse(fmts[i*FMTS_COLS+3], &p.f[2*i+1]);
+      else p.f[2*i+1]=p.f[2*i];
+    }
+
+  /* Allocate one buffer for each thread. */
+  if(numthreads==0) numthreads=1;
+  errno=0;
+  p.bufs=calloc(numthreads, sizeof *p.bufs);
+  if(p.bufs==NULL)
+    error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+          "'p.bufs'", __func__, numthreads*sizeof *p.bufs);
+
+  /* Format 'numthreads' blocks of rows in parallel, then write them in
+   order. */
+  numblocks=(p.numrows+TXT_WRITE_BLOCK_ROWS-1)/TXT_WRITE_BLOCK_ROWS;
+  for(p.firstblock=0; p.firstblock<numblocks; p.firstblock+=numthreads)
+    {
+      nact = ( p.firstblock+numthreads < numblocks
+               ? numthreads : numblocks-p.firstblock );
+      gal_threads_spin_off(txt_write_worker, &p, nact, numthreads,
+                           -1, 1);
+      for(i=0;i<nact;++i)
+        {
+          errno=0;
+          if( fwrite(p.bufs[i].b, 1, p.bufs[i].n, fp) != p.bufs[i].n )
+            error(EXIT_FAILURE, errno, "%s: couldn't write %zu bytes",
+                  __func__, p.bufs[i].n);
+        }
+    }
+
+  /* Clean up. */
+  for(i=0;i<numthreads;++i) free(p.bufs[i].b);
+  free(p.bufs);
+  free(p.f);
+}
+
+
+
+
+
+
 static void
 txt_write_metadata(FILE *fp, gal_data_t *datall, char **fmts,
                    int tab0_img1)
@@ -2038,14 +3006,16 @@ txt_write_keys(FILE *fp, struct gal_fits_list_key_t *keylist,
 
 
 void
-gal_txt_write(gal_data_t *input, struct gal_fits_list_key_t *keylist,
-              gal_list_str_t *comment, char *filename,
-              uint8_t colinfoinstdout, int tab0_img1, int freekeys)
+gal_txt_write_threads(gal_data_t *input,
+                      struct gal_fits_list_key_t *keylist,
+                      gal_list_str_t *comment, char *filename,
+                      uint8_t colinfoinstdout, int tab0_img1, int freekeys,
+                      size_t numthreads)
 {
   FILE *fp;
   char **fmts;
+  size_t i, num=0;
   gal_list_str_t *strt;
-  size_t i, j, k, num=0, d1;
   gal_data_t *data, *nextimg=NULL;
 
   /* Make sure input is valid. */
@@ -2130,39 +3100,7 @@ gal_txt_write(gal_data_t *input, struct gal_fits_list_key_t *keylist,
 
   /* Print row-by-row (if we actually have data to print!). */
   if(input->array)
-    {
-      if(tab0_img1) /* Image. */
-        for(i=0;i<input->dsize[0];++i)
-          {
-            d1=input->dsize[1];
-            for(j=0;j<d1;++j)
-              txt_print_value(fp, input, i*d1+j, fmts[j==d1-1 ? 3 : 0]);
-            fprintf(fp, "\n");
-          }
-      else /* Table. */
-        {
-          for(i=0;i<input->dsize[0];++i)                  /* Row.    */
-            {
-              k=0; /* Column counter. */
-              for(data=input;data!=NULL;data=data->next)  /* Column. */
-                {
-                  if(data->ndim>1)  /* Vector column. */
-                    {
-                      d1=data->dsize[1];
-                      for(j=0;j<d1;++j)
-                        txt_print_value(fp, data, i*d1+j,
-                          fmts[ k * FMTS_COLS
-                      /* Last of vector column has a different format. */
-                                + (j==d1-1 && data->next==NULL ? 3 : 0) ]);
-                    }
-                  else /* Non-vector column: simple! */
-                    txt_print_value(fp, data, i, fmts[k * FMTS_COLS]);
-                  ++k;
-                }
-              fprintf(fp, "\n");
-            }
-        }
-    }
+    txt_write_rows(fp, input, fmts, num, tab0_img1, numthreads);
 
 
   /* Clean up. */
@@ -2188,3 +3126,16 @@ gal_txt_write(gal_data_t *input, struct gal_fits_list_key_t *keylist,
   /* Restore the next pointer for an image. */
   if(nextimg) input->next=nextimg;
 }
+
+
+
+
+
+void
+gal_txt_write(gal_data_t *input, struct gal_fits_list_key_t *keylist,
+              gal_list_str_t *comment, char *filename,
+              uint8_t colinfoinstdout, int tab0_img1, int freekeys)
+{
+  gal_txt_write_threads(input, keylist, comment, filename,
+                        colinfoinstdout, tab0_img1, freekeys, 1);
+}
@@ -22,6 +22,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 **********************************************************************/
 #include <config.h>
 
+#include <math.h>
 #include <time.h>
 #include <errno.h>
 #include <error.h>
@@ -39,6 +40,7 @@ along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
 #include <gnuastro/tile.h>
 #include <gnuastro/fits.h>
 #include <gnuastro/pointer.h>
+#include <gnuastro/threads.h>
 #include <gnuastro/dimension.h>
 #include <gnuastro/statistics.h>
 #include <gnuastro/permutation.h>
@@ -2762,15 +2764,74 @@ gal_wcs_coverage(char *filename, char *hdu, size_t *ondim,
 /**************************************************************/
 /**********            Array conversion            ************/
 /**************************************************************/
+/* Number of coordinates that are converted in each action of the
+   threads. */
+#define WCS_CONVERT_CHUNK 4096
+
+/* Highest power in the SIP (9 in WCSLIB) and TPV (7) polynomials and the
+   size of the array to keep their coefficients (on each axis). */
+#define WCS_CONVERT_MAXPOW 9
+#define WCS_CONVERT_NCOEFF ( (WCS_CONVERT_MAXPOW+1)*(WCS_CONVERT_MAXPOW+1) )
+
+/* Inverting the distortion: maximum number of iterations (same as the
+   default in WCSLIB) and the relative tolerance for convergence. */
+#define WCS_CONVERT_ITERMAX 30
+#define WCS_CONVERT_TOL     1e-12
+
+/* Rounding errors in the celestial rotation are reduced with an
+   alternative formula bellow this value (as in WCSLIB). */
+#define WCS_CONVERT_ROTTOL  1e-5
+
+/* Parameters for the native conversion of two dimensional celestial
+   coordinates in the TAN (gnomonic) projection, optionally with SIP or
+   TPV distortions. They are all read from the WCSLIB structure after
+   'wcsset', so the same conventions are followed. */
+struct wcs_convert_tan
+{
+  int             lng;    /* Index of the longitude axis.              */
+  int             lat;    /* Index of the latitude axis.               */
+  int      distortion;    /* 'GAL_WCS_DISTORTION_*' (SIP or TPV).      */
+  int          bounds;    /* Points behind the plane are bad.          */
+  double           r0;    /* Radius of the generating sphere.          */
+  double     crpix[2];    /* Reference pixel.                          */
+  double     cdelt[2];    /* Scale of the intermediate coordinates.    */
+  double        pc[4];    /* Linear transformation matrix.             */
+  double       ipc[4];    /* Inverse of the linear transformation.     */
+  double     euler[5];    /* Euler angles of the celestial rotation.   */
+  double      sinphip;    /* Sine of the native longitude of the pole. */
+  double      cosphip;    /* Cosine of the native longitude of pole.   */
+  size_t   axis[2][2];    /* Distortion: input axes of each function.  */
+  double offset[2][2];    /* Distortion: offset of each input.         */
+  size_t        order;    /* Distortion: highest power of polynomial.  */
+  double coeff[2][WCS_CONVERT_NCOEFF]; /* Distortion: coefficients.    */
+};
+
+
+
+
+
+/* Parameters of the threads for the conversion. */
+struct wcs_convert_params
+{
+  int                img2world; /* Direction of the conversion.         */
+  gal_data_t               *in; /* List of input coordinates.           */
+  gal_data_t              *out; /* List of output coordinates.          */
+  struct wcsprm           *wcs; /* WCS when one thread is used.         */
+  struct wcsprm         **wcss; /* Separate copy of WCS for each thread.*/
+  struct wcs_convert_tan  *tan; /* Native TAN conversion (or NULL).     */
+};
+
+
+
+
+
 /* Some sanity checks for the WCS conversion functions. */
 static void
-wcs_convert_sanity_check_alloc(gal_data_t *coords, struct wcsprm *wcs,
-                               const char *func, int **stat, double **phi,
-                               double **theta, double **world,
-                               double **pixcrd, double **imgcrd)
+wcs_convert_sanity_check(gal_data_t *coords, struct wcsprm *wcs,
+                         const char *func)
 {
   gal_data_t *tmp;
-  size_t ndim=0, firstsize=0, size=coords->size;
+  size_t ndim=0, firstsize=0;
 
   /* Make sure a WCS structure is actually given. */
   if(wcs==NULL)
@@ -2808,20 +2869,6 @@ wcs_convert_sanity_check_alloc(gal_data_t *coords, struct wcsprm *wcs,
     error(EXIT_FAILURE, 0, "%s: the number of input coordinates (%zu) does "
           "not match the dimensions of the input WCS structure (%d)", func,
           ndim, wcs->naxis);
-
-  /* Allocate all the necessary arrays. */
-  *phi    = gal_pointer_allocate( GAL_TYPE_FLOAT64, size,      0, __func__,
-                                  "phi");
-  *stat   = gal_pointer_allocate( GAL_TYPE_INT,     size,      1, __func__,
-                                  "stat");
-  *theta  = gal_pointer_allocate( GAL_TYPE_FLOAT64, size,      0, __func__,
-                                  "theta");
-  *world  = gal_pointer_allocate( GAL_TYPE_FLOAT64, ndim*size, 0, __func__,
-                                  "world");
-  *imgcrd = gal_pointer_allocate( GAL_TYPE_FLOAT64, ndim*size, 0, __func__,
-                                  "imgcrd");
-  *pixcrd = gal_pointer_allocate( GAL_TYPE_FLOAT64, ndim*size, 0, __func__,
-                                  "pixcrd");
 }
 
 
@@ -2831,24 +2878,28 @@ wcs_convert_sanity_check_alloc(gal_data_t *coords, struct wcsprm *wcs,
 /* In Gnuastro, each column (coordinate for WCS conversion) is treated as a
    separate array in a 'gal_data_t' that are linked through a linked
    list. But in WCSLIB, the input is a single array (with multiple
-   columns). This function will convert between the two. */
+   columns). This function will convert between the two for the 'num'
+   coordinates that start from 'start'. */
 static void
 wcs_convert_list_to_from_array(gal_data_t *list, double *array, int *stat,
-                               size_t ndim, int to0from1)
+                               size_t ndim, size_t start, size_t num,
+                               int to0from1)
 {
   size_t i, d=0;
   gal_data_t *tmp;
+  double *col;
 
   for(tmp=list; tmp!=NULL; tmp=tmp->next)
     {
       /* Put all this coordinate's values into the single array that is
          input into or output from WCSLIB. */
-      for(i=0;i<list->size;++i)
+      col=(double *)(tmp->array)+start;
+      for(i=0;i<num;++i)
         {
           if(to0from1)
-            ((double *)(tmp->array))[i] = stat[i] ? NAN : array[i*ndim+d];
+            col[i] = stat[i] ? NAN : array[i*ndim+d];
           else
-            array[i*ndim+d] = ((double *)(tmp->array))[i];
+            array[i*ndim+d] = col[i];
         }
 
       /* Increment the dimension. */
@@ -2882,80 +2933,253 @@ wcs_convert_prepare_out(gal_data_t *coords, struct wcsprm *wcs, int inplace)
 
 
 
-/* Convert world coordinates to image coordinates given the input WCS
-   structure. The input must be a linked list of data structures of float64
-   ('double') type. The top element of the linked list must be the first
-   coordinate and etc. If 'inplace' is non-zero, then the output will be
-   written into the input's allocated space. */
-gal_data_t *
-gal_wcs_world_to_img(gal_data_t *coords, struct wcsprm *wcs, int inplace)
+/* Sine and cosine of an angle in degrees (exact for multiples of 90
+   degrees, like WCSLIB). */
+static void
+wcs_convert_sincosd(double angle, double *s, double *c)
 {
-  gal_data_t *out;
-  int *stat=NULL, ncoord=coords->size, nelem;
-  double *phi=NULL, *theta=NULL, *world=NULL, *pixcrd=NULL, *imgcrd=NULL;
+  if( fmod(angle, 90.0)==0.0 )
+    switch( abs( (int)floor(angle/90.0 + 0.5) ) % 4 )
+      {
+      case 0:  *s=0.0;                       *c= 1.0; break;
+      case 1:  *s = angle>0.0 ?  1.0 : -1.0; *c= 0.0; break;
+      case 2:  *s=0.0;                       *c=-1.0; break;
+      default: *s = angle>0.0 ? -1.0 :  1.0; *c= 0.0;
+      }
+  else
+    { *s=sin(angle*M_PI/180.0); *c=cos(angle*M_PI/180.0); }
+}
 
-  /* It can happen that the input datasets are empty. In this case, simply
-     return them. */
-  if(coords->size==0 || coords->array==NULL)
+
+
+
+
+#if GAL_CONFIG_HAVE_WCSLIB_DIS_H
+/* Read the coefficients of a SIP or TPV distortion from WCSLIB's
+   'disprm' structure (the same keys that 'wcsdistortion.c' reads). If
+   anything that isn't supported in the native conversion is present,
+   return 1 so WCSLIB is used. */
+static int
+wcs_convert_tan_read_dis(struct wcs_convert_tan *tan, struct disprm *dis)
+{
+  double value;
+  const char *cp;
+  struct dpkey *keyp;
+  int i, j, ival, sip=tan->distortion==GAL_WCS_DISTORTION_SIP;
+  size_t m, n, jhat, tpvpow[]={0,1,1,1,2,2,2,3,3,3,3,3,4,4,4,4,4,5,5,5,
+                               5,5,5,5,6,6,6,6,6,6,6,7,7,7,7,7,7,7,7,7};
+
+  /* By default, the two inputs of each function are the two axes. */
+  tan->axis[0][0]=tan->axis[1][0]=0;
+  tan->axis[0][1]=tan->axis[1][1]=1;
+
+  /* Parse the keys. */
+  for(i=0, keyp=dis->dp; i<dis->ndp; ++i, ++keyp)
     {
-      if(inplace) return coords;
-      else error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at "
-                 "'%s' to fix the problem. The input has no data and "
-                 "'inplace' is not called", __func__, PACKAGE_BUGREPORT);
+      /* Basic information. */
+      j=keyp->j-1;
+      cp=strchr(keyp->field, '.');
+      if(j<0 || j>1 || cp==NULL) return 1;
+      ++cp;
+      ival  = keyp->type ? (int)keyp->value.f : keyp->value.i;
+      value = keyp->type ? keyp->value.f : keyp->value.i;
+
+      /* Only two dimensional functions are supported. */
+      if( !strcmp(cp, "NAXES") )
+        { if(ival!=2) return 1; }
+
+      /* Input axes and their offset and scale. */
+      else if( !strncmp(cp, "AXIS.", 5) )
+        {
+          if( sscanf(cp+5, "%zu", &jhat)!=1 || jhat<1 || jhat>2
+              || ival<1 || ival>2 ) return 1;
+          tan->axis[j][jhat-1]=ival-1;
+        }
+      else if( !strncmp(cp, "OFFSET.", 7) )
+        {
+          if( sscanf(cp+7, "%zu", &jhat)!=1 || jhat<1 || jhat>2 )
+            return 1;
+          tan->offset[j][jhat-1]=value;
+        }
+      else if( !strncmp(cp, "SCALE.", 6) )
+        { if(value!=1.0) return 1; }
+
+      /* SIP coefficients (the reverse coefficients aren't used by WCSLIB
+         either: the distortion is inverted iteratively). */
+      else if( sip && !strncmp(cp, "SIP.FWD.", 8) )
+        {
+          if( sscanf(cp+8, "%zu_%zu", &m, &n)!=2
+              || m+n>WCS_CONVERT_MAXPOW ) return 1;
+          tan->coeff[j][m*(WCS_CONVERT_MAXPOW+1)+n]=value;
+          if(m+n>tan->order) tan->order=m+n;
+        }
+      else if( sip && !strncmp(cp, "SIP.REV.", 8) ) continue;
+
+      /* TPV coefficients. */
+      else if( !sip && !strncmp(cp, "TPV.", 4) )
+        {
+          if( sscanf(cp+4, "%zu", &m)!=1 || m>=40 ) return 1;
+          tan->coeff[j][m]=value;
+          if(tpvpow[m]>tan->order) tan->order=tpvpow[m];
+        }
+
+      /* Not supported. */
+      else return 1;
     }
 
+  /* Everything was read successfully. */
+  return 0;
+}
+#endif
 
-  /* Some sanity checks. */
-  wcs_convert_sanity_check_alloc(coords, wcs, __func__, &stat, &phi,
-                                 &theta, &world, &pixcrd, &imgcrd);
-  nelem=wcs->naxis; /* We have to make sure a WCS is given first. */
-
-
-  /* Write the values from the input list of separate columns into a single
-     array (WCSLIB input). */
-  wcs_convert_list_to_from_array(coords, world, stat, wcs->naxis, 0);
-
-
-  /* Use WCSLIB's wcss2p for the conversion. We are ignoring the over-all
-     status here, because later we will use the 'stat' array to set all bad
-     coordinates to NaN. */
-  wcss2p(wcs, ncoord, nelem, world, phi, theta, imgcrd, pixcrd, stat);
-
-
-  /* For a sanity check.
-  {
-    size_t i;
-    printf("\n\n%s sanity check:\n", __func__);
-    for(i=0;i<coords->size;++i)
-      printf("(%g, %g) --> phi:%g, theta: %g --> (%g, %g) --> (%g, %g) "
-             "[stat: %d]\n",
-             world[i*2],  world[i*2+1],
-             phi[i*2],    theta[i*2],
-             imgcrd[i*2], imgcrd[i*2+1],
-             pixcrd[i*2], pixcrd[i*2+1], stat[i]);
-    printf("stat: %d\n", stat[4]);
-  }
-  */
 
 
-  /* Allocate the output arrays if they were not already allocated. */
-  out=wcs_convert_prepare_out(coords, wcs, inplace);
 
 
-  /* Write the output from a single array (WCSLIB output) into the output
-     list of this function. */
-  wcs_convert_list_to_from_array(out, pixcrd, stat, wcs->naxis, 1);
+/* See if the given WCS can be converted natively (two dimensional
+   celestial coordinates in the TAN projection with no distortion or with
+   SIP or TPV distortions). If so, return the necessary parameters,
+   otherwise, return NULL. Note that 'wcsset' is called on the input like
+   WCSLIB's conversion functions. */
+static struct wcs_convert_tan *
+wcs_convert_tan_prepare(struct wcsprm *wcs)
+{
+  double det;
+  struct wcs_convert_tan *tan;
+  int distortion=GAL_WCS_DISTORTION_INVALID;
+
+  /* Basic checks. */
+  if( wcs->naxis!=2 || wcsset(wcs) || wcs->lng<0 || wcs->lat<0
+      || strcmp(wcs->cel.prj.code, "TAN") || wcs->cel.offset
+      || wcs->cel.euler[4]==0.0 )
+    return NULL;
+
+  /* Only the SIP (prior) or TPV (sequent) distortions are supported. */
+#if GAL_CONFIG_HAVE_WCSLIB_DIS_H
+  if(wcs->lin.dispre || wcs->lin.disseq)
+    {
+      distortion=gal_wcs_distortion_identify(wcs);
+      if( !( (distortion==GAL_WCS_DISTORTION_SIP && !wcs->lin.disseq)
+             || (distortion==GAL_WCS_DISTORTION_TPV && !wcs->lin.dispre) ) )
+        return NULL;
+    }
+#endif
+
+  /* Allocate the structure (initialized to zero). */
+  tan=gal_pointer_allocate(GAL_TYPE_UINT8, sizeof *tan, 1, __func__,
+                           "tan");
+  tan->distortion=distortion;
 
+  /* Read the distortion coefficients. */
+#if GAL_CONFIG_HAVE_WCSLIB_DIS_H
+  if( distortion!=GAL_WCS_DISTORTION_INVALID
+      && wcs_convert_tan_read_dis(tan,
+                                  ( distortion==GAL_WCS_DISTORTION_SIP
+                                    ? wcs->lin.dispre
+                                    : wcs->lin.disseq ) ) )
+    { free(tan); return NULL; }
+#endif
 
-  /* Clean up. */
-  free(phi);
-  free(stat);
-  free(theta);
-  free(world);
-  free(imgcrd);
-  free(pixcrd);
-
-  /* Return the output list of coordinates. */
+  /* The linear transformation and its inverse (when CD is given, WCSLIB
+     puts it in the PC matrix with a CDELT of 1). */
+  memcpy(tan->pc,    wcs->lin.pc,    4*sizeof *tan->pc);
+  memcpy(tan->crpix, wcs->lin.crpix, 2*sizeof *tan->crpix);
+  memcpy(tan->cdelt, wcs->lin.cdelt, 2*sizeof *tan->cdelt);
+  det=tan->pc[0]*tan->pc[3]-tan->pc[1]*tan->pc[2];
+  if(det==0.0 || tan->cdelt[0]==0.0 || tan->cdelt[1]==0.0)
+    { free(tan); return NULL; }
+  tan->ipc[0] =  tan->pc[3]/det;
+  tan->ipc[1] = -tan->pc[1]/det;
+  tan->ipc[2] = -tan->pc[2]/det;
+  tan->ipc[3] =  tan->pc[0]/det;
+
+  /* Projection and celestial rotation. */
+  tan->lng=wcs->lng;
+  tan->lat=wcs->lat;
+  tan->r0=wcs->cel.prj.r0;
+  tan->bounds=wcs->cel.prj.bounds&1;
+  memcpy(tan->euler, wcs->cel.euler, 5*sizeof *tan->euler);
+  wcs_convert_sincosd(tan->euler[2], &tan->sinphip, &tan->cosphip);
+
+  /* Return the parameters. */
+  return tan;
+}
+
+
+
+
+
+/* Value of the distortion function of axis 'j' on the input 'in'. When
+   'der!=NULL', the derivatives over the two inputs of the function are
+   also written in it. */
+static double
+wcs_convert_tan_poly(struct wcs_convert_tan *tan, size_t j, double *in,
+                     double *der)
+{
+  double *c=tan->coeff[j];
+  size_t i, k, d, m, n, o=tan->order;
+  double r, t, u, v, rd, out=0.0, pu[WCS_CONVERT_MAXPOW+1];
+  double pv[WCS_CONVERT_MAXPOW+1];
+
+  /* Powers of the inputs. */
+  u = in[ tan->axis[j][0] ] - tan->offset[j][0];
+  v = in[ tan->axis[j][1] ] - tan->offset[j][1];
+  pu[0]=pv[0]=1.0;
+  for(i=1;i<=o;++i) { pu[i]=pu[i-1]*u; pv[i]=pv[i-1]*v; }
+  if(der) der[0]=der[1]=0.0;
+
+  /* SIP: sum of 'A_m_n u^m v^n'. */
+  if(tan->distortion==GAL_WCS_DISTORTION_SIP)
+    {
+      for(m=0;m<=o;++m)
+        for(n=0;m+n<=o;++n)
+          if( (t=c[m*(WCS_CONVERT_MAXPOW+1)+n]) )
+            {
+              out += t*pu[m]*pv[n];
+              if(der)
+                {
+                  if(m) der[0] += m*t*pu[m-1]*pv[n];
+                  if(n) der[1] += n*t*pu[m]*pv[n-1];
+                }
+            }
+    }
+
+  /* TPV: terms of each degree are in decreasing powers of 'u', followed
+     by a power of the radius for odd degrees. */
+  else
+    {
+      r=sqrt(u*u+v*v);
+      out=c[0];
+      for(k=1, d=1; d<=o; ++d)
+        {
+          for(i=0;i<=d;++i, ++k)
+            if( (t=c[k]) )
+              {
+                out += t*pu[d-i]*pv[i];
+                if(der)
+                  {
+                    if(d-i) der[0] += (d-i)*t*pu[d-i-1]*pv[i];
+                    if(i)   der[1] += i*t*pu[d-i]*pv[i-1];
+                  }
+              }
+          if(d%2)
+            {
+              if( (t=c[k]) )
+                {
+                  for(i=1, rd=r; i<d; ++i) rd*=r;
+                  out += t*rd;
+                  if(der && r>0.0)
+                    {
+                      der[0] += d*t*rd*pu[1]/(r*r);
+                      der[1] += d*t*rd*pv[1]/(r*r);
+                    }
+                }
+              ++k;
+            }
+        }
+    }
+
+  /* Return the value. */
   return out;
 }
 
@@ -2963,71 +3187,431 @@ gal_wcs_world_to_img(gal_data_t *coords, struct wcsprm *wcs, int inplace)
 
 
 
-/* Similar to 'gal_wcs_world_to_img'. */
-gal_data_t *
-gal_wcs_img_to_world(gal_data_t *coords, struct wcsprm *wcs, int inplace)
+/* Apply the distortion on 'in' and write the result in 'out'. When
+   'jac!=NULL', the Jacobian matrix of the distortion is also written in
+   it (for the inversion). The SIP functions give the correction to the
+   input, while the TPV functions give the final value. */
+static void
+wcs_convert_tan_distort(struct wcs_convert_tan *tan, double *in,
+                        double *out, double *jac)
 {
-  gal_data_t *out;
-  int *stat=NULL, ncoord=coords->size, nelem;
-  double *phi=NULL, *theta=NULL, *world=NULL, *pixcrd=NULL, *imgcrd=NULL;
+  size_t j;
+  double der[2];
 
-  /* Some sanity checks. */
-  wcs_convert_sanity_check_alloc(coords, wcs, __func__, &stat, &phi, &theta,
-                                 &world, &pixcrd, &imgcrd);
-  nelem=wcs->naxis; /* We have to make sure a WCS is given first. */
+  for(j=0;j<2;++j)
+    {
+      out[j]=wcs_convert_tan_poly(tan, j, in, jac?der:NULL);
+      if(tan->distortion==GAL_WCS_DISTORTION_SIP) out[j]+=in[j];
+      if(jac)
+        {
+          jac[j*2]=jac[j*2+1]=0.0;
+          if(tan->distortion==GAL_WCS_DISTORTION_SIP) jac[j*2+j]=1.0;
+          jac[ j*2 + tan->axis[j][0] ] += der[0];
+          jac[ j*2 + tan->axis[j][1] ] += der[1];
+        }
+    }
+}
 
 
-  /* Write the values from the input list of separate columns into a single
-     array (WCSLIB input). */
-  wcs_convert_list_to_from_array(coords, pixcrd, stat, wcs->naxis, 0);
 
 
-  /* Use WCSLIB's wcsp2s for the conversion. We are ignoring the over-all
-     status here, because later we will use the 'stat' array to set all bad
-     coordinates to NaN. */
-  wcsp2s(wcs, ncoord, nelem, pixcrd, imgcrd, phi, theta, world, stat);
 
+/* Find the input of the distortion that gives 'target' with Newton's
+   method ('target' and 'out' can be the same). When a step doesn't
+   decrease the residual, it is halved. If it doesn't converge, return
+   1. */
+static int
+wcs_convert_tan_undistort(struct wcs_convert_tan *tan, double *target,
+                          double *out)
+{
+  size_t i;
+  double t[2], c[2], g[2], jac[4], cjac[4];
+  double det, d0, d1, step, res, cres;
+
+  /* Blank values can't be inverted. */
+  if( isnan(target[0]) || isnan(target[1]) ) return 1;
+
+  /* The distortions are small, so the target is the starting point. */
+  out[0]=t[0]=target[0];
+  out[1]=t[1]=target[1];
+  wcs_convert_tan_distort(tan, out, g, jac);
+  res=fabs(g[0]-t[0])+fabs(g[1]-t[1]);
+  for(i=0;i<WCS_CONVERT_ITERMAX;++i)
+    {
+      /* Newton step. */
+      det=jac[0]*jac[3]-jac[1]*jac[2];
+      if(det==0.0 || isnan(det)) return 1;
+      d0=( jac[3]*(g[0]-t[0]) - jac[1]*(g[1]-t[1]) )/det;
+      d1=(-jac[2]*(g[0]-t[0]) + jac[0]*(g[1]-t[1]) )/det;
+
+      /* A full step that is already at the level of round-off means that
+         it has converged. Close to the root, the residual can't decrease
+         any further (it just oscillates with round-off errors), so this
+         check has to be done before the line search below. */
+      if( fabs(d0)+fabs(d1)
+          <= WCS_CONVERT_TOL*(1.0+fabs(out[0])+fabs(out[1])) )
+        {
+          out[0]-=d0;
+          out[1]-=d1;
+          return 0;
+        }
 
-  /* For a check.
-  {
-    size_t i;
-    printf("\n\n%s sanity check (%d dimensions):\n", __func__, nelem);
-    for(i=0;i<coords->size;++i)
-      switch(nelem)
+      /* Halve the step until the residual decreases. */
+      for(step=1.0; step>1e-3; step/=2)
         {
-        case 2:
-          printf("(%-10g %-10g) --> (%-10g %-10g), [stat: %d]\n",
-                 pixcrd[i*2], pixcrd[i*2+1],
-                 world[i*2],  world[i*2+1], stat[i]);
-          break;
-        case 3:
-          printf("(%g, %g, %g) --> (%g, %g, %g), [stat: %d]\n",
-                 pixcrd[i*3], pixcrd[i*3+1], pixcrd[i*3+2],
-                 world[i*3],  world[i*3+1],  world[i*3+2], stat[i]);
-          break;
+          c[0]=out[0]-step*d0;
+          c[1]=out[1]-step*d1;
+          wcs_convert_tan_distort(tan, c, g, cjac);
+          cres=fabs(g[0]-t[0])+fabs(g[1]-t[1]);
+          if(cres<=res) break;
         }
-  }
-  */
+      out[0]=c[0];
+      out[1]=c[1];
+      memcpy(jac, cjac, 4*sizeof *jac);
+      res=cres;
+      if(res==0.0) return 0;
+    }
+  return 1;
+}
 
 
-  /* Allocate the output arrays if they were not already allocated. */
-  out=wcs_convert_prepare_out(coords, wcs, inplace);
 
 
-  /* Write the output from a single array (WCSLIB output) into the output
-     list of this function. */
-  wcs_convert_list_to_from_array(out, world, stat, wcs->naxis, 1);
+
+/* Convert one pixel coordinate to world coordinates with the native
+   TAN conversion. The steps are the same as 'wcsp2s': the prior (SIP)
+   distortion, the linear transformation, the sequent (TPV) distortion
+   and the scaling by CDELT (giving intermediate world coordinates), then
+   the de-projection into native spherical coordinates and the rotation
+   into celestial coordinates. */
+static void
+wcs_convert_tan_p2s(struct wcs_convert_tan *tan, double *pix, double *world)
+{
+  double *e=tan->euler, r2d=180.0/M_PI;
+  double p[2], s[2], x, y, z, r, rho, sinthe, costhe, ccos, csin, dlng;
+
+  /* Intermediate world coordinates. */
+  if(tan->distortion==GAL_WCS_DISTORTION_SIP)
+    wcs_convert_tan_distort(tan, pix, p, NULL);
+  else { p[0]=pix[0]; p[1]=pix[1]; }
+  p[0]-=tan->crpix[0];
+  p[1]-=tan->crpix[1];
+  s[0]=tan->pc[0]*p[0]+tan->pc[1]*p[1];
+  s[1]=tan->pc[2]*p[0]+tan->pc[3]*p[1];
+  if(tan->distortion==GAL_WCS_DISTORTION_TPV)
+    {
+      wcs_convert_tan_distort(tan, s, p, NULL);
+      s[0]=p[0]; s[1]=p[1];
+    }
+  x=s[tan->lng]*tan->cdelt[tan->lng];
+  y=s[tan->lat]*tan->cdelt[tan->lat];
+
+  /* De-projection: the sine and cosine of the native latitude and the
+     cosine of the native latitude multiplied by the cosine and sine of
+     the native longitude (relative to that of the celestial pole) are
+     found directly from the intermediate coordinates. */
+  r=sqrt(x*x+y*y);
+  rho=sqrt(tan->r0*tan->r0+r*r);
+  sinthe=tan->r0/rho;
+  costhe=r/rho;
+  ccos=( x*tan->sinphip - y*tan->cosphip)/rho;
+  csin=( x*tan->cosphip + y*tan->sinphip)/rho;
+
+  /* Celestial longitude (the alternative formula is used to reduce
+     rounding errors in the subtraction, like WCSLIB). */
+  x = sinthe*e[4] - ccos*e[3];
+  if( fabs(x)<WCS_CONVERT_ROTTOL )
+    x = ( -cos( atan2(sinthe, costhe) + e[1]/r2d )
+          + e[3]*(costhe-ccos) );
+  y = -csin;
+  if(x!=0.0 || y!=0.0) dlng=atan2(y, x)*r2d;
+  else
+    {
+      dlng = r>0.0 ? atan2(csin, ccos)*r2d : -e[2];
+      dlng = e[1]<90.0 ? dlng+180.0 : -dlng;
+    }
+  world[tan->lng]=e[0]+dlng;
+
+  /* Normalize the celestial longitude (like WCSLIB). */
+  if(e[0]>=0.0) { if(world[tan->lng]<0.0) world[tan->lng]+=360.0; }
+  else          { if(world[tan->lng]>0.0) world[tan->lng]-=360.0; }
+  if(world[tan->lng]>360.0)       world[tan->lng]-=360.0;
+  else if(world[tan->lng]<-360.0) world[tan->lng]+=360.0;
+
+  /* Celestial latitude. */
+  z = sinthe*e[3] + ccos*e[4];
+  world[tan->lat] = ( fabs(z)>0.99
+                      ? copysign(acos(sqrt(x*x+y*y)), z)
+                      : asin(z) ) * r2d;
+}
+
+
+
+
+
+/* Convert one world coordinate to pixel coordinates with the native
+   TAN conversion (the inverse of 'wcs_convert_tan_p2s'). If the point
+   can't be converted, the output will be NaN. */
+static void
+wcs_convert_tan_s2p(struct wcs_convert_tan *tan, double *world, double *pix)
+{
+  double *e=tan->euler, d2r=M_PI/180.0;
+  double s[2], x, y, z, sinlat, coslat, sinlng, coslng;
+
+  /* Rotation to the native spherical coordinates: (x, y, z) is the unit
+     vector in the native frame, so 'z' is the sine of the native latitude
+     and the other two are the cosine of the native latitude multiplied by
+     the cosine and sine of the native longitude (relative to that of the
+     celestial pole). */
+  sinlat=sin(world[tan->lat]*d2r);
+  coslat=cos(world[tan->lat]*d2r);
+  sinlng=sin((world[tan->lng]-e[0])*d2r);
+  coslng=cos((world[tan->lng]-e[0])*d2r);
+  x = sinlat*e[4] - coslat*e[3]*coslng;
+  if( fabs(x)<WCS_CONVERT_ROTTOL )
+    x = ( -cos( (world[tan->lat]+e[1])*d2r )
+          + coslat*e[3]*(1.0-coslng) );
+  y = -coslat*sinlng;
+  z = sinlat*e[3] + coslat*e[4]*coslng;
+
+  /* Projection: points on the plane of the sky or behind it (when the
+     bounds are checked) can't be projected. */
+  if( z==0.0 || (tan->bounds && z<0.0) || isnan(z) )
+    { pix[0]=pix[1]=NAN; return; }
+  s[tan->lng] =  tan->r0 * ( x*tan->sinphip + y*tan->cosphip ) / z;
+  s[tan->lat] = -tan->r0 * ( x*tan->cosphip - y*tan->sinphip ) / z;
+
+  /* Intermediate world coordinates to pixel coordinates. */
+  s[0]/=tan->cdelt[0];
+  s[1]/=tan->cdelt[1];
+  if( tan->distortion==GAL_WCS_DISTORTION_TPV
+      && wcs_convert_tan_undistort(tan, s, s) )
+    { pix[0]=pix[1]=NAN; return; }
+  pix[0]=tan->ipc[0]*s[0]+tan->ipc[1]*s[1]+tan->crpix[0];
+  pix[1]=tan->ipc[2]*s[0]+tan->ipc[3]*s[1]+tan->crpix[1];
+  if( tan->distortion==GAL_WCS_DISTORTION_SIP
+      && wcs_convert_tan_undistort(tan, pix, pix) )
+    pix[0]=pix[1]=NAN;
+}
+
 
 
+
+
+/* Worker function to convert the coordinates on each thread. Each action
+   is a chunk of 'WCS_CONVERT_CHUNK' coordinates. */
+static void *
+wcs_convert_on_thread(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct wcs_convert_params *p=(struct wcs_convert_params *)tprm->params;
+
+  int *stat=NULL, nelem=p->wcs->naxis;
+  size_t i, j, start, num, size=p->in->size;
+  struct wcsprm *wcs = p->wcss ? p->wcss[tprm->id] : p->wcs;
+  double *phi=NULL, *theta=NULL, *world=NULL, *pixcrd=NULL, *imgcrd=NULL;
+  double *icol[2]={NULL, NULL}, *ocol[2]={NULL, NULL}, a[2], b[2];
+
+  /* Necessary preparations. */
+  if(p->tan)
+    {
+      icol[0]=p->in->array;   icol[1]=p->in->next->array;
+      ocol[0]=p->out->array;  ocol[1]=p->out->next->array;
+    }
+  else
+    {
+      num=WCS_CONVERT_CHUNK;
+      phi    = gal_pointer_allocate( GAL_TYPE_FLOAT64, num,       0,
+                                     __func__, "phi");
+      stat   = gal_pointer_allocate( GAL_TYPE_INT,     num,       1,
+                                     __func__, "stat");
+      theta  = gal_pointer_allocate( GAL_TYPE_FLOAT64, num,       0,
+                                     __func__, "theta");
+      world  = gal_pointer_allocate( GAL_TYPE_FLOAT64, nelem*num, 0,
+                                     __func__, "world");
+      imgcrd = gal_pointer_allocate( GAL_TYPE_FLOAT64, nelem*num, 0,
+                                     __func__, "imgcrd");
+      pixcrd = gal_pointer_allocate( GAL_TYPE_FLOAT64, nelem*num, 0,
+                                     __func__, "pixcrd");
+    }
+
+  /* Go over all the actions (chunks) of this thread. */
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      /* Range of this chunk. */
+      start=tprm->indexs[i]*WCS_CONVERT_CHUNK;
+      num = ( start+WCS_CONVERT_CHUNK < size
+              ? WCS_CONVERT_CHUNK : size-start );
+
+      /* Native conversion: the columns are used directly. */
+      if(p->tan)
+        for(j=start;j<start+num;++j)
+          {
+            a[0]=icol[0][j];
+            a[1]=icol[1][j];
+            if(p->img2world) wcs_convert_tan_p2s(p->tan, a, b);
+            else             wcs_convert_tan_s2p(p->tan, a, b);
+            ocol[0][j]=b[0];
+            ocol[1][j]=b[1];
+          }
+
+      /* Use WCSLIB: write the values from the input list of separate
+         columns into a single array (WCSLIB input), do the conversion and
+         write the output into the output columns. We are ignoring the
+         over-all status here, because the 'stat' array is used to set
+         all bad coordinates to NaN. */
+      else if(p->img2world)
+        {
+          wcs_convert_list_to_from_array(p->in, pixcrd, stat, nelem,
+                                         start, num, 0);
+          wcsp2s(wcs, num, nelem, pixcrd, imgcrd, phi, theta, world,
+                 stat);
+          wcs_convert_list_to_from_array(p->out, world, stat, nelem,
+                                         start, num, 1);
+        }
+      else
+        {
+          wcs_convert_list_to_from_array(p->in, world, stat, nelem,
+                                         start, num, 0);
+          wcss2p(wcs, num, nelem, world, phi, theta, imgcrd, pixcrd,
+                 stat);
+          wcs_convert_list_to_from_array(p->out, pixcrd, stat, nelem,
+                                         start, num, 1);
+        }
+    }
+
   /* Clean up. */
-  free(phi);
-  free(stat);
-  free(theta);
-  free(world);
-  free(imgcrd);
-  free(pixcrd);
+  if(p->tan==NULL)
+    {
+      free(phi);
+      free(stat);
+      free(theta);
+      free(world);
+      free(imgcrd);
+      free(pixcrd);
+    }
 
+  /* Wait for all the other threads to finish, then return. */
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
 
-  /* Return the output list of coordinates. */
-  return out;
+
+
+
+
+/* Do the conversion in both directions. */
+static gal_data_t *
+wcs_convert(gal_data_t *coords, struct wcsprm *wcs, int inplace,
+            size_t numthreads, int img2world, const char *func)
+{
+  size_t i, numactions;
+  struct wcs_convert_params p;
+
+  /* Some sanity checks. */
+  if(numthreads==0)
+    error(EXIT_FAILURE, 0, "%s: the number of threads cannot be zero",
+          func);
+  wcs_convert_sanity_check(coords, wcs, func);
+
+  /* Allocate the output arrays if they were not already allocated. */
+  p.in=coords;
+  p.wcs=wcs;
+  p.wcss=NULL;
+  p.img2world=img2world;
+  p.out=wcs_convert_prepare_out(coords, wcs, inplace);
+
+  /* See if the native conversion can be used. */
+  p.tan=wcs_convert_tan_prepare(wcs);
+
+  /* When WCSLIB is used on multiple threads, each thread needs its own
+     copy of the WCS structure (it is not thread-safe). */
+  numactions=coords->size/WCS_CONVERT_CHUNK
+             + (coords->size%WCS_CONVERT_CHUNK ? 1 : 0);
+  if(numthreads>numactions) numthreads=numactions;
+  if(p.tan==NULL && numthreads>1)
+    {
+      errno=0;
+      p.wcss=malloc(numthreads*sizeof *p.wcss);
+      if(p.wcss==NULL)
+        error(EXIT_FAILURE, errno, "%s: allocating %zu bytes for "
+              "'p.wcss'", __func__, numthreads*sizeof *p.wcss);
+      for(i=0;i<numthreads;++i) p.wcss[i]=gal_wcs_copy(wcs);
+    }
+
+  /* Do the conversion. */
+  gal_threads_spin_off(wcs_convert_on_thread, &p, numactions, numthreads,
+                       coords->minmapsize, coords->quietmmap);
+
+  /* Clean up and return the output list of coordinates. */
+  if(p.wcss)
+    {
+      for(i=0;i<numthreads;++i) gal_wcs_free(p.wcss[i]);
+      free(p.wcss);
+    }
+  free(p.tan);
+  return p.out;
+}
+
+
+
+
+
+/* Convert world coordinates to image coordinates given the input WCS
+   structure. The input must be a linked list of data structures of float64
+   ('double') type. The top element of the linked list must be the first
+   coordinate and etc. If 'inplace' is non-zero, then the output will be
+   written into the input's allocated space. */
+gal_data_t *
+gal_wcs_world_to_img(gal_data_t *coords, struct wcsprm *wcs, int inplace)
+{
+  return gal_wcs_world_to_img_threads(coords, wcs, inplace, 1);
+}
+
+
+
+
+
+/* Similar to 'gal_wcs_world_to_img'. */
+gal_data_t *
+gal_wcs_img_to_world(gal_data_t *coords, struct wcsprm *wcs, int inplace)
+{
+  return gal_wcs_img_to_world_threads(coords, wcs, inplace, 1);
+}
+
+
+
+
+
+/* Similar to 'gal_wcs_world_to_img', but the coordinates are converted in
+   chunks on 'numthreads' threads. */
+gal_data_t *
+gal_wcs_world_to_img_threads(gal_data_t *coords, struct wcsprm *wcs,
+                             int inplace, size_t numthreads)
+{
+  /* It can happen that the input datasets are empty. In this case, simply
+     return them. */
+  if(coords->size==0 || coords->array==NULL)
+    {
+      if(inplace) return coords;
+      else error(EXIT_FAILURE, 0, "%s: a bug! Please contact us at "
+                 "'%s' to fix the problem. The input has no data and "
+                 "'inplace' is not called", __func__, PACKAGE_BUGREPORT);
+    }
+
+  /* Do the conversion. */
+  return wcs_convert(coords, wcs, inplace, numthreads, 0, __func__);
+}
+
+
+
+
+
+/* Similar to 'gal_wcs_img_to_world', but the coordinates are converted in
+   chunks on 'numthreads' threads. */
+gal_data_t *
+gal_wcs_img_to_world_threads(gal_data_t *coords, struct wcsprm *wcs,
+                             int inplace, size_t numthreads)
+{
+  return wcs_convert(coords, wcs, inplace, numthreads, 1, __func__);
 }
@@ -4,8 +4,6 @@
 
 
 __kernel void convolution(
-    __global float * image,
-    __global float * kernell,
 	__global float * image_array,
     __global size_t * image_dsize,
     __global float * kernell_array,
@@ -14,12 +12,6 @@ __kernel void convolution(
 	__global float * output
 )
 {	
-    /* correct the pointers 
-    image->dsize = image_dsize;
-    image->array = image_array;
-    kernell->dsize = kernell_dsize;
-    kernell->array = kernell_array;*/
-
     /* get the image and kernel size */
     int image_height = image_dsize[0];
     int image_width = image_dsize[1];
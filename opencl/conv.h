@@ -1,10 +1,15 @@
 #include <gnuastro/fits.h>
 
+/* Defined in 'gpu_utils.h' (not included here, so the CPU version can be
+   used without OpenCL). */
+struct gal_gpu_context_t;
+
 gal_data_t *
 gal_conv_cpu(gal_data_t *input_image, gal_data_t *kernel_image, size_t numthreads);
 
 
 gal_data_t *
-gal_conv_gpu(gal_data_t *input_image, gal_data_t *kernel_image, 
-                char * kernel_name, char * function_name, char *core_name,
-                size_t global_item_size, size_t local_item_size);
+gal_conv_gpu(struct gal_gpu_context_t *ctx, gal_data_t *input_image,
+             gal_data_t *kernel_image, char *kernel_name,
+             char *function_name, char *core_name,
+             size_t global_item_size, size_t local_item_size);
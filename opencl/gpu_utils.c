@@ -1,53 +1,23 @@
-#include "gpu_utils.h"
-#include <string.h>
-
-
-// char *
-// gal_gpu_read_file_to_string(char * name)
-// {
-//     FILE *fp;
-//     int ret=0;
-//     char *source_str;
-//     size_t source_size;
-//     fp = fopen(name, "r");
-//     source_str = (char*)malloc(MAX_SOURCE_SIZE);
-//     source_size = fread( source_str, 1, MAX_SOURCE_SIZE, fp);
-//     fclose( fp );
-
-//     return source_str;
-// }
-
-// size_t
-// gal_merge_files(char * kernel, char * core, char *result)
-// {
-//     FILE *coreFile = fopen("conv_core.h", "r");
-//     FILE *kernelFile = fopen("conv.cl", "r");
-
-//     fseek(coreFile, 0, SEEK_END);
-//     long coreSize = ftell(coreFile);
-//     fseek(coreFile, 0, SEEK_SET);
-
-    
-//     fseek(kernelFile, 0, SEEK_END);
-//     long kernelSize = ftell(kernelFile);
-//     fseek(kernelFile, 0, SEEK_SET);
+#include <config.h>
 
+#include <errno.h>
+#include <error.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/stat.h>
 
-//     result = (char *)malloc(coreSize + kernelSize + 1); // +1 for null-terminator
+#include <gnuastro/pointer.h>
 
-//     fread(result, 1, coreSize, coreFile);
+#include <gnuastro-internal/checkset.h>
 
-//     result[coreSize] = '\n';
+#include "gpu_utils.h"
 
-//     fread(result + coreSize + 1, 1, kernelSize, kernelFile);
 
-//     result[coreSize + kernelSize] = '\0';
 
-//     fclose(coreFile);
-//     fclose(kernelFile);
 
-//     return coreSize + kernelSize + 1;
-// }
 
 float diagnoseOpenCLnumber(cl_platform_id platform)
 {
@@ -59,145 +29,518 @@ float diagnoseOpenCLnumber(cl_platform_id platform)
     char version[4];
     version[3] = 0;
     memcpy(version, &complete_version[7], 3);
-    // printf("V %s %f\n", version, version_float);
     float version_float = atof(version);
     return version_float;
 }
 
+
+
+
+
 /*********************************************************************/
 /*************             Initialization          *******************/
 /*********************************************************************/
-/* Initializes the context and command queue with one of the available
-   devices, selected using device_id. Then creates the kernel object
-   using the created context for a specific funtion (named function_name)  */
-cl_kernel 
-gal_gpu_kernel_create(char *kernel_name, char *function_name, char *core_name,
-                        cl_device_id device_id, cl_context *context, 
-                        cl_command_queue *command_queue)
+/* Read the full contents of a file into an allocated string (with a
+   trailing '\0' that is not counted in 'size'). */
+static char *
+gpu_file_read(char *filename, size_t *size)
 {
-    /* initializations */
-    int ret=0;
-    cl_program program;
-    char device_name[1024];
-    cl_uint ret_num_devices;
-    cl_uint ret_num_platforms;
-    cl_platform_id platform_id = NULL; 
-
-    /* query available devices and select the one with device_id*/
-    // just put one availbale platform inside platform_id 
-    
-    /* Set up platform and GPU device */
-    cl_uint numPlatforms;
-
-    /* Find number of platforms */
-    ret = clGetPlatformIDs(0, NULL, &numPlatforms);
-    if (numPlatforms == 0)
+    FILE *fp;
+    long fsize;
+    char *out;
+
+    /* Open the file and find its size. */
+    errno=0;
+    fp=fopen(filename, "r");
+    if(fp==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't open '%s'", __func__,
+              filename);
+    if( fseek(fp, 0, SEEK_END) || (fsize=ftell(fp))<0
+        || fseek(fp, 0, SEEK_SET) )
+        error(EXIT_FAILURE, errno, "%s: couldn't find the size of '%s'",
+              __func__, filename);
+
+    /* Read the contents. */
+    out=gal_pointer_allocate(GAL_TYPE_UINT8, fsize+1, 0, __func__, "out");
+    if( fread(out, 1, fsize, fp) != (size_t)fsize )
+        error(EXIT_FAILURE, errno, "%s: couldn't read '%s'", __func__,
+              filename);
+    out[fsize]='\0';
+    *size=fsize;
+
+    /* Clean up and return. */
+    if(fclose(fp)==EOF)
+        error(EXIT_FAILURE, errno, "%s: couldn't close '%s'", __func__,
+              filename);
+    return out;
+}
+
+
+
+
+
+/* 64-bit FNV-1a hash of the given bytes (continuing from 'hash'). */
+static uint64_t
+gpu_hash(uint64_t hash, void *in, size_t size)
+{
+    size_t i;
+    unsigned char *c=in;
+    for(i=0;i<size;++i) { hash ^= c[i]; hash *= 0x100000001b3ULL; }
+    return hash;
+}
+
+
+
+
+
+/* Directory to keep the compiled programs in:
+   '$XDG_CACHE_HOME/gnuastro/opencl' (or '$HOME/.cache/gnuastro/opencl'
+   when 'XDG_CACHE_HOME' isn't set). If it can't be made, NULL is returned
+   and the programs are only kept in memory. */
+static char *
+gpu_cachedir(void)
+{
+    size_t i;
+    char *dir, *base;
+    char *sub[]={"gnuastro", "opencl"};
+    char *xdg=getenv("XDG_CACHE_HOME"), *home=getenv("HOME");
+
+    /* Set the base directory. */
+    if(xdg && xdg[0])
+        { if( asprintf(&dir, "%s", xdg)<0 ) return NULL; }
+    else if(home && home[0])
+        { if( asprintf(&dir, "%s/.cache", home)<0 ) return NULL; }
+    else return NULL;
+
+    /* Make the directories (if they don't already exist). */
+    if( gal_checkset_mkdir(dir) ) { free(dir); return NULL; }
+    for(i=0;i<sizeof sub/sizeof *sub;++i)
     {
-        printf("Found 0 platforms!\n");
-       
+        base=dir;
+        if( asprintf(&dir, "%s/%s", base, sub[i])<0 )
+            { free(base); return NULL; }
+        free(base);
+        if( gal_checkset_mkdir(dir) ) { free(dir); return NULL; }
     }
+    return dir;
+}
+
+
+
+
+
+/* String identifying the device and its driver (to be used in the hash
+   of the compiled programs). */
+static char *
+gpu_devkey(cl_platform_id platform, cl_device_id device)
+{
+    char *out;
+    char pname[256]={0}, dname[256]={0}, dversion[256]={0},
+        driver[256]={0};
+
+    clGetPlatformInfo(platform, CL_PLATFORM_NAME, sizeof pname-1, pname,
+                      NULL);
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof dname-1, dname, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_VERSION, sizeof dversion-1, dversion,
+                    NULL);
+    clGetDeviceInfo(device, CL_DRIVER_VERSION, sizeof driver-1, driver,
+                    NULL);
+    if( asprintf(&out, "%s|%s|%s|%s", pname, dname, dversion, driver)<0 )
+        error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
+    return out;
+}
+
+
 
-    /* Get all platforms */
-    cl_platform_id Platform[numPlatforms];
-    ret = clGetPlatformIDs(numPlatforms, Platform, NULL);
-    if(ret != CL_SUCCESS){
-        printf("NO PLATFORM/n");
+
+
+/* Find a device of the requested type on any of the available platforms
+   and build a context and command queue on it. These are kept in the
+   returned structure so the (expensive) initialization is only done once
+   and is then used in all later calls. When no OpenCL platform or device
+   is available, NULL is returned (so the caller can fall back to the
+   CPU). */
+gal_gpu_context_t *
+gal_gpu_context_create(cl_device_type type, int quiet)
+{
+    cl_int ret;
+    cl_uint i, numplatforms=0;
+    gal_gpu_context_t *ctx;
+    cl_platform_id *platforms;
+    char device_name[1024]={0};
+
+    /* Find the available platforms. */
+    if( clGetPlatformIDs(0, NULL, &numplatforms)!=CL_SUCCESS
+        || numplatforms==0 )
+        return NULL;
+    platforms=gal_pointer_allocate(GAL_TYPE_UINT8,
+                                   numplatforms*sizeof *platforms, 0,
+                                   __func__, "platforms");
+    if( clGetPlatformIDs(numplatforms, platforms, NULL)!=CL_SUCCESS )
+        { free(platforms); return NULL; }
+
+    /* Secure a device. */
+    errno=0;
+    ctx=calloc(1, sizeof *ctx);
+    if(ctx==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for "
+              "'ctx'", __func__, sizeof *ctx);
+    for(i=0;i<numplatforms;++i)
+        if( clGetDeviceIDs(platforms[i], type, 1, &ctx->device, NULL)
+            == CL_SUCCESS )
+            { ctx->platform=platforms[i]; break; }
+    free(platforms);
+    if(ctx->platform==NULL) { free(ctx); return NULL; }
+
+    /* Build the context and command queue. */
+    ctx->context=clCreateContext(NULL, 1, &ctx->device, NULL, NULL, &ret);
+    if(ret!=CL_SUCCESS) { free(ctx); return NULL; }
+    if( diagnoseOpenCLnumber(ctx->platform) >= 2.0 )
+        ctx->queue=clCreateCommandQueueWithProperties(ctx->context,
+                                                      ctx->device, 0, &ret);
+    else
+        ctx->queue=clCreateCommandQueue(ctx->context, ctx->device, 0, &ret);
+    if(ret!=CL_SUCCESS)
+        { clReleaseContext(ctx->context); free(ctx); return NULL; }
+
+    /* Identifiers for the cache of compiled programs. */
+    ctx->devkey=gpu_devkey(ctx->platform, ctx->device);
+    ctx->cachedir=gpu_cachedir();
+
+    /* Report the device. */
+    if(!quiet)
+    {
+        clGetDeviceInfo(ctx->device, CL_DEVICE_NAME, sizeof device_name-1,
+                        device_name, NULL);
+        printf("Using device: %s\n", device_name);
     }
+    return ctx;
+}
+
+
+
+
 
-    // Secure a device
-    for (int i = 0; i < numPlatforms; i++)
+/* Context that is used when no context is given to the high-level
+   functions: it is created on the first call and freed at exit. If no
+   OpenCL device is available, this will return NULL on every call
+   (without trying again). */
+static gal_gpu_context_t *gpu_context_default=NULL;
+
+static void
+gpu_context_default_free(void)
+{
+    gal_gpu_context_free(gpu_context_default);
+    gpu_context_default=NULL;
+}
+
+gal_gpu_context_t *
+gal_gpu_context_default(void)
+{
+    static int tried=0;
+    if(tried==0)
     {
-        ret = clGetDeviceIDs(Platform[i], DEVICE, 1, &device_id, NULL);
-        if (ret == CL_SUCCESS)
-        {
-            break;
-        }
+        tried=1;
+        gpu_context_default=gal_gpu_context_create(DEVICE, 0);
+        if(gpu_context_default) atexit(gpu_context_default_free);
     }
+    return gpu_context_default;
+}
+
+
+
 
-    clGetDeviceInfo(device_id, CL_DEVICE_NAME, sizeof(device_name), &device_name, NULL);
-    printf("Using device: %s\n", device_name);
 
-    *context = clCreateContext( NULL, 1, &device_id, NULL, NULL, &ret);
-     
-    float version_float = diagnoseOpenCLnumber(platform_id);
-    if(version_float >= 2.0) {
-      *command_queue = clCreateCommandQueueWithProperties(*context, device_id, 0, &ret);
-              
+void
+gal_gpu_context_free(gal_gpu_context_t *ctx)
+{
+    gal_gpu_buffer_t *b, *btmp;
+    gal_gpu_program_t *p, *ptmp;
+
+    if(ctx==NULL) return;
+
+    /* Free the cached programs and buffers. */
+    for(p=ctx->programs; p!=NULL; p=ptmp)
+    {
+        ptmp=p->next;
+        clReleaseKernel(p->kernel);
+        clReleaseProgram(p->program);
+        free(p->function_name);
+        free(p);
     }
-    else {
-        *command_queue = clCreateCommandQueue(*context, device_id, 0, &ret);
+    for(b=ctx->buffers; b!=NULL; b=btmp)
+    {
+        btmp=b->next;
+        clReleaseMemObject(b->mem);
+        free(b->host);
+        free(b);
     }
-  //  *command_queue = clCreateCommandQueueWithProperties(*context, device_id, 0, &ret);
- 
+
+    /* Free the context itself. */
+    clReleaseCommandQueue(ctx->queue);
+    clReleaseContext(ctx->context);
+    free(ctx->cachedir);
+    free(ctx->devkey);
+    free(ctx);
+}
 
 
-    // FILE *coreFile = fopen(core_name, "r");
-    // FILE *kernelFile = fopen(kernel_name, "r");
 
-    // char *result = (char *)malloc(MAX_SOURCE_SIZE); 
-    // size_t core_size = fread(result, 1, MAX_SOURCE_SIZE, coreFile);
-    
-    // result[core_size] = '\n';
-    // size_t kernel_size = fread(result + core_size+1, 1, MAX_SOURCE_SIZE, kernelFile);
-    // result[core_size + kernel_size] = '\0';
 
-    // fclose(coreFile);
-    // fclose(kernelFile);
 
+/* Abort with the build log of the program. */
+static void
+gpu_program_build_error(gal_gpu_context_t *ctx, cl_program program,
+                        char *kernel_name, cl_int ret)
+{
+    char *log;
+    size_t log_size=0;
+
+    clGetProgramBuildInfo(program, ctx->device, CL_PROGRAM_BUILD_LOG, 0,
+                          NULL, &log_size);
+    log=gal_pointer_allocate(GAL_TYPE_UINT8, log_size+1, 1, __func__,
+                             "log");
+    clGetProgramBuildInfo(program, ctx->device, CL_PROGRAM_BUILD_LOG,
+                          log_size, log, NULL);
+    error(EXIT_FAILURE, 0, "%s: couldn't build '%s' (OpenCL error %d). "
+          "The compilation log is:\n%s", __func__, kernel_name, ret, log);
+}
 
-    FILE *kernelFile = fopen(kernel_name, "r");
 
-    char *result = (char *)malloc(MAX_SOURCE_SIZE); 
 
 
-    size_t kernel_size = fread(result,1, MAX_SOURCE_SIZE, kernelFile);
-    fclose(kernelFile);
 
+/* Load a previously compiled program from the cache directory. If it
+   doesn't exist (or can't be used on this device, for example after a
+   driver update that wasn't caught in the hash), NULL is returned. */
+static cl_program
+gpu_program_load(gal_gpu_context_t *ctx, char *filename, char *options)
+{
+    size_t size;
+    cl_program program;
+    cl_int ret, binstatus;
+    unsigned char *binary;
+    struct stat st;
+
+    /* If the file doesn't exist, there is nothing to load. */
+    if( filename==NULL || stat(filename, &st) ) return NULL;
+
+    /* Read the binary and build the program from it. */
+    binary=(unsigned char *)gpu_file_read(filename, &size);
+    program=clCreateProgramWithBinary(ctx->context, 1, &ctx->device, &size,
+                                      (const unsigned char **)&binary,
+                                      &binstatus, &ret);
+    free(binary);
+    if(ret!=CL_SUCCESS || binstatus!=CL_SUCCESS)
+        { if(program) clReleaseProgram(program); return NULL; }
+    if( clBuildProgram(program, 1, &ctx->device, options, NULL, NULL)
+        != CL_SUCCESS )
+        { clReleaseProgram(program); return NULL; }
+    return program;
+}
 
-    program = clCreateProgramWithSource(*context, 1, 
-                                        (const char **)&result, 
-                                        (const size_t *)&kernel_size, &ret);
 
-    ret = clBuildProgram(program, 1, &device_id, "-I .", NULL, NULL);
-     if(ret!=CL_SUCCESS){
-        size_t log_size;
-    clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
 
-    char *log = (char *)malloc(log_size);
-    clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
 
-    // Print the compilation log
-    printf("Compilation log:\n%s\n", log);
 
-    // Free allocated memory
-    free(log);
+/* Write the binary of a compiled program into the cache directory. It is
+   first written in a temporary file and then renamed, so other processes
+   never see a partially written binary. Any failure here only means that
+   the program will be compiled again in the next run, so it isn't an
+   error. */
+static void
+gpu_program_save(cl_program program, char *filename)
+{
+    FILE *fp;
+    int failed;
+    size_t size=0;
+    char *tmpname;
+    unsigned char *binary;
+
+    /* Get the binary of the program (we only have one device). */
+    if( filename==NULL
+        || clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof size,
+                            &size, NULL)!=CL_SUCCESS
+        || size==0 )
+        return;
+    binary=gal_pointer_allocate(GAL_TYPE_UINT8, size, 0, __func__,
+                                "binary");
+    if( clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof binary,
+                         &binary, NULL)!=CL_SUCCESS )
+        { free(binary); return; }
+
+    /* Write it into the cache. */
+    if( asprintf(&tmpname, "%s.%ld.tmp", filename, (long)getpid())<0 )
+        { free(binary); return; }
+    fp=fopen(tmpname, "w");
+    if(fp)
+    {
+        failed = fwrite(binary, 1, size, fp)!=size;
+        failed = (fclose(fp)==EOF) || failed;
+        if( failed || rename(tmpname, filename) ) remove(tmpname);
     }
+    free(tmpname);
+    free(binary);
+}
+
 
-    cl_kernel kernel = clCreateKernel(program, function_name, &ret);
 
-    return kernel;
-    
-    }
 
 
+/* Return the kernel of 'function_name' in the OpenCL source file
+   'kernel_name' ('core_name' is an optional header that the source
+   includes; it is only used in the hash, so any change in it will also
+   trigger a re-build). Compiled programs are cached in memory (within the
+   context) and on disk (keyed by a hash of the sources, build options and
+   device/driver), so the program is only compiled once per device and
+   source. */
+cl_kernel
+gal_gpu_kernel_get(gal_gpu_context_t *ctx, char *kernel_name,
+                   char *function_name, char *core_name)
+{
+    cl_int ret;
+    uint64_t hash;
+    gal_gpu_program_t *p;
+    cl_program program=NULL;
+    size_t source_size, core_size;
+    char *source, *core, *slash, *options, *filename=NULL;
+
+    /* Build options: the directory of the source is added to the include
+       paths (so its headers can be found). */
+    slash=strrchr(kernel_name, '/');
+    if( ( slash==NULL
+          ? asprintf(&options, "-I .")
+          : asprintf(&options, "-I %.*s", (int)(slash-kernel_name),
+                     kernel_name) ) < 0 )
+        error(EXIT_FAILURE, 0, "%s: asprintf allocation", __func__);
+
+    /* Hash of everything that affects the compiled program. */
+    source=gpu_file_read(kernel_name, &source_size);
+    hash=gpu_hash(0xcbf29ce484222325ULL, source, source_size);
+    if(core_name)
+    {
+        core=gpu_file_read(core_name, &core_size);
+        hash=gpu_hash(hash, core, core_size);
+        free(core);
+    }
+    hash=gpu_hash(hash, options, strlen(options)+1);
+    hash=gpu_hash(hash, ctx->devkey, strlen(ctx->devkey)+1);
+
+    /* If this kernel has already been made, just return it. Otherwise, if
+       the program has been built (for another function), use it. */
+    for(p=ctx->programs; p!=NULL; p=p->next)
+        if( p->hash==hash && !strcmp(p->function_name, function_name) )
+            { free(source); free(options); return p->kernel; }
+    for(p=ctx->programs; p!=NULL; p=p->next)
+        if(p->hash==hash)
+            { program=p->program; clRetainProgram(program); break; }
+
+    /* Try loading the program from the cache directory, and if it isn't
+       there, build it from the source and save it in the cache. */
+    if(program==NULL)
+    {
+        if( ctx->cachedir
+            && asprintf(&filename, "%s/%016" PRIx64 ".bin", ctx->cachedir,
+                        hash)<0 )
+            filename=NULL;
+        program=gpu_program_load(ctx, filename, options);
+        if(program==NULL)
+        {
+            program=clCreateProgramWithSource(ctx->context, 1,
+                                              (const char **)&source,
+                                              &source_size, &ret);
+            if(ret!=CL_SUCCESS)
+                error(EXIT_FAILURE, 0, "%s: couldn't create program from "
+                      "'%s' (OpenCL error %d)", __func__, kernel_name, ret);
+            ret=clBuildProgram(program, 1, &ctx->device, options, NULL,
+                               NULL);
+            if(ret!=CL_SUCCESS)
+                gpu_program_build_error(ctx, program, kernel_name, ret);
+            gpu_program_save(program, filename);
+        }
+        free(filename);
+    }
+    free(source);
+    free(options);
+
+    /* Make the kernel and add it to the cache. */
+    errno=0;
+    p=malloc(sizeof *p);
+    if(p==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for 'p'",
+              __func__, sizeof *p);
+    p->hash=hash;
+    p->program=program;
+    p->kernel=clCreateKernel(program, function_name, &ret);
+    if(ret!=CL_SUCCESS)
+        error(EXIT_FAILURE, 0, "%s: no '%s' kernel in '%s' (OpenCL error "
+              "%d)", __func__, function_name, kernel_name, ret);
+    gal_checkset_allocate_copy(function_name, &p->function_name);
+    p->next=ctx->programs;
+    ctx->programs=p;
+    return p->kernel;
+}
+
 
 
-// void
-// gal_gpu_context_prepare(cl_device_id device_id, cl_context *context, cl_command_queue *command_queue)
-// {
 
-//     cl_platform_id platform_id = NULL;   
-//     cl_uint ret_num_devices;
-//     cl_uint ret_num_platforms;
 
-//     cl_int ret = clGetPlatformIDs(1, &platform_id, &ret_num_platforms);
-//     ret = clGetDeviceIDs( platform_id, CL_DEVICE_TYPE_DEFAULT, 1, &device_id, &ret_num_devices);
- 
-//     *context = clCreateContext( NULL, 1, &device_id, NULL, NULL, &ret);
- 
-//     *command_queue = clCreateCommandQueue(context, device_id, 0, &ret);
+/* Return a read-only buffer on the device with the given contents. If a
+   buffer with the same contents was requested before, it is re-used
+   (without uploading again). Only the most recent
+   'GAL_GPU_BUFFER_CACHE_NUM' buffers are kept, so this is only meant for
+   small arrays that are used in many calls (like the 'dsize' arrays or
+   the convolution kernel). The returned buffer belongs to the context,
+   so it should not be released by the caller. */
+cl_mem
+gal_gpu_buffer_readonly(gal_gpu_context_t *ctx, void *array, size_t nbytes)
+{
+    cl_int ret;
+    size_t num=0;
+    gal_gpu_buffer_t *b, *prev=NULL;
+
+    /* See if this buffer is already on the device. If so, move it to the
+       start of the list (so the least recently used is removed). */
+    for(b=ctx->buffers; b!=NULL; prev=b, b=b->next)
+        if( b->nbytes==nbytes && !memcmp(b->host, array, nbytes) )
+        {
+            if(prev)
+                { prev->next=b->next; b->next=ctx->buffers; ctx->buffers=b; }
+            return b->mem;
+        }
 
-// }
+    /* Upload it. */
+    errno=0;
+    b=malloc(sizeof *b);
+    if(b==NULL)
+        error(EXIT_FAILURE, errno, "%s: couldn't allocate %zu bytes for 'b'",
+              __func__, sizeof *b);
+    b->nbytes=nbytes;
+    b->host=gal_pointer_allocate(GAL_TYPE_UINT8, nbytes, 0, __func__,
+                                 "b->host");
+    memcpy(b->host, array, nbytes);
+    b->mem=clCreateBuffer(ctx->context,
+                          CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, nbytes,
+                          array, &ret);
+    if(ret!=CL_SUCCESS)
+        error(EXIT_FAILURE, 0, "%s: couldn't allocate %zu bytes on the "
+              "device (OpenCL error %d)", __func__, nbytes, ret);
+    b->next=ctx->buffers;
+    ctx->buffers=b;
+
+    /* Remove the least recently used buffer if there are too many. */
+    for(prev=b; prev->next!=NULL; prev=prev->next)
+        if(++num==GAL_GPU_BUFFER_CACHE_NUM)
+        {
+            b=prev->next;
+            prev->next=NULL;
+            clReleaseMemObject(b->mem);
+            free(b->host);
+            free(b);
+            break;
+        }
+    return ctx->buffers->mem;
+}
 
 
 
@@ -213,7 +556,7 @@ gal_gpu_copy_array_to_device(gal_data_t *in, cl_mem *input_mem_obj, cl_context c
                                     
     ret = clEnqueueWriteBuffer(command_queue, *input_mem_obj, CL_TRUE, 0,
                                 in->size * gal_type_sizeof(in->type), (float *)in->array, 0, NULL, NULL);
-
+    return *input_mem_obj;
 }
 
 
@@ -226,10 +569,11 @@ gal_gpu_copy_dsize_to_device(gal_data_t *in, cl_mem *input_mem_obj, cl_context c
 {
     int ret=0;
     *input_mem_obj = clCreateBuffer(context, CL_MEM_READ_ONLY, 
-                                    3*sizeof(size_t), NULL, &ret);
+                                    in->ndim*sizeof(size_t), NULL, &ret);
 
     ret = clEnqueueWriteBuffer(command_queue, *input_mem_obj, CL_TRUE, 0, 
-                                3*sizeof(size_t), in->dsize, 0, NULL, NULL);
+                                in->ndim*sizeof(size_t), in->dsize, 0, NULL, NULL);
+    return *input_mem_obj;
 }
 
 
@@ -246,6 +590,7 @@ gal_gpu_copy_struct_to_device(gal_data_t *in, cl_mem *input_mem_obj, cl_context
 
     ret = clEnqueueWriteBuffer(command_queue, *input_mem_obj, CL_TRUE, 0, 
                                 sizeof(in), in, 0, NULL, NULL);
+    return *input_mem_obj;
 }
 
 
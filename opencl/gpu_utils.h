@@ -1,9 +1,20 @@
 #include <stdio.h>
+#include <stdint.h>
 #include <gnuastro/data.h>
 #include <CL/cl.h>
 
 #define MAX_SOURCE_SIZE (0x100000)
 
+/* Type of device to use (can be set at compile time, for example
+   'make DEVICE=CL_DEVICE_TYPE_CPU'). */
+#ifndef DEVICE
+#define DEVICE CL_DEVICE_TYPE_DEFAULT
+#endif
+
+/* Maximum number of small read-only buffers that are kept on the device
+   (see 'gal_gpu_buffer_readonly'). */
+#define GAL_GPU_BUFFER_CACHE_NUM 16
+
 typedef struct gal_gpu_data_t
 {
   /* Basic information on array of data. */
@@ -46,13 +57,74 @@ typedef struct gal_gpu_data_t
 
 
 
+/* A compiled program and the kernel of one of its functions. These are
+   kept in the context so later calls don't need to build them again. The
+   hash is calculated over the source files, the build options and the
+   device (see 'gal_gpu_kernel_get'). */
+typedef struct gal_gpu_program_t
+{
+  uint64_t                    hash;  /* Hash of sources, options and device.  */
+  char              *function_name;  /* Name of the kernel function.          */
+  cl_program               program;  /* Compiled program.                     */
+  cl_kernel                 kernel;  /* Kernel of 'function_name'.            */
+  struct gal_gpu_program_t   *next;  /* Next cached program.                  */
+} gal_gpu_program_t;
+
+
+
+
+
+/* A small read-only buffer on the device (for example a 'dsize' array or
+   a convolution kernel). It is reused when the same contents are
+   requested again, so they are only uploaded once. */
+typedef struct gal_gpu_buffer_t
+{
+  void                       *host;  /* Copy of the uploaded contents.        */
+  size_t                    nbytes;  /* Number of bytes in the buffer.        */
+  cl_mem                       mem;  /* Buffer on the device.                 */
+  struct gal_gpu_buffer_t    *next;  /* Next cached buffer.                   */
+} gal_gpu_buffer_t;
+
+
+
+
+
+/* A long-lived OpenCL context: it is created once and used by all the
+   calls (until 'gal_gpu_context_free'). */
+typedef struct gal_gpu_context_t
+{
+  cl_platform_id          platform;  /* Platform hosting the device.          */
+  cl_device_id              device;  /* Device that is used.                  */
+  cl_context               context;  /* Context on the device.                */
+  cl_command_queue           queue;  /* Command queue on the device.          */
+  char                     *devkey;  /* Device/driver name and version.       */
+  char                   *cachedir;  /* Directory of compiled programs.       */
+  gal_gpu_program_t      *programs;  /* Programs that have been built.        */
+  gal_gpu_buffer_t        *buffers;  /* Cached read-only buffers.             */
+} gal_gpu_context_t;
+
+
+
+
+
 /*********************************************************************/
 /*************            initialization           *******************/
 /*********************************************************************/
-cl_kernel 
-gal_gpu_kernel_create(char *name, char *function_name, char *core_name, 
-                        cl_device_id device_id, cl_context *context, 
-                        cl_command_queue *command_queue);
+gal_gpu_context_t *
+gal_gpu_context_create(cl_device_type type, int quiet);
+
+gal_gpu_context_t *
+gal_gpu_context_default(void);
+
+void
+gal_gpu_context_free(gal_gpu_context_t *ctx);
+
+cl_kernel
+gal_gpu_kernel_get(gal_gpu_context_t *ctx, char *kernel_name,
+                   char *function_name, char *core_name);
+
+cl_mem
+gal_gpu_buffer_readonly(gal_gpu_context_t *ctx, void *array, size_t nbytes);
 
 
 
@@ -1,62 +1,63 @@
-#include "conv.h"
+#include <config.h>
+
+#include <time.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 #include <gnuastro/fits.h>
+#include <gnuastro/threads.h>
 
-int main(int argc){
+#include "conv.h"
+
+/* Directory containing 'conv.cl' and 'conv_core.h' (set by the build
+   system, otherwise the current directory). */
+#ifndef OPENCL_SRCDIR
+#define OPENCL_SRCDIR "."
+#endif
 
-    if(argc != 2){
-        // printf("invalid argumnets\n");
-        // exit(1);
-    }
 
-    clock_t start_load, end_load;
-    double cpu_time_used_load;
+/* Usage: './main [cpu|gpu] [number of repeats]'. With repeats, the
+   convolution is done several times to show the effect of keeping the
+   context and compiled program between calls (only the first GPU call
+   needs to initialize the device and build/load the program). */
+int main(int argc, char *argv[]){
 
-    start_load = clock();
+    size_t i, repeat = argc>2 ? strtoul(argv[2], NULL, 10) : 1;
+    int usegpu = argc>1 ? strcmp(argv[1], "cpu") : 1;
 
     gal_data_t *input_image = gal_fits_img_read_to_type("data/arithmetic.fits","1",GAL_TYPE_FLOAT32,-1,-1,"");
     gal_data_t *kernel_image = gal_fits_img_read_kernel("data/kernel.fits","1", -1, -1,"");
-    gal_data_t *output_image;
-
-    
-    end_load = clock();
-    cpu_time_used_load = ((double)(end_load - start_load)) / CLOCKS_PER_SEC;
-    //printf("Time taken in loadng input from Disk to CPU: %f\n", cpu_time_used_load);
-
-
-    clock_t start_total, end_total;
-    double cpu_time_used_total;
-
-    start_total = clock();
-
-    output_image = gal_conv_gpu(input_image, kernel_image,"conv.cl", "convolution","conv_core.h",input_image->size,128);
-
-    end_total = clock();
-    cpu_time_used_total = ((double)(end_total - start_total)) / CLOCKS_PER_SEC;
-    printf("\nTime taken for all operations : %f\n", cpu_time_used_total);
-
-
-
-    clock_t start_savi, end_savi;
-    double cpu_time_used_savi;
-
-    start_savi = clock();
+    gal_data_t *output_image = NULL;
+
+    for(i=0; i<repeat; ++i)
+    {
+        clock_t start_total, end_total;
+        double cpu_time_used_total;
+
+        start_total = clock();
+
+        gal_data_free(output_image);
+        output_image = usegpu
+            ? gal_conv_gpu(NULL, input_image, kernel_image,
+                           OPENCL_SRCDIR "/conv.cl", "convolution",
+                           OPENCL_SRCDIR "/conv_core.h", input_image->size,
+                           128)
+            : gal_conv_cpu(input_image, kernel_image, gal_threads_number());
+
+        end_total = clock();
+        cpu_time_used_total = ((double)(end_total - start_total)) / CLOCKS_PER_SEC;
+        printf("Time taken for all operations (call %zu): %f\n", i+1,
+               cpu_time_used_total);
+    }
 
     char res_file_name[20]="conv_";
-    strcat(res_file_name,"opencl");
+    strcat(res_file_name, usegpu ? "opencl" : "cpu");
     strcat(res_file_name,"_.fits");
-    fitsfile *fptr = gal_fits_img_write_to_ptr(output_image,res_file_name);
-    int status = 0;
-    fits_close_file(fptr, &status);
+    gal_fits_img_write(output_image, res_file_name, NULL, 0);
 
     gal_data_free(input_image);
     gal_data_free(kernel_image);
     gal_data_free(output_image);
 
-    end_savi = clock();
-    cpu_time_used_savi = ((double)(end_savi - start_savi)) / CLOCKS_PER_SEC;
-    //printf("Time taken in saving output from CPU to disk: %f\n", cpu_time_used_savi);
-
-
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,154 @@
+# Compare the running (sliding-window) median and mean filters with the
+# median and mean of each pixel's box (found from sigma-clipping that
+# doesn't clip anything).
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     agent <agent@local>
+# Contributing author(s):
+# Copyright (C) 2026 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=arithmetic
+img1=mkprofcat1.fits
+img2=convolve_spatial_noised.fits
+execname=../bin/$prog/ast$prog
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $img1     ]; then echo "$img1 does not exist.";  exit 77; fi
+if [ ! -f $img2     ]; then echo "$img2 does not exist.";  exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# The pixels of the profiles are blanked (so some boxes only have blank
+# pixels). The median is tested on floating point and on 32 and 16 bit
+# integers (which use different algorithms), with boxes of odd and even
+# widths, and boxes that are larger than the image. With a multiple of
+# 1e30 and one clip, sigma-clipping doesn't remove any pixel, so it gives
+# the median and mean of each box (with the box's pixels that are within
+# the image).
+$execname $img2 $img1 0 gt nan where 10 / --output=filter-float32.fits
+$execname filter-float32.fits int32 --output=filter-int32.fits
+$execname filter-float32.fits int16 --output=filter-int16.fits
+for type in float32 int32 int16; do
+    in=filter-$type.fits
+    for box in "5 5" "4 7" "1 120" "30 3"; do
+        name=filter-$type-$(echo $box | sed -e's/ /-/')
+        $check_with_program $execname $box $in filter-median \
+                                      --output=$name-median.fits
+        $check_with_program $execname $box $in filter-mean \
+                                      --output=$name-mean.fits
+        $execname 1e30 1 $box $in filter-sigclip-median \
+                  --output=$name-median-ref.fits
+        $execname 1e30 1 $box $in filter-sigclip-mean \
+                  --output=$name-mean-ref.fits
+
+        # The blank pixels should be the same, the medians should be
+        # identical and the means should only differ by floating point
+        # errors.
+        for stat in median mean; do
+            nblank=$($execname $name-$stat.fits isblank \
+                               $name-$stat-ref.fits isblank ne \
+                               sumvalue --quiet)
+            if [ $stat = median ]; then
+                diff=$($execname $name-$stat.fits $name-$stat-ref.fits \
+                                 - abs maxvalue --quiet)
+            else
+                diff=$($execname $name-$stat.fits $name-$stat-ref.fits \
+                                 - abs $name-$stat-ref.fits abs / \
+                                 maxvalue --quiet)
+            fi
+            if ! echo "$nblank $diff $stat" \
+                    | $AWK '{exit !($1==0 && ($3=="median" ? $2==0 \
+                                                           : $2<1e-5))}'
+            then
+                echo "filter-$stat on $type with a '$box' box: $nblank"\
+                     "pixels have different blank status and the"\
+                     "maximum difference is $diff"
+                exit 1
+            fi
+        done
+    done
+done
+
+
+
+
+
+# A long line (with a large offset, so round-off errors would accumulate
+# in a running sum) is compared with the mean of each box. The same line
+# with a positive and a negative infinity (55 pixels apart) should give
+# the same means outside the boxes of the infinities, an infinity in the
+# boxes that only contain one of them and NaN in the 46 boxes that
+# contain both.
+$execname 30000 1 makenew indexonly float64 0.01 x sin 1000 x 1e6 + \
+          --output=filter-line.fits
+$execname filter-line.fits \
+          filter-line.fits indexonly 12345 eq \
+          filter-line.fits 0 x 1 + 0 / where \
+          filter-line.fits indexonly 12400 eq \
+          filter-line.fits 0 x 1 - 0 / where \
+          --output=filter-line-inf.fits
+$check_with_program $execname 101 filter-line.fits filter-mean \
+                              --output=filter-line-mean.fits
+$check_with_program $execname 101 filter-line-inf.fits filter-mean \
+                              --output=filter-line-inf-mean.fits
+$execname 1e30 1 101 filter-line.fits filter-sigclip-mean \
+          --output=filter-line-mean-ref.fits
+diff=$($execname filter-line-mean.fits filter-line-mean-ref.fits - abs \
+                 filter-line-mean-ref.fits abs / maxvalue --quiet)
+diffinf=$($execname filter-line-inf-mean.fits filter-line-mean.fits - abs \
+                    filter-line-mean.fits abs / set-d d d isblank 0 where \
+                    set-e e e 1e300 gt 0 where maxvalue --quiet)
+npinf=$($execname filter-line-inf-mean.fits 1e300 gt sumvalue --quiet)
+nninf=$($execname filter-line-inf-mean.fits -1e300 lt sumvalue --quiet)
+nnan=$($execname filter-line-inf-mean.fits isblank sumvalue --quiet)
+if ! echo "$diff $diffinf $npinf $nninf $nnan" \
+        | $AWK '{exit !($1<1e-6 && $2<1e-10 && $3==55 && $4==55 && $5==46)}'
+then
+    echo "filter-mean on a long line: the maximum relative difference"\
+         "with the mean of each box is $diff; with infinities, the"\
+         "maximum relative difference of finite pixels is $diffinf and"\
+         "there are $npinf positive infinities, $nninf negative"\
+         "infinities and $nnan NaN pixels (should be 55, 55 and 46)"
+    exit 1
+fi
@@ -0,0 +1,77 @@
+# Stack images in strips of rows and compare the result with the stack of
+# the images that are read completely.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     agent <agent@local>
+# Contributing author(s):
+# Copyright (C) 2026 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=arithmetic
+img1=mkprofcat1.fits
+img2=convolve_spatial.fits
+img3=convolve_spatial_noised.fits
+execname=../bin/$prog/ast$prog
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $img1     ]; then echo "$img1 does not exist.";  exit 77; fi
+if [ ! -f $img2     ]; then echo "$img2 does not exist.";  exit 77; fi
+if [ ! -f $img3     ]; then echo "$img3 does not exist.";  exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# The strips are not a multiple of the number of rows (100), so the last
+# strip is shorter. The output should be identical to the default mode.
+for op in sum median "3 0.2 sigclip-mean"; do
+    name=stackstrip-$(echo $op | sed -e's/ /-/g')
+    $check_with_program $execname $img1 $img2 $img3 3 $op \
+                                  --output=$name-full.fits
+    $check_with_program $execname $img1 $img2 $img3 3 $op \
+                                  --stackstrip=7 --output=$name-strip.fits
+    maxdiff=$($execname $name-full.fits $name-strip.fits - abs \
+                        maxvalue --quiet)
+    if ! echo "$maxdiff" | $AWK '{exit !($1==0)}'; then
+        echo "'$op' in strips differs from the full stack by $maxdiff"
+        exit 1
+    fi
+done
@@ -0,0 +1,81 @@
+# Convolve an image in the spatial domain with tiles that are much smaller
+# than the kernel and compare it with the convolution on the default tiles.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     agent <agent@local>
+# Contributing author(s):
+# Copyright (C) 2026 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+psf=psf.fits
+prog=convolve
+img=mkprofcat1.fits
+ref=convolve_spatial.fits
+execname=../bin/$prog/ast$prog
+arith=$progbdir/astarithmetic
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $arith    ]; then echo "$arith not created.";    exit 77; fi
+if [ ! -f $img      ]; then echo "$img does not exist.";   exit 77; fi
+if [ ! -f $psf      ]; then echo "$psf does not exist.";   exit 77; fi
+if [ ! -f $ref      ]; then echo "$ref does not exist.";   exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# The kernel is much wider than the 4-pixel tiles, so the tiles on the
+# right edge of the image start within half a kernel width of the edge
+# (where no pixel can be in the interior). The pixels are independent of
+# the tiles, so the output should be the same as the default tiling (to
+# within floating point round-off errors).
+$check_with_program $execname $img --kernel=$psf --domain=spatial \
+                              --tilesize=4,4 \
+                              --output=convolve_spatial_small_tiles.fits
+
+# Find the maximum absolute difference (relative to the maximum value).
+maxdiff=$($arith convolve_spatial_small_tiles.fits $ref - abs \
+                 maxvalue --quiet)
+maxval=$($arith $ref maxvalue --quiet)
+if ! echo "$maxdiff $maxval" | $AWK '{exit !($1<=1e-5*$2)}'; then
+    echo "Convolution with small tiles differs by $maxdiff (max: $maxval)"
+    exit 1
+fi
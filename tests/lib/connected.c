@@ -0,0 +1,208 @@
+/*********************************************************************
+A test program for labeling connected components with Gnuastro's library.
+
+The labels of 'gal_binary_connected_components_threads' (on one and
+several threads) are compared with the labels of a simple flood fill
+that starts from every unlabeled pixel in raster order. The inputs have
+one to three dimensions, blank pixels, fractions of foreground pixels
+around the percolation threshold (so some components are very large and
+cross many strips) and fewer rows than threads.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gnuastro/blank.h"
+#include "gnuastro/binary.h"
+#include "gnuastro/pointer.h"
+#include "gnuastro/dimension.h"
+
+#include "testlib.h"
+
+
+
+
+
+/* Label the connected components with a flood fill: every unlabeled
+   foreground pixel (in raster order) starts a new label, and the labels
+   are given to all the pixels that can be reached from it. Two pixels are
+   neighbors when their coordinates differ by at most one along each
+   dimension and along at most 'connectivity' dimensions. */
+static size_t
+connected_flood(gal_data_t *binary, int32_t *lab, int connectivity)
+{
+  int off, outside;
+  int32_t numlabs=0;
+  uint8_t *b=binary->array;
+  size_t ndim=binary->ndim, *dsize=binary->dsize;
+  size_t d, i, j, k, p, n, nstack, nchanged, coord[3], ncoord[3];
+  size_t nneighbors = ndim==1 ? 3 : ( ndim==2 ? 9 : 27 );
+  size_t *stack=gal_pointer_allocate(GAL_TYPE_SIZE_T, binary->size, 0,
+                                     __func__, "stack");
+
+  /* Initialize the labels (blank pixels have a blank label). */
+  for(i=0;i<binary->size;++i)
+    lab[i] = b[i]==GAL_BLANK_UINT8 ? GAL_BLANK_INT32 : 0;
+
+  /* Label the pixels. */
+  for(i=0;i<binary->size;++i)
+    if(b[i]==1 && lab[i]==0)
+      {
+        lab[i]=++numlabs;
+        stack[0]=i;
+        nstack=1;
+        while(nstack)
+          {
+            p=stack[--nstack];
+            gal_dimension_index_to_coord(p, ndim, dsize, coord);
+
+            /* Go over all the '3^ndim' offsets (each between -1 and 1
+               along each dimension). */
+            for(j=0;j<nneighbors;++j)
+              {
+                for(k=j, nchanged=outside=0, d=0; d<ndim; ++d, k/=3)
+                  {
+                    off = (int)(k%3) - 1;
+                    if(off) ++nchanged;
+                    if( (off<0 && coord[d]==0)
+                        || (off>0 && coord[d]==dsize[d]-1) ) outside=1;
+                    ncoord[d]=coord[d]+off;
+                  }
+                if( nchanged==0 || nchanged>(size_t)connectivity
+                    || outside ) continue;
+                n=gal_dimension_coord_to_index(ndim, dsize, ncoord);
+                if(b[n]==1 && lab[n]==0)
+                  { lab[n]=numlabs; stack[nstack++]=n; }
+              }
+          }
+      }
+
+  /* Clean up and return. */
+  free(stack);
+  return numlabs;
+}
+
+
+
+
+
+/* Label the input on the given number of threads and compare with the
+   flood fill. */
+static int
+connected_check(gal_data_t *binary, int connectivity, size_t numthreads,
+                int32_t *expected, size_t numexpected)
+{
+  size_t i, numlabs;
+  int out=EXIT_SUCCESS;
+  gal_data_t *lab=NULL;
+  int32_t *l;
+
+  /* Label the input. */
+  numlabs=gal_binary_connected_components_threads(binary, &lab,
+                                                  connectivity,
+                                                  numthreads);
+
+  /* Compare the labels. */
+  l=lab->array;
+  if(numlabs!=numexpected)
+    {
+      fprintf(stderr, "%zu dimensions (%zu rows), connectivity %d, %zu "
+              "threads: %zu labels, but there should be %zu\n",
+              binary->ndim, binary->dsize[0], connectivity, numthreads,
+              numlabs, numexpected);
+      out=EXIT_FAILURE;
+    }
+  for(i=0;i<binary->size;++i)
+    if(l[i]!=expected[i])
+      {
+        fprintf(stderr, "%zu dimensions (%zu rows), connectivity %d, %zu "
+                "threads: pixel %zu has label %d, but it should be %d\n",
+                binary->ndim, binary->dsize[0], connectivity, numthreads,
+                i, l[i], expected[i]);
+        out=EXIT_FAILURE;
+        break;
+      }
+
+  /* Label again in the same (already allocated) dataset. */
+  if( gal_binary_connected_components_threads(binary, &lab, connectivity,
+                                              numthreads) != numlabs )
+    {
+      fprintf(stderr, "%zu dimensions, connectivity %d, %zu threads: "
+              "different number of labels with an allocated output\n",
+              binary->ndim, connectivity, numthreads);
+      out=EXIT_FAILURE;
+    }
+
+  /* Clean up and return. */
+  gal_data_free(lab);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  uint8_t *b;
+  int32_t *expected;
+  uint64_t state=TESTLIB_SEED;
+  gal_data_t *binary;
+  int c, out=EXIT_SUCCESS;
+  size_t i, s, f, t, ndim, numexpected;
+  size_t threads[]={1, 2, 3, 4, 7, 16};
+  double fraction[]={0.0, 0.3, 0.5, 0.6, 0.8, 1.0};
+  size_t dsize[][3]={ {1000, 0,   0}, {1,   300, 0},  {5, 90, 0},
+                      {200,  150, 0}, {400, 3,   0},  {3, 40, 50},
+                      {30,   20,  25} };
+
+  for(s=0;s<sizeof dsize/sizeof *dsize;++s)
+    for(f=0;f<sizeof fraction/sizeof *fraction;++f)
+      {
+        /* The input (with some blank pixels). */
+        ndim = dsize[s][1]==0 ? 1 : ( dsize[s][2]==0 ? 2 : 3 );
+        binary=gal_data_alloc(NULL, GAL_TYPE_UINT8, ndim, dsize[s], NULL,
+                              0, -1, 1, NULL, NULL, NULL);
+        b=binary->array;
+        for(i=0;i<binary->size;++i)
+          b[i] = ( testlib_chance(0.02, &state)
+                   ? GAL_BLANK_UINT8
+                   : testlib_chance(fraction[f], &state) );
+        expected=gal_pointer_allocate(GAL_TYPE_INT32, binary->size, 0,
+                                      __func__, "expected");
+
+        /* Check all the connectivities on all the threads. */
+        for(c=1;c<=(int)ndim;++c)
+          {
+            numexpected=connected_flood(binary, expected, c);
+            for(t=0;t<sizeof threads/sizeof *threads;++t)
+              if( connected_check(binary, c, threads[t], expected,
+                                  numexpected)==EXIT_FAILURE )
+                out=EXIT_FAILURE;
+          }
+
+        /* Clean up. */
+        free(expected);
+        gal_data_free(binary);
+      }
+
+  return out;
+}
@@ -0,0 +1,178 @@
+/*********************************************************************
+A test program for reading and writing FITS images in parallel strips.
+
+Images of all the numeric types (so all the FITS 'BITPIX' values, and
+the unsigned or signed types that need a 'BZERO' offset), with and
+without blank values, are written with 'gal_fits_img_write_threads' and
+read back with 'gal_fits_img_read_threads' (each on one and several
+threads). The read images must be identical to the written ones. The
+images are large enough to be written in several strips, but their sizes
+are not a multiple of the strips.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gnuastro/fits.h"
+#include "gnuastro/blank.h"
+
+#include "testlib.h"
+
+
+/* Name of the temporary file. */
+#define FILENAME "fitsthreads.fits"
+
+
+
+
+
+/* An image with random values over the full range of integer types (so
+   all the bytes have to be swapped and the offsets of unsigned types are
+   necessary), and 'blankfrac' of them blank. */
+static gal_data_t *
+fitsthreads_input(uint8_t type, size_t ndim, size_t *dsize,
+                  double blankfrac, uint64_t *state)
+{
+  size_t i;
+  uint64_t r;
+  gal_data_t *out=gal_data_alloc(NULL, type, ndim, dsize, NULL, 0, -1, 1,
+                                 NULL, NULL, NULL);
+  size_t width=gal_type_sizeof(type);
+  unsigned char *a=out->array;
+
+  for(i=0;i<out->size;++i)
+    {
+      r = testlib_random64(state);
+      if( testlib_chance(blankfrac, state) )
+        gal_blank_write(a+i*width, type);
+      else
+        switch(type)
+          {
+          case GAL_TYPE_FLOAT32:
+            ((float *)a)[i] = ( ((double)(r>>11)/(double)(1ULL<<53)-0.5)
+                                * pow(10, (double)(r%20)) );
+            break;
+          case GAL_TYPE_FLOAT64:
+            ((double *)a)[i] = ( ((double)(r>>11)/(double)(1ULL<<53)-0.5)
+                                 * pow(10, (double)(r%40)) );
+            break;
+          default:
+            memcpy(a+i*width, &r, width);
+          }
+    }
+  return out;
+}
+
+
+
+
+
+/* Write the image with 'wthreads' threads and read it back with
+   'rthreads' threads, then compare them. */
+static int
+fitsthreads_check(gal_data_t *img, size_t wthreads, size_t rthreads)
+{
+  size_t i;
+  gal_data_t *read;
+  int out=EXIT_SUCCESS;
+  size_t width=gal_type_sizeof(img->type);
+  unsigned char *a=img->array, *b;
+
+  /* Write the image into a new file and read it. */
+  unlink(FILENAME);
+  gal_fits_img_write_threads(img, FILENAME, NULL, 0, wthreads);
+  read=gal_fits_img_read_threads(FILENAME, "1", -1, 1, rthreads, NULL);
+
+  /* Check the type and size. */
+  if( read->type!=img->type || read->ndim!=img->ndim
+      || memcmp(read->dsize, img->dsize, img->ndim*sizeof *img->dsize) )
+    {
+      fprintf(stderr, "%s (%zu dimensions, first is %zu), written on %zu "
+              "and read on %zu threads: read as %s with %zu dimensions "
+              "(first is %zu)\n", gal_type_name(img->type, 1), img->ndim,
+              img->dsize[0], wthreads, rthreads,
+              gal_type_name(read->type, 1), read->ndim, read->dsize[0]);
+      gal_data_free(read);
+      return EXIT_FAILURE;
+    }
+
+  /* Check the values (the blank values of floating point types are NaN,
+     which may have different bits). */
+  b=read->array;
+  for(i=0;i<img->size;++i)
+    if( gal_blank_is(a+i*width, img->type)
+        ? !gal_blank_is(b+i*width, img->type)
+        : memcmp(a+i*width, b+i*width, width) )
+      {
+        fprintf(stderr, "%s (%zu dimensions, first is %zu), written on "
+                "%zu and read on %zu threads: element %zu is different\n",
+                gal_type_name(img->type, 1), img->ndim, img->dsize[0],
+                wthreads, rthreads, i);
+        out=EXIT_FAILURE;
+        break;
+      }
+
+  /* Clean up and return. */
+  gal_data_free(read);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  gal_data_t *img;
+  uint64_t state=TESTLIB_SEED;
+  int out=EXIT_SUCCESS;
+  size_t t, s, b, w, r, ndim;
+  size_t threads[]={1, 4};
+  double blankfrac[]={0.0, 0.01};
+  size_t dsize[][3]={ {270001, 0, 0}, {13, 7, 0}, {517, 611, 0},
+                      {3, 250, 401} };
+  uint8_t types[]={GAL_TYPE_UINT8, GAL_TYPE_INT8, GAL_TYPE_UINT16,
+                   GAL_TYPE_INT16, GAL_TYPE_UINT32, GAL_TYPE_INT32,
+                   GAL_TYPE_UINT64, GAL_TYPE_INT64, GAL_TYPE_FLOAT32,
+                   GAL_TYPE_FLOAT64};
+
+  for(t=0;t<sizeof types/sizeof *types;++t)
+    for(s=0;s<sizeof dsize/sizeof *dsize;++s)
+      for(b=0;b<sizeof blankfrac/sizeof *blankfrac;++b)
+        {
+          ndim = dsize[s][1]==0 ? 1 : ( dsize[s][2]==0 ? 2 : 3 );
+          img=fitsthreads_input(types[t], ndim, dsize[s], blankfrac[b],
+                                &state);
+          for(w=0;w<sizeof threads/sizeof *threads;++w)
+            for(r=0;r<sizeof threads/sizeof *threads;++r)
+              if( fitsthreads_check(img, threads[w],
+                                    threads[r])==EXIT_FAILURE )
+                out=EXIT_FAILURE;
+          gal_data_free(img);
+        }
+
+  /* Clean up and return. */
+  unlink(FILENAME);
+  return out;
+}
@@ -0,0 +1,371 @@
+/*********************************************************************
+A test program for nearest neighbor interpolation with the radial metric.
+
+The outputs of 'gal_interpolate_neighbors' with the radial metric (where
+the neighbors are found with a k-d tree), on one and several threads,
+are compared with the minimum, maximum, mean or median of the nearest
+non-blank elements that are found by measuring the distance to all the
+non-blank elements (when several elements have the same distance, the
+ones with a smaller index are nearer). The inputs have one to three
+dimensions, a few or many blank elements (or a large blank region), and
+are interpolated as a whole or over each channel of a tessellation
+separately. Both filling only the blank elements and all the elements
+are checked, on a single dataset and on a list of datasets (with
+different types).
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/blank.h"
+#include "gnuastro/tile.h"
+#include "gnuastro/pointer.h"
+#include "gnuastro/dimension.h"
+#include "gnuastro/statistics.h"
+#include "gnuastro/interpolate.h"
+
+#include "testlib.h"
+
+
+/* Maximum number of dimensions and of neighbors. */
+#define MAXDIM 3
+#define MAXNGB 9
+
+/* The blank elements of the first input. */
+enum blanks
+  {
+    BLANKS_NONE,
+    BLANKS_FEW,
+    BLANKS_MOST,
+    BLANKS_REGION,            /* Only the start of each channel is used. */
+    BLANKS_NUMBER,            /* Number of blank types (must be last).   */
+  };
+
+/* A neighbor (index and squared distance). */
+struct neighbor
+{
+  size_t dist;
+  size_t index;
+};
+
+/* The inputs and the nearest neighbors of each element. */
+struct interpolate_test
+{
+  size_t          ndim;  /* Number of dimensions.                      */
+  size_t           nch;  /* Number of channels.                        */
+  size_t      *chdsize;  /* Size of each channel along each dimension. */
+  gal_data_t    *input;  /* 32-bit float (with blanks) and integer.    */
+  size_t          *ngb;  /* The 'MAXNGB' nearest neighbors of elements.*/
+  size_t         numin;  /* Smallest number of non-blanks in a channel.*/
+};
+
+
+
+
+
+/* The two inputs: the first is a 32-bit floating point dataset with blank
+   elements and the second is a 32-bit signed integer. The values are
+   integers (so the mean doesn't depend on the order of the neighbors). */
+static void
+interpolate_input(struct interpolate_test *t, size_t *dsize, int blanks,
+                  uint64_t *state)
+{
+  float *f;
+  int32_t *s;
+  size_t i, chsize;
+
+  /* Allocate the inputs. */
+  t->input=NULL;
+  gal_list_data_add_alloc(&t->input, NULL, GAL_TYPE_INT32, t->ndim, dsize,
+                          NULL, 0, -1, 1, NULL, NULL, NULL);
+  gal_list_data_add_alloc(&t->input, NULL, GAL_TYPE_FLOAT32, t->ndim,
+                          dsize, NULL, 0, -1, 1, NULL, NULL, NULL);
+  f=t->input->array;
+  s=t->input->next->array;
+  chsize=t->input->size/t->nch;
+
+  /* Fill them. */
+  for(i=0;i<t->input->size;++i)
+    {
+      s[i] = (int32_t)(testlib_random(state)%2001) - 1000;
+      f[i] = testlib_random(state)%100;
+      switch(blanks)
+        {
+        case BLANKS_NONE:
+          break;
+        case BLANKS_FEW:
+          if(testlib_random(state)%10==0) f[i]=NAN;
+          break;
+        case BLANKS_MOST:
+          if(testlib_random(state)%10) f[i]=NAN;
+          break;
+        case BLANKS_REGION:
+          if(i%chsize>=chsize/10) f[i]=NAN;
+          break;
+        default:
+          fprintf(stderr, "%s: blank type %d is not recognized\n",
+                  __func__, blanks);
+          exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+
+
+
+/* Sort the neighbors by their distance, and by their index when the
+   distances are equal. */
+static int
+interpolate_neighbor_compare(const void *a, const void *b)
+{
+  const struct neighbor *na=a, *nb=b;
+  return ( na->dist!=nb->dist
+           ? (na->dist>nb->dist) - (na->dist<nb->dist)
+           : (na->index>nb->index) - (na->index<nb->index) );
+}
+
+
+
+
+
+/* Find the 'MAXNGB' nearest non-blank elements of each element (in the
+   same channel) by measuring the distance to all of them. */
+static void
+interpolate_brute(struct interpolate_test *t)
+{
+  float *f=t->input->array;
+  size_t c, d, i, j, n, dist, cstart, ci[MAXDIM], cj[MAXDIM];
+  size_t chsize=t->input->size/t->nch;
+  struct neighbor *nb=malloc(t->input->size*sizeof *nb);
+
+  if(nb==NULL)
+    {
+      fprintf(stderr, "%s: couldn't allocate the neighbors\n", __func__);
+      exit(EXIT_FAILURE);
+    }
+
+  t->numin=GAL_BLANK_SIZE_T;
+  t->ngb=gal_pointer_allocate(GAL_TYPE_SIZE_T, t->input->size*MAXNGB, 0,
+                              __func__, "t->ngb");
+  for(i=0;i<t->input->size;++i)
+    {
+      /* The distances to the non-blank elements of this channel. */
+      c=i/chsize;
+      cstart=c*chsize;
+      gal_dimension_index_to_coord(i-cstart, t->ndim, t->chdsize, ci);
+      for(n=0, j=cstart; j<cstart+chsize; ++j)
+        if( !isnan(f[j]) )
+          {
+            gal_dimension_index_to_coord(j-cstart, t->ndim, t->chdsize,
+                                         cj);
+            for(dist=d=0;d<t->ndim;++d)
+              dist += ( ci[d]>cj[d]
+                        ? (ci[d]-cj[d])*(ci[d]-cj[d])
+                        : (cj[d]-ci[d])*(cj[d]-ci[d]) );
+            nb[n].dist=dist;
+            nb[n++].index=j;
+          }
+      if(n<t->numin) t->numin=n;
+
+      /* Keep the nearest ones. */
+      qsort(nb, n, sizeof *nb, interpolate_neighbor_compare);
+      for(j=0;j<MAXNGB;++j)
+        t->ngb[i*MAXNGB+j] = j<n ? nb[j].index : GAL_BLANK_SIZE_T;
+    }
+  free(nb);
+}
+
+
+
+
+
+/* The expected value of element 'i' of 'in' with the given function on
+   its 'k' nearest neighbors (written in 'out'). */
+static void
+interpolate_expected(struct interpolate_test *t, gal_data_t *in, size_t i,
+                     size_t k, int function, void *out)
+{
+  size_t j;
+  gal_data_t *value=NULL;
+  size_t width=gal_type_sizeof(in->type);
+  gal_data_t *near=gal_data_alloc(NULL, in->type, 1, &k, NULL, 0, -1, 1,
+                                  NULL, NULL, NULL);
+
+  /* The values of the neighbors. */
+  for(j=0;j<k;++j)
+    memcpy(gal_pointer_increment(near->array, j, in->type),
+           gal_pointer_increment(in->array, t->ngb[i*MAXNGB+j], in->type),
+           width);
+
+  /* The statistic (like the interpolation). */
+  switch(function)
+    {
+    case GAL_INTERPOLATE_NEIGHBORS_FUNC_MIN:
+      value=gal_statistics_minimum(near);                   break;
+    case GAL_INTERPOLATE_NEIGHBORS_FUNC_MAX:
+      value=gal_statistics_maximum(near);                   break;
+    case GAL_INTERPOLATE_NEIGHBORS_FUNC_MEAN:
+      value=gal_statistics_mean(near);
+      value=gal_data_copy_to_new_type_free(value, in->type); break;
+    case GAL_INTERPOLATE_NEIGHBORS_FUNC_MEDIAN:
+      value=gal_statistics_median(near, 1);                 break;
+    default:
+      fprintf(stderr, "%s: function %d is not recognized\n", __func__,
+              function);
+      exit(EXIT_FAILURE);
+    }
+  memcpy(out, value->array, width);
+
+  /* Clean up. */
+  gal_data_free(near);
+  gal_data_free(value);
+}
+
+
+
+
+
+/* Interpolate the input(s) and compare with the expected values. */
+static int
+interpolate_check(struct interpolate_test *t,
+                  struct gal_tile_two_layer_params *tl, size_t k,
+                  int function, int onlyblank, int aslinkedlist,
+                  size_t numthreads)
+{
+  size_t i;
+  double expected;
+  int out=EXIT_SUCCESS;
+  float *f=t->input->array;
+  gal_data_t *in, *output, *o;
+  size_t width;
+
+  /* Interpolate. */
+  output=gal_interpolate_neighbors(t->input, tl,
+                                   GAL_INTERPOLATE_NEIGHBORS_METRIC_RADIAL,
+                                   k, numthreads, onlyblank, aslinkedlist,
+                                   function);
+
+  /* Check all the outputs. */
+  for(in=t->input, o=output; o!=NULL; in=in->next, o=o->next)
+    {
+      width=gal_type_sizeof(in->type);
+      for(i=0;i<in->size;++i)
+        {
+          /* The expected value. */
+          if(onlyblank && !isnan(f[i]))
+            memcpy(&expected, gal_pointer_increment(in->array, i,
+                                                    in->type), width);
+          else
+            interpolate_expected(t, in, i, k, function, &expected);
+
+          /* Compare it with the output. */
+          if( memcmp(&expected, gal_pointer_increment(o->array, i,
+                                                      o->type), width) )
+            {
+              fprintf(stderr, "%zu dimensions (first is %zu), %zu "
+                      "channels, %s, %zu neighbors, function %d, %s, "
+                      "%zu threads: element %zu is different\n", t->ndim,
+                      in->dsize[0], t->nch, gal_type_name(in->type, 1),
+                      k, function, onlyblank ? "only blanks" : "all",
+                      numthreads, i);
+              out=EXIT_FAILURE;
+              break;
+            }
+        }
+    }
+
+  /* Make sure a list is only returned when asked for. */
+  if( gal_list_data_number(output) != (aslinkedlist ? 2 : 1) )
+    {
+      fprintf(stderr, "%zu dimensions (first is %zu), %zu channels: %zu "
+              "outputs, but it should be %d\n", t->ndim,
+              t->input->dsize[0], t->nch, gal_list_data_number(output),
+              aslinkedlist ? 2 : 1);
+      out=EXIT_FAILURE;
+    }
+
+  /* Clean up and return. */
+  gal_list_data_free(output);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  uint64_t state=TESTLIB_SEED;
+  struct interpolate_test t;
+  int out=EXIT_SUCCESS;
+  int b, ob, al, function;
+  struct gal_tile_two_layer_params tl, *tlp;
+  size_t d, s, c, k, n, chdsize[MAXDIM];
+  size_t threads[]={1, 4}, knum[]={1, 4, MAXNGB}, nch[]={1, 2};
+  size_t dsize[][MAXDIM]={ {600, 0, 0}, {30, 25, 0}, {8, 9, 10} };
+
+  for(s=0;s<sizeof dsize/sizeof *dsize;++s)
+    for(c=0;c<sizeof nch/sizeof *nch;++c)
+      for(b=0;b<BLANKS_NUMBER;++b)
+        {
+          /* The inputs (the channels are along the first dimension). */
+          t.ndim = dsize[s][1]==0 ? 1 : ( dsize[s][2]==0 ? 2 : 3 );
+          t.nch=nch[c];
+          t.chdsize=chdsize;
+          for(d=0;d<t.ndim;++d) chdsize[d]=dsize[s][d];
+          chdsize[0]/=t.nch;
+          interpolate_input(&t, dsize[s], b, &state);
+          interpolate_brute(&t);
+
+          /* The tessellation (only the parameters that are necessary for
+             interpolating over each channel). */
+          memset(&tl, 0, sizeof tl);
+          tl.ndim=t.ndim;
+          tl.totchannels=t.nch;
+          tl.numtilesinch=chdsize;
+          tl.tottilesinch=t.input->size/t.nch;
+          tlp = t.nch>1 ? &tl : NULL;
+
+          /* Do the checks (when there are enough neighbors). */
+          for(k=0;k<sizeof knum/sizeof *knum;++k)
+            if(knum[k]<=t.numin)
+              for(function=GAL_INTERPOLATE_NEIGHBORS_FUNC_MIN;
+                  function<=GAL_INTERPOLATE_NEIGHBORS_FUNC_MEDIAN;
+                  ++function)
+                for(ob=0;ob<2;++ob)
+                  for(al=0;al<2;++al)
+                    for(n=0;n<sizeof threads/sizeof *threads;++n)
+                      if( interpolate_check(&t, tlp, knum[k], function,
+                                            ob, al,
+                                            threads[n])==EXIT_FAILURE )
+                        out=EXIT_FAILURE;
+
+          /* Clean up. */
+          free(t.ngb);
+          gal_list_data_free(t.input);
+        }
+
+  return out;
+}
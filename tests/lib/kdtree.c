@@ -0,0 +1,390 @@
+/*********************************************************************
+A test program for k-d tree searches with Gnuastro's library.
+
+The neighbours that are found with the k-d tree of 'gal_kdtree_create'
+('gal_kdtree_nearest_neighbour', 'gal_kdtree_nearest_neighbours' and
+'gal_kdtree_range') are compared with the neighbours that are found by
+measuring the distance to all the points. The points have one to three
+dimensions, real or integer coordinates (with many points at the same
+distance, or on a grid of two values along each dimension so most points
+have the same coordinates), or all the points are identical. Some query
+points have blank coordinates. The flat layout of the tree is built once
+and used by all the batch queries, which shouldn't change the tree.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/blank.h"
+#include "gnuastro/kdtree.h"
+#include "gnuastro/pointer.h"
+
+#include "testlib.h"
+
+
+/* Number of query points. */
+#define NUMQUERY 300
+
+/* Maximum number of dimensions. */
+#define MAXDIM 3
+
+/* A neighbour (index and squared distance). */
+struct neighbour
+{
+  double dist;
+  size_t index;
+};
+
+/* The points, the query points and their k-d tree. */
+struct kdtree_test
+{
+  size_t          ndim;  /* Number of dimensions.                      */
+  size_t          grid;  /* Integer coordinates (if not zero).         */
+  gal_data_t   *coords;  /* Coordinates of the points.                 */
+  gal_data_t  *queries;  /* Coordinates of the query points.           */
+  gal_data_t     *tree;  /* The k-d tree.                              */
+  size_t          root;  /* Root of the k-d tree.                      */
+  gal_kdtree_flat_t *flat; /* Flat layout of the tree.                */
+  struct neighbour **nb; /* All points (sorted) for each query point.  */
+};
+
+
+
+
+
+/* A list of 'ndim' columns with 'num' random coordinates. When 'grid' is
+   non-zero, the coordinates are integers between 0 and 'grid' (so many
+   points have the same distance to the query points). When 'same' is
+   non-zero, all the rows are identical. 'blankfrac' of the rows will have
+   a blank coordinate (in one dimension). */
+static gal_data_t *
+kdtree_points(size_t ndim, size_t num, size_t grid, int same,
+              double blankfrac, uint64_t *state)
+{
+  size_t d, i;
+  gal_data_t *out=NULL, *col;
+  double *c[MAXDIM];
+
+  /* Allocate the columns. */
+  for(d=0;d<ndim;++d)
+    gal_list_data_add_alloc(&out, NULL, GAL_TYPE_FLOAT64, 1, &num, NULL,
+                            0, -1, 1, NULL, NULL, NULL);
+  for(d=0, col=out; col!=NULL; col=col->next) c[d++]=col->array;
+
+  /* Fill them. */
+  for(i=0;i<num;++i)
+    {
+      for(d=0;d<ndim;++d)
+        c[d][i] = ( same && i
+                    ? c[d][0]
+                    : ( grid
+                        ? (double)(testlib_random(state)%(grid+1))
+                        : testlib_uniform(0, 100, state) ) );
+      if( testlib_chance(blankfrac, state) )
+        c[testlib_random(state)%ndim][i]=NAN;
+    }
+  return out;
+}
+
+
+
+
+
+/* Order the neighbours by distance, and the ones with the same distance
+   by their index. */
+static int
+kdtree_neighbour_compare(const void *a, const void *b)
+{
+  const struct neighbour *A=a, *B=b;
+  return ( A->dist < B->dist ? -1
+           : ( A->dist > B->dist ? 1
+               : (A->index > B->index) - (A->index < B->index) ) );
+}
+
+
+
+
+
+/* Coordinates of a query point (returns 1 if it has a blank
+   coordinate). */
+static int
+kdtree_query(struct kdtree_test *t, size_t i, double *q)
+{
+  size_t d;
+  int blank=0;
+  gal_data_t *col;
+
+  for(d=0, col=t->queries; col!=NULL; col=col->next, ++d)
+    if( isnan( q[d]=((double *)col->array)[i] ) ) blank=1;
+  return blank;
+}
+
+
+
+
+
+/* Squared distance of all the points to all the query points (sorted by
+   distance and index). The dimensions are added in order (like the
+   library), so the distances are identical. Query points with a blank
+   coordinate have no neighbour (NULL). */
+static void
+kdtree_brute(struct kdtree_test *t)
+{
+  gal_data_t *col;
+  double x, q[MAXDIM];
+  size_t d, i, j, n=t->coords->size;
+
+  t->nb=gal_pointer_allocate(GAL_TYPE_UINT8, NUMQUERY*sizeof *t->nb, 0,
+                             __func__, "t->nb");
+  for(i=0;i<NUMQUERY;++i)
+    {
+      t->nb[i]=NULL;
+      if( kdtree_query(t, i, q) || n==0 ) continue;
+      t->nb[i]=gal_pointer_allocate(GAL_TYPE_UINT8, n*sizeof *t->nb[i],
+                                    0, __func__, "t->nb[i]");
+      for(j=0;j<n;++j)
+        {
+          t->nb[i][j].index=j;
+          t->nb[i][j].dist=0.0;
+          for(d=0, col=t->coords; col!=NULL; col=col->next, ++d)
+            {
+              x=((double *)col->array)[j]-q[d];
+              t->nb[i][j].dist += x*x;
+            }
+        }
+      qsort(t->nb[i], n, sizeof *t->nb[i], kdtree_neighbour_compare);
+    }
+}
+
+
+
+
+
+/* The nearest neighbour of each point with the single-point function.
+   When several points are at the same distance, any of them may be
+   returned, so only the distance is checked. */
+static int
+kdtree_check_single(struct kdtree_test *t)
+{
+  size_t i, ind;
+  double q[MAXDIM], dist;
+
+  for(i=0;i<NUMQUERY;++i)
+    if(t->nb[i])
+      {
+        kdtree_query(t, i, q);
+        ind=gal_kdtree_nearest_neighbour(t->coords, t->tree, t->root, q,
+                                         &dist);
+        if( dist!=sqrt(t->nb[i][0].dist) || ind>=t->coords->size )
+          {
+            fprintf(stderr, "%zu dimensions, %zu points (grid: %zu): "
+                    "the nearest neighbour of query %zu is %zu at %g, "
+                    "but it should be at %g\n", t->ndim, t->coords->size,
+                    t->grid, i, ind, dist, sqrt(t->nb[i][0].dist));
+            return EXIT_FAILURE;
+          }
+      }
+  return EXIT_SUCCESS;
+}
+
+
+
+
+
+/* The batch queries shouldn't change the k-d tree. */
+static int
+kdtree_check_tree(struct kdtree_test *t)
+{
+  if( t->tree && gal_list_data_number(t->tree)!=2 )
+    {
+      fprintf(stderr, "%zu dimensions, %zu points (grid: %zu): the k-d "
+              "tree has %zu columns after a batch query\n", t->ndim,
+              t->coords->size, t->grid, gal_list_data_number(t->tree));
+      return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+
+
+
+
+/* The 'k' nearest neighbours (within 'maxdist') of all the query
+   points. */
+static int
+kdtree_check_nearest(struct kdtree_test *t, size_t k, double maxdist,
+                     size_t numthreads)
+{
+  gal_data_t *out;
+  size_t i, j, *ind, eind;
+  double *dist, edist, maxdist2=maxdist*maxdist;
+  int ret=EXIT_SUCCESS;
+
+  out=gal_kdtree_nearest_neighbours(t->flat, t->queries, k, maxdist,
+                                    numthreads, -1, 1);
+  ret=kdtree_check_tree(t);
+  ind=out->array;
+  dist=out->next->array;
+  for(i=0;i<NUMQUERY && ret==EXIT_SUCCESS;++i)
+    for(j=0;j<k;++j)
+      {
+        /* The expected neighbour. */
+        if( t->nb[i] && j<t->coords->size
+            && ( isnan(maxdist) || t->nb[i][j].dist<maxdist2 ) )
+          { eind=t->nb[i][j].index; edist=sqrt(t->nb[i][j].dist); }
+        else
+          { eind=GAL_BLANK_SIZE_T; edist=NAN; }
+
+        /* Compare it. */
+        if( ind[i*k+j]!=eind
+            || (isnan(edist) ? !isnan(dist[i*k+j]) : dist[i*k+j]!=edist) )
+          {
+            fprintf(stderr, "%zu dimensions, %zu points (grid: %zu), "
+                    "k=%zu, maximum distance %g, %zu threads: neighbour "
+                    "%zu of query %zu is %zu at %g, but it should be %zu "
+                    "at %g\n", t->ndim, t->coords->size, t->grid, k,
+                    maxdist, numthreads, j, i, ind[i*k+j], dist[i*k+j],
+                    eind, edist);
+            ret=EXIT_FAILURE;
+            break;
+          }
+      }
+  gal_list_data_free(out);
+  return ret;
+}
+
+
+
+
+
+/* All the neighbours within 'radius' of all the query points. */
+static int
+kdtree_check_range(struct kdtree_test *t, double radius, size_t numthreads)
+{
+  gal_data_t *out;
+  size_t i, j, n, *ind, *off;
+  double *dist, radius2=radius*radius;
+  int ret=EXIT_SUCCESS;
+
+  out=gal_kdtree_range(t->flat, t->queries, radius, numthreads, -1, 1);
+  ret=kdtree_check_tree(t);
+  ind=out->array;
+  dist=out->next->array;
+  off=out->next->next->array;
+  for(i=0;i<NUMQUERY && ret==EXIT_SUCCESS;++i)
+    {
+      /* Number of expected neighbours. */
+      n=0;
+      if(t->nb[i])
+        while(n<t->coords->size && t->nb[i][n].dist<=radius2) ++n;
+
+      /* Compare them. */
+      if(off[i+1]-off[i]!=n)
+        {
+          fprintf(stderr, "%zu dimensions, %zu points (grid: %zu), "
+                  "radius %g, %zu threads: query %zu has %zu neighbours, "
+                  "but it should have %zu\n", t->ndim, t->coords->size,
+                  t->grid, radius, numthreads, i, off[i+1]-off[i], n);
+          ret=EXIT_FAILURE;
+        }
+      else
+        for(j=0;j<n;++j)
+          if( ind[off[i]+j]!=t->nb[i][j].index
+              || dist[off[i]+j]!=sqrt(t->nb[i][j].dist) )
+            {
+              fprintf(stderr, "%zu dimensions, %zu points (grid: %zu), "
+                      "radius %g, %zu threads: neighbour %zu of query "
+                      "%zu is %zu at %g, but it should be %zu at %g\n",
+                      t->ndim, t->coords->size, t->grid, radius,
+                      numthreads, j, i, ind[off[i]+j], dist[off[i]+j],
+                      t->nb[i][j].index, sqrt(t->nb[i][j].dist));
+              ret=EXIT_FAILURE;
+              break;
+            }
+    }
+  gal_list_data_free(out);
+  return ret;
+}
+
+
+
+
+
+int
+main(void)
+{
+  uint64_t state=TESTLIB_SEED;
+  struct kdtree_test t;
+  int out=EXIT_SUCCESS;
+  int same;
+  size_t i, n, g, k, m, r, nt;
+  size_t threads[]={1, 4}, knum[]={1, 4, 25};
+  size_t num[]={0, 1, 2, 17, 100, 3000}, grid[]={0, 1, 5, 40};
+  double maxdist[2], radius[2];
+
+  for(t.ndim=1; t.ndim<=MAXDIM; ++t.ndim)
+    for(n=0;n<sizeof num/sizeof *num;++n)
+      for(g=0;g<sizeof grid/sizeof *grid;++g)
+        for(same=0;same<2;++same)
+        {
+          /* The points, the query points and the tree. */
+          t.grid=grid[g];
+          t.coords=kdtree_points(t.ndim, num[n], t.grid, same, 0, &state);
+          t.queries=kdtree_points(t.ndim, NUMQUERY, t.grid, 0, 0.05,
+                                  &state);
+          t.tree=gal_kdtree_create(t.coords, &t.root);
+          t.flat=gal_kdtree_flat_build(t.coords, t.tree, t.root, -1, 1);
+          kdtree_brute(&t);
+
+          /* The distances to check (a distance that is equal to the
+             distance of some points for integer coordinates). */
+          maxdist[0]=NAN;
+          maxdist[1] = radius[0] = t.grid ? 2.0 : 10.0;
+          radius[1] = t.grid ? 0.0 : 30.0;
+
+          /* Do the checks. */
+          if( num[n] && kdtree_check_single(&t)==EXIT_FAILURE )
+            out=EXIT_FAILURE;
+          for(nt=0;nt<sizeof threads/sizeof *threads;++nt)
+            {
+              for(k=0;k<sizeof knum/sizeof *knum;++k)
+                for(m=0;m<2;++m)
+                  if( kdtree_check_nearest(&t, knum[k], maxdist[m],
+                                           threads[nt])==EXIT_FAILURE )
+                    out=EXIT_FAILURE;
+              for(r=0;r<2;++r)
+                if( kdtree_check_range(&t, radius[r],
+                                       threads[nt])==EXIT_FAILURE )
+                  out=EXIT_FAILURE;
+            }
+
+          /* Clean up. */
+          for(i=0;i<NUMQUERY;++i) free(t.nb[i]);
+          free(t.nb);
+          gal_kdtree_flat_free(t.flat);
+          gal_list_data_free(t.tree);
+          gal_list_data_free(t.coords);
+          gal_list_data_free(t.queries);
+        }
+
+  return out;
+}
@@ -0,0 +1,275 @@
+/*********************************************************************
+A test program for pooling with Gnuastro's library.
+
+The outputs of the 'gal_pool_*' functions are compared with the values
+that are found by gathering and sorting the (non-blank) pixels of each
+window separately. The inputs have one to three dimensions, blank pixels
+(some windows only have blank pixels) and lengths that are not a
+multiple of the stride; they are pooled on one and on several threads.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gnuastro/pool.h"
+#include "gnuastro/blank.h"
+#include "gnuastro/qsort.h"
+#include "gnuastro/pointer.h"
+#include "gnuastro/dimension.h"
+
+#include "testlib.h"
+
+
+/* The pooling operators. */
+enum operators
+  {
+    OP_MAX,
+    OP_MIN,
+    OP_SUM,
+    OP_MEAN,
+    OP_MEDIAN,
+    OP_NUMBER,                  /* Number of operators (must be last). */
+  };
+
+
+
+
+
+/* A random input of the given type: the values are between -100 and 100
+   for signed types and between 0 and 200 for unsigned types (with a
+   fraction of 0.5 in floating point types, so the mean of two values is
+   also exact), and 'blankfrac' of them are blank. */
+static gal_data_t *
+pool_input(uint8_t type, size_t ndim, size_t *dsize, double blankfrac,
+           uint64_t *state)
+{
+  size_t i;
+  double *d;
+  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, ndim, dsize,
+                                 NULL, 0, -1, 1, NULL, NULL, NULL);
+
+  d=out->array;
+  for(i=0;i<out->size;++i)
+    d[i] = ( testlib_chance(blankfrac, state)
+             ? NAN
+             : ( (double)(testlib_random(state)%201)
+                 - (testlib_type_is_unsigned(type) ? 0.0 : 100.0)
+                 + (testlib_type_is_float(type)    ? 0.5 : 0.0) ) );
+  return gal_data_copy_to_new_type_free(out, type);
+}
+
+
+
+
+
+/* Pool the input with the given operator. */
+static gal_data_t *
+pool_run(int op, gal_data_t *input, size_t psize, size_t stride,
+         size_t numthreads)
+{
+  gal_data_t *out=NULL;
+  switch(op)
+    {
+    case OP_MAX:    out=gal_pool_max(input, psize, stride, numthreads);
+      break;
+    case OP_MIN:    out=gal_pool_min(input, psize, stride, numthreads);
+      break;
+    case OP_SUM:    out=gal_pool_sum(input, psize, stride, numthreads);
+      break;
+    case OP_MEAN:   out=gal_pool_mean(input, psize, stride, numthreads);
+      break;
+    case OP_MEDIAN: out=gal_pool_median(input, psize, stride, numthreads);
+      break;
+    }
+  return gal_data_copy_to_new_type_free(out, GAL_TYPE_FLOAT64);
+}
+
+
+
+
+
+/* The expected value of one output pixel: the non-blank pixels of its
+   window are gathered in 'w' (that has space for the full window) and
+   sorted. 'in' is the input in 64-bit floating point (where all the
+   blank values are NaN). */
+static double
+pool_expected(int op, gal_data_t *in, int isint, size_t psize,
+              size_t stride, size_t *osize, size_t oind, double *w)
+{
+  double s;
+  size_t d, i, n=0, ndim=in->ndim;
+  size_t start[3], end[3], coord[3];
+  double *a=in->array;
+
+  /* The window of this output pixel. */
+  gal_dimension_index_to_coord(oind, ndim, osize, start);
+  for(d=0;d<ndim;++d)
+    {
+      start[d]*=stride;
+      end[d] = ( start[d]+psize < in->dsize[d]
+                 ? start[d]+psize : in->dsize[d] );
+      coord[d]=start[d];
+    }
+
+  /* Gather the non-blank values (the coordinate is incremented like an
+     odometer). */
+  do
+    {
+      i=gal_dimension_coord_to_index(ndim, in->dsize, coord);
+      if( !isnan(a[i]) ) w[n++]=a[i];
+      for(d=ndim; d-->0;)
+        if( ++coord[d] < end[d] ) break;
+        else coord[d]=start[d];
+    }
+  while(d!=(size_t)(-1));
+  if(n==0) return NAN;
+
+  /* The output value. */
+  qsort(w, n, sizeof *w, gal_qsort_float64_i);
+  switch(op)
+    {
+    case OP_MAX:  return w[n-1];
+    case OP_MIN:  return w[0];
+    case OP_SUM:
+    case OP_MEAN:
+      for(s=0.0f, i=0;i<n;++i) s+=w[i];
+      return op==OP_SUM ? s : s/n;
+    case OP_MEDIAN:
+      return ( n%2
+               ? w[n/2]
+               : ( isint ? trunc((w[n/2]+w[n/2-1])/2)
+                   : (w[n/2]+w[n/2-1])/2 ) );
+    }
+  return NAN;
+}
+
+
+
+
+
+/* Pool the input with all the operators (on one and several threads)
+   and check all the output pixels. */
+static int
+pool_check(gal_data_t *input, size_t psize, size_t stride)
+{
+  int op, out=EXIT_SUCCESS;
+  size_t d, i, t, numpixs=1, osize[3];
+  gal_data_t *in, *res, *res1=NULL;
+  size_t threads[]={1, 3, 8};
+  double v, *w, *r, tolerance;
+  int isint = ( input->type!=GAL_TYPE_FLOAT32
+                && input->type!=GAL_TYPE_FLOAT64 );
+
+  /* The input in 64-bit floating point and the size of the output. */
+  in=gal_data_copy_to_new_type(input, GAL_TYPE_FLOAT64);
+  for(d=0;d<input->ndim;++d)
+    {
+      osize[d] = input->dsize[d]/stride + (input->dsize[d]%stride>0);
+      numpixs *= psize;
+    }
+  w=gal_pointer_allocate(GAL_TYPE_FLOAT64, numpixs, 0, __func__, "w");
+
+  for(op=0;op<OP_NUMBER;++op)
+    {
+      for(t=0;t<sizeof threads/sizeof *threads;++t)
+        {
+          /* Check all the output pixels. The sum of the values may be
+             added in a different order. */
+          res=pool_run(op, input, psize, stride, threads[t]);
+          r=res->array;
+          for(i=0;i<res->size;++i)
+            {
+              v=pool_expected(op, in, isint, psize, stride, osize, i, w);
+              tolerance = op==OP_SUM || op==OP_MEAN ? 1e-9*fabs(v) : 0;
+              if( isnan(v) ? !isnan(r[i]) : !(fabs(r[i]-v)<=tolerance) )
+                {
+                  fprintf(stderr, "%s (%zu dimensions), pool size %zu, "
+                          "stride %zu, operator %d, %zu threads: output "
+                          "pixel %zu is %g, but should be %g\n",
+                          gal_type_name(input->type, 1), input->ndim, psize,
+                          stride, op, threads[t], i, r[i], v);
+                  out=EXIT_FAILURE;
+                  break;
+                }
+            }
+
+          /* Different number of threads should give identical outputs. */
+          if(t==0) res1=res;
+          else
+            {
+              for(i=0;i<res->size;++i)
+                if( memcmp(&r[i], &((double *)res1->array)[i], sizeof *r) )
+                  {
+                    fprintf(stderr, "%s (%zu dimensions), operator %d: "
+                            "output pixel %zu differs on %zu threads\n",
+                            gal_type_name(input->type, 1), input->ndim, op,
+                            i, threads[t]);
+                    out=EXIT_FAILURE;
+                    break;
+                  }
+              gal_data_free(res);
+            }
+        }
+      gal_data_free(res1);
+    }
+
+  /* Clean up and return. */
+  free(w);
+  gal_data_free(in);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  gal_data_t *input;
+  uint64_t state=TESTLIB_SEED;
+  int out=EXIT_SUCCESS;
+  size_t t, c, b, ndim;
+  double blankfrac[]={0.0, 0.2, 0.9};
+  size_t dsize[][3]={ {37, 0, 0}, {23, 18, 0}, {11, 9, 14} };
+  size_t psize[]={2, 3, 3, 4, 5}, stride[]={2, 1, 2, 3, 5};
+  uint8_t types[]={GAL_TYPE_UINT8, GAL_TYPE_INT8, GAL_TYPE_UINT16,
+                   GAL_TYPE_INT16, GAL_TYPE_UINT32, GAL_TYPE_INT32,
+                   GAL_TYPE_UINT64, GAL_TYPE_INT64, GAL_TYPE_FLOAT32,
+                   GAL_TYPE_FLOAT64};
+
+  /* All the types, dimensions and pool sizes (with blank values in
+     some inputs). */
+  for(t=0;t<sizeof types/sizeof *types;++t)
+    for(ndim=1;ndim<=3;++ndim)
+      for(b=0;b<sizeof blankfrac/sizeof *blankfrac;++b)
+        {
+          input=pool_input(types[t], ndim, dsize[ndim-1], blankfrac[b],
+                           &state);
+          for(c=0;c<sizeof psize/sizeof *psize;++c)
+            if( pool_check(input, psize[c], stride[c])==EXIT_FAILURE )
+              out=EXIT_FAILURE;
+          gal_data_free(input);
+        }
+
+  return out;
+}
@@ -0,0 +1,266 @@
+/*********************************************************************
+A test program for sorting indexs with Gnuastro's radix sort.
+
+The indexs sorted by 'gal_qsort_index_radix' (on one and several
+threads) are compared with the indexs sorted by 'qsort' with the
+'gal_qsort_index_single_*' comparators of the same type and order. Since
+'qsort' isn't stable, equal values are sorted by their position in the
+input index array (the radix sort must keep that order). The values
+cover all the numeric types (the full range of integers, so negative
+values are also checked) with many equal values, and floating points
+also have NaN, infinity and both positive and negative zeros. The number
+of elements is around the size where the radix sort is used instead of
+an insertion sort and where it uses several threads.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gnuastro/type.h"
+#include "gnuastro/qsort.h"
+#include "gnuastro/pointer.h"
+
+#include "testlib.h"
+
+
+/* The input index array of the reference sort and the comparator of the
+   values (they are only used through 'radixsort_reference_compare',
+   which is given to 'qsort'). */
+static size_t *radixsort_refindex;
+static int (*radixsort_refcompare)(const void *, const void *);
+
+
+
+
+
+/* Compare two positions of the input index array: by the values they
+   point to (with the old comparator), and by their position when the
+   values are equal. */
+static int
+radixsort_reference_compare(const void *a, const void *b)
+{
+  size_t pa=*(size_t *)a, pb=*(size_t *)b;
+  int out=radixsort_refcompare(&radixsort_refindex[pa],
+                               &radixsort_refindex[pb]);
+  return out ? out : (pa>pb) - (pa<pb);
+}
+
+
+
+
+
+/* The comparator of the given type and order. */
+static int
+(*radixsort_comparator(uint8_t type, int decreasing))(const void *,
+                                                      const void *)
+{
+  switch(type)
+    {
+    case GAL_TYPE_UINT8:   return ( decreasing
+                                    ? gal_qsort_index_single_uint8_d
+                                    : gal_qsort_index_single_uint8_i );
+    case GAL_TYPE_INT8:    return ( decreasing
+                                    ? gal_qsort_index_single_int8_d
+                                    : gal_qsort_index_single_int8_i );
+    case GAL_TYPE_UINT16:  return ( decreasing
+                                    ? gal_qsort_index_single_uint16_d
+                                    : gal_qsort_index_single_uint16_i );
+    case GAL_TYPE_INT16:   return ( decreasing
+                                    ? gal_qsort_index_single_int16_d
+                                    : gal_qsort_index_single_int16_i );
+    case GAL_TYPE_UINT32:  return ( decreasing
+                                    ? gal_qsort_index_single_uint32_d
+                                    : gal_qsort_index_single_uint32_i );
+    case GAL_TYPE_INT32:   return ( decreasing
+                                    ? gal_qsort_index_single_int32_d
+                                    : gal_qsort_index_single_int32_i );
+    case GAL_TYPE_UINT64:  return ( decreasing
+                                    ? gal_qsort_index_single_uint64_d
+                                    : gal_qsort_index_single_uint64_i );
+    case GAL_TYPE_INT64:   return ( decreasing
+                                    ? gal_qsort_index_single_int64_d
+                                    : gal_qsort_index_single_int64_i );
+    case GAL_TYPE_FLOAT32: return ( decreasing
+                                    ? gal_qsort_index_single_float32_d
+                                    : gal_qsort_index_single_float32_i );
+    case GAL_TYPE_FLOAT64: return ( decreasing
+                                    ? gal_qsort_index_single_float64_d
+                                    : gal_qsort_index_single_float64_i );
+    default:
+      fprintf(stderr, "%s: type code %u not recognized\n", __func__,
+              type);
+      exit(EXIT_FAILURE);
+    }
+  return NULL;
+}
+
+
+
+
+
+/* Random values of the given type. When 'ties' is non-zero, the values
+   only have a few (small) distinct values. Otherwise, integers cover the
+   full range of the type and floating points have very different
+   exponents. A fraction of the floating point values are special: NaN,
+   infinity, and positive or negative zero. */
+static void *
+radixsort_values(uint8_t type, size_t size, int ties, uint64_t *state)
+{
+  size_t i;
+  uint64_t r;
+  double d, special[]={NAN, INFINITY, -INFINITY, 0.0, -0.0};
+  size_t width=gal_type_sizeof(type);
+  unsigned char *a=gal_pointer_allocate(type, size, 0, __func__,
+                                        "values");
+
+  for(i=0;i<size;++i)
+    {
+      r = testlib_random64(state);
+      if(ties) r=(int64_t)(r%7)-3;
+      switch(type)
+        {
+        case GAL_TYPE_FLOAT32:
+        case GAL_TYPE_FLOAT64:
+          if( testlib_random(state)%10==0 )
+            d=special[ testlib_random(state)%5 ];
+          else
+            d = ( ties
+                  ? (double)(int64_t)r/2
+                  : ( ((double)(r>>11)/(double)(1ULL<<53)-0.5)
+                      * pow(10, (double)(r%60)-30) ) );
+          if(type==GAL_TYPE_FLOAT32) ((float *)a)[i]=d;
+          else                       ((double *)a)[i]=d;
+          break;
+        default:
+          memcpy(a+i*width, &r, width);
+        }
+    }
+  return a;
+}
+
+
+
+
+
+/* Sort the index with the radix sort on the given number of threads and
+   compare it with the expected index. */
+static int
+radixsort_check(size_t *input, size_t *expected, size_t size, void *values,
+                uint8_t type, int decreasing, int ties, size_t numthreads)
+{
+  size_t i, *index;
+  int out=EXIT_SUCCESS;
+
+  /* Sort a copy of the input index. */
+  index=gal_pointer_allocate(GAL_TYPE_SIZE_T, size ? size : 1, 0,
+                             __func__, "index");
+  if(size) memcpy(index, input, size*sizeof *index);
+  gal_qsort_index_radix(index, size, values, type, decreasing,
+                        numthreads, -1, 1);
+
+  /* Compare with the expected index. */
+  for(i=0;i<size;++i)
+    if(index[i]!=expected[i])
+      {
+        fprintf(stderr, "%s, %zu elements (%s, %s), %zu threads: element "
+                "%zu is %zu, but it should be %zu\n",
+                gal_type_name(type, 1), size,
+                decreasing ? "decreasing" : "increasing",
+                ties ? "many equal values" : "full range", numthreads,
+                i, index[i], expected[i]);
+        out=EXIT_FAILURE;
+        break;
+      }
+
+  /* Clean up and return. */
+  free(index);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  void *values;
+  uint64_t state=TESTLIB_SEED;
+  int ties, decreasing, out=EXIT_SUCCESS;
+  size_t i, t, s, y, nvalues, *input, *expected, *pos;
+  size_t threads[]={1, 3, 4, 16};
+  size_t sizes[]={0, 1, 2, 5, 127, 128, 129, 1000, 65535, 65536, 65537,
+                  200000};
+  uint8_t types[]={GAL_TYPE_UINT8, GAL_TYPE_INT8, GAL_TYPE_UINT16,
+                   GAL_TYPE_INT16, GAL_TYPE_UINT32, GAL_TYPE_INT32,
+                   GAL_TYPE_UINT64, GAL_TYPE_INT64, GAL_TYPE_FLOAT32,
+                   GAL_TYPE_FLOAT64};
+
+  for(y=0;y<sizeof types/sizeof *types;++y)
+    for(s=0;s<sizeof sizes/sizeof *sizes;++s)
+      for(ties=0;ties<2;++ties)
+        {
+          /* The values (twice the number of indexs, so some values are
+             not in the index and some are repeated). */
+          nvalues=2*sizes[s]+1;
+          values=radixsort_values(types[y], nvalues, ties, &state);
+
+          /* The input index and the positions for the reference. */
+          input=gal_pointer_allocate(GAL_TYPE_SIZE_T, sizes[s]+1, 0,
+                                     __func__, "input");
+          expected=gal_pointer_allocate(GAL_TYPE_SIZE_T, sizes[s]+1, 0,
+                                        __func__, "expected");
+          pos=gal_pointer_allocate(GAL_TYPE_SIZE_T, sizes[s]+1, 0,
+                                   __func__, "pos");
+          for(i=0;i<sizes[s];++i)
+            input[i]=testlib_random(&state)%nvalues;
+
+          /* Check both orders. */
+          for(decreasing=0;decreasing<2;++decreasing)
+            {
+              /* The expected index. */
+              for(i=0;i<sizes[s];++i) pos[i]=i;
+              gal_qsort_index_single=values;
+              radixsort_refindex=input;
+              radixsort_refcompare=radixsort_comparator(types[y],
+                                                        decreasing);
+              qsort(pos, sizes[s], sizeof *pos,
+                    radixsort_reference_compare);
+              for(i=0;i<sizes[s];++i) expected[i]=input[pos[i]];
+
+              /* Check the radix sort on all the threads. */
+              for(t=0;t<sizeof threads/sizeof *threads;++t)
+                if( radixsort_check(input, expected, sizes[s], values,
+                                    types[y], decreasing, ties,
+                                    threads[t])==EXIT_FAILURE )
+                  out=EXIT_FAILURE;
+            }
+
+          /* Clean up. */
+          free(pos);
+          free(input);
+          free(values);
+          free(expected);
+        }
+
+  return out;
+}
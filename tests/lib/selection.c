@@ -0,0 +1,323 @@
+/*********************************************************************
+A test program for selecting ranks and quantiles with Gnuastro's library.
+
+The elements that 'gal_qsort_select' puts at the requested ranks (and the
+quantiles of 'gal_statistics_quantiles') are compared with the elements
+at the same ranks after sorting the full array (how they were found
+before). The arrays have many equal values, blank values, and are
+already sorted (in increasing or decreasing order) in some cases.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gnuastro/qsort.h"
+#include "gnuastro/blank.h"
+#include "gnuastro/pointer.h"
+#include "gnuastro/statistics.h"
+
+#include "testlib.h"
+
+
+/* The order of the values in the arrays. */
+enum order
+  {
+    ORDER_RANDOM,
+    ORDER_INCREASING,
+    ORDER_DECREASING,
+    ORDER_NUMBER,               /* Number of orders (must be last). */
+  };
+
+
+
+
+
+/* An array of 'size' random values (between -'range'/2 and 'range'/2
+   for signed types and from 0 to 'range' for unsigned types, so a small
+   range gives many equal values) in the given type and order. A
+   fraction of 'blankfrac' of the values will be blank. */
+static gal_data_t *
+selection_array(uint8_t type, size_t size, size_t range, int order,
+                double blankfrac, uint64_t *state)
+{
+  size_t i;
+  double *d;
+  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT64, 1, &size, NULL,
+                                 0, -1, 1, NULL, NULL, NULL);
+
+  /* Fill the array (the fraction is only used for floating points). */
+  d=out->array;
+  for(i=0;i<size;++i)
+    d[i] = ( (double)(testlib_random(state)%(range+1))
+             - ( testlib_type_is_unsigned(type) ? 0.0 : (double)(range/2) )
+             + ( testlib_type_is_float(type)    ? 0.5 : 0.0 ) );
+
+  /* Set the order (before adding the blank values). */
+  switch(order)
+    {
+    case ORDER_INCREASING: qsort(d, size, sizeof *d, gal_qsort_float64_i);
+      break;
+    case ORDER_DECREASING: qsort(d, size, sizeof *d, gal_qsort_float64_d);
+      break;
+    }
+
+  /* Add the blank values. */
+  if(blankfrac>0)
+    for(i=0;i<size;++i)
+      if( testlib_chance(blankfrac, state) ) d[i]=NAN;
+
+  /* Convert the array to the requested type. */
+  return gal_data_copy_to_new_type_free(out, type);
+}
+
+
+
+
+
+/* The sorted (increasing) non-blank values of the input in 64-bit
+   floating point (all the tested values can be written exactly). */
+static gal_data_t *
+selection_sorted(gal_data_t *input)
+{
+  gal_data_t *out=gal_data_copy_to_new_type(input, GAL_TYPE_FLOAT64);
+  gal_blank_remove(out);
+  qsort(out->array, out->size, sizeof(double), gal_qsort_float64_i);
+  return out;
+}
+
+
+
+
+
+/* Select the given ranks of the (non-blank) array and check them with
+   the sorted array. */
+static int
+selection_check_select(gal_data_t *input, size_t *ranks, size_t numranks)
+{
+  double *s, *a;
+  size_t i, j, lo;
+  int out=EXIT_SUCCESS;
+  gal_data_t *sorted=selection_sorted(input), *arr;
+
+  /* 'gal_qsort_select' doesn't accept blank values. */
+  arr=gal_data_copy(input);
+  gal_blank_remove(arr);
+  gal_qsort_select(arr->array, arr->size, arr->type, ranks, numranks);
+  arr=gal_data_copy_to_new_type_free(arr, GAL_TYPE_FLOAT64);
+
+  /* Each rank should have the same value as the sorted array, and the
+     elements between the ranks should be between their values. */
+  s=sorted->array;
+  a=arr->array;
+  for(i=lo=0;i<numranks;++i)
+    {
+      if(a[ranks[i]]!=s[ranks[i]])
+        {
+          fprintf(stderr, "%s: %zu elements: rank %zu has value %g, but "
+                  "it should be %g\n", gal_type_name(input->type, 1),
+                  arr->size, ranks[i], a[ranks[i]], s[ranks[i]]);
+          out=EXIT_FAILURE;
+        }
+      for(j=lo;j<arr->size;++j)
+        if( (j<ranks[i] && a[j]>a[ranks[i]])
+            || (j>ranks[i] && a[j]<a[ranks[i]]) )
+          {
+            fprintf(stderr, "%s: %zu elements: element %zu (%g) is on "
+                    "the wrong side of rank %zu (%g)\n",
+                    gal_type_name(input->type, 1), arr->size, j, a[j],
+                    ranks[i], a[ranks[i]]);
+            out=EXIT_FAILURE;
+            break;
+          }
+      lo=ranks[i];
+    }
+
+  /* Clean up and return. */
+  gal_data_free(arr);
+  gal_data_free(sorted);
+  return out;
+}
+
+
+
+
+
+/* Check the quantiles (and the median) of the array with the sorted
+   array. The input is given to the library functions as it is (already
+   sorted arrays are flagged as sorted first), and also in place. */
+static int
+selection_check_quantiles(gal_data_t *input, int order)
+{
+  double *s, v;
+  size_t i, n, size=9;
+  int inplace, out=EXIT_SUCCESS;
+  gal_data_t *sorted=selection_sorted(input), *q, *res, *med, *in;
+  double qs[]={0.5, 0.0, 1.0, 0.25, 0.75, 0.1, 0.9, 0.333, 0.5};
+
+  /* The quantiles (not in order, with a repeated quantile). */
+  q=gal_data_alloc(qs, GAL_TYPE_FLOAT64, 1, &size, NULL, 0, -1, 1, NULL,
+                   NULL, NULL);
+
+  /* Check the quantiles (in place and not). */
+  s=sorted->array;
+  for(inplace=0;inplace<2;++inplace)
+    {
+      /* Set the sorted flags (only when the array has no blanks). */
+      in=gal_data_copy(input);
+      if(order!=ORDER_RANDOM && gal_blank_present(in, 1)==0)
+        gal_statistics_is_sorted(in, 1);
+
+      /* The median is found before the quantiles, so the in-place
+         quantiles are found on the (partially sorted) array of the
+         median. */
+      med=gal_statistics_median(in, inplace);
+      res=gal_statistics_quantiles(in, q, inplace);
+      med=gal_data_copy_to_new_type_free(med, GAL_TYPE_FLOAT64);
+      res=gal_data_copy_to_new_type_free(res, GAL_TYPE_FLOAT64);
+
+      /* The median (in the same way as 'gal_statistics_median'). */
+      v = ( sorted->size
+            ? ( sorted->size%2 ? s[sorted->size/2]
+                : ( input->type==GAL_TYPE_FLOAT32
+                    || input->type==GAL_TYPE_FLOAT64
+                    ? (s[sorted->size/2]+s[sorted->size/2-1])/2
+                    : trunc((s[sorted->size/2]+s[sorted->size/2-1])/2) ) )
+            : NAN );
+      if( isnan(v) ? !isnan(*(double *)med->array)
+                   : v!=*(double *)med->array )
+        {
+          fprintf(stderr, "%s: %zu elements (in place: %d): median is "
+                  "%g, but should be %g\n", gal_type_name(input->type, 1),
+                  sorted->size, inplace, *(double *)med->array, v);
+          out=EXIT_FAILURE;
+        }
+
+      /* The quantiles (like 'gal_statistics_quantile', the index of an
+         array that is flagged as sorted in decreasing order is found
+         from the inverse quantile). */
+      for(i=0;i<size;++i)
+        {
+          n=sorted->size;
+          v = ( n
+                ? ( in->flag & GAL_DATA_FLAG_SORTED_D
+                    ? s[n-1-gal_statistics_quantile_index(n, 1.0f-qs[i])]
+                    : s[gal_statistics_quantile_index(n, qs[i])] )
+                : NAN );
+          if( isnan(v) ? !isnan(((double *)res->array)[i])
+                       : v!=((double *)res->array)[i] )
+            {
+              fprintf(stderr, "%s: %zu elements (in place: %d): quantile "
+                      "%g is %g, but should be %g\n",
+                      gal_type_name(input->type, 1), sorted->size, inplace,
+                      qs[i], ((double *)res->array)[i], v);
+              out=EXIT_FAILURE;
+            }
+        }
+
+      /* Clean up. */
+      gal_data_free(in);
+      gal_data_free(res);
+      gal_data_free(med);
+    }
+
+  /* Clean up and return ('qs' is not allocated). */
+  q->array=NULL;
+  gal_data_free(q);
+  gal_data_free(sorted);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  gal_data_t *arr;
+  uint64_t state=TESTLIB_SEED;
+  int order, out=EXIT_SUCCESS;
+  size_t i, j, k, t, n, r, s, numranks, *ranks;
+  size_t sizes[]={0, 1, 2, 3, 5, 16, 17, 100, 1000, 10001};
+  size_t ranges[]={0, 3, 100, 1000000};
+  uint8_t types[]={GAL_TYPE_UINT8, GAL_TYPE_INT8, GAL_TYPE_UINT16,
+                   GAL_TYPE_INT16, GAL_TYPE_UINT32, GAL_TYPE_INT32,
+                   GAL_TYPE_UINT64, GAL_TYPE_INT64, GAL_TYPE_FLOAT32,
+                   GAL_TYPE_FLOAT64};
+
+  /* Space for the ranks. */
+  ranks=gal_pointer_allocate(GAL_TYPE_SIZE_T, 64, 0, __func__, "ranks");
+
+  /* Check all the types, sizes, ranges and orders. */
+  for(t=0;t<sizeof types/sizeof *types;++t)
+    for(s=0;s<sizeof sizes/sizeof *sizes;++s)
+      for(r=0;r<sizeof ranges/sizeof *ranges;++r)
+        for(order=0;order<ORDER_NUMBER;++order)
+          {
+            /* Integers with one byte can't have a very large range. */
+            if( gal_type_sizeof(types[t])==1 && ranges[r]>100 ) continue;
+
+            /* Without blank values: select random ranks (sorted, with
+               repeated ranks), the first and last ranks and all the
+               ranks of small arrays. */
+            n=sizes[s];
+            arr=selection_array(types[t], n, ranges[r], order, 0, &state);
+            if(n)
+              {
+                numranks = 1 + testlib_random(&state)%10;
+                for(i=0;i<numranks;++i)
+                  {
+                    k=testlib_random(&state)%n;
+                    for(j=i; j>0 && ranks[j-1]>k; --j) ranks[j]=ranks[j-1];
+                    ranks[j]=k;
+                  }
+                if( selection_check_select(arr, ranks, numranks)
+                    ==EXIT_FAILURE ) out=EXIT_FAILURE;
+                ranks[0]=0; ranks[1]=n-1;
+                if( selection_check_select(arr, ranks, 1+(n>1))
+                    ==EXIT_FAILURE ) out=EXIT_FAILURE;
+                if(n<=64)
+                  {
+                    for(j=0;j<n;++j) ranks[j]=j;
+                    if( selection_check_select(arr, ranks, n)
+                        ==EXIT_FAILURE ) out=EXIT_FAILURE;
+                  }
+              }
+            if( selection_check_quantiles(arr, order)==EXIT_FAILURE )
+              out=EXIT_FAILURE;
+            gal_data_free(arr);
+
+            /* With blank values (only floating point types have a blank
+               value that doesn't overlap with the random values). */
+            if( types[t]==GAL_TYPE_FLOAT32 || types[t]==GAL_TYPE_FLOAT64 )
+              {
+                arr=selection_array(types[t], n, ranges[r], order, 0.3,
+                                    &state);
+                if( selection_check_quantiles(arr, order)==EXIT_FAILURE )
+                  out=EXIT_FAILURE;
+                gal_data_free(arr);
+              }
+          }
+
+  /* Clean up and return. */
+  free(ranks);
+  return out;
+}
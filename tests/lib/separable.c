@@ -0,0 +1,281 @@
+/*********************************************************************
+A test program for the separable spatial convolution of the library.
+
+Images are convolved with 'gal_convolve_spatial' once as 2D images
+(where separable kernels are convolved in two 1D passes) and once as 3D
+images with a single slice (where the generic spatial convolution is
+always used). The kernels are an exactly separable one, a separable one
+with random deviations at the level of 32-bit floating point round-off
+errors, and a truncated circular Gaussian with small random deviations
+(like the kernels of MakeProfiles, where the pixels are integrated with
+random points). The first two should only differ by round-off errors,
+while the last should not be convolved as a separable kernel: its two
+outputs should be identical. This is checked with and without blank
+values, edge correction and convolution over blank pixels, on one and
+several threads.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gnuastro/pointer.h"
+#include "gnuastro/convolve.h"
+
+#include "testlib.h"
+
+
+/* Relative tolerance of the rank-1 approximation of the kernel in the
+   separable convolution (see the description of 'gal_convolve_spatial'
+   in the manual). */
+#define SEPARABLE_TOLERANCE 1e-6
+
+/* Relative round-off error of the 32-bit floating point output. */
+#define SEPARABLE_ROUNDOFF 1e-6
+
+/* Size of the images (not a multiple of the kernel sizes). */
+#define SEPARABLE_NROWS 97
+#define SEPARABLE_NCOLS 83
+
+
+
+
+
+/* The kernels: when 'separable!=0', the outer product of two 1D
+   Gaussians with different sizes (so it is separable). Otherwise, a
+   circular Gaussian (truncated at a radius of 5 pixels). Each pixel is
+   multiplied by a random factor within '1+-perturb' and the kernels are
+   normalized to have a sum of 1. */
+static gal_data_t *
+separable_kernel(int separable, double perturb, uint64_t *state)
+{
+  float *k;
+  double dy, dx, r2, sum=0.0f;
+  size_t i, j, kh, kw, dsize[2];
+  gal_data_t *kernel;
+
+  /* Size of the kernel. */
+  kh = separable ? 7  : 11;
+  kw = separable ? 9  : 11;
+  dsize[0]=kh; dsize[1]=kw;
+  kernel=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, 2, dsize, NULL, 0, -1, 1,
+                        NULL, NULL, NULL);
+
+  /* Fill the kernel. */
+  k=kernel->array;
+  for(i=0;i<kh;++i)
+    for(j=0;j<kw;++j)
+      {
+        dy=(double)i-kh/2;
+        dx=(double)j-kw/2;
+        r2=dy*dy+dx*dx;
+        if(separable)
+          k[i*kw+j] = exp( -dy*dy/(2*1.2*1.2) ) * exp( -dx*dx/(2*1.8*1.8) );
+        else
+          k[i*kw+j] = r2>25.0f ? 0.0f : exp( -r2/(2*0.85*0.85) );
+        k[i*kw+j] *= 1+perturb*testlib_uniform(-1, 1, state);
+        sum+=k[i*kw+j];
+      }
+  for(i=0;i<kernel->size;++i) k[i]/=sum;
+  return kernel;
+}
+
+
+
+
+
+/* A random image with values between -100 and 100 ('blankfrac' of the
+   pixels are blank). */
+static gal_data_t *
+separable_image(double blankfrac, uint64_t *state)
+{
+  float *f;
+  size_t i, dsize[2]={SEPARABLE_NROWS, SEPARABLE_NCOLS};
+  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, 2, dsize, NULL,
+                                 0, -1, 1, NULL, NULL, NULL);
+  f=out->array;
+  for(i=0;i<out->size;++i)
+    f[i] = ( testlib_chance(blankfrac, state)
+             ? NAN
+             : testlib_uniform(-100, 100, state) );
+  return out;
+}
+
+
+
+
+
+/* Convolve the 2D 'image' with the 2D 'kernel' through a 3D image and
+   kernel that have a single slice (so the generic spatial convolution is
+   used). */
+static gal_data_t *
+separable_generic(gal_data_t *image, gal_data_t *kernel, size_t numthreads,
+                  int edgecorrection, int conv_on_blank)
+{
+  gal_data_t *in3, *k3, *out;
+  size_t idsize[3]={1, image->dsize[0], image->dsize[1]};
+  size_t kdsize[3]={1, kernel->dsize[0], kernel->dsize[1]};
+
+  /* Wrap the arrays in 3D datasets (without copying them). */
+  in3=gal_data_alloc(image->array, GAL_TYPE_FLOAT32, 3, idsize, NULL, 0,
+                     -1, 1, NULL, NULL, NULL);
+  k3=gal_data_alloc(kernel->array, GAL_TYPE_FLOAT32, 3, kdsize, NULL, 0,
+                    -1, 1, NULL, NULL, NULL);
+
+  /* Convolve and clean up (the arrays belong to the 2D datasets). */
+  out=gal_convolve_spatial(in3, k3, numthreads, edgecorrection, 1,
+                           conv_on_blank);
+  in3->array=k3->array=NULL;
+  gal_data_free(in3);
+  gal_data_free(k3);
+  return out;
+}
+
+
+
+
+
+/* The maximum difference between the separable and generic convolution
+   of one pixel: the numerator and denominator (sum of the kernel over
+   the overlapping non-blank pixels with edge correction) of each
+   convolved value can change by 'SEPARABLE_TOLERANCE' times the sum of
+   the absolute kernel values (multiplied by the maximum absolute value
+   of the image for the numerator), and the output has the round-off
+   error of 32-bit floating point. A negative value is returned when the
+   denominator is too small for a meaningful comparison. */
+static double
+separable_bound(gal_data_t *image, gal_data_t *kernel, size_t ind,
+                int edgecorrection, double sumabs, double maxabs)
+{
+  float *f=image->array, *k=kernel->array;
+  size_t kh=kernel->dsize[0], kw=kernel->dsize[1];
+  size_t h=image->dsize[0], w=image->dsize[1], y=ind/w, x=ind%w;
+  double den=0.0f, delta=SEPARABLE_TOLERANCE*sumabs;
+  size_t i, j, yy, xx;
+
+  /* The denominator of edge correction. */
+  if(edgecorrection)
+    {
+      for(i=0;i<kh;++i)
+        for(j=0;j<kw;++j)
+          {
+            yy=y+i; xx=x+j;
+            if( yy<kh/2 || yy-kh/2>=h || xx<kw/2 || xx-kw/2>=w ) continue;
+            if( !isnan(f[(yy-kh/2)*w+xx-kw/2]) ) den+=k[i*kw+j];
+          }
+    }
+  else den=1.0f;
+
+  /* Return the bound. */
+  if(den<=4*delta) return -1.0f;
+  return ( 2*delta*maxabs + SEPARABLE_ROUNDOFF*maxabs ) / (den-delta);
+}
+
+
+
+
+
+/* Convolve the image with the kernel through both paths and compare the
+   outputs (they should be identical when 'exact!=0'). */
+static int
+separable_check(gal_data_t *image, gal_data_t *kernel, size_t numthreads,
+                int edgecorrection, int conv_on_blank, int exact)
+{
+  size_t i;
+  int out=EXIT_SUCCESS;
+  gal_data_t *sep, *gen;
+  float *s, *g, *f=image->array, *k=kernel->array;
+  double b, sumabs=0.0f, maxabs=0.0f;
+
+  /* The scales of the bounds. */
+  for(i=0;i<kernel->size;++i) sumabs+=fabs(k[i]);
+  for(i=0;i<image->size;++i)
+    if( fabs(f[i])>maxabs ) maxabs=fabs(f[i]);
+
+  /* Convolve through both paths. */
+  sep=gal_convolve_spatial(image, kernel, numthreads, edgecorrection, 1,
+                           conv_on_blank);
+  gen=separable_generic(image, kernel, numthreads, edgecorrection,
+                        conv_on_blank);
+
+  /* Compare all the pixels. */
+  s=sep->array;
+  g=gen->array;
+  for(i=0;i<image->size;++i)
+    {
+      if(exact) b=0.0f;
+      else
+        {
+          b=separable_bound(image, kernel, i, edgecorrection, sumabs,
+                            maxabs);
+          if(b<0.0f) continue;
+        }
+      if( isnan(g[i]) ? !isnan(s[i]) : !( fabs(s[i]-g[i]) <= b ) )
+        {
+          fprintf(stderr, "%zux%zu kernel, %zu threads, edge correction "
+                  "%d, convolution on blank %d: pixel %zu is %g, but "
+                  "should be %g (within %g)\n", kernel->dsize[0],
+                  kernel->dsize[1], numthreads, edgecorrection,
+                  conv_on_blank, i, s[i], g[i], b);
+          out=EXIT_FAILURE;
+          break;
+        }
+    }
+
+  /* Clean up and return. */
+  gal_data_free(sep);
+  gal_data_free(gen);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  uint64_t state=TESTLIB_SEED;
+  int out=EXIT_SUCCESS;
+  gal_data_t *image, *kernel;
+  size_t b, p, t, e, c, threads[]={1, 4};
+  double blankfrac[]={0.0, 0.02}, perturb[]={0.0, 1e-7, 5e-4};
+
+  /* All the kernels, images and options (the last kernel isn't
+     separable). */
+  for(p=0;p<sizeof perturb/sizeof *perturb;++p)
+    {
+      kernel=separable_kernel(p<2, perturb[p], &state);
+      for(b=0;b<sizeof blankfrac/sizeof *blankfrac;++b)
+        {
+          image=separable_image(blankfrac[b], &state);
+          for(t=0;t<sizeof threads/sizeof *threads;++t)
+            for(e=0;e<2;++e)
+              for(c=0;c<2;++c)
+                if( separable_check(image, kernel, threads[t], e, c,
+                                    p==2)==EXIT_FAILURE )
+                  out=EXIT_FAILURE;
+          gal_data_free(image);
+        }
+      gal_data_free(kernel);
+    }
+
+  return out;
+}
@@ -0,0 +1,284 @@
+/*********************************************************************
+A test program for sigma-clipping multiple operands in Arithmetic.
+
+The outputs of the 'sigclip-std', 'sigclip-mean' and 'sigclip-median'
+operators on 32-bit floating point inputs (that are sigma-clipped on
+blocks of pixels, on one and several threads) are compared with the
+outputs of 'gal_statistics_clip_sigma' on the values of each pixel. The
+number of inputs is 1 to 200 (around the powers of two that are used in
+the blocks) and the values of each pixel have outliers, blank values,
+many equal values, or are monotonic (increasing or decreasing) over the
+inputs. Both clipping by tolerance and by number of clips are checked.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gnuastro/list.h"
+#include "gnuastro/pointer.h"
+#include "gnuastro/arithmetic.h"
+#include "gnuastro/statistics.h"
+
+#include "testlib.h"
+
+
+/* The types of pixels (along the inputs). */
+enum pattern
+  {
+    PATTERN_OUTLIERS,
+    PATTERN_BLANKS,
+    PATTERN_ALLBLANK,
+    PATTERN_TIES,
+    PATTERN_INCREASING,
+    PATTERN_DECREASING,
+    PATTERN_CONSTANT,
+    PATTERN_ONEVALUE,
+    PATTERN_HEAVYTAIL,
+    PATTERN_NUMBER,           /* Number of patterns (must be last). */
+  };
+
+/* Size of the inputs (the number of pixels isn't a multiple of the
+   blocks). */
+#define SIGCLIP_NROWS 7
+#define SIGCLIP_NCOLS (2*PATTERN_NUMBER+1)
+
+
+
+
+
+/* The value of input 'i' (out of 'n') in pixel 'j'. */
+static float
+sigclip_value(size_t i, size_t n, size_t j, uint64_t *state)
+{
+  double u=testlib_uniform(-0.5, 0.5, state);
+  double g=u+testlib_uniform(-0.5, 0.5, state)
+            +testlib_uniform(-0.5, 0.5, state);
+
+  switch(j%PATTERN_NUMBER)
+    {
+    case PATTERN_OUTLIERS:
+      return testlib_random(state)%20 ? 10+g : 10+100*u;
+    case PATTERN_BLANKS:
+      return testlib_random(state)%3 ? 10+g : NAN;
+    case PATTERN_ALLBLANK:
+      return NAN;
+    case PATTERN_TIES:
+      return testlib_random(state)%4;
+    case PATTERN_INCREASING:
+      return i+1==n && n>3 ? 1000 : 0.5*i;
+    case PATTERN_DECREASING:
+      return n-i + (i==0 && n>3 ? 1000 : 0);
+    case PATTERN_CONSTANT:
+      return 7;
+    case PATTERN_ONEVALUE:
+      return i==n/2 ? 3 : NAN;
+    case PATTERN_HEAVYTAIL:
+      return 100*g*g*g;
+    default:
+      fprintf(stderr, "%s: a bug! pattern %zu is not recognized\n",
+              __func__, j%PATTERN_NUMBER);
+      exit(EXIT_FAILURE);
+    }
+  return NAN;
+}
+
+
+
+
+
+/* Output column of each operator. */
+static size_t
+sigclip_column(int operator)
+{
+  switch(operator)
+    {
+    case GAL_ARITHMETIC_OP_SIGCLIP_STD:
+      return GAL_STATISTICS_CLIP_OUTCOL_STD;
+    case GAL_ARITHMETIC_OP_SIGCLIP_MEAN:
+      return GAL_STATISTICS_CLIP_OUTCOL_MEAN;
+    case GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN:
+      return GAL_STATISTICS_CLIP_OUTCOL_MEDIAN;
+    default:
+      fprintf(stderr, "%s: operator %d is not recognized\n", __func__,
+              operator);
+      exit(EXIT_FAILURE);
+    }
+  return 0;
+}
+
+
+
+
+
+/* A single-element 32-bit floating point dataset (for the parameters). */
+static gal_data_t *
+sigclip_param(float value)
+{
+  size_t one=1;
+  gal_data_t *out=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, 1, &one, NULL,
+                                 0, -1, 1, NULL, NULL, NULL);
+  ((float *)(out->array))[0]=value;
+  return out;
+}
+
+
+
+
+
+/* Number of used inputs in pixel 'j' of the numbers output. */
+static size_t
+sigclip_number(gal_data_t *numbers, size_t j)
+{
+  switch(numbers->type)
+    {
+    case GAL_TYPE_UINT8:  return ((uint8_t  *)(numbers->array))[j];
+    case GAL_TYPE_UINT16: return ((uint16_t *)(numbers->array))[j];
+    case GAL_TYPE_UINT32: return ((uint32_t *)(numbers->array))[j];
+    default:
+      fprintf(stderr, "%s: type code %u is not recognized\n", __func__,
+              numbers->type);
+      exit(EXIT_FAILURE);
+    }
+  return 0;
+}
+
+
+
+
+
+/* Sigma-clip the inputs with the given operator and compare the output
+   (and the number of used inputs) with sigma-clipping each pixel. */
+static int
+sigclip_check(gal_data_t *list, size_t n, int operator, float multip,
+              float param, size_t numthreads)
+{
+  size_t j, num;
+  float e, en, *c, *o, *v;
+  int out=EXIT_SUCCESS;
+  gal_data_t *tmp, *output, *cont, *clip, *params;
+  size_t col=sigclip_column(operator), npix=list->size;
+  uint8_t flags = ( operator==GAL_ARITHMETIC_OP_SIGCLIP_MEAN
+                    ? GAL_STATISTICS_CLIP_OUTCOL_OPTIONAL_MEAN : 0 );
+
+  /* Do the clipping on all the pixels (the first parameter is the
+     multiple of sigma and the second is the tolerance or number). */
+  params=sigclip_param(multip);
+  params->next=sigclip_param(param);
+  output=gal_arithmetic(operator, numthreads, 0, list, params);
+  o=output->array;
+
+  /* Clip the values of each pixel. */
+  cont=gal_data_alloc(NULL, GAL_TYPE_FLOAT32, 1, &n, NULL, 0, -1, 1,
+                      NULL, NULL, NULL);
+  v=cont->array;
+  for(j=0;j<npix;++j)
+    {
+      /* The usable values of this pixel (in the order of the list). */
+      for(num=0, tmp=list; tmp!=NULL; tmp=tmp->next)
+        if( !isnan( ((float *)(tmp->array))[j] ) )
+          v[num++]=((float *)(tmp->array))[j];
+
+      /* The expected output and number of used inputs (when the
+         clipping doesn't converge, the number is NaN and isn't
+         checked). */
+      if(num)
+        {
+          cont->flag=0;
+          cont->size=cont->dsize[0]=num;
+          clip=gal_statistics_clip_sigma(cont, multip, param, flags, 1, 1);
+          c=clip->array;
+          e=c[col];
+          en=c[GAL_STATISTICS_CLIP_OUTCOL_NUMBER_USED];
+          gal_data_free(clip);
+        }
+      else e=NAN, en=0;
+
+      /* Compare them. */
+      if( !( o[j]==e || (isnan(o[j]) && isnan(e)) )
+          || ( !isnan(en) && sigclip_number(output->next, j)!=en ) )
+        {
+          fprintf(stderr, "%s with %zu inputs (%g sigma, %g), %zu "
+                  "threads: pixel %zu (pattern %zu) is %g (from %zu "
+                  "inputs), but it should be %g (from %g inputs)\n",
+                  gal_arithmetic_operator_string(operator), n, multip,
+                  param, numthreads, j, j%PATTERN_NUMBER, o[j],
+                  sigclip_number(output->next, j), e, en);
+          out=EXIT_FAILURE;
+          break;
+        }
+    }
+
+  /* Clean up and return. */
+  gal_list_data_free(params);
+  gal_list_data_free(output);
+  gal_data_free(cont);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  float *a;
+  uint64_t state=TESTLIB_SEED;
+  gal_data_t *list;
+  int out=EXIT_SUCCESS;
+  size_t i, j, t, c, o, ni;
+  size_t threads[]={1, 4};
+  size_t dsize[]={SIGCLIP_NROWS, SIGCLIP_NCOLS};
+  size_t numin[]={1, 2, 3, 4, 5, 8, 15, 16, 17, 31, 32, 33, 64, 65, 100,
+                  128, 129, 200};
+  float clip[][2]={ {3, 0.2}, {3, 5}, {2, 0.01}, {1.5, 50}, {3, 1e-7},
+                    {0.5, 3} };
+  int operators[]={GAL_ARITHMETIC_OP_SIGCLIP_STD,
+                   GAL_ARITHMETIC_OP_SIGCLIP_MEAN,
+                   GAL_ARITHMETIC_OP_SIGCLIP_MEDIAN};
+
+  for(ni=0;ni<sizeof numin/sizeof *numin;++ni)
+    {
+      /* The inputs. */
+      list=NULL;
+      for(i=0;i<numin[ni];++i)
+        {
+          gal_list_data_add_alloc(&list, NULL, GAL_TYPE_FLOAT32, 2, dsize,
+                                  NULL, 0, -1, 1, NULL, NULL, NULL);
+          a=list->array;
+          for(j=0;j<list->size;++j)
+            a[j]=sigclip_value(i, numin[ni], j, &state);
+        }
+
+      /* Check all the operators and clipping parameters. */
+      for(o=0;o<sizeof operators/sizeof *operators;++o)
+        for(c=0;c<sizeof clip/sizeof *clip;++c)
+          for(t=0;t<sizeof threads/sizeof *threads;++t)
+            if( sigclip_check(list, numin[ni], operators[o], clip[c][0],
+                              clip[c][1], threads[t])==EXIT_FAILURE )
+              out=EXIT_FAILURE;
+
+      /* Clean up. */
+      gal_list_data_free(list);
+    }
+
+  return out;
+}
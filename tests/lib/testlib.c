@@ -0,0 +1,103 @@
+/*********************************************************************
+Helpers that are shared by the library test programs.
+
+See 'testlib.h' for a description.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gnuastro/type.h"
+
+#include "testlib.h"
+
+
+
+
+
+/* A linear congruential generator (with the constants of Knuth's MMIX).
+   Its lowest bits have short periods, so only the highest 53 bits are
+   returned (enough for the mantissa of a 64-bit floating point). */
+uint64_t
+testlib_random(uint64_t *state)
+{
+  *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return *state >> 11;
+}
+
+
+
+
+
+/* A random number with all its 64 bits random (for example to cover the
+   full range of the 64-bit integer types). */
+uint64_t
+testlib_random64(uint64_t *state)
+{
+  uint64_t r=testlib_random(state);
+  return r ^ (testlib_random(state)<<32);
+}
+
+
+
+
+
+/* A random number between 'min' (inclusive) and 'max' (exclusive). */
+double
+testlib_uniform(double min, double max, uint64_t *state)
+{
+  return min + (max-min) * (double)testlib_random(state)
+                         / (double)(1ULL<<53);
+}
+
+
+
+
+
+/* Return 1 with a probability of 'fraction' (for example to decide if an
+   element should be blank) and 0 otherwise. */
+int
+testlib_chance(double fraction, uint64_t *state)
+{
+  return testlib_uniform(0, 1, state) < fraction;
+}
+
+
+
+
+
+/* If the type is a floating point type. */
+int
+testlib_type_is_float(uint8_t type)
+{
+  return type==GAL_TYPE_FLOAT32 || type==GAL_TYPE_FLOAT64;
+}
+
+
+
+
+
+/* If the type is an unsigned integer type. */
+int
+testlib_type_is_unsigned(uint8_t type)
+{
+  return ( type==GAL_TYPE_UINT8  || type==GAL_TYPE_UINT16
+           || type==GAL_TYPE_UINT32 || type==GAL_TYPE_UINT64 );
+}
@@ -0,0 +1,53 @@
+/*********************************************************************
+Helpers that are shared by the library test programs.
+
+The test programs build their inputs from a simple (and reproducible)
+random number generator, so every run (on any system) tests the same
+inputs. The generator and the common steps to build the random inputs
+are defined here (in 'testlib.c', that is built into every program).
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#ifndef TESTLIB_H
+#define TESTLIB_H
+
+#include <stdint.h>
+
+/* Initial state of the random number generator in all the tests. */
+#define TESTLIB_SEED 1
+
+uint64_t
+testlib_random(uint64_t *state);
+
+uint64_t
+testlib_random64(uint64_t *state);
+
+double
+testlib_uniform(double min, double max, uint64_t *state);
+
+int
+testlib_chance(double fraction, uint64_t *state);
+
+int
+testlib_type_is_float(uint8_t type);
+
+int
+testlib_type_is_unsigned(uint8_t type);
+
+#endif
@@ -0,0 +1,232 @@
+/*********************************************************************
+A test program for spinning off threads with Gnuastro's library.
+
+Every action is counted by the worker that it is given to, and after
+each job, all the actions should have been counted exactly once. The jobs
+are run back-to-back (on the same pool of threads), with less actions
+than threads, from within the workers of another job (nested) and with
+all the schedules (the blocks of the block schedule are also checked).
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gnuastro/blank.h"
+#include "gnuastro/pointer.h"
+#include "gnuastro/threads.h"
+
+
+/* Number of actions of the inner jobs (that are run within a worker). */
+#define INNERACTIONS 37
+
+/* Parameters of a job. */
+struct params
+{
+  size_t     *counts;   /* Number of times each action was done.    */
+  size_t   numthreads;  /* Number of threads of the inner jobs.     */
+  int          nested;  /* Run an inner job for every action.       */
+  int        schedule;  /* How to distribute the actions.           */
+  size_t    chunksize;  /* Chunk size of the dynamic schedule.      */
+  pthread_mutex_t lock; /* To count the actions of different threads.*/
+};
+
+
+
+
+
+/* Count the actions of this thread (an action that is wrongly given to
+   two threads should be counted twice, so the counting is locked). When
+   'nested' is set, each action runs a job of its own (with
+   'INNERACTIONS' actions) and the action is only counted if all the inner
+   actions were done once. */
+static void *
+threads_worker(void *in_prm)
+{
+  struct gal_threads_params *tprm=(struct gal_threads_params *)in_prm;
+  struct params *p=(struct params *)tprm->params;
+
+  size_t i, j, ind;
+  struct params inner;
+
+  for(i=0; tprm->indexs[i] != GAL_BLANK_SIZE_T; ++i)
+    {
+      ind=tprm->indexs[i];
+      if(p->nested)
+        {
+          inner.nested=0;
+          inner.schedule=p->schedule;
+          inner.chunksize=p->chunksize;
+          pthread_mutex_init(&inner.lock, NULL);
+          inner.counts=gal_pointer_allocate(GAL_TYPE_SIZE_T, INNERACTIONS,
+                                            1, __func__, "inner.counts");
+          gal_threads_spin_off_schedule(threads_worker, &inner,
+                                        INNERACTIONS, p->numthreads,
+                                        p->schedule, p->chunksize, -1, 1);
+          for(j=0;j<INNERACTIONS;++j)
+            if(inner.counts[j]!=1) break;
+          pthread_mutex_destroy(&inner.lock);
+          free(inner.counts);
+          if(j<INNERACTIONS) continue;
+        }
+      pthread_mutex_lock(&p->lock);
+      ++p->counts[ind];
+      pthread_mutex_unlock(&p->lock);
+    }
+
+  if(tprm->b) pthread_barrier_wait(tprm->b);
+  return NULL;
+}
+
+
+
+
+
+/* Run one job and check that every action was done exactly once. */
+static int
+threads_check(size_t numactions, size_t numthreads, int nested,
+              int schedule, size_t chunksize)
+{
+  size_t i;
+  struct params p;
+
+  /* Run the job. */
+  p.nested=nested;
+  p.schedule=schedule;
+  p.chunksize=chunksize;
+  p.numthreads=numthreads;
+  pthread_mutex_init(&p.lock, NULL);
+  p.counts=gal_pointer_allocate(GAL_TYPE_SIZE_T, numactions ? numactions
+                                : 1, 1, __func__, "p.counts");
+  if(schedule==GAL_THREADS_SCHEDULE_CYCLIC)
+    gal_threads_spin_off(threads_worker, &p, numactions, numthreads,
+                         -1, 1);
+  else
+    gal_threads_spin_off_schedule(threads_worker, &p, numactions,
+                                  numthreads, schedule, chunksize, -1, 1);
+
+  /* Check the counts. */
+  for(i=0;i<numactions;++i)
+    if(p.counts[i]!=1)
+      {
+        fprintf(stderr, "%zu actions on %zu threads (nested: %d, "
+                "schedule: %d, chunk size: %zu): action %zu was done %zu "
+                "times\n", numactions, numthreads, nested, schedule,
+                chunksize, i, p.counts[i]);
+        pthread_mutex_destroy(&p.lock);
+        free(p.counts);
+        return EXIT_FAILURE;
+      }
+  pthread_mutex_destroy(&p.lock);
+  free(p.counts);
+  return EXIT_SUCCESS;
+}
+
+
+
+
+
+/* The blocks of the block schedule should be contiguous, in order, and
+   their sizes should differ by at most one. */
+static int
+threads_check_blocks(size_t numactions, size_t numthreads)
+{
+  int out=EXIT_SUCCESS;
+  size_t i, j, n, next=0, *thrds, thrdcols;
+
+  gal_threads_dist_in_threads_schedule(numactions, numthreads,
+                                       GAL_THREADS_SCHEDULE_BLOCK, -1, 1,
+                                       &thrds, &thrdcols);
+  for(i=0;i<numthreads;++i)
+    {
+      for(n=0; thrds[i*thrdcols+n]!=GAL_BLANK_SIZE_T; ++n)
+        if(thrds[i*thrdcols+n]!=next++) out=EXIT_FAILURE;
+      if( n != numactions/numthreads + (i<numactions%numthreads) )
+        out=EXIT_FAILURE;
+    }
+  if(next!=numactions) out=EXIT_FAILURE;
+  if(out==EXIT_FAILURE)
+    {
+      fprintf(stderr, "%zu actions in blocks on %zu threads:\n",
+              numactions, numthreads);
+      for(i=0;i<numthreads;++i)
+        {
+          fprintf(stderr, "  thread %zu:", i);
+          for(j=0; thrds[i*thrdcols+j]!=GAL_BLANK_SIZE_T; ++j)
+            fprintf(stderr, " %zu", thrds[i*thrdcols+j]);
+          fprintf(stderr, "\n");
+        }
+    }
+  free(thrds);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  int out=EXIT_SUCCESS;
+  size_t i, t, s, nt=gal_threads_number();
+  size_t threads[]={1, 2, 3, 8, 0}, actions[]={0, 1, 2, 5, 7, 64, 1001};
+  int schedule[]={ GAL_THREADS_SCHEDULE_CYCLIC, GAL_THREADS_SCHEDULE_BLOCK,
+                   GAL_THREADS_SCHEDULE_DYNAMIC, GAL_THREADS_SCHEDULE_DYNAMIC,
+                   GAL_THREADS_SCHEDULE_DYNAMIC };
+  size_t chunksize[]={0, 0, 0, 1, 7};   /* Only for the dynamic schedule. */
+
+  /* Some systems only have one processor, but the threads should also
+     work with more threads than processors. */
+  threads[4] = nt>1 ? nt : 4;
+
+  /* Back-to-back jobs with all the schedules, including those with less
+     actions than threads. Each is repeated so the same (persistent)
+     threads do many jobs. */
+  for(s=0;s<sizeof schedule/sizeof *schedule;++s)
+    for(t=0;t<sizeof threads/sizeof *threads;++t)
+      for(i=0;i<sizeof actions/sizeof *actions;++i)
+        if( threads_check(actions[i], threads[t], 0, schedule[s],
+                          chunksize[s])==EXIT_FAILURE
+            || threads_check(actions[i], threads[t], 0, schedule[s],
+                             chunksize[s])==EXIT_FAILURE )
+          out=EXIT_FAILURE;
+
+  /* Nested jobs: each action of the outer job spins off its own job. */
+  for(s=0;s<sizeof schedule/sizeof *schedule;++s)
+    for(t=1;t<sizeof threads/sizeof *threads;++t)
+      if( threads_check(5, threads[t], 1, schedule[s],
+                        chunksize[s])==EXIT_FAILURE
+          || threads_check(64, threads[t], 1, schedule[s],
+                           chunksize[s])==EXIT_FAILURE )
+        out=EXIT_FAILURE;
+
+  /* Another plain job after the nested ones. */
+  if( threads_check(1001, threads[4], 0, GAL_THREADS_SCHEDULE_CYCLIC,
+                    0)==EXIT_FAILURE )
+    out=EXIT_FAILURE;
+
+  /* The blocks of the block schedule. */
+  for(t=0;t<sizeof threads/sizeof *threads;++t)
+    for(i=0;i<sizeof actions/sizeof *actions;++i)
+      if( threads_check_blocks(actions[i], threads[t])==EXIT_FAILURE )
+        out=EXIT_FAILURE;
+
+  return out;
+}
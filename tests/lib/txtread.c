@@ -0,0 +1,377 @@
+/*********************************************************************
+A test program for reading plain-text tables with Gnuastro's library.
+
+Plain-text files are parsed from a memory-mapped copy by one or several
+threads (each reading a chunk of the file). The columns that are read
+from a file (on one and several threads) are compared with the columns
+that are read from the same lines in memory (like the standard input,
+where each line is parsed separately). The file is large enough to be
+read in several chunks (that start in the middle of rows or of a very
+long comment line). Its rows have blank values (numbers and strings),
+strings with delimiters and quotes, vector columns, all the delimiters,
+comment and empty lines, and some rows end with a carriage return.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gnuastro/txt.h"
+#include "gnuastro/list.h"
+#include "gnuastro/pointer.h"
+
+#include "testlib.h"
+
+
+/* Name of the temporary file. */
+#define FILENAME "txtread.txt"
+
+/* Metadata of the columns. */
+#define HEADER                                          \
+  "# A table with all kinds of tokens.\n"               \
+  "# Column 1: ID   [counts, i64,   ] Row number\n"     \
+  "# Column 2: F64  [,       f64,   -9999]\n"           \
+  "# Column 3: F32  [,       f32,   nan] Floats\n"      \
+  "# Column 4: I16  [,       i16,   --]\r\n"            \
+  "# Column 5: NAME [,       str12, N/A] A string\n"    \
+  "# Column 6: VEC  [,       i32(3), -1] A vector\n"
+
+/* Width of the string column. */
+#define STRWIDTH 12
+
+
+
+
+
+/* A random floating point token in one of many formats. */
+static int
+txtread_float(char *str, uint64_t *state)
+{
+  uint64_t r=testlib_random(state);
+  double d=testlib_uniform(-0.5, 0.5, state);
+  char *fixed[]={"nan", "-9999", "+.5", "5.", "-0", "0.000", "1e300",
+                 "4.9e-324", "000123.4500", "-1.7976931348623157e308",
+                 "12345678901234567890.5", "NaN"};
+
+  switch(r%8)
+    {
+    case 0:  return sprintf(str, "%.17g", d*pow(10, (double)(r%60)-30));
+    case 1:  return sprintf(str, "%.6f", d*2000);
+    case 2:  return sprintf(str, "%de%d", (int)(r%1000)-500,
+                            (int)(r%50)-25);
+    case 3:  return sprintf(str, "%.3E", d*1e5);
+    case 4:  return sprintf(str, "%s",
+                            fixed[r%(sizeof fixed/sizeof *fixed)]);
+    default: return sprintf(str, "%.4f", d);
+    }
+}
+
+
+
+
+
+/* A random delimiter between two tokens. */
+static char *
+txtread_delimiter(uint64_t *state)
+{
+  char *delims[]={" ", "  ", "\t", ",", " , ", ", ", "\t \t", ",\t"};
+  return delims[testlib_random(state)%(sizeof delims/sizeof *delims)];
+}
+
+
+
+
+
+/* Write one data row into 'str' and return its length. */
+static size_t
+txtread_row(char *str, size_t row, uint64_t *state)
+{
+  size_t i;
+  char *s=str;
+  uint64_t r=testlib_random(state);
+  char *names[]={"plain", "two words", "a,b,c", "\"quoted\"",
+                 "'single, q'", "N/A", "x", "with\ttab", "12 chars xyz",
+                 "#not-comment"};
+
+  /* Leading delimiters, the ID, F64 and F32. */
+  s += sprintf(s, "%s%zu%s", r%3==0 ? "" : (r%3==1 ? " " : "\t,"), row,
+               txtread_delimiter(state));
+  s += txtread_float(s, state);
+  s += sprintf(s, "%s", txtread_delimiter(state));
+  s += txtread_float(s, state);
+  s += sprintf(s, "%s", txtread_delimiter(state));
+
+  /* The 16-bit integer (some are blank, with a blank string). */
+  r=testlib_random(state);
+  switch(r%6)
+    {
+    case 0:  s += sprintf(s, "--");                          break;
+    case 1:  s += sprintf(s, "+%d", (int)(r%100));           break;
+    case 2:  s += sprintf(s, "00%d", (int)(r%100));          break;
+    default: s += sprintf(s, "%d", (int)(r%65536)-32768);
+    }
+
+  /* The string (it always has the full width, so it can be followed
+     by delimiters). */
+  r=testlib_random(state);
+  s += sprintf(s, "%s%-*s%s", txtread_delimiter(state), STRWIDTH,
+               names[r%(sizeof names/sizeof *names)], r%2 ? "  , " : "");
+
+  /* The vector column (some elements are blank). */
+  for(i=0;i<3;++i)
+    {
+      r=testlib_random(state);
+      s += sprintf(s, "%s%ld", i ? txtread_delimiter(state) : "",
+                   r%5==0 ? -1L : (long)(r%4000000000ULL)-2000000000L);
+    }
+
+  /* Trailing delimiters. */
+  r=testlib_random(state);
+  s += sprintf(s, "%s", r%4 ? "" : txtread_delimiter(state));
+
+  /* The end of the line (with a carriage return in some rows). */
+  s += sprintf(s, "%s", r%5==0 ? "\r\n" : "\n");
+  return s-str;
+}
+
+
+
+
+
+/* Write a table with 'numrows' rows into 'out'. A very long comment line
+   is written in the middle (so some chunks of the file start and end
+   inside of it), along with comment and empty lines. */
+static size_t
+txtread_table(char *out, size_t numrows, size_t longcomment,
+              uint64_t *state)
+{
+  uint64_t r;
+  size_t i, j;
+  char *s=out;
+
+  s += sprintf(s, "%s", HEADER);
+  for(i=0;i<numrows;++i)
+    {
+      /* Comment and empty lines. */
+      r=testlib_random(state);
+      switch(r%50)
+        {
+        case 0: s += sprintf(s, "# A comment line\n");     break;
+        case 1: s += sprintf(s, "   \t# Indented comment\n"); break;
+        case 2: s += sprintf(s, "\n");                     break;
+        case 3: s += sprintf(s, " , \t \n");               break;
+        case 4: s += sprintf(s, "#\r\n");                  break;
+        }
+      if(i==numrows/2 && longcomment)
+        {
+          *s++='#';
+          for(j=0;j<longcomment;++j) *s++ = 'a'+j%26;
+          *s++='\n';
+        }
+
+      /* The data row. */
+      s += txtread_row(s, i, state);
+    }
+
+  /* The last line doesn't have a new-line character. */
+  if(numrows && *(s-1)=='\n') { --s; if(*(s-1)=='\r') --s; }
+  *s='\0';
+  return s-out;
+}
+
+
+
+
+
+/* Read the table from the file (when 'lines==NULL') or the lines. */
+static gal_data_t *
+txtread_read(gal_list_str_t *lines, gal_list_sizet_t *indexll,
+             size_t numthreads)
+{
+  gal_data_t *info, *out;
+  size_t numcols, numrows;
+
+  info=gal_txt_table_info(lines ? NULL : FILENAME, lines, &numcols,
+                          &numrows);
+  out=gal_txt_table_read_threads(lines ? NULL : FILENAME, lines, numrows,
+                                 info, indexll, numthreads, -1, 1);
+  gal_data_array_free(info, numcols, 1);
+  return out;
+}
+
+
+
+
+
+/* Compare two lists of columns. */
+static int
+txtread_compare(gal_data_t *a, gal_data_t *b, size_t numthreads)
+{
+  size_t i, c, width;
+  unsigned char *x, *y;
+
+  for(c=0; a!=NULL && b!=NULL; a=a->next, b=b->next, ++c)
+    {
+      /* The type and size. */
+      if( a->type!=b->type || a->ndim!=b->ndim || a->size!=b->size )
+        {
+          fprintf(stderr, "%zu threads: output column %zu has a "
+                  "different type or size\n", numthreads, c+1);
+          return EXIT_FAILURE;
+        }
+
+      /* The values. */
+      x=a->array;
+      y=b->array;
+      width=gal_type_sizeof(a->type);
+      for(i=0;i<a->size;++i)
+        if( a->type==GAL_TYPE_STRING
+            ? strcmp(((char **)x)[i], ((char **)y)[i])
+            : ( ( a->type==GAL_TYPE_FLOAT32
+                  && isnan(((float *)x)[i]) && isnan(((float *)y)[i]) )
+                || ( a->type==GAL_TYPE_FLOAT64
+                     && isnan(((double *)x)[i])
+                     && isnan(((double *)y)[i]) )
+                ? 0
+                : memcmp(x+i*width, y+i*width, width) ) )
+          {
+            fprintf(stderr, "%zu threads: element %zu of output column "
+                    "%zu is different\n", numthreads, i, c+1);
+            return EXIT_FAILURE;
+          }
+    }
+
+  /* The number of columns. */
+  if(a!=NULL || b!=NULL)
+    {
+      fprintf(stderr, "%zu threads: different number of columns\n",
+              numthreads);
+      return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
+
+
+
+
+
+/* Read the table from the lines and from the file (on several numbers of
+   threads), with the given columns. */
+static int
+txtread_check(gal_list_str_t *lines, size_t numrows, size_t *cols,
+              size_t ncols)
+{
+  size_t i, t;
+  int out=EXIT_SUCCESS;
+  gal_list_sizet_t *indexll=NULL;
+  gal_data_t *expected, *read, *id;
+  size_t threads[]={1, 2, 3, 8, 32};
+
+  /* The columns to read. */
+  for(i=0;i<ncols;++i) gal_list_sizet_add(&indexll, cols[i]);
+  gal_list_sizet_reverse(&indexll);
+
+  /* Read the lines (the first column is the ID, which is the row
+     number). */
+  expected=txtread_read(lines, indexll, 1);
+  id = cols[0]==0 ? expected : NULL;
+  if( expected->dsize[0]!=numrows
+      || ( id && ((int64_t *)(id->array))[numrows-1]!=(int64_t)numrows-1 ) )
+    {
+      fprintf(stderr, "%zu rows were read from the lines, but there are "
+              "%zu\n", expected->dsize[0], numrows);
+      out=EXIT_FAILURE;
+    }
+
+  /* Read the file and compare. */
+  for(t=0;t<sizeof threads/sizeof *threads;++t)
+    {
+      read=txtread_read(NULL, indexll, threads[t]);
+      if( txtread_compare(expected, read, threads[t])==EXIT_FAILURE )
+        out=EXIT_FAILURE;
+      gal_list_data_free(read);
+    }
+
+  /* Clean up and return. */
+  gal_list_sizet_free(indexll);
+  gal_list_data_free(expected);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  FILE *fp;
+  size_t n;
+  char *table, *c, *l;
+  uint64_t state=TESTLIB_SEED;
+  int out=EXIT_SUCCESS;
+  gal_list_str_t *lines;
+  size_t numrows[]={1, 3, 60000}, longcomment[]={0, 0, 2500000};
+  size_t allcols[]={0, 1, 2, 3, 4, 5}, somecols[]={5, 1, 1, 3};
+
+  for(n=0;n<sizeof numrows/sizeof *numrows;++n)
+    {
+      /* Write the table into a file. */
+      table=gal_pointer_allocate(GAL_TYPE_UINT8,
+                                 1000 + 200*numrows[n] + longcomment[n],
+                                 0, __func__, "table");
+      txtread_table(table, numrows[n], longcomment[n], &state);
+      fp=fopen(FILENAME, "w");
+      if( fp==NULL || fputs(table, fp)==EOF || fclose(fp) )
+        {
+          fprintf(stderr, "couldn't write '%s'\n", FILENAME);
+          return EXIT_FAILURE;
+        }
+
+      /* Break it into lines (keeping the new-line characters, like
+         'gal_txt_stdin_read'). */
+      lines=NULL;
+      for(l=table; *l!='\0'; l=c+1)
+        {
+          c=strchr(l, '\n');
+          if(c==NULL) c=l+strlen(l)-1;
+          gal_list_str_add(&lines, strndup(l, c-l+1), 0);
+        }
+      gal_list_str_reverse(&lines);
+
+      /* Read all the columns, and some of them (in a different order
+         and repeated). */
+      if( txtread_check(lines, numrows[n], allcols,
+                        sizeof allcols/sizeof *allcols)==EXIT_FAILURE
+          || txtread_check(lines, numrows[n], somecols,
+                           sizeof somecols/sizeof *somecols)==EXIT_FAILURE )
+        out=EXIT_FAILURE;
+
+      /* Clean up. */
+      gal_list_str_free(lines, 1);
+      free(table);
+    }
+
+  /* Clean up and return. */
+  unlink(FILENAME);
+  return out;
+}
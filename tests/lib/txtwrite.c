@@ -0,0 +1,285 @@
+/*********************************************************************
+A test program for writing plain-text tables with Gnuastro's library.
+
+The rows of the table that is written with 'gal_txt_write' (and
+'gal_txt_write_threads') are compared with the rows that are printed by
+calling 'fprintf' for every value with the column's format (how plain-text
+tables were written before).
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gnuastro/txt.h"
+#include "gnuastro/list.h"
+#include "gnuastro/blank.h"
+#include "gnuastro/table.h"
+#include "gnuastro/pointer.h"
+#include "gnuastro/statistics.h"
+
+#include "testlib.h"
+
+
+/* Number of rows in the table. */
+#define NUMROWS 20000
+
+/* Maximum length of one row (the '%f' of very large numbers is long). */
+#define MAXROW 8192
+
+
+
+
+
+/* Special values that will be put in the first rows of the floating point
+   columns. */
+static double special[]={ NAN, INFINITY, -INFINITY, 0.0, -0.0, 0.5, 1.5,
+                          2.5, -2.5, 0.125, 0.05, 9.9999999995, 1e22, 1e23,
+                          -1e23, 123456789.0, 1e-5, DBL_MAX, -DBL_MAX,
+                          DBL_MIN, 4.9e-324, FLT_MAX, FLT_MIN, 1e300,
+                          -1e-300, 0.1, 0.3, 2.0/3.0 };
+
+
+
+
+
+/* A floating point number with a random sign, mantissa and power of 10
+   (between 10^-'maxpow' and 10^'maxpow'). */
+static double
+txtwrite_random_float(uint64_t *state, int maxpow)
+{
+  double mant=testlib_uniform(0, 1, state);
+  int p10=(int)(testlib_random(state)%(2*maxpow+1)) - maxpow;
+  return (testlib_random(state)%2 ? -1 : 1) * mant * pow(10, p10);
+}
+
+
+
+
+
+/* Allocate a column and set its display format. */
+static gal_data_t *
+txtwrite_column(gal_data_t **list, uint8_t type, char *name, int fmt,
+                int width, int precision)
+{
+  size_t nrows=NUMROWS;
+  gal_data_t *col=gal_data_alloc(NULL, type, 1, &nrows, NULL, 0, -1, 1,
+                                 name, NULL, NULL);
+  col->disp_fmt=fmt;
+  col->disp_width=width;
+  col->disp_precision=precision;
+  gal_list_data_add(list, col);
+  return col;
+}
+
+
+
+
+
+/* The 'printf' format of a column (like the old 'txt_fmts_for_printf'
+   in 'lib/txt.c'). */
+static void
+txtwrite_printf_fmt(gal_data_t *col, char *fmt)
+{
+  size_t i, len;
+  int width=col->disp_width;
+  char c, *lng, **strarr=col->array;
+  int hasneg = ( col->type==GAL_TYPE_STRING
+                 ? 0 : gal_statistics_has_negative(col) );
+
+  /* Conversion character and length modifier. */
+  lng = col->type==GAL_TYPE_INT64 ? "l" : "";
+  switch(col->type)
+    {
+    case GAL_TYPE_STRING:
+      c='s';
+      for(i=0;i<col->size;++i)
+        if( (len=strlen(strarr[i])) > width ) width=len;
+      break;
+    case GAL_TYPE_INT64: c='d'; break;
+    default:
+      c = ( col->disp_fmt==GAL_TABLE_DISPLAY_FMT_FIXED ? 'f'
+            : ( col->disp_fmt==GAL_TABLE_DISPLAY_FMT_GENERAL ? 'g'
+                : 'e' ) );
+    }
+
+  /* The last column has no width and no space after it. */
+  if(col->next)
+    {
+      if(col->disp_precision==GAL_BLANK_INT)
+        sprintf(fmt, hasneg ? "%% -%d%s%c " : "%%-%d%s%c ", width, lng, c);
+      else
+        sprintf(fmt, hasneg ? "%% -%d.%d%s%c " : "%%-%d.%d%s%c ", width,
+                col->disp_precision, lng, c);
+    }
+  else
+    {
+      if(col->disp_precision==GAL_BLANK_INT)
+        sprintf(fmt, hasneg ? "%% %s%c" : "%%%s%c", lng, c);
+      else
+        sprintf(fmt, hasneg ? "%% .%d%s%c" : "%%.%d%s%c",
+                col->disp_precision, lng, c);
+    }
+}
+
+
+
+
+
+/* Compare the rows (non-comment lines) of the written file with the
+   rows printed with 'fprintf'. */
+static int
+txtwrite_compare(char *written, char *printed)
+{
+  size_t row=0;
+  int out=EXIT_SUCCESS;
+  FILE *fw=fopen(written, "r"), *fp=fopen(printed, "r");
+  char *lw=malloc(MAXROW), *lp=malloc(MAXROW);
+
+  if(fw==NULL || fp==NULL || lw==NULL || lp==NULL)
+    { fprintf(stderr, "couldn't open the files or allocate\n");
+      return EXIT_FAILURE; }
+
+  while( fgets(lp, MAXROW, fp) )
+    {
+      /* Skip the comments of the written file. */
+      do if( fgets(lw, MAXROW, fw)==NULL ) { lw[0]='\0'; break; }
+      while(lw[0]=='#');
+
+      /* Compare the row. */
+      if( strcmp(lw, lp) )
+        {
+          fprintf(stderr, "%s: row %zu differs from 'fprintf':\n"
+                  "  written: %s  fprintf: %s", written, row, lw, lp);
+          out=EXIT_FAILURE;
+          break;
+        }
+      ++row;
+    }
+  if( out==EXIT_SUCCESS && fgets(lw, MAXROW, fw) )
+    {
+      fprintf(stderr, "%s: has more rows than expected\n", written);
+      out=EXIT_FAILURE;
+    }
+
+  fclose(fw);
+  fclose(fp);
+  free(lw);
+  free(lp);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  FILE *fp;
+  uint64_t state=TESTLIB_SEED;
+  char fmt[7][64];
+  size_t i, c, nspecial=sizeof special/sizeof *special;
+  gal_data_t *cols=NULL, *col, *e64, *f64, *g64, *e32, *g32, *i64, *str;
+  char *written="txtwrite.txt", *written4="txtwrite-4.txt";
+  char *printed="txtwrite-printf.txt";
+
+  /* Build the columns (the list is built in reverse). */
+  e64=txtwrite_column(&cols, GAL_TYPE_FLOAT64, "LASTE64",
+                      GAL_TABLE_DISPLAY_FMT_EXP, 0, 16);
+  str=txtwrite_column(&cols, GAL_TYPE_STRING,  "STRING",
+                      GAL_TABLE_DISPLAY_FMT_STRING, 0, GAL_BLANK_INT);
+  i64=txtwrite_column(&cols, GAL_TYPE_INT64,   "INT64",
+                      GAL_TABLE_DISPLAY_FMT_DECIMAL, 21, GAL_BLANK_INT);
+  g32=txtwrite_column(&cols, GAL_TYPE_FLOAT32, "G32",
+                      GAL_TABLE_DISPLAY_FMT_GENERAL, 13, 6);
+  e32=txtwrite_column(&cols, GAL_TYPE_FLOAT32, "E32",
+                      GAL_TABLE_DISPLAY_FMT_EXP, 15, 7);
+  g64=txtwrite_column(&cols, GAL_TYPE_FLOAT64, "G64",
+                      GAL_TABLE_DISPLAY_FMT_GENERAL, 24, 17);
+  f64=txtwrite_column(&cols, GAL_TYPE_FLOAT64, "F64",
+                      GAL_TABLE_DISPLAY_FMT_FIXED, 25, 9);
+
+  /* Fill the columns: the special values come first. */
+  for(i=0;i<NUMROWS;++i)
+    {
+      ((double *)f64->array)[i] = ( i<nspecial ? special[i]
+                                    : txtwrite_random_float(&state, 30) );
+      ((double *)g64->array)[i] = ( i<nspecial ? special[i]
+                                    : txtwrite_random_float(&state, 300) );
+      ((float *)e32->array)[i]  = ( i<nspecial ? special[i]
+                                    : txtwrite_random_float(&state, 37) );
+      ((float *)g32->array)[i]  = ( i<nspecial ? special[i]
+                                    : txtwrite_random_float(&state, 37) );
+      ((int64_t *)i64->array)[i] = ( i==0 ? INT64_MIN
+                                     : ( i==1 ? INT64_MAX
+                                         : (int64_t)testlib_random(&state)
+                                           - (int64_t)(1ULL<<52) ) );
+      ((double *)e64->array)[i] = ( i<nspecial ? special[nspecial-1-i]
+                                    : txtwrite_random_float(&state, 300) );
+      ((char **)str->array)[i]=gal_pointer_allocate(GAL_TYPE_UINT8, 8, 0,
+                                                    __func__, "str");
+      sprintf(((char **)str->array)[i], "s%zu",
+              (size_t)testlib_random(&state)%100000);
+    }
+
+  /* Print the rows with 'fprintf' (before writing the table, because
+     writing may change the display width of the columns). */
+  for(c=0, col=cols; col!=NULL; col=col->next, ++c)
+    txtwrite_printf_fmt(col, fmt[c]);
+  fp=fopen(printed, "w");
+  if(fp==NULL) { fprintf(stderr, "can't open %s\n", printed);
+                 return EXIT_FAILURE; }
+  for(i=0;i<NUMROWS;++i)
+    {
+      for(c=0, col=cols; col!=NULL; col=col->next, ++c)
+        switch(col->type)
+          {
+          case GAL_TYPE_FLOAT32:
+            fprintf(fp, fmt[c], ((float *)col->array)[i]);       break;
+          case GAL_TYPE_FLOAT64:
+            fprintf(fp, fmt[c], ((double *)col->array)[i]);      break;
+          case GAL_TYPE_INT64:
+            fprintf(fp, fmt[c], ((int64_t *)col->array)[i]);     break;
+          case GAL_TYPE_STRING:
+            fprintf(fp, fmt[c], ((char **)col->array)[i]);       break;
+          }
+      fprintf(fp, "\n");
+    }
+  fclose(fp);
+
+  /* Write the table on one thread and on four threads. */
+  unlink(written);
+  unlink(written4);
+  gal_txt_write(cols, NULL, NULL, written, 0, 0, 0);
+  gal_txt_write_threads(cols, NULL, NULL, written4, 0, 0, 0, 4);
+
+  /* Compare the outputs. */
+  if( txtwrite_compare(written,  printed)==EXIT_FAILURE
+      || txtwrite_compare(written4, printed)==EXIT_FAILURE )
+    return EXIT_FAILURE;
+
+  /* Clean up and return. */
+  gal_list_data_free(cols);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,484 @@
+/*********************************************************************
+A test program for converting coordinates with Gnuastro's WCS library.
+
+The coordinates that are converted with 'gal_wcs_img_to_world_threads'
+and 'gal_wcs_world_to_img_threads' (on one and several threads) are
+compared with the coordinates that are converted with WCSLIB's 'wcsp2s'
+and 'wcss2p'. The WCSs have two dimensions and cover the cases that are
+converted natively by Gnuastro: the TAN projection (with equatorial or
+galactic coordinates, or with the latitude as the first axis) without
+distortion, or with SIP or TPV distortions. Their linear transformation
+is given with the CD matrix or with the PC matrix and CDELT, and the
+reference point is anywhere on the sky (also near and on the celestial
+poles, with or without LONPOLE). A WCS that is only converted by WCSLIB
+(the SIN projection) is also checked. The converted pixels cover a large
+image and some world coordinates are behind the projection plane.
+
+Original author:
+     agent <agent@local>
+Contributing author(s):
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+Gnuastro is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by the
+Free Software Foundation, either version 3 of the License, or (at your
+option) any later version.
+
+Gnuastro is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Gnuastro. If not, see <http://www.gnu.org/licenses/>.
+**********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <wcslib/wcshdr.h>
+
+#include "gnuastro/wcs.h"
+#include "gnuastro/list.h"
+#include "gnuastro/pointer.h"
+
+#include "testlib.h"
+
+
+/* Number of coordinates to convert (more than one chunk). */
+#define NUMCOORD 10000
+
+/* Maximum number of keywords in a header. */
+#define MAXKEYS 80
+
+/* Largest acceptable differences with WCSLIB: in degrees for the world
+   coordinates and in pixels for the image coordinates. */
+#define WORLDTOL 1e-9
+#define PIXELTOL 1e-6
+
+/* The types of WCS. */
+enum kind
+  {
+    KIND_TAN,
+    KIND_SWAPPED,             /* The latitude is the first axis.        */
+    KIND_GALACTIC,
+    KIND_SIP,
+    KIND_TPV,
+    KIND_SIN,                 /* Not converted natively.                */
+    KIND_NUMBER,              /* Number of kinds (must be last).        */
+  };
+
+/* Position of the reference point. */
+enum pole
+  {
+    POLE_NONE,
+    POLE_NEARNORTH,
+    POLE_NEARSOUTH,
+    POLE_NORTH,
+    POLE_NUMBER,              /* Number of positions (must be last).    */
+  };
+
+/* A header and the number of its keywords. */
+struct wcsconvert_header
+{
+  int              nkeys;
+  char  keys[MAXKEYS*80+1];
+};
+
+
+
+
+
+/* Add a keyword (with the value in the given format) to the header. */
+static void
+wcsconvert_key(struct wcsconvert_header *h, const char *name,
+               const char *format, ...)
+{
+  va_list args;
+  char value[81];
+
+  if(h->nkeys>=MAXKEYS-1)
+    {
+      fprintf(stderr, "%s: too many keywords\n", __func__);
+      exit(EXIT_FAILURE);
+    }
+  va_start(args, format);
+  vsnprintf(value, sizeof value, format, args);
+  va_end(args);
+  snprintf(h->keys+h->nkeys*80, 81, "%-8s= %-70s", name, value);
+  ++h->nkeys;
+}
+
+
+
+
+
+/* A random header of the given kind ('pc' is non-zero for using the PC
+   matrix and CDELT instead of the CD matrix). */
+static void
+wcsconvert_make_header(struct wcsconvert_header *h, int kind, int pc,
+                       int pole, int lonpole, uint64_t *state)
+{
+  char name[9];
+  size_t i, m, n, d, order;
+  double s, scale, tpvscale;
+  const char *ctype[KIND_NUMBER][2]={ {"'RA---TAN'",     "'DEC--TAN'"},
+                                      {"'DEC--TAN'",     "'RA---TAN'"},
+                                      {"'GLON-TAN'",     "'GLAT-TAN'"},
+                                      {"'RA---TAN-SIP'", "'DEC--TAN-SIP'"},
+                                      {"'RA---TPV'",     "'DEC--TPV'"},
+                                      {"'RA---SIN'",     "'DEC--SIN'"} };
+  double cd=testlib_uniform(1e-5, 3e-4, state);
+  double rot=testlib_uniform(0, 2*M_PI, state);
+
+  /* Basic keywords. */
+  h->nkeys=0;
+  wcsconvert_key(h, "NAXIS", "2");
+  wcsconvert_key(h, "CTYPE1", "%s", ctype[kind][0]);
+  wcsconvert_key(h, "CTYPE2", "%s", ctype[kind][1]);
+  wcsconvert_key(h, "CRPIX1", "%.6f",
+                 testlib_uniform(-100, 4000, state));
+  wcsconvert_key(h, "CRPIX2", "%.6f",
+                 testlib_uniform(-100, 4000, state));
+  wcsconvert_key(h, kind==KIND_SWAPPED ? "CRVAL2" : "CRVAL1", "%.10f",
+                 testlib_uniform(-180, 360, state));
+  switch(pole)
+    {
+    case POLE_NONE:      s=testlib_uniform(-80, 80, state);     break;
+    case POLE_NEARNORTH: s=testlib_uniform(89, 89.99, state);   break;
+    case POLE_NEARSOUTH: s=-testlib_uniform(89, 89.99, state);  break;
+    case POLE_NORTH:     s=90;                                     break;
+    default:
+      fprintf(stderr, "%s: pole code %d is not recognized\n", __func__,
+              pole);
+      exit(EXIT_FAILURE);
+    }
+  wcsconvert_key(h, kind==KIND_SWAPPED ? "CRVAL1" : "CRVAL2", "%.10f", s);
+  if(lonpole)
+    wcsconvert_key(h, "LONPOLE", "%.5f",
+                   testlib_uniform(0, 360, state));
+
+  /* The linear transformation (slightly skewed). */
+  if(pc)
+    {
+      wcsconvert_key(h, "CDELT1", "%.10g",
+                     -cd*testlib_uniform(0.5, 2, state));
+      wcsconvert_key(h, "CDELT2", "%.10g",
+                     cd*testlib_uniform(0.5, 2, state));
+      wcsconvert_key(h, "PC1_1", "%.12g", cos(rot));
+      wcsconvert_key(h, "PC1_2", "%.12g", 1.1*sin(rot));
+      wcsconvert_key(h, "PC2_1", "%.12g", -sin(rot));
+      wcsconvert_key(h, "PC2_2", "%.12g", cos(rot));
+    }
+  else
+    {
+      wcsconvert_key(h, "CD1_1", "%.12g", -cd*cos(rot));
+      wcsconvert_key(h, "CD1_2", "%.12g", cd*sin(rot));
+      wcsconvert_key(h, "CD2_1", "%.12g", 0.9*cd*sin(rot));
+      wcsconvert_key(h, "CD2_2", "%.12g", cd*cos(rot));
+    }
+
+  /* SIP distortion (a few pixels over the image). */
+  if(kind==KIND_SIP)
+    {
+      order=2+testlib_random(state)%4;
+      wcsconvert_key(h, "A_ORDER", "%zu", order);
+      wcsconvert_key(h, "B_ORDER", "%zu", order);
+      for(m=0;m<=order;++m)
+        for(n=0;m+n<=order;++n)
+          if(m+n>=2)
+            {
+              s=pow(3000, -(double)(m+n))*testlib_uniform(-3, 3, state);
+              sprintf(name, "A_%zu_%zu", m, n);
+              wcsconvert_key(h, name, "%.12g", s);
+              sprintf(name, "B_%zu_%zu", m, n);
+              wcsconvert_key(h, name, "%.12g",
+                             -s*testlib_uniform(0, 2, state));
+            }
+    }
+
+  /* TPV distortion: the input of the polynomials is in degrees with the
+     CD matrix and in pixels with the PC matrix, so the coefficients are
+     scaled by the size of the image in those units. */
+  if(kind==KIND_TPV)
+    {
+      tpvscale = pc ? 4000 : 4000*cd;
+      wcsconvert_key(h, "PV1_0", "%.12g",
+                     testlib_uniform(-1e-5, 1e-5, state));
+      wcsconvert_key(h, "PV1_1", "%.12g",
+                     1+testlib_uniform(-1e-3, 1e-3, state));
+      wcsconvert_key(h, "PV2_1", "%.12g",
+                     1+testlib_uniform(-1e-3, 1e-3, state));
+      wcsconvert_key(h, "PV2_2", "%.12g",
+                     testlib_uniform(-1e-3, 1e-3, state));
+      for(i=3;i<40;++i)
+        if(testlib_random(state)%3==0)
+          {
+            d = ( i<4 ? 1 : i<7 ? 2 : i<12 ? 3 : i<17 ? 4 : i<24 ? 5
+                  : i<31 ? 6 : 7 );
+            scale=2e-5*pow(tpvscale, -(double)(d-1));
+            sprintf(name, "PV%d_%zu", 1+(int)(testlib_random(state)%2),
+                    i);
+            wcsconvert_key(h, name, "%.12g",
+                           scale*testlib_uniform(-1, 1, state));
+          }
+    }
+
+  /* End the header. */
+  snprintf(h->keys+h->nkeys*80, 81, "%-80s", "END");
+  ++h->nkeys;
+}
+
+
+
+
+
+/* Print the header (one keyword on each line). */
+static void
+wcsconvert_print_header(struct wcsconvert_header *h)
+{
+  int i;
+  for(i=0;i<h->nkeys;++i)
+    fprintf(stderr, "  %.80s\n", h->keys+i*80);
+}
+
+
+
+
+
+/* Read the WCS from the header with WCSLIB. */
+static struct wcsprm *
+wcsconvert_wcs(struct wcsconvert_header *h)
+{
+  struct wcsprm *wcs;
+  int nreject, nwcs, status;
+
+  status=wcspih(h->keys, h->nkeys, WCSHDR_all, 0, &nreject, &nwcs, &wcs);
+  if(status || nwcs<1 || wcsset(wcs))
+    {
+      fprintf(stderr, "%s: the WCS couldn't be read (status %d) from "
+              "this header:\n", __func__, status);
+      wcsconvert_print_header(h);
+      exit(EXIT_FAILURE);
+    }
+  return wcs;
+}
+
+
+
+
+
+/* Two columns of 64-bit floating point coordinates with the values of
+   the given (WCSLIB) array. */
+static gal_data_t *
+wcsconvert_columns(double *array)
+{
+  size_t i, n=NUMCOORD;
+  gal_data_t *out=NULL;
+  double *c[2];
+
+  gal_list_data_add_alloc(&out, NULL, GAL_TYPE_FLOAT64, 1, &n, NULL, 0,
+                          -1, 1, NULL, NULL, NULL);
+  gal_list_data_add_alloc(&out, NULL, GAL_TYPE_FLOAT64, 1, &n, NULL, 0,
+                          -1, 1, NULL, NULL, NULL);
+  c[0]=out->array;
+  c[1]=out->next->array;
+  for(i=0;i<n;++i)
+    {
+      c[0][i]=array[i*2];
+      c[1][i]=array[i*2+1];
+    }
+  return out;
+}
+
+
+
+
+
+/* Difference between two world coordinates (in degrees). The longitudes
+   should be in the same range (like WCSLIB's outputs), so they can only
+   differ by 360 degrees when they are on the border of the range. */
+static double
+wcsconvert_world_diff(struct wcsprm *wcs, double *a, double *b)
+{
+  double r, dlng=fabs(a[wcs->lng]-b[wcs->lng]);
+
+  if(dlng>180.0)
+    {
+      r=fmod(fabs(b[wcs->lng]), 360.0);
+      dlng = ( r<WORLDTOL || r>360.0-WORLDTOL
+               ? fabs(dlng-360.0) : INFINITY );
+    }
+  return ( dlng*cos(a[wcs->lat]*M_PI/180.0)
+           + fabs(a[wcs->lat]-b[wcs->lat]) );
+}
+
+
+
+
+
+/* Convert the coordinates in 'in' (in WCSLIB's format) with Gnuastro (on
+   one and several threads) and compare them with 'expected' (where the
+   coordinates that can't be converted have a non-zero 'stat'). */
+static int
+wcsconvert_check(struct wcsprm *wcs, struct wcsconvert_header *h,
+                 int img2world, double *in, double *expected, int *stat)
+{
+  int bad;
+  size_t i, t;
+  double diff, g[2];
+  int out=EXIT_SUCCESS;
+  gal_data_t *coords, *conv[2];
+  double *c[2], *c4[2];
+  size_t threads[2]={1, 4};
+
+  /* Do the conversion. */
+  coords=wcsconvert_columns(in);
+  for(t=0;t<2;++t)
+    conv[t] = ( img2world
+                ? gal_wcs_img_to_world_threads(coords, wcs, 0, threads[t])
+                : gal_wcs_world_to_img_threads(coords, wcs, 0,
+                                               threads[t]) );
+  c[0]=conv[0]->array;   c[1]=conv[0]->next->array;
+  c4[0]=conv[1]->array;  c4[1]=conv[1]->next->array;
+
+  /* Compare the outputs. */
+  for(i=0;i<NUMCOORD;++i)
+    {
+      /* The output on several threads must be identical. */
+      if( memcmp(&c[0][i], &c4[0][i], sizeof *c[0])
+          || memcmp(&c[1][i], &c4[1][i], sizeof *c[1]) )
+        {
+          fprintf(stderr, "%s on %zu threads: coordinate %zu is "
+                  "different from one thread\n", img2world
+                  ? "img-to-world" : "world-to-img", threads[1], i);
+          out=EXIT_FAILURE;
+          break;
+        }
+
+      /* Compare with WCSLIB (the coordinates that WCSLIB can't convert
+         should be blank). */
+      g[0]=c[0][i];
+      g[1]=c[1][i];
+      bad = stat[i] || isnan(expected[i*2]) || isnan(expected[i*2+1]);
+      if( bad || isnan(g[0]) || isnan(g[1]) )
+        diff = ( bad && isnan(g[0]) && isnan(g[1]) ) ? 0.0 : INFINITY;
+      else
+        diff = ( img2world
+                 ? wcsconvert_world_diff(wcs, g, expected+i*2)
+                 : ( fabs(g[0]-expected[i*2])
+                     + fabs(g[1]-expected[i*2+1]) ) );
+      if( diff > (img2world ? WORLDTOL : PIXELTOL) )
+        {
+          fprintf(stderr, "%s: (%.12g, %.12g) is converted to (%.12g, "
+                  "%.12g), but WCSLIB converts it to (%.12g, %.12g) "
+                  "with status %d. The header:\n", img2world
+                  ? "img-to-world" : "world-to-img", in[i*2], in[i*2+1],
+                  g[0], g[1], expected[i*2], expected[i*2+1], stat[i]);
+          wcsconvert_print_header(h);
+          out=EXIT_FAILURE;
+          break;
+        }
+    }
+
+  /* Clean up and return. */
+  gal_list_data_free(coords);
+  gal_list_data_free(conv[0]);
+  gal_list_data_free(conv[1]);
+  return out;
+}
+
+
+
+
+
+/* Convert random pixels (and the world coordinates of WCSLIB) with both
+   Gnuastro and WCSLIB. */
+static int
+wcsconvert_wcs_check(struct wcsprm *wcs, struct wcsconvert_header *h,
+                     uint64_t *state)
+{
+  size_t i;
+  int out=EXIT_SUCCESS;
+  int *stat=gal_pointer_allocate(GAL_TYPE_INT, NUMCOORD, 1, __func__,
+                                 "stat");
+  double *phi=gal_pointer_allocate(GAL_TYPE_FLOAT64, NUMCOORD, 0,
+                                   __func__, "phi");
+  double *theta=gal_pointer_allocate(GAL_TYPE_FLOAT64, NUMCOORD, 0,
+                                     __func__, "theta");
+  double *pix=gal_pointer_allocate(GAL_TYPE_FLOAT64, 2*NUMCOORD, 0,
+                                   __func__, "pix");
+  double *img=gal_pointer_allocate(GAL_TYPE_FLOAT64, 2*NUMCOORD, 0,
+                                   __func__, "img");
+  double *world=gal_pointer_allocate(GAL_TYPE_FLOAT64, 2*NUMCOORD, 0,
+                                     __func__, "world");
+
+  /* Random pixels over a large image, the reference pixel and a blank
+     pixel. */
+  for(i=0;i<2*NUMCOORD;++i)
+    pix[i]=testlib_uniform(-500, 4500, state);
+  pix[0]=wcs->crpix[0];
+  pix[1]=wcs->crpix[1];
+  pix[2]=NAN;
+
+  /* Image to world coordinates. */
+  wcsp2s(wcs, NUMCOORD, 2, pix, img, phi, theta, world, stat);
+  if( wcsconvert_check(wcs, h, 1, pix, world, stat)==EXIT_FAILURE )
+    out=EXIT_FAILURE;
+
+  /* World to image coordinates (of the same pixels), with some points
+     behind the projection plane (opposite the reference point). */
+  for(i=0;i<NUMCOORD;++i)
+    if(i%50==7)
+      {
+        world[i*2+wcs->lng] = fmod(wcs->crval[wcs->lng]+180.0, 360.0);
+        world[i*2+wcs->lat] = ( -wcs->crval[wcs->lat]
+                                + testlib_uniform(-1, 1, state) );
+        world[i*2+wcs->lat] = ( world[i*2+wcs->lat]>90.0 ? 90.0
+                                : world[i*2+wcs->lat]<-90.0 ? -90.0
+                                : world[i*2+wcs->lat] );
+      }
+  memset(stat, 0, NUMCOORD*sizeof *stat);
+  wcss2p(wcs, NUMCOORD, 2, world, phi, theta, img, pix, stat);
+  if( wcsconvert_check(wcs, h, 0, world, pix, stat)==EXIT_FAILURE )
+    out=EXIT_FAILURE;
+
+  /* Clean up and return. */
+  free(pix);
+  free(img);
+  free(phi);
+  free(stat);
+  free(theta);
+  free(world);
+  return out;
+}
+
+
+
+
+
+int
+main(void)
+{
+  int nwcs=1;
+  uint64_t state=TESTLIB_SEED;
+  struct wcsprm *wcs;
+  struct wcsconvert_header h;
+  int kind, pc, pole, lonpole, out=EXIT_SUCCESS;
+
+  for(kind=0;kind<KIND_NUMBER;++kind)
+    for(pc=0;pc<2;++pc)
+      for(pole=0;pole<POLE_NUMBER;++pole)
+        for(lonpole=0;lonpole<2;++lonpole)
+          {
+            wcsconvert_make_header(&h, kind, pc, pole, lonpole, &state);
+            wcs=wcsconvert_wcs(&h);
+            if( wcsconvert_wcs_check(wcs, &h, &state)==EXIT_FAILURE )
+              out=EXIT_FAILURE;
+            wcsvfree(&nwcs, &wcs);
+          }
+
+  return out;
+}
@@ -0,0 +1,78 @@
+# Make a catalog while reading the inputs in bands of rows and compare it
+# with the catalog from the full inputs.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     agent <agent@local>
+# Contributing author(s):
+# Copyright (C) 2026 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=mkcatalog
+execname=../bin/$prog/ast$prog
+labels=connected-components.fits
+base=convolve_spatial_noised_detected.fits
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created.";  exit 77; fi
+if [ ! -f $labels   ]; then echo "$labels does not exist."; exit 77; fi
+if [ ! -f $base     ]; then echo "$base does not exist.";   exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# Make the catalog from the full inputs and in bands of rows (with a
+# number of rows that isn't a divisor of the image size, so objects cross
+# several bands and the last band is smaller).
+$check_with_program $execname $labels -h1 --valuesfile=$base \
+                    --tableformat=txt --output=bandrows-full.txt \
+                    --ids --x --y --geo-x --geo-y --area --sum \
+                    --min-x --max-x --min-y --max-y --semi-major \
+                    --axis-ratio
+$check_with_program $execname $labels -h1 --valuesfile=$base \
+                    --tableformat=txt --output=bandrows-bands.txt \
+                    --ids --x --y --geo-x --geo-y --area --sum \
+                    --min-x --max-x --min-y --max-y --semi-major \
+                    --axis-ratio --bandrows=7
+
+# The measurements (not the comments) should be identical.
+grep -v '^#' bandrows-full.txt  > bandrows-full-rows.txt
+grep -v '^#' bandrows-bands.txt > bandrows-bands-rows.txt
+cmp bandrows-full-rows.txt bandrows-bands-rows.txt
@@ -0,0 +1,78 @@
+# Make the profiles of the first mosaic with a radial look-up table and
+# compare them with the profiles that were made without it.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     agent <agent@local>
+# Contributing author(s):
+# Copyright (C) 2026 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=mkprof
+ref=mkprofcat1.fits
+execname=../bin/$prog/ast$prog
+arith=$progbdir/astarithmetic
+cat=$topsrc/tests/$prog/mkprofcat1.txt
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $arith    ]; then echo "$arith not created.";    exit 77; fi
+if [ ! -f $cat      ]; then echo "$cat does not exist.";   exit 77; fi
+if [ ! -f $ref      ]; then echo "$ref does not exist.";   exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# The same options as 'mosaic1.sh', but with a radial look-up table for
+# the pixels that are not integrated.
+$check_with_program $execname $cat --mergedsize=100,100 --zeropoint=0 \
+                              --radialtable=1e-4 \
+                              --output=mkprof-radialtable.fits
+
+# Every pixel value is the (normalized) sum of positive profile values
+# that are each within the tolerance of the direct evaluation. So the
+# relative difference of every pixel should be of the same order (pixels
+# that are zero in both images give NaN and are ignored by 'maxvalue').
+maxrel=$($arith mkprof-radialtable.fits $ref - abs $ref / maxvalue \
+                --quiet)
+if ! echo "$maxrel" | $AWK '{exit !($1<=1e-3)}'; then
+    echo "Radial table differs from the profile by a fraction of $maxrel"
+    exit 1
+fi
@@ -0,0 +1,85 @@
+# Make many overlapping profiles with '--replace' on one and several
+# threads and compare the two outputs.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     agent <agent@local>
+# Contributing author(s):
+# Copyright (C) 2026 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=mkprof
+execname=../bin/$prog/ast$prog
+arith=$progbdir/astarithmetic
+cat=mkprof-replace-threads.txt
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+if [ ! -f $arith    ]; then echo "$arith not created.";    exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# The catalog has 400 profiles over a 600x600 image (with many profiles
+# overlapping each other, some partially outside the image). Their
+# overlapping pixels are much more than the pixels of one batch of the
+# writer, so the profiles are merged in several batches while the
+# builders are still running. With '--replace', the value of each pixel
+# doesn't depend on the order of the profiles, so the two outputs should
+# be identical.
+$AWK 'BEGIN{ f[0]="sersic"; f[1]="moffat"; f[2]="gaussian";
+             for(i=1;i<=400;++i)
+               printf "%d %g %g %s %g %g %g %g %g %g\n", i,
+                      (i*37)%640-20, (i*53)%640-20, f[i%3], 5+i%17,
+                      1+(i%7)/2, (i*29)%180, 0.3+(i%8)/10, -5-(i%9),
+                      5 }' > $cat
+for nt in 1 4; do
+    $check_with_program $execname $cat --mergedsize=600,600 --replace \
+                                  --numthreads=$nt --zeropoint=0 \
+                                  --output=mkprof-replace-$nt.fits
+done
+
+# The two outputs should be identical.
+maxdiff=$($arith mkprof-replace-1.fits mkprof-replace-4.fits - abs \
+                 maxvalue --quiet)
+if ! echo "$maxdiff" | $AWK '{exit !($1==0)}'; then
+    echo "Outputs on one and four threads differ by up to $maxdiff"
+    exit 1
+fi
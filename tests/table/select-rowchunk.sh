@@ -0,0 +1,79 @@
+# Select rows by value while reading the table in chunks of rows and
+# compare it with the selection on the full table.
+#
+# See the Tests subsection of the manual for a complete explanation
+# (in the Installing gnuastro section).
+#
+# Original author:
+#     agent <agent@local>
+# Contributing author(s):
+# Copyright (C) 2026 Free Software Foundation, Inc.
+#
+# Copying and distribution of this file, with or without modification,
+# are permitted in any medium without royalty provided the copyright
+# notice and this notice are preserved.  This file is offered as-is,
+# without any warranty.
+
+
+
+
+
+# Preliminaries
+# =============
+#
+# Set the variables (The executable is in the build tree). Do the
+# basic checks to see if the executable is made or if the defaults
+# file exists (basicchecks.sh is in the source tree).
+prog=table
+execname=../bin/$prog/ast$prog
+
+
+
+
+
+# Skip?
+# =====
+#
+# If the dependencies of the test don't exist, then skip it. There are two
+# types of dependencies:
+#
+#   - The executable was not made (for example due to a configure option),
+#
+#   - The input data was not made (for example the test that created the
+#     data file failed).
+if [ ! -f $execname ]; then echo "$execname not created."; exit 77; fi
+
+
+
+
+
+# Actual test script
+# ==================
+#
+# 'check_with_program' can be something like Valgrind or an empty
+# string. Such programs will execute the command if present and help in
+# debugging when the developer doesn't have access to the user's system.
+#
+# Build a FITS table with many rows (including blank values and strings),
+# so the selected rows are spread over many chunks.
+$AWK 'BEGIN{ print "# Column 1: ID   [counter, i32]"; \
+             print "# Column 2: X    [pixel, f64]";   \
+             print "# Column 3: Y    [pixel, f32]";   \
+             print "# Column 4: NAME [name, str7]";   \
+             for(i=1;i<=1000;++i)                     \
+               printf "%d %d %s obj%d\n", i, (i*37)%1000, \
+                      i%7 ? sprintf("%.3f", i/3) : "nan", i }' \
+     > table-rowchunk-in.txt
+$check_with_program $execname table-rowchunk-in.txt \
+                    --output=table-rowchunk.fits
+
+# Select the rows on the full table and in chunks (with a chunk size that
+# isn't a multiple of the number of rows) and sort the selected rows.
+$check_with_program $execname table-rowchunk.fits --range=X,100:600 \
+                    --noblank=Y --sort=Y --output=table-rowchunk-full.txt
+$check_with_program $execname table-rowchunk.fits --range=X,100:600 \
+                    --noblank=Y --sort=Y --rowchunk=64 \
+                    --output=table-rowchunk-chunks.txt
+
+# The two outputs should be identical.
+cmp table-rowchunk-full.txt table-rowchunk-chunks.txt